@@ -0,0 +1,82 @@
+//***************************************************************************************
+// PickQueue.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "PickQueue.h"
+
+PickQueue::PickQueue()
+	: mProjScaleX(1.0f), mProjScaleY(1.0f), mClientWidth(1), mClientHeight(1)
+{
+	XMStoreFloat4x4(&mInvView, XMMatrixIdentity());
+}
+
+PickQueue::~PickQueue()
+{
+}
+
+void PickQueue::SetCamera(CXMMATRIX view, CXMMATRIX proj, int clientWidth, int clientHeight)
+{
+	XMMATRIX V = view;
+	XMStoreFloat4x4(&mInvView, XMMatrixInverse(&XMMatrixDeterminant(V), V));
+
+	mProjScaleX = XMVectorGetX(proj.r[0]);
+	mProjScaleY = XMVectorGetY(proj.r[1]);
+	mClientWidth  = clientWidth;
+	mClientHeight = clientHeight;
+}
+
+void PickQueue::RequestScreenPick(int sx, int sy, UINT tag)
+{
+	XMMATRIX invView = XMLoadFloat4x4(&mInvView);
+
+	// Compute picking ray in view space and transform it to world space.
+	float vx = (+2.0f*sx/mClientWidth  - 1.0f)/mProjScaleX;
+	float vy = (-2.0f*sy/mClientHeight + 1.0f)/mProjScaleY;
+
+	XMVECTOR rayDir = XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView);
+
+	RequestRayPick(invView.r[3], XMVector3Normalize(rayDir), MathHelper::Infinity, tag);
+}
+
+void PickQueue::RequestRayPick(FXMVECTOR posW, FXMVECTOR dirW, float maxDist, UINT tag)
+{
+	PickRay ray;
+	XMStoreFloat3(&ray.Pos, posW);
+	XMStoreFloat3(&ray.Dir, dirW);
+	ray.MaxDist = maxDist;
+
+	mRays.push_back(ray);
+	mTags.push_back(tag);
+}
+
+UINT PickQueue::GetPendingCount()const
+{
+	return mRays.size();
+}
+
+void PickQueue::Resolve(const PickScene& scene)
+{
+	UINT count = mRays.size();
+
+	mResults.resize(count);
+	if( count == 0 )
+		return;
+
+	mHits.resize(count);
+	scene.PickBatch(&mRays[0], count, &mHits[0]);
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		mResults[i].Tag    = mTags[i];
+		mResults[i].Hit    = mHits[i].InstanceId != UINT(-1);
+		mResults[i].Result = mHits[i];
+	}
+
+	mRays.clear();
+	mTags.clear();
+}
+
+const std::vector<PickQueueResult>& PickQueue::GetResults()const
+{
+	return mResults;
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// PickQueue.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Collects pick requests during a frame and resolves them together against a
+// PickScene.  The world space ray of a screen space request is computed when the
+// request is made, with the camera of the frame the user clicked on (set once 
+// per frame with SetCamera), so moving the camera before Resolve does not change
+// what is picked.  The whole batch goes through PickScene::PickBatch in a single
+// pass.  Requests made during frame N are answered by the Resolve call of frame 
+// N+1.
+//***************************************************************************************
+
+#ifndef PICKQUEUE_H
+#define PICKQUEUE_H
+
+#include "PickScene.h"
+
+///<summary>
+/// Answer to one queued request.  Tag is the value passed when the request was
+/// made so callers can route results back to whoever asked.
+///</summary>
+struct PickQueueResult
+{
+	UINT Tag;
+	bool Hit;
+	PickResult Result;
+};
+
+class PickQueue
+{
+public:
+	PickQueue();
+	~PickQueue();
+
+	// Sets the camera screen space requests are made through, normally once per
+	// frame with the camera the frame is drawn with.  The view matrix is 
+	// inverted here, once, rather than for every request.
+	void SetCamera(CXMMATRIX view, CXMMATRIX proj, int clientWidth, int clientHeight);
+
+	// Queues a ray through pixel (sx, sy) of the viewport of the camera last
+	// passed to SetCamera.
+	void RequestScreenPick(int sx, int sy, UINT tag = 0);
+
+	// Queues a world space ray, e.g., a line of sight test.  dirW should be unit length.
+	void RequestRayPick(FXMVECTOR posW, FXMVECTOR dirW, float maxDist, UINT tag = 0);
+
+	UINT GetPendingCount()const;
+
+	// Resolves every pending request and replaces the previous results.
+	void Resolve(const PickScene& scene);
+
+	// Results of the last Resolve, in the order the requests were made.
+	const std::vector<PickQueueResult>& GetResults()const;
+
+private:
+	PickQueue(const PickQueue& rhs);
+	PickQueue& operator=(const PickQueue& rhs);
+
+private:
+	// Camera to world transform, and the projection scale of x and y, of the 
+	// camera screen space requests go through.
+	XMFLOAT4X4 mInvView;
+	float mProjScaleX;
+	float mProjScaleY;
+	int mClientWidth;
+	int mClientHeight;
+
+	// Pending rays and their tags, in request order.
+	std::vector<PickRay> mRays;
+	std::vector<UINT> mTags;
+
+	// Scratch buffer reused between frames to avoid per-frame allocations.
+	std::vector<PickResult> mHits;
+
+	std::vector<PickQueueResult> mResults;
+};
+
+#endif // PICKQUEUE_H
@@ -0,0 +1,689 @@
+//***************************************************************************************
+// PickScene.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "PickScene.h"
+
+namespace
+{
+	// Even-odd rule point in polygon test.
+	bool PointInPolygon(float x, float y, const XMFLOAT2* polygon, size_t n)
+	{
+		bool inside = false;
+
+		for(size_t i = 0, j = n-1; i < n; j = i++)
+		{
+			float xi = polygon[i].x;
+			float yi = polygon[i].y;
+			float xj = polygon[j].x;
+			float yj = polygon[j].y;
+
+			if( (yi > y) != (yj > y) && x < xi + (y - yi)*(xj - xi)/(yj - yi) )
+				inside = !inside;
+		}
+
+		return inside;
+	}
+
+	// Twice the signed area of triangle (a, b, c).
+	float Orient(const XMFLOAT2& a, const XMFLOAT2& b, const XMFLOAT2& c)
+	{
+		return (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	}
+
+	// True if the closed segments (a, b) and (c, d) intersect.  Collinear overlaps
+	// are not reported; the point in polygon tests catch those cases.
+	bool SegmentsIntersect(const XMFLOAT2& a, const XMFLOAT2& b, const XMFLOAT2& c, const XMFLOAT2& d)
+	{
+		float d1 = Orient(c, d, a);
+		float d2 = Orient(c, d, b);
+		float d3 = Orient(a, b, c);
+		float d4 = Orient(a, b, d);
+
+		return ((d1 > 0.0f && d2 < 0.0f) || (d1 < 0.0f && d2 > 0.0f)) &&
+		       ((d3 > 0.0f && d4 < 0.0f) || (d3 < 0.0f && d4 > 0.0f));
+	}
+
+	// True if the polygons share a point: a vertex of one is inside the other or
+	// two edges cross.
+	bool PolygonsOverlap(const XMFLOAT2* a, size_t na, const XMFLOAT2* b, size_t nb)
+	{
+		if( PointInPolygon(a[0].x, a[0].y, b, nb) || PointInPolygon(b[0].x, b[0].y, a, na) )
+			return true;
+
+		for(size_t i = 0, j = na-1; i < na; j = i++)
+		{
+			for(size_t k = 0, l = nb-1; k < nb; l = k++)
+			{
+				if( SegmentsIntersect(a[j], a[i], b[l], b[k]) )
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Slabs ray/box test for the instance boxes.
+	bool IntersectRayBox(FXMVECTOR pos, FXMVECTOR invDir, const OctreeBox& box, float tMax)
+	{
+		XMVECTOR C = XMLoadFloat3(&box.Center);
+		XMVECTOR E = XMLoadFloat3(&box.Extents);
+
+		XMVECTOR tSlab0 = (C - E - pos)*invDir;
+		XMVECTOR tSlab1 = (C + E - pos)*invDir;
+
+		XMVECTOR tNear = XMVectorMin(tSlab0, tSlab1);
+		XMVECTOR tFar  = XMVectorMax(tSlab0, tSlab1);
+
+		float t0 = MathHelper::Max(0.0f, MathHelper::Max(XMVectorGetX(tNear),
+			MathHelper::Max(XMVectorGetY(tNear), XMVectorGetZ(tNear))));
+		float t1 = MathHelper::Min(tMax, MathHelper::Min(XMVectorGetX(tFar),
+			MathHelper::Min(XMVectorGetY(tFar), XMVectorGetZ(tFar))));
+
+		return t0 <= t1;
+	}
+
+	void ComputeLassoRect(const std::vector<POINT>& lasso, RECT& rect)
+	{
+		rect.left   = rect.right  = lasso[0].x;
+		rect.top    = rect.bottom = lasso[0].y;
+		for(size_t i = 1; i < lasso.size(); ++i)
+		{
+			rect.left   = MathHelper::Min(rect.left,   lasso[i].x);
+			rect.right  = MathHelper::Max(rect.right,  lasso[i].x);
+			rect.top    = MathHelper::Min(rect.top,    lasso[i].y);
+			rect.bottom = MathHelper::Max(rect.bottom, lasso[i].y);
+		}
+	}
+}
+
+PickScene::PickScene()
+	: mHierarchyDirty(false)
+{
+}
+
+PickScene::~PickScene()
+{
+	for(size_t i = 0; i < mMeshes.size(); ++i)
+		SafeDelete(mMeshes[i]);
+}
+
+UINT PickScene::AddMesh(const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& indices)
+{
+	Octree* octree = new Octree();
+	octree->Build(positions, indices);
+
+	mMeshes.push_back(octree);
+	return mMeshes.size()-1;
+}
+
+UINT PickScene::AddInstance(UINT meshId, CXMMATRIX world)
+{
+	Instance instance;
+	instance.MeshId = meshId;
+	mInstances.push_back(instance);
+
+	UINT instanceId = mInstances.size()-1;
+	SetInstanceWorld(instanceId, world);
+
+	return instanceId;
+}
+
+void PickScene::SetInstanceWorld(UINT instanceId, CXMMATRIX world)
+{
+	Instance& instance = mInstances[instanceId];
+
+	XMMATRIX W = world;
+	XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
+
+	XMStoreFloat4x4(&instance.World, W);
+	XMStoreFloat4x4(&instance.InvWorld, invWorld);
+
+	mHierarchyDirty = true;
+}
+
+UINT PickScene::GetInstanceMeshId(UINT instanceId)const
+{
+	return mInstances[instanceId].MeshId;
+}
+
+bool PickScene::Pick(FXMVECTOR rayPosW, FXMVECTOR rayDirW, PickResult& result, float maxDist)const
+{
+	result.InstanceId = UINT(-1);
+	result.TriangleId = UINT(-1);
+	result.Distance   = maxDist;
+	result.U = 0.0f;
+	result.V = 0.0f;
+
+	PickRay rayW;
+	XMStoreFloat3(&rayW.Pos, rayPosW);
+	XMStoreFloat3(&rayW.Dir, rayDirW);
+	rayW.MaxDist = maxDist;
+
+	std::vector<UINT> candidates;
+	CullInstances(&rayW, 1, candidates);
+
+	for(size_t c = 0; c < candidates.size(); ++c)
+	{
+		UINT i = candidates[c];
+		const Instance& instance = mInstances[i];
+
+		// Transform the ray to the local space of the instance.  We deliberately
+		// do not renormalize the local direction: then a local hit at parameter t
+		// is at the same t along the world ray, so hits from different instances
+		// compare directly and the nearest one so far can cull the next instance.
+		XMMATRIX invWorld = XMLoadFloat4x4(&instance.InvWorld);
+
+		XMVECTOR rayPos = XMVector3TransformCoord(rayPosW, invWorld);
+		XMVECTOR rayDir = XMVector3TransformNormal(rayDirW, invWorld);
+
+		OctreeHit hit;
+		if( mMeshes[instance.MeshId]->RayOctreeClosestHit(rayPos, rayDir, hit, result.Distance) )
+		{
+			result.InstanceId = i;
+			result.TriangleId = hit.TriangleId;
+			result.Distance   = hit.T;
+			result.U = hit.U;
+			result.V = hit.V;
+		}
+	}
+
+	return result.InstanceId != UINT(-1);
+}
+
+UINT PickScene::PickBatch(const PickRay* rays, UINT count, PickResult* results)const
+{
+	for(UINT j = 0; j < count; ++j)
+	{
+		results[j].InstanceId = UINT(-1);
+		results[j].TriangleId = UINT(-1);
+		results[j].Distance   = rays[j].MaxDist;
+		results[j].U = 0.0f;
+		results[j].V = 0.0f;
+	}
+
+	// Only the instances that at least one ray reaches.
+	std::vector<UINT> candidates;
+	CullInstances(rays, count, candidates);
+
+	std::vector<XMFLOAT3> localPos(count);
+	std::vector<XMFLOAT3> localDir(count);
+	std::vector<float> tMax(count);
+	std::vector<OctreeHit> hits(count);
+
+	for(size_t c = 0; c < candidates.size(); ++c)
+	{
+		UINT i = candidates[c];
+		const Instance& instance = mInstances[i];
+
+		XMMATRIX invWorld = XMLoadFloat4x4(&instance.InvWorld);
+
+		for(UINT j = 0; j < count; ++j)
+		{
+			// As in Pick, the local direction is left unnormalized so distances
+			// stay in world units.
+			XMStoreFloat3(&localPos[j], XMVector3TransformCoord(XMLoadFloat3(&rays[j].Pos), invWorld));
+			XMStoreFloat3(&localDir[j], XMVector3TransformNormal(XMLoadFloat3(&rays[j].Dir), invWorld));
+			tMax[j] = results[j].Distance;
+		}
+
+		// One walk of the instance's octree for the whole batch.
+		if( mMeshes[instance.MeshId]->RayOctreeClosestHits(&localPos[0], &localDir[0], &tMax[0], count, &hits[0]) == 0 )
+			continue;
+
+		for(UINT j = 0; j < count; ++j)
+		{
+			if( hits[j].TriangleId != UINT(-1) )
+			{
+				results[j].InstanceId = i;
+				results[j].TriangleId = hits[j].TriangleId;
+				results[j].Distance   = hits[j].T;
+				results[j].U = hits[j].U;
+				results[j].V = hits[j].V;
+			}
+		}
+	}
+
+	UINT numHits = 0;
+	for(UINT j = 0; j < count; ++j)
+	{
+		if( results[j].InstanceId != UINT(-1) )
+			++numHits;
+	}
+
+	return numHits;
+}
+
+void PickScene::ComputeScreenRectFrustum(CXMMATRIX proj, int clientWidth, int clientHeight,
+										 const RECT& rect, XNA::Frustum& frustumV)
+{
+	XMMATRIX P = proj;
+	XNA::ComputeFrustumFromProjection(&frustumV, &P);
+
+	// The frustum slopes are x/z and y/z in view space, which is exactly what the 
+	// picking ray computation gives for a pixel.
+	float x0 = (float)MathHelper::Min(rect.left, rect.right);
+	float x1 = (float)MathHelper::Max(rect.left, rect.right);
+	float y0 = (float)MathHelper::Min(rect.top, rect.bottom);
+	float y1 = (float)MathHelper::Max(rect.top, rect.bottom);
+
+	frustumV.LeftSlope   = (+2.0f*x0/clientWidth  - 1.0f)/P(0,0);
+	frustumV.RightSlope  = (+2.0f*x1/clientWidth  - 1.0f)/P(0,0);
+	frustumV.TopSlope    = (-2.0f*y0/clientHeight + 1.0f)/P(1,1);
+	frustumV.BottomSlope = (-2.0f*y1/clientHeight + 1.0f)/P(1,1);
+}
+
+UINT PickScene::SelectInstances(const XNA::Frustum& frustumV, CXMMATRIX view, std::vector<UINT>& instances)const
+{
+	// The planes go from view space to world space with the transpose of the view
+	// matrix; see ComputeLocalPlanes.
+	XMVECTOR planesW[6];
+	XNA::ComputePlanesFromFrustum(&frustumV,
+		&planesW[0], &planesW[1], &planesW[2], &planesW[3], &planesW[4], &planesW[5]);
+
+	XMMATRIX toPlaneWorld = XMMatrixTranspose(view);
+	for(int k = 0; k < 6; ++k)
+		planesW[k] = XMPlaneNormalize(XMPlaneTransform(planesW[k], toPlaneWorld));
+
+	std::vector<UINT> candidates;
+	CullInstances(planesW, candidates);
+
+	UINT count = 0;
+	for(size_t c = 0; c < candidates.size(); ++c)
+	{
+		UINT i = candidates[c];
+		const Octree* octree = mMeshes[mInstances[i].MeshId];
+
+		XMVECTOR planes[6];
+		ComputeLocalPlanes(frustumV, view, i, planes);
+
+		OctreeBox bounds;
+		if( !octree->GetBounds(bounds) )
+			continue;
+
+		int result = Octree::IntersectBoxPlanes(bounds, planes);
+
+		if( result == 0 )
+			continue;
+
+		// If the bounds are only partly inside, make sure some triangle is.
+		if( result == 2 || octree->FrustumOctreeIntersect(planes) )
+		{
+			instances.push_back(i);
+			++count;
+		}
+	}
+
+	return count;
+}
+
+UINT PickScene::SelectTriangles(const XNA::Frustum& frustumV, CXMMATRIX view, std::vector<PickSelection>& selection)const
+{
+	// Cull whole instances first, as in SelectInstances.
+	std::vector<UINT> candidates;
+	SelectInstances(frustumV, view, candidates);
+
+	std::vector<UINT> triangles;
+
+	UINT count = 0;
+	for(size_t c = 0; c < candidates.size(); ++c)
+	{
+		UINT i = candidates[c];
+
+		XMVECTOR planes[6];
+		ComputeLocalPlanes(frustumV, view, i, planes);
+
+		triangles.clear();
+		mMeshes[mInstances[i].MeshId]->FrustumOctreeQuery(planes, triangles);
+
+		for(size_t j = 0; j < triangles.size(); ++j)
+		{
+			PickSelection item;
+			item.InstanceId = i;
+			item.TriangleId = triangles[j];
+			selection.push_back(item);
+		}
+
+		count += triangles.size();
+	}
+
+	return count;
+}
+
+UINT PickScene::SelectTrianglesInLasso(const std::vector<POINT>& lasso, CXMMATRIX view, CXMMATRIX proj,
+									   int clientWidth, int clientHeight, std::vector<PickSelection>& selection)const
+{
+	if( lasso.size() < 3 )
+		return 0;
+
+	RECT rect;
+	ComputeLassoRect(lasso, rect);
+
+	XNA::Frustum frustumV;
+	ComputeScreenRectFrustum(proj, clientWidth, clientHeight, rect, frustumV);
+
+	size_t first = selection.size();
+	SelectTriangles(frustumV, view, selection);
+
+	std::vector<XMFLOAT2> polygon(lasso.size());
+	for(size_t i = 0; i < lasso.size(); ++i)
+		polygon[i] = XMFLOAT2((float)lasso[i].x, (float)lasso[i].y);
+
+	// Keep the candidates whose projection touches the lasso.
+	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+	size_t numKept = first;
+	for(size_t i = first; i < selection.size(); ++i)
+	{
+		const PickSelection& item = selection[i];
+
+		if( TriangleTouchesPolygon(item.InstanceId, item.TriangleId, viewProj, clientWidth, clientHeight, polygon) )
+			selection[numKept++] = item;
+	}
+	selection.resize(numKept);
+
+	return numKept - first;
+}
+
+UINT PickScene::SelectInstancesInLasso(const std::vector<POINT>& lasso, CXMMATRIX view, CXMMATRIX proj,
+									   int clientWidth, int clientHeight, std::vector<UINT>& instances)const
+{
+	if( lasso.size() < 3 )
+		return 0;
+
+	RECT rect;
+	ComputeLassoRect(lasso, rect);
+
+	XNA::Frustum frustumV;
+	ComputeScreenRectFrustum(proj, clientWidth, clientHeight, rect, frustumV);
+
+	std::vector<UINT> candidates;
+	SelectInstances(frustumV, view, candidates);
+
+	std::vector<XMFLOAT2> polygon(lasso.size());
+	for(size_t i = 0; i < lasso.size(); ++i)
+		polygon[i] = XMFLOAT2((float)lasso[i].x, (float)lasso[i].y);
+
+	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+	// An instance is selected as soon as one of its triangles inside the bounding
+	// rectangle touches the lasso.
+	std::vector<UINT> triangles;
+
+	UINT count = 0;
+	for(size_t c = 0; c < candidates.size(); ++c)
+	{
+		UINT i = candidates[c];
+
+		XMVECTOR planes[6];
+		ComputeLocalPlanes(frustumV, view, i, planes);
+
+		triangles.clear();
+		mMeshes[mInstances[i].MeshId]->FrustumOctreeQuery(planes, triangles);
+
+		for(size_t j = 0; j < triangles.size(); ++j)
+		{
+			if( TriangleTouchesPolygon(i, triangles[j], viewProj, clientWidth, clientHeight, polygon) )
+			{
+				instances.push_back(i);
+				++count;
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+void PickScene::ComputeLocalPlanes(const XNA::Frustum& frustumV, CXMMATRIX view, UINT instanceId, 
+								   XMVECTOR planes[6])const
+{
+	XNA::ComputePlanesFromFrustum(&frustumV, 
+		&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+	// A plane is transformed by the inverse transpose of the point transform.  The
+	// planes go from view space to local space, so the point transform is the 
+	// inverse of local-to-view, and the plane transform is transpose(world*view).
+	// Unlike XNA::TransformFrustum, this also handles nonuniformly scaled instances.
+	XMMATRIX W = XMLoadFloat4x4(&mInstances[instanceId].World);
+	XMMATRIX toPlaneLocal = XMMatrixTranspose(XMMatrixMultiply(W, view));
+
+	for(int i = 0; i < 6; ++i)
+		planes[i] = XMPlaneNormalize(XMPlaneTransform(planes[i], toPlaneLocal));
+}
+
+void PickScene::CullInstances(const XMVECTOR planesW[6], std::vector<UINT>& instances)const
+{
+	UpdateHierarchy();
+
+	if( mHierarchy.empty() )
+		return;
+
+	size_t first = instances.size();
+
+	std::vector<UINT> stack;
+	stack.push_back(0);
+	while( !stack.empty() )
+	{
+		const HierarchyNode& node = mHierarchy[stack.back()];
+		stack.pop_back();
+
+		if( Octree::IntersectBoxPlanes(node.Bounds, planesW) == 0 )
+			continue;
+
+		if( node.Count > 0 )
+		{
+			instances.insert(instances.end(),
+				mHierarchyInstances.begin() + node.First,
+				mHierarchyInstances.begin() + node.First + node.Count);
+		}
+		else
+		{
+			stack.push_back(node.First);
+			stack.push_back(node.First+1);
+		}
+	}
+
+	std::sort(instances.begin() + first, instances.end());
+}
+
+void PickScene::CullInstances(const PickRay* rays, UINT count, std::vector<UINT>& instances)const
+{
+	UpdateHierarchy();
+
+	if( mHierarchy.empty() || count == 0 )
+		return;
+
+	std::vector<XMFLOAT3> invDirs(count);
+	for(UINT j = 0; j < count; ++j)
+		XMStoreFloat3(&invDirs[j], XMVectorReciprocal(XMLoadFloat3(&rays[j].Dir)));
+
+	size_t first = instances.size();
+
+	std::vector<UINT> stack;
+	stack.push_back(0);
+	while( !stack.empty() )
+	{
+		const HierarchyNode& node = mHierarchy[stack.back()];
+		stack.pop_back();
+
+		bool hit = false;
+		for(UINT j = 0; j < count && !hit; ++j)
+		{
+			hit = IntersectRayBox(XMLoadFloat3(&rays[j].Pos), XMLoadFloat3(&invDirs[j]),
+				node.Bounds, rays[j].MaxDist);
+		}
+
+		if( !hit )
+			continue;
+
+		if( node.Count > 0 )
+		{
+			instances.insert(instances.end(),
+				mHierarchyInstances.begin() + node.First,
+				mHierarchyInstances.begin() + node.First + node.Count);
+		}
+		else
+		{
+			stack.push_back(node.First);
+			stack.push_back(node.First+1);
+		}
+	}
+
+	std::sort(instances.begin() + first, instances.end());
+}
+
+bool PickScene::TriangleTouchesPolygon(UINT instanceId, UINT triangleId, CXMMATRIX viewProj,
+									   int clientWidth, int clientHeight, const std::vector<XMFLOAT2>& polygon)const
+{
+	const Octree* octree = mMeshes[mInstances[instanceId].MeshId];
+
+	XMFLOAT3 v[3];
+	octree->GetTriangle(triangleId, v[0], v[1], v[2]);
+
+	XMMATRIX W = XMLoadFloat4x4(&mInstances[instanceId].World);
+	XMMATRIX worldViewProj = XMMatrixMultiply(W, viewProj);
+
+	XMFLOAT4 posH[3];
+	for(int k = 0; k < 3; ++k)
+		XMStoreFloat4(&posH[k], XMVector3Transform(XMLoadFloat3(&v[k]), worldViewProj));
+
+	// Clip the triangle to the near plane (z >= 0 in homogeneous clip space), which
+	// leaves at most four vertices, so points behind the camera never project.
+	XMFLOAT4 clipped[4];
+	UINT numClipped = 0;
+	for(int k = 0, l = 2; k < 3; l = k++)
+	{
+		const XMFLOAT4& a = posH[l];
+		const XMFLOAT4& b = posH[k];
+
+		if( (a.z >= 0.0f) != (b.z >= 0.0f) )
+		{
+			float s = a.z/(a.z - b.z);
+			clipped[numClipped++] = XMFLOAT4(
+				a.x + s*(b.x - a.x),
+				a.y + s*(b.y - a.y),
+				0.0f,
+				a.w + s*(b.w - a.w));
+		}
+
+		if( b.z >= 0.0f )
+			clipped[numClipped++] = b;
+	}
+
+	if( numClipped < 3 )
+		return false;
+
+	// NDC to screen space.
+	XMFLOAT2 screen[4];
+	for(UINT k = 0; k < numClipped; ++k)
+	{
+		float w = MathHelper::Max(clipped[k].w, 1e-6f);
+		screen[k].x = ( clipped[k].x/w + 1.0f)*0.5f*clientWidth;
+		screen[k].y = (-clipped[k].y/w + 1.0f)*0.5f*clientHeight;
+	}
+
+	return PolygonsOverlap(screen, numClipped, &polygon[0], polygon.size());
+}
+
+void PickScene::UpdateHierarchy()const
+{
+	if( !mHierarchyDirty )
+		return;
+
+	mHierarchyDirty = false;
+
+	mInstanceBounds.resize(mInstances.size());
+	mHierarchyInstances.clear();
+	mHierarchy.clear();
+
+	for(UINT i = 0; i < mInstances.size(); ++i)
+	{
+		OctreeBox localBounds;
+		if( !mMeshes[mInstances[i].MeshId]->GetBounds(localBounds) )
+			continue;
+
+		// The box center goes through the whole transform, and the half extents
+		// along each world axis are the local extents projected onto it.
+		XMMATRIX W = XMLoadFloat4x4(&mInstances[i].World);
+
+		XMVECTOR C = XMVector3TransformCoord(XMLoadFloat3(&localBounds.Center), W);
+
+		const XMFLOAT3& e = localBounds.Extents;
+		XMVECTOR E =
+			e.x*XMVectorAbs(W.r[0]) +
+			e.y*XMVectorAbs(W.r[1]) +
+			e.z*XMVectorAbs(W.r[2]);
+
+		XMStoreFloat3(&mInstanceBounds[i].Center, C);
+		XMStoreFloat3(&mInstanceBounds[i].Extents, E);
+
+		mHierarchyInstances.push_back(i);
+	}
+
+	if( mHierarchyInstances.empty() )
+		return;
+
+	mHierarchy.push_back(HierarchyNode());
+	BuildHierarchyNode(0, 0, mHierarchyInstances.size());
+}
+
+void PickScene::BuildHierarchyNode(UINT nodeIndex, UINT first, UINT count)const
+{
+	// Bounds of the instance boxes, and of their centers for choosing the split.
+	XMVECTOR boxMin    = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR boxMax    = XMVectorReplicate(-MathHelper::Infinity);
+	XMVECTOR centerMin = boxMin;
+	XMVECTOR centerMax = boxMax;
+
+	for(UINT k = first; k < first + count; ++k)
+	{
+		const OctreeBox& box = mInstanceBounds[mHierarchyInstances[k]];
+		XMVECTOR C = XMLoadFloat3(&box.Center);
+		XMVECTOR E = XMLoadFloat3(&box.Extents);
+
+		boxMin    = XMVectorMin(boxMin, C - E);
+		boxMax    = XMVectorMax(boxMax, C + E);
+		centerMin = XMVectorMin(centerMin, C);
+		centerMax = XMVectorMax(centerMax, C);
+	}
+
+	HierarchyNode& node = mHierarchy[nodeIndex];
+	XMStoreFloat3(&node.Bounds.Center,  0.5f*(boxMin + boxMax));
+	XMStoreFloat3(&node.Bounds.Extents, 0.5f*(boxMax - boxMin));
+
+	if( count <= MaxInstancesPerLeaf )
+	{
+		node.First = first;
+		node.Count = count;
+		return;
+	}
+
+	// Split at the median center along the axis where the centers spread most.
+	XMFLOAT3 spread;
+	XMStoreFloat3(&spread, centerMax - centerMin);
+
+	int axis = 0;
+	if( spread.y > spread.x )
+		axis = 1;
+	if( spread.z > (axis == 0 ? spread.x : spread.y) )
+		axis = 2;
+
+	const std::vector<OctreeBox>& bounds = mInstanceBounds;
+	UINT mid = first + count/2;
+	std::nth_element(mHierarchyInstances.begin() + first, mHierarchyInstances.begin() + mid,
+		mHierarchyInstances.begin() + first + count,
+		[&](UINT a, UINT b) { return (&bounds[a].Center.x)[axis] < (&bounds[b].Center.x)[axis]; });
+
+	// The children are allocated together so they can be found from First.
+	UINT firstChild = mHierarchy.size();
+	node.First = firstChild;
+	node.Count = 0;
+
+	// node is not used past this point; push_back may move it.
+	mHierarchy.push_back(HierarchyNode());
+	mHierarchy.push_back(HierarchyNode());
+
+	BuildHierarchyNode(firstChild,   first, mid - first);
+	BuildHierarchyNode(firstChild+1, mid,   first + count - mid);
+}
@@ -0,0 +1,157 @@
+//***************************************************************************************
+// PickScene.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Collection of pickable meshes and instances of them.  Each mesh gets an Octree
+// built once when it is added, and each instance has its own world transform.
+// Picking a world space ray returns the nearest triangle over all instances.
+//
+// The world space boxes of the instances are kept in a bounding volume hierarchy,
+// so picks and selections only visit the instances near the ray or volume.  The
+// hierarchy is rebuilt by the first query after an instance is added or moved.
+//***************************************************************************************
+
+#ifndef PICKSCENE_H
+#define PICKSCENE_H
+
+#include "d3dUtil.h"
+#include "Octree.h"
+
+///<summary>
+/// Nearest hit of a pick ray.  Distance is measured along the world space ray, and
+/// (U, V) are the barycentric coordinates of the hit within triangle TriangleId of
+/// the instance's mesh.
+///</summary>
+struct PickResult
+{
+	UINT InstanceId;
+	UINT TriangleId;
+	float Distance;
+	float U;
+	float V;
+};
+
+///<summary>
+/// World space ray for batched picking.  Dir should be unit length.
+///</summary>
+struct PickRay
+{
+	XMFLOAT3 Pos;
+	XMFLOAT3 Dir;
+	float MaxDist;
+};
+
+///<summary>
+/// One triangle returned by a selection query.
+///</summary>
+struct PickSelection
+{
+	UINT InstanceId;
+	UINT TriangleId;
+};
+
+class PickScene
+{
+public:
+	PickScene();
+	~PickScene();
+
+	// Builds the acceleration structure for the mesh and returns its id.
+	UINT AddMesh(const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& indices);
+
+	// Returns the id of the new instance.
+	UINT AddInstance(UINT meshId, CXMMATRIX world);
+	void SetInstanceWorld(UINT instanceId, CXMMATRIX world);
+
+	UINT GetInstanceMeshId(UINT instanceId)const;
+
+	// Finds the nearest triangle hit by the world space ray within maxDist.  rayDirW
+	// should be unit length so that result.Distance is a world space distance.
+	bool Pick(FXMVECTOR rayPosW, FXMVECTOR rayDirW, PickResult& result, 
+		float maxDist = MathHelper::Infinity)const;
+
+	// Picks count rays at once and returns the number that hit something.  The
+	// instances are visited in the outer loop, and each instance's octree is 
+	// walked once for the whole batch with Octree::RayOctreeClosestHits.  Rays 
+	// that miss get InstanceId == UINT(-1).
+	UINT PickBatch(const PickRay* rays, UINT count, PickResult* results)const;
+
+	// Computes the view space frustum of the camera narrowed to the pixels inside
+	// rect, for use with the selection queries below.
+	static void ComputeScreenRectFrustum(CXMMATRIX proj, int clientWidth, int clientHeight,
+		const RECT& rect, XNA::Frustum& frustumV);
+
+	// Marquee selection: appends every instance, or every triangle, touching the 
+	// view space frustum.  Instances are culled by their bounds through the
+	// hierarchy first, and the octree of each surviving instance is walked so whole
+	// nodes are accepted or rejected at once.  Returns the number of items appended.
+	UINT SelectInstances(const XNA::Frustum& frustumV, CXMMATRIX view, std::vector<UINT>& instances)const;
+	UINT SelectTriangles(const XNA::Frustum& frustumV, CXMMATRIX view, std::vector<PickSelection>& selection)const;
+
+	// Lasso selection: appends every triangle, or every instance with a triangle,
+	// whose projection touches the area of the closed screen space polygon, as the
+	// marquee queries do for a rectangle.  The bounding rectangle of the polygon is
+	// used to cull with the marquee queries first.
+	UINT SelectTrianglesInLasso(const std::vector<POINT>& lasso, CXMMATRIX view, CXMMATRIX proj,
+		int clientWidth, int clientHeight, std::vector<PickSelection>& selection)const;
+	UINT SelectInstancesInLasso(const std::vector<POINT>& lasso, CXMMATRIX view, CXMMATRIX proj,
+		int clientWidth, int clientHeight, std::vector<UINT>& instances)const;
+
+private:
+	PickScene(const PickScene& rhs);
+	PickScene& operator=(const PickScene& rhs);
+
+private:
+	// Transforms the six planes of the view space frustum into the local space of
+	// the instance.
+	void ComputeLocalPlanes(const XNA::Frustum& frustumV, CXMMATRIX view, UINT instanceId, 
+		XMVECTOR planes[6])const;
+
+	// Appends the instances whose world bounds are not outside the world space
+	// planes, or that one of the rays enters, in increasing id order.
+	void CullInstances(const XMVECTOR planesW[6], std::vector<UINT>& instances)const;
+	void CullInstances(const PickRay* rays, UINT count, std::vector<UINT>& instances)const;
+
+	// True if the projection of the triangle, clipped to the near plane, overlaps
+	// the polygon.
+	bool TriangleTouchesPolygon(UINT instanceId, UINT triangleId, CXMMATRIX viewProj,
+		int clientWidth, int clientHeight, const std::vector<XMFLOAT2>& polygon)const;
+
+	// Rebuilds the instance hierarchy if an instance was added or moved.
+	void UpdateHierarchy()const;
+	void BuildHierarchyNode(UINT nodeIndex, UINT first, UINT count)const;
+
+private:
+	struct Instance
+	{
+		UINT MeshId;
+		XMFLOAT4X4 World;
+
+		// Cached so picking does not invert the world matrix per ray.
+		XMFLOAT4X4 InvWorld;
+	};
+
+	///<summary>
+	/// Node of the instance hierarchy.  A leaf holds mHierarchyInstances[First] 
+	/// through mHierarchyInstances[First+Count-1]; an interior node has Count == 0
+	/// and its two children are nodes First and First+1.
+	///</summary>
+	struct HierarchyNode
+	{
+		OctreeBox Bounds;
+		UINT First;
+		UINT Count;
+	};
+
+	static const UINT MaxInstancesPerLeaf = 4;
+
+	std::vector<Octree*> mMeshes;
+	std::vector<Instance> mInstances;
+
+	// Built lazily by the const queries.
+	mutable bool mHierarchyDirty;
+	mutable std::vector<OctreeBox> mInstanceBounds;
+	mutable std::vector<HierarchyNode> mHierarchy;
+	mutable std::vector<UINT> mHierarchyInstances;
+};
+
+#endif // PICKSCENE_H
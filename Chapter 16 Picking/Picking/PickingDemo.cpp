@@ -20,7 +20,7 @@
 #include "Vertex.h"
 #include "Camera.h"
 #include "RenderStates.h"
-#include "xnacollision.h"
+#include "PickQueue.h"
 
 class PickingApp : public D3DApp 
 {
@@ -39,18 +39,23 @@ public:
 
 private:
 	void BuildMeshGeometryBuffers();
-	void Pick(int sx, int sy);
+	void ResolvePicks();
+	void SelectTriangles(int x, int y);
 
 private:
 
 	ID3D11Buffer* mMeshVB;
 	ID3D11Buffer* mMeshIB;
 
-	// Keep system memory copies of the Mesh geometry for picking.
 	std::vector<Vertex::Basic32> mMeshVertices;
 	std::vector<UINT> mMeshIndices;
 
-	XNA::AxisAlignedBox mMeshBox;
+	// Acceleration structure for picking; the Mesh is added as a single instance.
+	PickScene mPickScene;
+	UINT mMeshInstance;
+
+	// Mouse picks are queued when clicked and resolved as one batch next frame.
+	PickQueue mPickQueue;
 
 	DirectionalLight mDirLights[3];
 	Material mMeshMat;
@@ -63,6 +68,13 @@ private:
 
 	UINT mPickedTriangle;
 
+	// Right dragging selects the triangles inside a rectangle, or inside a lasso
+	// while shift is held.
+	bool mSelecting;
+	POINT mSelectStart;
+	std::vector<POINT> mLasso;
+	std::vector<UINT> mSelectedTriangles;
+
 	Camera mCam;
 
 	POINT mLastMousePos;
@@ -86,13 +98,16 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
  
 
 PickingApp::PickingApp(HINSTANCE hInstance)
-: D3DApp(hInstance), mMeshVB(0), mMeshIB(0), mMeshIndexCount(0), mPickedTriangle(-1)
+: D3DApp(hInstance), mMeshVB(0), mMeshIB(0), mMeshIndexCount(0), mMeshInstance(0), mPickedTriangle(-1), mSelecting(false)
 {
 	mMainWndCaption = L"Picking Demo";
 	
 	mLastMousePos.x = 0;
 	mLastMousePos.y = 0;
 
+	mSelectStart.x = 0;
+	mSelectStart.y = 0;
+
 	mCam.SetPosition(0.0f, 2.0f, -15.0f);
 
 	XMMATRIX MeshScale = XMMatrixScaling(0.5f, 0.5f, 0.5f);
@@ -170,6 +185,8 @@ void PickingApp::UpdateScene(float dt)
 
 	if( GetAsyncKeyState('D') & 0x8000 )
 		mCam.Strafe(10.0f*dt);
+
+	ResolvePicks();
 }
 
 void PickingApp::DrawScene()
@@ -189,6 +206,10 @@ void PickingApp::DrawScene()
 	XMMATRIX proj     = mCam.Proj();
 	XMMATRIX viewProj = mCam.ViewProj();
 
+	// Clicks until the next frame pick through the camera of this one, which is
+	// what the user sees.
+	mPickQueue.SetCamera(view, proj, mClientWidth, mClientHeight);
+
 
 	
 
@@ -242,6 +263,20 @@ void PickingApp::DrawScene()
 			// restore default
 			md3dImmediateContext->OMSetDepthStencilState(0, 0);
 		}
+
+		// Likewise for the triangles selected by the last rectangle or lasso.
+
+		if(!mSelectedTriangles.empty())
+		{
+			md3dImmediateContext->OMSetDepthStencilState(RenderStates::LessEqualDSS, 0);
+
+			Effects::BasicFX->SetMaterial(mPickedTriangleMat);
+			activeMeshTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			for(size_t i = 0; i < mSelectedTriangles.size(); ++i)
+				md3dImmediateContext->DrawIndexed(3, 3*mSelectedTriangles[i], 0);
+
+			md3dImmediateContext->OMSetDepthStencilState(0, 0);
+		}
 	}
 
 	
@@ -261,12 +296,34 @@ void PickingApp::OnMouseDown(WPARAM btnState, int x, int y)
 	}
 	else if( (btnState & MK_RBUTTON) != 0 )
 	{
-		Pick(x, y);
+		mSelecting = true;
+		mSelectStart.x = x;
+		mSelectStart.y = y;
+
+		mLasso.clear();
+		mLasso.push_back(mSelectStart);
+
+		SetCapture(mhMainWnd);
 	}
 }
 
 void PickingApp::OnMouseUp(WPARAM btnState, int x, int y)
 {
+	if( mSelecting && (btnState & MK_RBUTTON) == 0 )
+	{
+		mSelecting = false;
+
+		// A click without much movement is a regular pick.
+		if( abs(x - mSelectStart.x) < 4 && abs(y - mSelectStart.y) < 4 )
+		{
+			// The ray is computed now, through the camera of the last frame
+			// drawn; the pick is resolved next frame.
+			mPickQueue.RequestScreenPick(x, y);
+		}
+		else
+			SelectTriangles(x, y);
+	}
+
 	ReleaseCapture();
 }
 
@@ -281,6 +338,11 @@ void PickingApp::OnMouseMove(WPARAM btnState, int x, int y)
 		mCam.Pitch(dy);
 		mCam.RotateY(dx);
 	}
+	else if( mSelecting && (btnState & MK_RBUTTON) != 0 )
+	{
+		POINT p = { x, y };
+		mLasso.push_back(p);
+	}
 
 	mLastMousePos.x = x;
 	mLastMousePos.y = y;
@@ -303,26 +365,16 @@ void PickingApp::BuildMeshGeometryBuffers()
 	fin >> ignore >> vcount;
 	fin >> ignore >> tcount;
 	fin >> ignore >> ignore >> ignore >> ignore;
-	
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-	
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+
+	std::vector<XMFLOAT3> positions(vcount);
 	mMeshVertices.resize(vcount);
 	for(UINT i = 0; i < vcount; ++i)
 	{
 		fin >> mMeshVertices[i].Pos.x >> mMeshVertices[i].Pos.y >> mMeshVertices[i].Pos.z;
 		fin >> mMeshVertices[i].Normal.x >> mMeshVertices[i].Normal.y >> mMeshVertices[i].Normal.z;
-		
-		XMVECTOR P = XMLoadFloat3(&mMeshVertices[i].Pos);
-		
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
+
+		positions[i] = mMeshVertices[i].Pos;
 	}
-	
-	XMStoreFloat3(&mMeshBox.Center, 0.5f*(vMin+vMax));
-	XMStoreFloat3(&mMeshBox.Extents, 0.5f*(vMax-vMin));
 
 	fin >> ignore;
 	fin >> ignore;
@@ -337,6 +389,10 @@ void PickingApp::BuildMeshGeometryBuffers()
 
 	fin.close();
 
+	// Build the octree once up front so picking does not have to test every triangle.
+	UINT meshId = mPickScene.AddMesh(positions, mMeshIndices);
+	mMeshInstance = mPickScene.AddInstance(meshId, XMLoadFloat4x4(&mMeshWorld));
+
     D3D11_BUFFER_DESC vbd;
     vbd.Usage = D3D11_USAGE_IMMUTABLE;
 	vbd.ByteWidth = sizeof(Vertex::Basic32) * vcount;
@@ -362,69 +418,59 @@ void PickingApp::BuildMeshGeometryBuffers()
     HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mMeshIB));
 }
 
-void PickingApp::Pick(int sx, int sy)
+void PickingApp::ResolvePicks()
 {
-	XMMATRIX P = mCam.Proj();
+	if( mPickQueue.GetPendingCount() == 0 )
+		return;
 
-	// Compute picking ray in view space.
-	float vx = (+2.0f*sx/mClientWidth  - 1.0f)/P(0,0);
-	float vy = (-2.0f*sy/mClientHeight + 1.0f)/P(1,1);
+	mPickQueue.Resolve(mPickScene);
 
-	// Ray definition in view space.
-	XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-	XMVECTOR rayDir    = XMVectorSet(vx, vy, 1.0f, 0.0f);
+	// Apply the clicks in the order they were made, so if several arrived since
+	// the last frame the picked triangle is the one from the last click.
+	const std::vector<PickQueueResult>& results = mPickQueue.GetResults();
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const PickQueueResult& result = results[i];
 
-	// Tranform ray to local space of Mesh.
-	XMMATRIX V = mCam.View();
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
+		// Assume we have not picked anything, so init to -1.
+		mPickedTriangle = -1;
+		mSelectedTriangles.clear();
+		if(result.Hit && result.Result.InstanceId == mMeshInstance)
+		{
+			mPickedTriangle = result.Result.TriangleId;
+		}
+	}
+}
 
-	XMMATRIX W = XMLoadFloat4x4(&mMeshWorld);
-	XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
+void PickingApp::SelectTriangles(int x, int y)
+{
+	mCam.UpdateViewMatrix();
+
+	mPickedTriangle = -1;
+	mSelectedTriangles.clear();
 
-	XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+	std::vector<PickSelection> selection;
+	if( GetAsyncKeyState(VK_SHIFT) & 0x8000 )
+	{
+		POINT p = { x, y };
+		mLasso.push_back(p);
 
-	rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-	rayDir = XMVector3TransformNormal(rayDir, toLocal);
+		mPickScene.SelectTrianglesInLasso(mLasso, mCam.View(), mCam.Proj(), 
+			mClientWidth, mClientHeight, selection);
+	}
+	else
+	{
+		RECT rect = { mSelectStart.x, mSelectStart.y, x, y };
 
-	// Make the ray direction unit length for the intersection tests.
-	rayDir = XMVector3Normalize(rayDir);
+		XNA::Frustum frustumV;
+		PickScene::ComputeScreenRectFrustum(mCam.Proj(), mClientWidth, mClientHeight, rect, frustumV);
 
-	// If we hit the bounding box of the Mesh, then we might have picked a Mesh triangle,
-	// so do the ray/triangle tests.
-	//
-	// If we did not hit the bounding box, then it is impossible that we hit 
-	// the Mesh, so do not waste effort doing ray/triangle tests.
+		mPickScene.SelectTriangles(frustumV, mCam.View(), selection);
+	}
 
-	// Assume we have not picked anything yet, so init to -1.
-	mPickedTriangle = -1;
-	float tmin = 0.0f;
-	if(XNA::IntersectRayAxisAlignedBox(rayOrigin, rayDir, &mMeshBox, &tmin))
+	for(size_t i = 0; i < selection.size(); ++i)
 	{
-		// Find the nearest ray/triangle intersection.
-		tmin = MathHelper::Infinity;
-		for(UINT i = 0; i < mMeshIndices.size()/3; ++i)
-		{
-			// Indices for this triangle.
-			UINT i0 = mMeshIndices[i*3+0];
-			UINT i1 = mMeshIndices[i*3+1];
-			UINT i2 = mMeshIndices[i*3+2];
-
-			// Vertices for this triangle.
-			XMVECTOR v0 = XMLoadFloat3(&mMeshVertices[i0].Pos);
-			XMVECTOR v1 = XMLoadFloat3(&mMeshVertices[i1].Pos);
-			XMVECTOR v2 = XMLoadFloat3(&mMeshVertices[i2].Pos);
-
-			// We have to iterate over all the triangles in order to find the nearest intersection.
-			float t = 0.0f;
-			if(XNA::IntersectRayTriangle(rayOrigin, rayDir, v0, v1, v2, &t))
-			{
-				if( t < tmin )
-				{
-					// This is the new nearest picked triangle.
-					tmin = t;
-					mPickedTriangle = i;
-				}
-			}
-		}
+		if( selection[i].InstanceId == mMeshInstance )
+			mSelectedTriangles.push_back(selection[i].TriangleId);
 	}
 }
\ No newline at end of file
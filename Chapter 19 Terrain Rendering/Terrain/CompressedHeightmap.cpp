@@ -0,0 +1,702 @@
+//***************************************************************************************
+// CompressedHeightmap.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "CompressedHeightmap.h"
+#include "ParallelFor.h"
+#include "FilePath.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const unsigned HeightFileMagic   = 0x50484D43; // "CMHP"
+	const unsigned HeightFileVersion = 1;
+
+	const unsigned MaxSample = 65535;
+
+	// Rice codes with a quotient this large are replaced by the escape code (the
+	// quotient as Escape ones) followed by the raw 16-bit residual.
+	const unsigned RiceEscape = 24;
+
+	// Rice parameters are written in 4 bits.
+	const unsigned MaxRiceParameter = 15;
+
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<unsigned char>& out) : mOut(out), mBits(0), mCount(0)
+		{
+		}
+
+		// Appends the low numBits (<= 24) bits of value.
+		void Put(unsigned value, unsigned numBits)
+		{
+			mBits  |= (unsigned long long)value << mCount;
+			mCount += numBits;
+
+			while(mCount >= 8)
+			{
+				mOut.push_back((unsigned char)mBits);
+				mBits  >>= 8;
+				mCount -= 8;
+			}
+		}
+
+		void Flush()
+		{
+			if(mCount > 0)
+				mOut.push_back((unsigned char)mBits);
+
+			mBits  = 0;
+			mCount = 0;
+		}
+
+	private:
+		std::vector<unsigned char>& mOut;
+		unsigned long long mBits;
+		unsigned mCount;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char* data, size_t size)
+			: mData(data), mSize(size), mPos(0), mBits(0), mCount(0), mOverrun(false)
+		{
+		}
+
+		// Reads numBits (<= 24) bits.
+		unsigned Get(unsigned numBits)
+		{
+			Refill();
+			if(mCount < numBits)
+			{
+				mOverrun = true;
+				return 0;
+			}
+
+			unsigned value = (unsigned)(mBits & ((1ull << numBits) - 1));
+			mBits  >>= numBits;
+			mCount -= numBits;
+
+			return value;
+		}
+
+		// Counts the one bits before the next zero bit and skips the zero, unless
+		// limit (<= 24) ones come first.
+		unsigned GetUnary(unsigned limit)
+		{
+			Refill();
+
+			unsigned n = 0;
+			while(n < limit && n < mCount && ((mBits >> n) & 1))
+				++n;
+
+			unsigned used = n < limit ? n + 1 : n;
+			if(used > mCount)
+			{
+				mOverrun = true;
+				return 0;
+			}
+
+			mBits  >>= used;
+			mCount -= used;
+
+			return n;
+		}
+
+		// True if a read ran past the end of the data.
+		bool Overrun()const
+		{
+			return mOverrun;
+		}
+
+	private:
+		void Refill()
+		{
+			while(mCount <= 56 && mPos < mSize)
+			{
+				mBits  |= (unsigned long long)mData[mPos++] << mCount;
+				mCount += 8;
+			}
+		}
+
+	private:
+		const unsigned char* mData;
+		size_t mSize;
+		size_t mPos;
+		unsigned long long mBits;
+		unsigned mCount;
+		bool mOverrun;
+	};
+
+	// Median edge detector from LOCO-I: predicts a sample from its left (a), upper
+	// (b) and upper-left (c) neighbors, picking min(a, b) or max(a, b) when c
+	// suggests an edge and the planar a + b - c otherwise.
+	unsigned PredictSample(const unsigned short* tile, unsigned side, unsigned i, unsigned j)
+	{
+		if(i == 0)
+			return j == 0 ? 0 : tile[j-1];
+
+		if(j == 0)
+			return tile[(i-1)*side];
+
+		int a = tile[i*side + j-1];
+		int b = tile[(i-1)*side + j];
+		int c = tile[(i-1)*side + j-1];
+
+		if(c >= std::max(a, b))
+			return (unsigned)std::min(a, b);
+		if(c <= std::min(a, b))
+			return (unsigned)std::max(a, b);
+
+		return (unsigned)(a + b - c);
+	}
+
+	// Maps the 16-bit wrapped difference q - pred to 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+	unsigned ZigZag(unsigned q, unsigned pred)
+	{
+		int r = (short)(unsigned short)(q - pred);
+		return (unsigned short)(((unsigned)r << 1) ^ (unsigned)(r >> 15));
+	}
+
+	unsigned UnZigZag(unsigned u, unsigned pred)
+	{
+		int r = (int)(u >> 1) ^ -(int)(u & 1);
+		return (unsigned short)(pred + r);
+	}
+
+	void EncodeTile(const unsigned short* tile, unsigned side, std::vector<unsigned char>& out)
+	{
+		unsigned count = side*side;
+
+		std::vector<unsigned short> residuals(count);
+		for(unsigned i = 0; i < side; ++i)
+		{
+			for(unsigned j = 0; j < side; ++j)
+				residuals[i*side + j] = (unsigned short)ZigZag(tile[i*side + j], PredictSample(tile, side, i, j));
+		}
+
+		// Pick the Rice parameter that gives the smallest tile.
+		unsigned bestK = 0;
+		unsigned long long bestBits = ~0ull;
+		for(unsigned k = 0; k <= MaxRiceParameter; ++k)
+		{
+			unsigned long long bits = 0;
+			for(unsigned n = 0; n < count; ++n)
+			{
+				unsigned quotient = residuals[n] >> k;
+				bits += quotient < RiceEscape ? quotient + 1 + k : RiceEscape + 16;
+			}
+
+			if(bits < bestBits)
+			{
+				bestBits = bits;
+				bestK = k;
+			}
+		}
+
+		BitWriter writer(out);
+		writer.Put(bestK, 4);
+
+		for(unsigned n = 0; n < count; ++n)
+		{
+			unsigned u = residuals[n];
+			unsigned quotient = u >> bestK;
+
+			if(quotient < RiceEscape)
+			{
+				// quotient ones, a zero, then the low bits.
+				writer.Put((1u << quotient) - 1, quotient + 1);
+				writer.Put(u & ((1u << bestK) - 1), bestK);
+			}
+			else
+			{
+				writer.Put((1u << RiceEscape) - 1, RiceEscape);
+				writer.Put(u, 16);
+			}
+		}
+
+		writer.Flush();
+	}
+
+	bool DecodeTile(const unsigned char* data, size_t size, unsigned side, unsigned short* tile)
+	{
+		BitReader reader(data, size);
+		unsigned k = reader.Get(4);
+
+		for(unsigned i = 0; i < side; ++i)
+		{
+			for(unsigned j = 0; j < side; ++j)
+			{
+				unsigned quotient = reader.GetUnary(RiceEscape);
+				unsigned u = quotient < RiceEscape ? (quotient << k) | reader.Get(k) : reader.Get(16);
+
+				tile[i*side + j] = (unsigned short)UnZigZag(u & 0xffff, PredictSample(tile, side, i, j));
+			}
+		}
+
+		return !reader.Overrun();
+	}
+}
+
+CompressedHeightmap::CompressedHeightmap()
+: mWidth(0), mHeight(0), mTileCells(0), mTileSide(0), mTileRows(0), mTileCols(0)
+{
+}
+
+CompressedHeightmap::~CompressedHeightmap()
+{
+}
+
+void CompressedHeightmap::Build(const float* heights, unsigned width, unsigned height, unsigned tileCells)
+{
+	SetSize(width, height, tileCells);
+
+	ParallelFor::Run(mTileMinY.size(), 4, [=](size_t begin, size_t end)
+	{
+		for(size_t tileId = begin; tileId < end; ++tileId)
+		{
+			unsigned row0, col0, numRows, numCols;
+			GetOwnedTexels((unsigned)tileId, row0, col0, numRows, numCols);
+
+			QuantizeTile((unsigned)tileId, heights + row0*width + col0, width);
+		}
+	});
+
+	ComputeTileBounds(0, 0, mTileRows, mTileCols);
+}
+
+void CompressedHeightmap::Update(const float* heights, unsigned row0, unsigned col0, unsigned numRows, unsigned numCols,
+								 unsigned& tileRow0, unsigned& tileCol0, unsigned& tileRow1, unsigned& tileCol1)
+{
+	tileRow0 = tileCol0 = tileRow1 = tileCol1 = 0;
+
+	numRows = std::min(numRows, mHeight - std::min(row0, mHeight));
+	numCols = std::min(numCols, mWidth  - std::min(col0, mWidth));
+	if(numRows == 0 || numCols == 0)
+		return;
+
+	// Tiles owning the texels; the far border tiles also own the last row/column.
+	unsigned ti0 = std::min(row0 / mTileCells, mTileRows-1);
+	unsigned tj0 = std::min(col0 / mTileCells, mTileCols-1);
+	unsigned ti1 = std::min((row0 + numRows-1) / mTileCells, mTileRows-1) + 1;
+	unsigned tj1 = std::min((col0 + numCols-1) / mTileCells, mTileCols-1) + 1;
+	unsigned numTileCols = tj1 - tj0;
+
+	ParallelFor::Run((ti1 - ti0)*numTileCols, 1, [&](size_t begin, size_t end)
+	{
+		std::vector<float> texels(mTileSide*mTileSide);
+
+		for(size_t k = begin; k < end; ++k)
+		{
+			unsigned tileId = (ti0 + (unsigned)k/numTileCols)*mTileCols + tj0 + (unsigned)k%numTileCols;
+
+			unsigned r0, c0, rows, cols;
+			GetOwnedTexels(tileId, r0, c0, rows, cols);
+
+			for(unsigned i = 0; i < rows; ++i)
+			{
+				for(unsigned j = 0; j < cols; ++j)
+				{
+					unsigned row = r0 + i;
+					unsigned col = c0 + j;
+
+					bool edited = row >= row0 && row < row0 + numRows && col >= col0 && col < col0 + numCols;
+					texels[i*cols + j] = edited ? heights[(row - row0)*numCols + (col - col0)] : GetTexel(row, col);
+				}
+			}
+
+			QuantizeTile(tileId, &texels[0], cols);
+		}
+	});
+
+	// The cells of the tiles before also use the first row and column of texels
+	// of these tiles.
+	tileRow0 = ti0 > 0 ? ti0-1 : 0;
+	tileCol0 = tj0 > 0 ? tj0-1 : 0;
+	tileRow1 = ti1;
+	tileCol1 = tj1;
+
+	ComputeTileBounds(tileRow0, tileCol0, tileRow1, tileCol1);
+}
+
+bool CompressedHeightmap::Write(const std::wstring& filename, bool entropyCode)const
+{
+	if(mSamples.empty())
+		return false;
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic        = HeightFileMagic;
+	header.Version      = HeightFileVersion;
+	header.Width        = mWidth;
+	header.Height       = mHeight;
+	header.TileCells    = mTileCells;
+	header.TileRows     = mTileRows;
+	header.TileCols     = mTileCols;
+	header.EntropyCoded = entropyCode ? 1 : 0;
+
+	std::ofstream fout(NativePath(filename), std::ios_base::binary);
+	if(!fout)
+		return false;
+
+	size_t numTiles = mTileMinY.size();
+
+	fout.write((const char*)&header, sizeof(header));
+	fout.write((const char*)&mTileMinY[0], (std::streamsize)(numTiles*sizeof(float)));
+	fout.write((const char*)&mTileScale[0], (std::streamsize)(numTiles*sizeof(float)));
+
+	if(!entropyCode)
+	{
+		fout.write((const char*)&mSamples[0], (std::streamsize)(mSamples.size()*sizeof(unsigned short)));
+		return fout.good();
+	}
+
+	// Tiles are coded independently, so they are coded in parallel and can be
+	// decoded in parallel from the offset table.
+	std::vector<std::vector<unsigned char> > coded(numTiles);
+	ParallelFor::Run(numTiles, 4, [&](size_t begin, size_t end)
+	{
+		for(size_t tileId = begin; tileId < end; ++tileId)
+			EncodeTile(GetTileSamples((unsigned)tileId), mTileSide, coded[tileId]);
+	});
+
+	// Offsets of each tile's code, relative to the end of the table, plus the end.
+	std::vector<unsigned long long> offsets(numTiles+1, 0);
+	for(size_t k = 0; k < numTiles; ++k)
+		offsets[k+1] = offsets[k] + coded[k].size();
+
+	fout.write((const char*)&offsets[0], (std::streamsize)(offsets.size()*sizeof(unsigned long long)));
+	for(size_t k = 0; k < numTiles; ++k)
+		fout.write((const char*)&coded[k][0], (std::streamsize)coded[k].size());
+
+	return fout.good();
+}
+
+bool CompressedHeightmap::Read(const std::wstring& filename)
+{
+	std::ifstream fin(NativePath(filename), std::ios_base::binary);
+	if(!fin)
+		return false;
+
+	FileHeader header;
+	fin.read((char*)&header, sizeof(header));
+	if(!fin || header.Magic != HeightFileMagic || header.Version != HeightFileVersion ||
+		header.Width < 2 || header.Height < 2 || header.TileCells == 0 ||
+		header.TileRows != (header.Height-2)/header.TileCells + 1 ||
+		header.TileCols != (header.Width-2)/header.TileCells + 1)
+	{
+		return false;
+	}
+
+	SetSize(header.Width, header.Height, header.TileCells);
+
+	size_t numTiles = mTileMinY.size();
+
+	fin.read((char*)&mTileMinY[0], (std::streamsize)(numTiles*sizeof(float)));
+	fin.read((char*)&mTileScale[0], (std::streamsize)(numTiles*sizeof(float)));
+
+	bool ok = true;
+	if(!header.EntropyCoded)
+	{
+		fin.read((char*)&mSamples[0], (std::streamsize)(mSamples.size()*sizeof(unsigned short)));
+		ok = !fin.fail();
+	}
+	else
+	{
+		std::vector<unsigned long long> offsets(numTiles+1);
+		fin.read((char*)&offsets[0], (std::streamsize)(offsets.size()*sizeof(unsigned long long)));
+
+		std::vector<unsigned char> coded;
+		if(fin)
+		{
+			coded.resize((size_t)offsets[numTiles]);
+			if(!coded.empty())
+				fin.read((char*)&coded[0], (std::streamsize)coded.size());
+		}
+		ok = !fin.fail();
+
+		for(size_t k = 0; ok && k < numTiles; ++k)
+			ok = offsets[k] < offsets[k+1] && offsets[k+1] <= offsets[numTiles];
+
+		if(ok)
+		{
+			std::vector<char> tileOk(numTiles, 1);
+			ParallelFor::Run(numTiles, 4, [&](size_t begin, size_t end)
+			{
+				for(size_t tileId = begin; tileId < end; ++tileId)
+				{
+					tileOk[tileId] = DecodeTile(&coded[(size_t)offsets[tileId]],
+						(size_t)(offsets[tileId+1] - offsets[tileId]), mTileSide,
+						&mSamples[tileId*mTileSide*mTileSide]);
+				}
+			});
+
+			ok = std::find(tileOk.begin(), tileOk.end(), 0) == tileOk.end();
+		}
+	}
+
+	if(!ok)
+	{
+		SetSize(0, 0, 0);
+		return false;
+	}
+
+	ComputeTileBounds(0, 0, mTileRows, mTileCols);
+	return true;
+}
+
+unsigned CompressedHeightmap::GetWidth()const
+{
+	return mWidth;
+}
+
+unsigned CompressedHeightmap::GetHeight()const
+{
+	return mHeight;
+}
+
+unsigned CompressedHeightmap::GetTileCells()const
+{
+	return mTileCells;
+}
+
+unsigned CompressedHeightmap::GetTileRows()const
+{
+	return mTileRows;
+}
+
+unsigned CompressedHeightmap::GetTileCols()const
+{
+	return mTileCols;
+}
+
+const DirectX::XMFLOAT2& CompressedHeightmap::GetTileBoundsY(unsigned row, unsigned col)const
+{
+	return mTileBoundsY[row*mTileCols + col];
+}
+
+float CompressedHeightmap::GetTexel(unsigned row, unsigned col)const
+{
+	// The tiles on the far borders also own the last row and column of the map.
+	unsigned ti = std::min(row / mTileCells, mTileRows-1);
+	unsigned tj = std::min(col / mTileCells, mTileCols-1);
+	unsigned tileId = ti*mTileCols + tj;
+
+	unsigned i = row - ti*mTileCells;
+	unsigned j = col - tj*mTileCells;
+
+	return mTileMinY[tileId] + GetTileSamples(tileId)[i*mTileSide + j]*mTileScale[tileId];
+}
+
+void CompressedHeightmap::GetCell(unsigned row, unsigned col, float corners[4])const
+{
+	// Cells never start on the last row or column of texels, so the tile of the
+	// cell is (row, col) / mTileCells without clamping.
+	unsigned ti = row / mTileCells;
+	unsigned tj = col / mTileCells;
+	unsigned i  = row - ti*mTileCells;
+	unsigned j  = col - tj*mTileCells;
+
+	// The far corners of the cells along a tile's last row and column belong to
+	// the next tile, except on the far borders of the map.  Every other cell has
+	// all four corners in its own tile.
+	if( (i+1 == mTileCells && ti+1 < mTileRows) || (j+1 == mTileCells && tj+1 < mTileCols) )
+	{
+		corners[0] = GetTexel(row,   col);
+		corners[1] = GetTexel(row,   col+1);
+		corners[2] = GetTexel(row+1, col);
+		corners[3] = GetTexel(row+1, col+1);
+		return;
+	}
+
+	unsigned tileId = ti*mTileCols + tj;
+	const unsigned short* texel = GetTileSamples(tileId) + i*mTileSide + j;
+
+	float minY  = mTileMinY[tileId];
+	float scale = mTileScale[tileId];
+
+	corners[0] = minY + texel[0]*scale;
+	corners[1] = minY + texel[1]*scale;
+	corners[2] = minY + texel[mTileSide]*scale;
+	corners[3] = minY + texel[mTileSide+1]*scale;
+}
+
+void CompressedHeightmap::Decode(float* heights)const
+{
+	const unsigned width = mWidth;
+
+	ParallelFor::Run(mHeight, 64, [=](size_t begin, size_t end)
+	{
+		for(size_t r = begin; r < end; ++r)
+		{
+			unsigned row = (unsigned)r;
+			unsigned ti  = std::min(row / mTileCells, mTileRows-1);
+			unsigned i   = row - ti*mTileCells;
+
+			float* dst = heights + row*width;
+
+			// Each tile supplies the texels of this row up to the next tile's first
+			// column; the last tile also supplies the map's last column.
+			for(unsigned tj = 0; tj < mTileCols; ++tj)
+			{
+				unsigned tileId = ti*mTileCols + tj;
+				unsigned col0 = tj*mTileCells;
+				unsigned col1 = tj+1 < mTileCols ? col0 + mTileCells : width;
+
+				const unsigned short* src = GetTileSamples(tileId) + i*mTileSide - col0;
+				float minY  = mTileMinY[tileId];
+				float scale = mTileScale[tileId];
+
+				for(unsigned col = col0; col < col1; ++col)
+					dst[col] = minY + src[col]*scale;
+			}
+		}
+	});
+}
+
+size_t CompressedHeightmap::GetResidentBytes()const
+{
+	return mSamples.size()*sizeof(unsigned short) + mTileBoundsY.size()*sizeof(DirectX::XMFLOAT2) + 
+		mTileMinY.size()*sizeof(float) + mTileScale.size()*sizeof(float);
+}
+
+void CompressedHeightmap::SetSize(unsigned width, unsigned height, unsigned tileCells)
+{
+	if(width < 2 || height < 2 || tileCells == 0)
+		width = height = tileCells = 0;
+
+	mWidth     = width;
+	mHeight    = height;
+	mTileCells = tileCells;
+	mTileSide  = tileCells > 0 ? tileCells + 1 : 0;
+	mTileRows  = tileCells > 0 ? (height - 2)/tileCells + 1 : 0;
+	mTileCols  = tileCells > 0 ? (width  - 2)/tileCells + 1 : 0;
+
+	size_t numTiles = (size_t)mTileRows*mTileCols;
+
+	mTileBoundsY.assign(numTiles, DirectX::XMFLOAT2(0.0f, 0.0f));
+	mTileMinY.assign(numTiles, 0.0f);
+	mTileScale.assign(numTiles, 0.0f);
+	mSamples.assign(numTiles*mTileSide*mTileSide, 0);
+}
+
+void CompressedHeightmap::GetOwnedTexels(unsigned tileId, unsigned& row0, unsigned& col0, 
+										 unsigned& numRows, unsigned& numCols)const
+{
+	unsigned ti = tileId / mTileCols;
+	unsigned tj = tileId % mTileCols;
+
+	row0 = ti*mTileCells;
+	col0 = tj*mTileCells;
+	numRows = ti+1 < mTileRows ? mTileCells : mHeight - row0;
+	numCols = tj+1 < mTileCols ? mTileCells : mWidth  - col0;
+}
+
+void CompressedHeightmap::QuantizeTile(unsigned tileId, const float* texels, unsigned rowPitch)
+{
+	unsigned row0, col0, numRows, numCols;
+	GetOwnedTexels(tileId, row0, col0, numRows, numCols);
+
+	float minY = +FLT_MAX;
+	float maxY = -FLT_MAX;
+	for(unsigned i = 0; i < numRows; ++i)
+	{
+		const float* row = texels + i*rowPitch;
+		for(unsigned j = 0; j < numCols; ++j)
+		{
+			minY = std::min(minY, row[j]);
+			maxY = std::max(maxY, row[j]);
+		}
+	}
+
+	// A flat tile has a zero step and all samples zero.
+	float scale = (maxY - minY) / MaxSample;
+	float invScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+	// Samples past the owned texels repeat the last owned one, which costs next to
+	// nothing once entropy coded.
+	const unsigned side = mTileSide;
+	unsigned short* tile = &mSamples[(size_t)tileId*side*side];
+	for(unsigned i = 0; i < side; ++i)
+	{
+		const float* row = texels + std::min(i, numRows-1)*rowPitch;
+		for(unsigned j = 0; j < side; ++j)
+		{
+			float h = row[std::min(j, numCols-1)];
+			tile[i*side + j] = (unsigned short)std::min((h - minY)*invScale + 0.5f, (float)MaxSample);
+		}
+	}
+
+	mTileMinY[tileId]  = minY;
+	mTileScale[tileId] = scale;
+}
+
+void CompressedHeightmap::ComputeTileBounds(unsigned tileRow0, unsigned tileCol0, unsigned tileRow1, unsigned tileCol1)
+{
+	unsigned numTileCols = tileCol1 - tileCol0;
+
+	// A tile's cells also touch the first row and column of texels of the next
+	// tiles, which decode with that tile's step, so bound what GetCell returns.
+	ParallelFor::Run((tileRow1 - tileRow0)*numTileCols, 4, [=](size_t begin, size_t end)
+	{
+		for(size_t k = begin; k < end; ++k)
+		{
+			size_t tileId = (tileRow0 + k/numTileCols)*mTileCols + tileCol0 + k%numTileCols;
+
+			unsigned row0, col0, numRows, numCols;
+			GetOwnedTexels((unsigned)tileId, row0, col0, numRows, numCols);
+
+			const unsigned short* tile = GetTileSamples((unsigned)tileId);
+
+			unsigned qMin = MaxSample;
+			unsigned qMax = 0;
+			for(unsigned i = 0; i < numRows; ++i)
+			{
+				for(unsigned j = 0; j < numCols; ++j)
+				{
+					qMin = std::min(qMin, (unsigned)tile[i*mTileSide + j]);
+					qMax = std::max(qMax, (unsigned)tile[i*mTileSide + j]);
+				}
+			}
+
+			float minY = mTileMinY[tileId] + qMin*mTileScale[tileId];
+			float maxY = mTileMinY[tileId] + qMax*mTileScale[tileId];
+
+			unsigned row1 = std::min(row0 + mTileCells, mHeight-1);
+			unsigned col1 = std::min(col0 + mTileCells, mWidth-1);
+
+			if(numRows <= row1 - row0)
+			{
+				for(unsigned col = col0; col <= col1; ++col)
+				{
+					float h = GetTexel(row1, col);
+					minY = std::min(minY, h);
+					maxY = std::max(maxY, h);
+				}
+			}
+
+			if(numCols <= col1 - col0)
+			{
+				for(unsigned row = row0; row <= row1; ++row)
+				{
+					float h = GetTexel(row, col1);
+					minY = std::min(minY, h);
+					maxY = std::max(maxY, h);
+				}
+			}
+
+			mTileBoundsY[tileId] = DirectX::XMFLOAT2(minY, maxY);
+		}
+	});
+}
+
+const unsigned short* CompressedHeightmap::GetTileSamples(unsigned tileId)const
+{
+	return &mSamples[(size_t)tileId*mTileSide*mTileSide];
+}
@@ -0,0 +1,116 @@
+//***************************************************************************************
+// CompressedHeightmap.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Heightmap stored as 16-bit samples quantized per tile.  Each tile keeps the min
+// and max of its heights, and its samples are 16-bit steps between the two, so a
+// height costs 2 bytes instead of 4 and the quantization error of a tile is at
+// most (max - min) / 131070.
+//
+// Every texel is stored by exactly one tile, so neighboring cells always agree on
+// the heights of their shared corners.  A tile owns tileCells x tileCells texels
+// (the tiles on the far borders also own the last row or column of the map), and
+// a cell lookup decodes with one multiply-add per corner.  Cells along a tile's
+// last row and column reach into the neighboring tiles and take a slower path.
+//
+// On disk the samples can optionally be entropy coded (losslessly, on top of the
+// quantization) by predicting each sample from its decoded neighbors and Rice
+// coding the residuals, which saves about a third on smooth terrain.
+//
+// Only depends on DirectXMath and the standard library so it can be used by
+// headless tools.
+//***************************************************************************************
+
+#ifndef COMPRESSEDHEIGHTMAP_H
+#define COMPRESSEDHEIGHTMAP_H
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+class CompressedHeightmap
+{
+public:
+	CompressedHeightmap();
+	~CompressedHeightmap();
+
+	// Quantizes a width x height heightmap, stored row by row, in tiles of
+	// tileCells x tileCells cells.
+	void Build(const float* heights, unsigned width, unsigned height, unsigned tileCells);
+
+	// Sets the numRows x numCols texels starting at (row0, col0) to heights, stored
+	// row by row, and quantizes the tiles owning them again.  The other texels of
+	// those tiles keep their decoded heights up to the new quantization step.
+	// Returns the tiles [tileRow0, tileRow1) x [tileCol0, tileCol1) whose cells and
+	// bounds changed, which include the tiles before the requantized ones.
+	void Update(const float* heights, unsigned row0, unsigned col0, unsigned numRows, unsigned numCols,
+		unsigned& tileRow0, unsigned& tileCol0, unsigned& tileRow1, unsigned& tileCol1);
+
+	// Writes the quantized samples, raw or entropy coded.  Reading back gives
+	// exactly the samples that were written either way.
+	bool Write(const std::wstring& filename, bool entropyCode)const;
+	bool Read(const std::wstring& filename);
+
+	unsigned GetWidth()const;
+	unsigned GetHeight()const;
+	unsigned GetTileCells()const;
+	unsigned GetTileRows()const;
+	unsigned GetTileCols()const;
+
+	// (min, max) decoded height of the texels touched by a tile's cells, which
+	// include the first row and column of the next tiles.
+	const DirectX::XMFLOAT2& GetTileBoundsY(unsigned row, unsigned col)const;
+
+	// Decoded height of texel (row, col).
+	float GetTexel(unsigned row, unsigned col)const;
+
+	// Decoded heights of the corners of cell (row, col), in the order (row, col),
+	// (row, col+1), (row+1, col), (row+1, col+1).
+	void GetCell(unsigned row, unsigned col, float corners[4])const;
+
+	// Decodes the whole map into a width x height array, row by row.
+	void Decode(float* heights)const;
+
+	// Memory used by the samples and per-tile data.
+	size_t GetResidentBytes()const;
+
+private:
+	struct FileHeader
+	{
+		unsigned Magic;
+		unsigned Version;
+		unsigned Width;
+		unsigned Height;
+		unsigned TileCells;
+		unsigned TileRows;
+		unsigned TileCols;
+		unsigned EntropyCoded;
+	};
+
+	void SetSize(unsigned width, unsigned height, unsigned tileCells);
+	void GetOwnedTexels(unsigned tileId, unsigned& row0, unsigned& col0, 
+		unsigned& numRows, unsigned& numCols)const;
+	void QuantizeTile(unsigned tileId, const float* texels, unsigned rowPitch);
+	void ComputeTileBounds(unsigned tileRow0, unsigned tileCol0, unsigned tileRow1, unsigned tileCol1);
+
+	const unsigned short* GetTileSamples(unsigned tileId)const;
+
+private:
+	unsigned mWidth;
+	unsigned mHeight;
+	unsigned mTileCells;
+	unsigned mTileSide;
+	unsigned mTileRows;
+	unsigned mTileCols;
+
+	// Per tile bounds of the cells, and the height of sample 0 and of one 
+	// quantization step.
+	std::vector<DirectX::XMFLOAT2> mTileBoundsY;
+	std::vector<float> mTileMinY;
+	std::vector<float> mTileScale;
+
+	// mTileSide^2 samples per tile, tile after tile.  Samples past the texels a 
+	// tile owns are padding.
+	std::vector<unsigned short> mSamples;
+};
+
+#endif // COMPRESSEDHEIGHTMAP_H
@@ -140,18 +140,24 @@ TerrainEffect::TerrainEffect(ID3D11Device* device, const std::wstring& filename)
 	DirLights          = mFX->GetVariableByName("gDirLights");
 	Mat                = mFX->GetVariableByName("gMaterial");
 
-	MinDist            = mFX->GetVariableByName("gMinDist")->AsScalar();
-	MaxDist            = mFX->GetVariableByName("gMaxDist")->AsScalar();
-	MinTess            = mFX->GetVariableByName("gMinTess")->AsScalar();
-	MaxTess            = mFX->GetVariableByName("gMaxTess")->AsScalar();
 	TexelCellSpaceU    = mFX->GetVariableByName("gTexelCellSpaceU")->AsScalar();
 	TexelCellSpaceV    = mFX->GetVariableByName("gTexelCellSpaceV")->AsScalar();
 	WorldCellSpace     = mFX->GetVariableByName("gWorldCellSpace")->AsScalar();
-	WorldFrustumPlanes = mFX->GetVariableByName("gWorldFrustumPlanes")->AsVector();
+	Paged              = mFX->GetVariableByName("gPaged")->AsScalar();
+	HeightmapCells     = mFX->GetVariableByName("gHeightmapCells")->AsVector();
+	TileGrid           = mFX->GetVariableByName("gTileGrid")->AsVector();
+	TileCells          = mFX->GetVariableByName("gTileCells")->AsScalar();
+	TileSide           = mFX->GetVariableByName("gTileSide")->AsScalar();
+	OverviewStep       = mFX->GetVariableByName("gOverviewStep")->AsScalar();
+	OverviewSize       = mFX->GetVariableByName("gOverviewSize")->AsVector();
 
 	LayerMapArray      = mFX->GetVariableByName("gLayerMapArray")->AsShaderResource();
 	BlendMap           = mFX->GetVariableByName("gBlendMap")->AsShaderResource();
 	HeightMap          = mFX->GetVariableByName("gHeightMap")->AsShaderResource();
+	PatchLods          = mFX->GetVariableByName("gPatchLods")->AsShaderResource();
+	TileHeightMapArray = mFX->GetVariableByName("gTileHeightMapArray")->AsShaderResource();
+	TileBlendMapArray  = mFX->GetVariableByName("gTileBlendMapArray")->AsShaderResource();
+	TileSlots          = mFX->GetVariableByName("gTileSlots")->AsShaderResource();
 }
 
 TerrainEffect::~TerrainEffect()
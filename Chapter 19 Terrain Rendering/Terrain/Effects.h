@@ -151,18 +151,25 @@ public:
 	void SetDirLights(const DirectionalLight* lights)   { DirLights->SetRawValue(lights, 0, 3*sizeof(DirectionalLight)); }
 	void SetMaterial(const Material& mat)               { Mat->SetRawValue(&mat, 0, sizeof(Material)); }
 
-	void SetMinDist(float f)                            { MinDist->SetFloat(f); }
-	void SetMaxDist(float f)                            { MaxDist->SetFloat(f); }
-	void SetMinTess(float f)                            { MinTess->SetFloat(f); }
-	void SetMaxTess(float f)                            { MaxTess->SetFloat(f); }
 	void SetTexelCellSpaceU(float f)                    { TexelCellSpaceU->SetFloat(f); }
 	void SetTexelCellSpaceV(float f)                    { TexelCellSpaceV->SetFloat(f); }
 	void SetWorldCellSpace(float f)                     { WorldCellSpace->SetFloat(f); }
-	void SetWorldFrustumPlanes(XMFLOAT4 planes[6])      { WorldFrustumPlanes->SetFloatVectorArray(reinterpret_cast<float*>(planes), 0, 6); }
+
+	void SetPaged(bool b)                               { Paged->SetBool(b); }
+	void SetHeightmapCells(const XMFLOAT2& v)           { HeightmapCells->SetRawValue(&v, 0, sizeof(XMFLOAT2)); }
+	void SetTileGrid(const XMFLOAT2& v)                 { TileGrid->SetRawValue(&v, 0, sizeof(XMFLOAT2)); }
+	void SetTileCells(float f)                          { TileCells->SetFloat(f); }
+	void SetTileSide(float f)                           { TileSide->SetFloat(f); }
+	void SetOverviewStep(float f)                       { OverviewStep->SetFloat(f); }
+	void SetOverviewSize(const XMFLOAT2& v)             { OverviewSize->SetRawValue(&v, 0, sizeof(XMFLOAT2)); }
 
 	void SetLayerMapArray(ID3D11ShaderResourceView* tex)   { LayerMapArray->SetResource(tex); }
 	void SetBlendMap(ID3D11ShaderResourceView* tex)        { BlendMap->SetResource(tex); }
 	void SetHeightMap(ID3D11ShaderResourceView* tex)       { HeightMap->SetResource(tex); }
+	void SetPatchLods(ID3D11ShaderResourceView* buf)       { PatchLods->SetResource(buf); }
+	void SetTileHeightMapArray(ID3D11ShaderResourceView* tex) { TileHeightMapArray->SetResource(tex); }
+	void SetTileBlendMapArray(ID3D11ShaderResourceView* tex)  { TileBlendMapArray->SetResource(tex); }
+	void SetTileSlots(ID3D11ShaderResourceView* buf)          { TileSlots->SetResource(buf); }
 	
 
 	ID3DX11EffectTechnique* Light1Tech;
@@ -182,18 +189,24 @@ public:
 	ID3DX11EffectScalarVariable* FogRange;
 	ID3DX11EffectVariable* DirLights;
 	ID3DX11EffectVariable* Mat;
-	ID3DX11EffectScalarVariable* MinDist;
-	ID3DX11EffectScalarVariable* MaxDist;
-	ID3DX11EffectScalarVariable* MinTess;
-	ID3DX11EffectScalarVariable* MaxTess;
 	ID3DX11EffectScalarVariable* TexelCellSpaceU;
 	ID3DX11EffectScalarVariable* TexelCellSpaceV;
 	ID3DX11EffectScalarVariable* WorldCellSpace;
-	ID3DX11EffectVectorVariable* WorldFrustumPlanes;
+	ID3DX11EffectScalarVariable* Paged;
+	ID3DX11EffectVectorVariable* HeightmapCells;
+	ID3DX11EffectVectorVariable* TileGrid;
+	ID3DX11EffectScalarVariable* TileCells;
+	ID3DX11EffectScalarVariable* TileSide;
+	ID3DX11EffectScalarVariable* OverviewStep;
+	ID3DX11EffectVectorVariable* OverviewSize;
 
 	ID3DX11EffectShaderResourceVariable* LayerMapArray;
 	ID3DX11EffectShaderResourceVariable* BlendMap;
 	ID3DX11EffectShaderResourceVariable* HeightMap;
+	ID3DX11EffectShaderResourceVariable* PatchLods;
+	ID3DX11EffectShaderResourceVariable* TileHeightMapArray;
+	ID3DX11EffectShaderResourceVariable* TileBlendMapArray;
+	ID3DX11EffectShaderResourceVariable* TileSlots;
 };
 #pragma endregion
 
@@ -10,24 +10,21 @@ cbuffer cbPerFrame
 	float  gFogRange;
 	float4 gFogColor;
 	
-	// When distance is minimum, the tessellation is maximum.
-	// When distance is maximum, the tessellation is minimum.
-	float gMinDist;
-	float gMaxDist;
-
-	// Exponents for power of 2 tessellation.  The tessellation
-	// range is [2^(gMinTess), 2^(gMaxTess)].  Since the maximum
-	// tessellation is 64, this means gMaxTess can be at most 6
-	// since 2^6 = 64.
-	float gMinTess;
-	float gMaxTess;
-	
 	float gTexelCellSpaceU;
 	float gTexelCellSpaceV;
 	float gWorldCellSpace;
 	float2 gTexScale = 50.0f;
-	
-	float4 gWorldFrustumPlanes[6];
+
+	// Paged mode.  gHeightMap and gBlendMap then hold the overview, which samples
+	// every gOverviewStep-th texel, and resident tiles are read from their slot in
+	// the tile arrays.  A tile's texels start one texel before its first cell.
+	bool gPaged;
+	float2 gHeightmapCells;
+	float2 gTileGrid;
+	float gTileCells;
+	float gTileSide;
+	float gOverviewStep;
+	float2 gOverviewSize;
 };
 
 cbuffer cbPerObject
@@ -44,6 +41,21 @@ Texture2DArray gLayerMapArray;
 Texture2D gBlendMap;
 Texture2D gHeightMap;
 
+// Tessellation factors of the patches being drawn, chosen on the CPU by
+// TerrainLodSelector.  Entry i belongs to the i-th patch of the draw call.
+struct PatchLod
+{
+	float4 EdgeTess;
+	float InsideTess;
+};
+
+StructuredBuffer<PatchLod> gPatchLods;
+
+// Paged mode: the tile arrays, and the slot of every tile (-1 if not resident).
+Texture2DArray gTileHeightMapArray;
+Texture2DArray gTileBlendMapArray;
+Buffer<int> gTileSlots;
+
 SamplerState samLinear
 {
 	Filter = MIN_MAG_MIP_LINEAR;
@@ -60,83 +72,114 @@ SamplerState samHeightmap
 	AddressV = CLAMP;
 };
 
+//
+// Heightmap lookups shared by the domain and pixel shaders.  slot selects the tile
+// to read (see ResidentTileSlot); with slot < 0 the heightmap and blend map are 
+// read, or the overview in paged mode.
+//
+
+// Tile that owns the point at cell (in cells from the upper-left corner).  Points
+// past the last whole tile belong to the last tile.
+int2 TileOf(float2 cell)
+{
+	return (int2)clamp(floor(cell / gTileCells), 0.0f, gTileGrid - 1.0f);
+}
+
+int GetTileSlot(int2 tile)
+{
+	return gTileSlots[tile.y*(int)gTileGrid.x + tile.x];
+}
+
+// Slot to read the point at tex from, or -1.  The domain shader passes the 
+// vertices on a patch border, which are shared by the tiles on both sides, so 
+// with shared = true the tile is only used if every tile touching the point is
+// resident.  Neighboring patches then agree on their border heights and do not
+// crack where residency changes.
+int ResidentTileSlot(float2 tex, bool shared, out int2 tile)
+{
+	float2 cell = tex*gHeightmapCells;
+	tile = TileOf(cell);
+
+	if( !gPaged )
+		return -1;
+
+	int slot = GetTileSlot(tile);
+	if( shared )
+	{
+		int2 tile0 = TileOf(cell - 0.01f);
+		int2 tile1 = TileOf(cell + 0.01f);
+
+		if( GetTileSlot(tile0) < 0 || GetTileSlot(tile1) < 0 ||
+			GetTileSlot(int2(tile0.x, tile1.y)) < 0 || GetTileSlot(int2(tile1.x, tile0.y)) < 0 )
+		{
+			slot = -1;
+		}
+	}
+
+	return slot;
+}
+
+float3 TileTex(float2 tex, int2 tile, int slot)
+{
+	float2 texel = tex*gHeightmapCells - tile*gTileCells + 1.0f;
+	return float3((texel + 0.5f) / gTileSide, slot);
+}
+
+float2 OverviewTex(float2 tex)
+{
+	// Exact except in the last overview row and column, which can be narrower 
+	// than gOverviewStep.
+	return (tex*gHeightmapCells / gOverviewStep + 0.5f) / gOverviewSize;
+}
+
+float SampleHeight(float2 tex, int2 tile, int slot)
+{
+	if( slot >= 0 )
+		return gTileHeightMapArray.SampleLevel( samHeightmap, TileTex(tex, tile, slot), 0 ).r;
+
+	if( gPaged )
+		return gHeightMap.SampleLevel( samHeightmap, OverviewTex(tex), 0 ).r;
+
+	return gHeightMap.SampleLevel( samHeightmap, tex, 0 ).r;
+}
+
+float4 SampleBlend(float2 tex, int2 tile, int slot)
+{
+	if( slot >= 0 )
+		return gTileBlendMapArray.SampleLevel( samHeightmap, TileTex(tex, tile, slot), 0 );
+
+	if( gPaged )
+		return gBlendMap.SampleLevel( samHeightmap, OverviewTex(tex), 0 );
+
+	return gBlendMap.Sample( samLinear, tex );
+}
+
 struct VertexIn
 {
 	float3 PosL     : POSITION;
 	float2 Tex      : TEXCOORD0;
-	float2 BoundsY  : TEXCOORD1;
 };
 
 struct VertexOut
 {
 	float3 PosW     : POSITION;
 	float2 Tex      : TEXCOORD0;
-	float2 BoundsY  : TEXCOORD1;
 };
 
 VertexOut VS(VertexIn vin)
 {
 	VertexOut vout;
 	
-	// Terrain specified directly in world space.
+	// Terrain specified directly in world space.  The domain shader does the 
+	// displacement, so the patch corners are left at y = 0.
 	vout.PosW = vin.PosL;
 
-	// Displace the patch corners to world space.  This is to make 
-	// the eye to patch distance calculation more accurate.
-	vout.PosW.y = gHeightMap.SampleLevel( samHeightmap, vin.Tex, 0 ).r;
-
 	// Output vertex attributes to next stage.
 	vout.Tex      = vin.Tex;
-	vout.BoundsY  = vin.BoundsY;
 	
 	return vout;
 }
  
-float CalcTessFactor(float3 p)
-{
-	float d = distance(p, gEyePosW);
-
-	// max norm in xz plane (useful to see detail levels from a bird's eye).
-	//float d = max( abs(p.x-gEyePosW.x), abs(p.z-gEyePosW.z) );
-	
-	float s = saturate( (d - gMinDist) / (gMaxDist - gMinDist) );
-	
-	return pow(2, (lerp(gMaxTess, gMinTess, s)) );
-}
-
-// Returns true if the box is completely behind (in negative half space) of plane.
-bool AabbBehindPlaneTest(float3 center, float3 extents, float4 plane)
-{
-	float3 n = abs(plane.xyz);
-	
-	// This is always positive.
-	float r = dot(extents, n);
-	
-	// signed distance from center point to plane.
-	float s = dot( float4(center, 1.0f), plane );
-	
-	// If the center point of the box is a distance of e or more behind the
-	// plane (in which case s is negative since it is behind the plane),
-	// then the box is completely in the negative half space of the plane.
-	return (s + r) < 0.0f;
-}
-
-// Returns true if the box is completely outside the frustum.
-bool AabbOutsideFrustumTest(float3 center, float3 extents, float4 frustumPlanes[6])
-{
-	for(int i = 0; i < 6; ++i)
-	{
-		// If the box is completely behind any of the frustum planes
-		// then it is outside the frustum.
-		if( AabbBehindPlaneTest(center, extents, frustumPlanes[i]) )
-		{
-			return true;
-		}
-	}
-	
-	return false;
-}
-
 struct PatchTess
 {
 	float EdgeTess[4]   : SV_TessFactor;
@@ -147,59 +190,19 @@ PatchTess ConstantHS(InputPatch<VertexOut, 4> patch, uint patchID : SV_Primitive
 {
 	PatchTess pt;
 	
-	//
-	// Frustum cull
-	//
-	
-	// We store the patch BoundsY in the first control point.
-	float minY = patch[0].BoundsY.x;
-	float maxY = patch[0].BoundsY.y;
+	// Only the patches that passed the CPU frustum cull are drawn, and the CPU
+	// already made the factors of shared edges agree, so just look them up.
+	PatchLod lod = gPatchLods[patchID];
+
+	pt.EdgeTess[0] = lod.EdgeTess.x;
+	pt.EdgeTess[1] = lod.EdgeTess.y;
+	pt.EdgeTess[2] = lod.EdgeTess.z;
+	pt.EdgeTess[3] = lod.EdgeTess.w;
 	
-	// Build axis-aligned bounding box.  patch[2] is lower-left corner
-	// and patch[1] is upper-right corner.
-	float3 vMin = float3(patch[2].PosW.x, minY, patch[2].PosW.z);
-	float3 vMax = float3(patch[1].PosW.x, maxY, patch[1].PosW.z);
+	pt.InsideTess[0] = lod.InsideTess;
+	pt.InsideTess[1] = lod.InsideTess;
 	
-	float3 boxCenter  = 0.5f*(vMin + vMax);
-	float3 boxExtents = 0.5f*(vMax - vMin);
-	if( AabbOutsideFrustumTest(boxCenter, boxExtents, gWorldFrustumPlanes) )
-	{
-		pt.EdgeTess[0] = 0.0f;
-		pt.EdgeTess[1] = 0.0f;
-		pt.EdgeTess[2] = 0.0f;
-		pt.EdgeTess[3] = 0.0f;
-		
-		pt.InsideTess[0] = 0.0f;
-		pt.InsideTess[1] = 0.0f;
-		
-		return pt;
-	}
-	//
-	// Do normal tessellation based on distance.
-	//
-	else 
-	{
-		// It is important to do the tess factor calculation based on the
-		// edge properties so that edges shared by more than one patch will
-		// have the same tessellation factor.  Otherwise, gaps can appear.
-		
-		// Compute midpoint on edges, and patch center
-		float3 e0 = 0.5f*(patch[0].PosW + patch[2].PosW);
-		float3 e1 = 0.5f*(patch[0].PosW + patch[1].PosW);
-		float3 e2 = 0.5f*(patch[1].PosW + patch[3].PosW);
-		float3 e3 = 0.5f*(patch[2].PosW + patch[3].PosW);
-		float3  c = 0.25f*(patch[0].PosW + patch[1].PosW + patch[2].PosW + patch[3].PosW);
-		
-		pt.EdgeTess[0] = CalcTessFactor(e0);
-		pt.EdgeTess[1] = CalcTessFactor(e1);
-		pt.EdgeTess[2] = CalcTessFactor(e2);
-		pt.EdgeTess[3] = CalcTessFactor(e3);
-		
-		pt.InsideTess[0] = CalcTessFactor(c);
-		pt.InsideTess[1] = pt.InsideTess[0];
-	
-		return pt;
-	}
+	return pt;
 }
 
 struct HullOut
@@ -259,7 +262,9 @@ DomainOut DS(PatchTess patchTess,
 	dout.TiledTex = dout.Tex*gTexScale; 
 	
 	// Displacement mapping
-	dout.PosW.y = gHeightMap.SampleLevel( samHeightmap, dout.Tex, 0 ).r;
+	int2 tile;
+	int slot = ResidentTileSlot(dout.Tex, true, tile);
+	dout.PosW.y = SampleHeight(dout.Tex, tile, slot);
 	
 	// NOTE: We tried computing the normal in the shader using finite difference, 
 	// but the vertices move continuously with fractional_even which creates
@@ -284,10 +289,14 @@ float4 PS(DomainOut pin,
 	float2 bottomTex = pin.Tex + float2(0.0f, gTexelCellSpaceV);
 	float2 topTex    = pin.Tex + float2(0.0f, -gTexelCellSpaceV);
 	
-	float leftY   = gHeightMap.SampleLevel( samHeightmap, leftTex, 0 ).r;
-	float rightY  = gHeightMap.SampleLevel( samHeightmap, rightTex, 0 ).r;
-	float bottomY = gHeightMap.SampleLevel( samHeightmap, bottomTex, 0 ).r;
-	float topY    = gHeightMap.SampleLevel( samHeightmap, topTex, 0 ).r;
+	// The neighbors are read from the same tile; its apron covers them.
+	int2 tile;
+	int slot = ResidentTileSlot(pin.Tex, false, tile);
+
+	float leftY   = SampleHeight(leftTex, tile, slot);
+	float rightY  = SampleHeight(rightTex, tile, slot);
+	float bottomY = SampleHeight(bottomTex, tile, slot);
+	float topY    = SampleHeight(topTex, tile, slot);
 	
 	float3 tangent = normalize(float3(2.0f*gWorldCellSpace, rightY - leftY, 0.0f));
 	float3 bitan   = normalize(float3(0.0f, bottomY - topY, -2.0f*gWorldCellSpace)); 
@@ -315,7 +324,7 @@ float4 PS(DomainOut pin,
 	float4 c4 = gLayerMapArray.Sample( samLinear, float3(pin.TiledTex, 4.0f) ); 
 	
 	// Sample the blend map.
-	float4 t  = gBlendMap.Sample( samLinear, pin.Tex ); 
+	float4 t  = SampleBlend(pin.Tex, tile, slot); 
     
     // Blend the layers on top of each other.
     float4 texColor = c0;
@@ -0,0 +1,458 @@
+//***************************************************************************************
+// HeightmapPyramid.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "HeightmapPyramid.h"
+#include "CompressedHeightmap.h"
+#include "PagedHeightmap.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// Moller-Trumbore ray/triangle test; returns the ray parameter in t.
+	bool IntersectRayTriangle(const float pos[3], const float dir[3], 
+		const float v0[3], const float v1[3], const float v2[3], float& t)
+	{
+		float e1[3] = { v1[0]-v0[0], v1[1]-v0[1], v1[2]-v0[2] };
+		float e2[3] = { v2[0]-v0[0], v2[1]-v0[1], v2[2]-v0[2] };
+
+		float p[3] = {
+			dir[1]*e2[2] - dir[2]*e2[1],
+			dir[2]*e2[0] - dir[0]*e2[2],
+			dir[0]*e2[1] - dir[1]*e2[0] };
+
+		float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+		if( fabsf(det) < 1e-12f )
+			return false;
+
+		float invDet = 1.0f / det;
+
+		float s[3] = { pos[0]-v0[0], pos[1]-v0[1], pos[2]-v0[2] };
+		float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*invDet;
+		if( u < 0.0f || u > 1.0f )
+			return false;
+
+		float q[3] = {
+			s[1]*e1[2] - s[2]*e1[1],
+			s[2]*e1[0] - s[0]*e1[2],
+			s[0]*e1[1] - s[1]*e1[0] };
+
+		float v = (dir[0]*q[0] + dir[1]*q[1] + dir[2]*q[2])*invDet;
+		if( v < 0.0f || u + v > 1.0f )
+			return false;
+
+		t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*invDet;
+		return t >= 0.0f;
+	}
+}
+
+HeightmapPyramid::HeightmapPyramid()
+: mCellRows(0), mCellCols(0), mBlockCells(0)
+{
+}
+
+HeightmapPyramid::~HeightmapPyramid()
+{
+}
+
+void HeightmapPyramid::Build(const DirectX::XMFLOAT2* blockBounds, unsigned cellRows, unsigned cellCols, unsigned blockCells)
+{
+	mCellRows   = cellRows;
+	mCellCols   = cellCols;
+	mBlockCells = blockCells;
+	mLevels.clear();
+
+	if(cellRows == 0 || cellCols == 0 || blockCells == 0)
+		return;
+
+	// Level 0 has one entry per block; keep halving (rounding up) down to 1x1.
+	unsigned rows = (cellRows + blockCells-1)/blockCells;
+	unsigned cols = (cellCols + blockCells-1)/blockCells;
+	for(;;)
+	{
+		Level level;
+		level.Rows = rows;
+		level.Cols = cols;
+		level.Bounds.resize(rows*cols);
+		mLevels.push_back(level);
+
+		if(rows == 1 && cols == 1)
+			break;
+
+		rows = (rows+1)/2;
+		cols = (cols+1)/2;
+	}
+
+	mLevels[0].Bounds.assign(blockBounds, blockBounds + mLevels[0].Rows*mLevels[0].Cols);
+
+	for(unsigned k = 1; k < mLevels.size(); ++k)
+		BuildLevel(k, 0, 0, mLevels[k].Rows, mLevels[k].Cols);
+}
+
+void HeightmapPyramid::Update(const DirectX::XMFLOAT2* blockBounds, unsigned row0, unsigned col0, unsigned row1, unsigned col1)
+{
+	if(mLevels.empty())
+		return;
+
+	Level& blocks = mLevels[0];
+	row1 = std::min(row1, blocks.Rows);
+	col1 = std::min(col1, blocks.Cols);
+	if(row0 >= row1 || col0 >= col1)
+		return;
+
+	for(unsigned i = row0; i < row1; ++i)
+	{
+		const DirectX::XMFLOAT2* src = blockBounds + (i - row0)*(col1 - col0);
+		std::copy(src, src + (col1 - col0), &blocks.Bounds[i*blocks.Cols + col0]);
+	}
+
+	// Each coarser level only changes over the parents of the changed entries.
+	for(unsigned k = 1; k < mLevels.size(); ++k)
+	{
+		row0 = row0/2;
+		col0 = col0/2;
+		row1 = (row1+1)/2;
+		col1 = (col1+1)/2;
+
+		BuildLevel(k, row0, col0, row1, col1);
+	}
+}
+
+unsigned HeightmapPyramid::GetNumLevels()const
+{
+	return (unsigned)mLevels.size();
+}
+
+unsigned HeightmapPyramid::GetLevelRows(unsigned level)const
+{
+	return mLevels[level].Rows;
+}
+
+unsigned HeightmapPyramid::GetLevelCols(unsigned level)const
+{
+	return mLevels[level].Cols;
+}
+
+unsigned HeightmapPyramid::GetCellRows()const
+{
+	return mCellRows;
+}
+
+unsigned HeightmapPyramid::GetCellCols()const
+{
+	return mCellCols;
+}
+
+unsigned HeightmapPyramid::GetBlockCells()const
+{
+	return mBlockCells;
+}
+
+const DirectX::XMFLOAT2& HeightmapPyramid::GetBounds(unsigned level, unsigned row, unsigned col)const
+{
+	const Level& l = mLevels[level];
+	return l.Bounds[row*l.Cols + col];
+}
+
+size_t HeightmapPyramid::GetResidentBytes()const
+{
+	size_t bytes = mLevels.size()*sizeof(Level);
+	for(size_t k = 0; k < mLevels.size(); ++k)
+		bytes += mLevels[k].Bounds.size()*sizeof(DirectX::XMFLOAT2);
+
+	return bytes;
+}
+
+void HeightmapPyramid::BuildLevel(unsigned k, unsigned row0, unsigned col0, unsigned row1, unsigned col1)
+{
+	const Level& fine = mLevels[k-1];
+	Level& coarse = mLevels[k];
+
+	// Rows only read the finer level and write their own entries, so they can run
+	// in parallel.  A level needs the finer one to be complete, so the levels run
+	// one after the other.
+	ParallelFor::Run(row1 - row0, 16, [&](size_t begin, size_t end)
+	{
+		for(unsigned i = row0 + (unsigned)begin; i < row0 + (unsigned)end; ++i)
+		{
+			// The last row/column of a level with an odd size has no second child.
+			unsigned fi0 = 2*i;
+			unsigned fi1 = std::min(2*i+1, fine.Rows-1);
+
+			for(unsigned j = col0; j < col1; ++j)
+			{
+				unsigned fj0 = 2*j;
+				unsigned fj1 = std::min(2*j+1, fine.Cols-1);
+
+				const DirectX::XMFLOAT2& a = fine.Bounds[fi0*fine.Cols + fj0];
+				const DirectX::XMFLOAT2& b = fine.Bounds[fi0*fine.Cols + fj1];
+				const DirectX::XMFLOAT2& c = fine.Bounds[fi1*fine.Cols + fj0];
+				const DirectX::XMFLOAT2& d = fine.Bounds[fi1*fine.Cols + fj1];
+
+				coarse.Bounds[i*coarse.Cols + j] = DirectX::XMFLOAT2(
+					std::min(std::min(a.x, b.x), std::min(c.x, d.x)),
+					std::max(std::max(a.y, b.y), std::max(c.y, d.y)));
+			}
+		}
+	});
+}
+
+void HeightmapPyramid::GetBlockRange(unsigned level, unsigned row, unsigned col, 
+	unsigned& row0, unsigned& col0, unsigned& row1, unsigned& col1)const
+{
+	unsigned size = mBlockCells << level;
+
+	row0 = row*size;
+	col0 = col*size;
+	row1 = std::min(row0 + size, mCellRows);
+	col1 = std::min(col0 + size, mCellCols);
+}
+
+bool HeightmapPyramid::IntersectRay(const CompressedHeightmap& heights, const DirectX::XMFLOAT3& rayPos, const DirectX::XMFLOAT3& rayDir, 
+	float tMax, float& t, DirectX::XMFLOAT3& normal)const
+{
+	Ray ray;
+	ray.Heights = &heights;
+	ray.PagedHeights = 0;
+
+	return IntersectRay(ray, rayPos, rayDir, tMax, t, normal);
+}
+
+bool HeightmapPyramid::IntersectRay(const PagedHeightmap& heights, const DirectX::XMFLOAT3& rayPos, const DirectX::XMFLOAT3& rayDir, 
+	float tMax, float& t, DirectX::XMFLOAT3& normal)const
+{
+	Ray ray;
+	ray.Heights = 0;
+	ray.PagedHeights = &heights;
+
+	return IntersectRay(ray, rayPos, rayDir, tMax, t, normal);
+}
+
+bool HeightmapPyramid::IntersectRay(Ray& ray, const DirectX::XMFLOAT3& rayPos, const DirectX::XMFLOAT3& rayDir, 
+	float tMax, float& t, DirectX::XMFLOAT3& normal)const
+{
+	if(mLevels.empty())
+		return false;
+
+	ray.Pos[0] = rayPos.x; ray.Pos[1] = rayPos.y; ray.Pos[2] = rayPos.z;
+	ray.Dir[0] = rayDir.x; ray.Dir[1] = rayDir.y; ray.Dir[2] = rayDir.z;
+	for(int i = 0; i < 3; ++i)
+		ray.InvDir[i] = 1.0f / ray.Dir[i];
+
+	RayHit hit;
+	hit.T = tMax;
+	hit.Found = false;
+
+	unsigned top = (unsigned)mLevels.size()-1;
+
+	float tEnter;
+	if(IntersectRayBlock(ray, top, 0, 0, tMax, tEnter))
+		IntersectRay(ray, top, 0, 0, tEnter, hit);
+
+	if(!hit.Found)
+		return false;
+
+	t = hit.T;
+	normal = hit.Normal;
+	return true;
+}
+
+void HeightmapPyramid::IntersectRay(const Ray& ray, unsigned level, unsigned row, unsigned col, float tEnter, RayHit& hit)const
+{
+	if(level == 0)
+	{
+		IntersectRayCells(ray, row, col, tEnter, hit);
+		return;
+	}
+
+	// Sort the (up to four) children the ray enters by entry distance, like a 2D 
+	// DDA step at this level, and stop once a child starts beyond the nearest hit.
+	const Level& fine = mLevels[level-1];
+
+	unsigned childRow[4];
+	unsigned childCol[4];
+	float childEnter[4];
+	unsigned count = 0;
+
+	for(unsigned i = 2*row; i < std::min(2*row+2, fine.Rows); ++i)
+	{
+		for(unsigned j = 2*col; j < std::min(2*col+2, fine.Cols); ++j)
+		{
+			float te;
+			if(!IntersectRayBlock(ray, level-1, i, j, hit.T, te))
+				continue;
+
+			// Insertion sort.
+			unsigned k = count++;
+			for(; k > 0 && childEnter[k-1] > te; --k)
+			{
+				childRow[k]   = childRow[k-1];
+				childCol[k]   = childCol[k-1];
+				childEnter[k] = childEnter[k-1];
+			}
+			childRow[k]   = i;
+			childCol[k]   = j;
+			childEnter[k] = te;
+		}
+	}
+
+	for(unsigned k = 0; k < count; ++k)
+	{
+		if(childEnter[k] > hit.T)
+			break;
+
+		IntersectRay(ray, level-1, childRow[k], childCol[k], childEnter[k], hit);
+	}
+}
+
+bool HeightmapPyramid::IntersectRayBlock(const Ray& ray, unsigned level, unsigned row, unsigned col, 
+	float tMax, float& tEnter)const
+{
+	unsigned row0, col0, row1, col1;
+	GetBlockRange(level, row, col, row0, col0, row1, col1);
+
+	const DirectX::XMFLOAT2& boundsY = GetBounds(level, row, col);
+
+	float boxMin[3] = { (float)col0, boundsY.x, (float)row0 };
+	float boxMax[3] = { (float)col1, boundsY.y, (float)row1 };
+
+	float tNear = 0.0f;
+	float tFar  = tMax;
+	for(int i = 0; i < 3; ++i)
+	{
+		// A ray parallel to a slab must start inside it.
+		if(ray.Dir[i] == 0.0f)
+		{
+			if(ray.Pos[i] < boxMin[i] || ray.Pos[i] > boxMax[i])
+				return false;
+			continue;
+		}
+
+		float t0 = (boxMin[i] - ray.Pos[i])*ray.InvDir[i];
+		float t1 = (boxMax[i] - ray.Pos[i])*ray.InvDir[i];
+		if(t0 > t1)
+			std::swap(t0, t1);
+
+		tNear = std::max(tNear, t0);
+		tFar  = std::min(tFar, t1);
+		if(tNear > tFar)
+			return false;
+	}
+
+	tEnter = tNear;
+	return true;
+}
+
+void HeightmapPyramid::IntersectRayCells(const Ray& ray, unsigned row, unsigned col, float tEnter, RayHit& hit)const
+{
+	unsigned row0, col0, row1, col1;
+	GetBlockRange(0, row, col, row0, col0, row1, col1);
+
+	// Start in the cell where the ray enters the block.  Rounding can put the
+	// entry point just outside, so clamp it to the block.
+	float t = tEnter;
+	int i = (int)floorf(ray.Pos[2] + t*ray.Dir[2]);
+	int j = (int)floorf(ray.Pos[0] + t*ray.Dir[0]);
+	i = std::min(std::max(i, (int)row0), (int)row1-1);
+	j = std::min(std::max(j, (int)col0), (int)col1-1);
+
+	// 2D DDA over the cells: tNextCol/tNextRow is where the ray crosses into the 
+	// next column/row of cells.
+	int stepCol = ray.Dir[0] > 0.0f ? 1 : -1;
+	int stepRow = ray.Dir[2] > 0.0f ? 1 : -1;
+
+	float tDeltaCol = ray.Dir[0] != 0.0f ? fabsf(ray.InvDir[0]) : FLT_MAX;
+	float tDeltaRow = ray.Dir[2] != 0.0f ? fabsf(ray.InvDir[2]) : FLT_MAX;
+
+	float tNextCol = ray.Dir[0] != 0.0f ? ((float)(stepCol > 0 ? j+1 : j) - ray.Pos[0])*ray.InvDir[0] : FLT_MAX;
+	float tNextRow = ray.Dir[2] != 0.0f ? ((float)(stepRow > 0 ? i+1 : i) - ray.Pos[2])*ray.InvDir[2] : FLT_MAX;
+
+	for(;;)
+	{
+		float tExit = std::min(std::min(tNextCol, tNextRow), hit.T);
+
+		// Only test the triangles if the ray's height over the cell reaches the
+		// range of its corners.
+		float corners[4];
+		if( ray.Heights )
+			ray.Heights->GetCell((unsigned)i, (unsigned)j, corners);
+		else
+			ray.PagedHeights->GetCell((unsigned)i, (unsigned)j, corners);
+
+		float minY = std::min(std::min(corners[0], corners[1]), std::min(corners[2], corners[3]));
+		float maxY = std::max(std::max(corners[0], corners[1]), std::max(corners[2], corners[3]));
+
+		float y0 = ray.Pos[1] + t*ray.Dir[1];
+		float y1 = ray.Pos[1] + tExit*ray.Dir[1];
+
+		if(std::max(y0, y1) >= minY && std::min(y0, y1) <= maxY)
+			IntersectRayCell(ray, (unsigned)i, (unsigned)j, corners, hit);
+
+		// Cells are visited in order along the ray, so a hit before the ray leaves
+		// this cell is the nearest.
+		if(tNextCol >= hit.T && tNextRow >= hit.T)
+			return;
+
+		if(tNextCol < tNextRow)
+		{
+			j += stepCol;
+			t = tNextCol;
+			tNextCol += tDeltaCol;
+		}
+		else
+		{
+			i += stepRow;
+			t = tNextRow;
+			tNextRow += tDeltaRow;
+		}
+
+		if(i < (int)row0 || i >= (int)row1 || j < (int)col0 || j >= (int)col1)
+			return;
+	}
+}
+
+void HeightmapPyramid::IntersectRayCell(const Ray& ray, unsigned row, unsigned col, const float corners[4], RayHit& hit)const
+{
+	// A*--*B
+	//  | /|
+	//  |/ |
+	// C*--*D
+	float c0 = (float)col;
+	float c1 = (float)(col+1);
+	float r0 = (float)row;
+	float r1 = (float)(row+1);
+	float A[3] = { c0, corners[0], r0 };
+	float B[3] = { c1, corners[1], r0 };
+	float C[3] = { c0, corners[2], r1 };
+	float D[3] = { c1, corners[3], r1 };
+
+	// Upper triangle ABC and lower triangle DCB.
+	const float* tris[2][3] = { { A, B, C }, { D, C, B } };
+
+	for(int k = 0; k < 2; ++k)
+	{
+		const float* v0 = tris[k][0];
+		const float* v1 = tris[k][1];
+		const float* v2 = tris[k][2];
+
+		float t;
+		if(IntersectRayTriangle(ray.Pos, ray.Dir, v0, v1, v2, t) && t <= hit.T)
+		{
+			float e1[3] = { v1[0]-v0[0], v1[1]-v0[1], v1[2]-v0[2] };
+			float e2[3] = { v2[0]-v0[0], v2[1]-v0[1], v2[2]-v0[2] };
+
+			// Oriented so that the normal of a flat cell points up (+y).
+			DirectX::XMFLOAT3 n(
+				e2[1]*e1[2] - e2[2]*e1[1],
+				e2[2]*e1[0] - e2[0]*e1[2],
+				e2[0]*e1[1] - e2[1]*e1[0]);
+
+			hit.T = t;
+			hit.Normal = n;
+			hit.Found = true;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+//***************************************************************************************
+// HeightmapPyramid.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Min/max height pyramid (a quadtree of height bounds) over a heightmap.  Level 0
+// has one entry per block of blockCells x blockCells cells (Terrain uses its
+// patches, which are also the tiles of its compressed heightmap); each coarser
+// level halves the resolution, so an entry of level k bounds 2^k x 2^k blocks.
+// The last level is a single entry for the whole map.
+//
+// Bounds of single cells are not stored.  The ray cast computes them from the
+// corners of each cell it visits inside a level 0 block, which keeps the pyramid
+// a few kilobytes even for very large maps.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef HEIGHTMAPPYRAMID_H
+#define HEIGHTMAPPYRAMID_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+class CompressedHeightmap;
+class PagedHeightmap;
+
+class HeightmapPyramid
+{
+public:
+	HeightmapPyramid();
+	~HeightmapPyramid();
+
+	// Builds every level for a map of cellRows x cellCols cells, given the (min, max)
+	// heights of its blocks of blockCells x blockCells cells, stored row by row.
+	// The blocks on the far borders may be partial.
+	void Build(const DirectX::XMFLOAT2* blockBounds, unsigned cellRows, unsigned cellCols, unsigned blockCells);
+
+	// Replaces the bounds of the blocks [row0, row1) x [col0, col1) after their 
+	// heights changed, and recomputes only the coarser entries covering them.
+	// blockBounds holds the new bounds of just those blocks, row by row.
+	void Update(const DirectX::XMFLOAT2* blockBounds, unsigned row0, unsigned col0, unsigned row1, unsigned col1);
+
+	unsigned GetNumLevels()const;
+	unsigned GetLevelRows(unsigned level)const;
+	unsigned GetLevelCols(unsigned level)const;
+
+	unsigned GetCellRows()const;
+	unsigned GetCellCols()const;
+	unsigned GetBlockCells()const;
+
+	// (min, max) height of the block at (row, col) of the given level.
+	const DirectX::XMFLOAT2& GetBounds(unsigned level, unsigned row, unsigned col)const;
+
+	// Finds the first intersection of a ray with the heightfield surface, made of 
+	// two triangles per cell split along the (row, col+1)-(row+1, col) diagonal.
+	// The block bounds the pyramid was built from must bound the cells of heights.
+	//
+	// The ray is given in grid space: x runs along the columns, z along the rows, 
+	// and y is the height, with one unit per cell in x and z.  Returns true and the
+	// ray parameter t in [0, tMax] of the hit, along with the unnormalized grid 
+	// space normal of the triangle hit.
+	//
+	// Blocks are visited nearest first and skipped whenever the ray misses their
+	// height bounds, so empty space above the terrain is crossed in a few large 
+	// steps.  Inside a level 0 block the cells are walked along the ray, and only 
+	// the cells whose corner heights the ray passes have their triangles tested.
+	bool IntersectRay(const CompressedHeightmap& heights, const DirectX::XMFLOAT3& rayPos, const DirectX::XMFLOAT3& rayDir, 
+		float tMax, float& t, DirectX::XMFLOAT3& normal)const;
+
+	// Same, but the cells come from a paged heightmap, so the surface is only at
+	// full resolution where its tiles are resident.  Elsewhere it is interpolated
+	// from the overview and may stray slightly past the tile bounds, so those hits
+	// are approximate.
+	bool IntersectRay(const PagedHeightmap& heights, const DirectX::XMFLOAT3& rayPos, const DirectX::XMFLOAT3& rayDir, 
+		float tMax, float& t, DirectX::XMFLOAT3& normal)const;
+
+	// Memory used by the levels.
+	size_t GetResidentBytes()const;
+
+private:
+	struct Level
+	{
+		unsigned Rows;
+		unsigned Cols;
+		std::vector<DirectX::XMFLOAT2> Bounds;
+	};
+
+	// Recomputes the entries [row0, row1) x [col0, col1) of a level from the 
+	// finer one.
+	void BuildLevel(unsigned level, unsigned row0, unsigned col0, unsigned row1, unsigned col1);
+
+	// Per-query ray data shared by every block visit.
+	struct Ray
+	{
+		float Pos[3];
+		float Dir[3];
+		float InvDir[3];
+
+		// Exactly one is set.
+		const CompressedHeightmap* Heights;
+		const PagedHeightmap* PagedHeights;
+	};
+
+	struct RayHit
+	{
+		float T;
+		DirectX::XMFLOAT3 Normal;
+		bool Found;
+	};
+
+	bool IntersectRay(Ray& ray, const DirectX::XMFLOAT3& rayPos, const DirectX::XMFLOAT3& rayDir, 
+		float tMax, float& t, DirectX::XMFLOAT3& normal)const;
+	void IntersectRay(const Ray& ray, unsigned level, unsigned row, unsigned col, float tEnter, RayHit& hit)const;
+	bool IntersectRayBlock(const Ray& ray, unsigned level, unsigned row, unsigned col, float tMax, float& tEnter)const;
+	void IntersectRayCells(const Ray& ray, unsigned row, unsigned col, float tEnter, RayHit& hit)const;
+	void IntersectRayCell(const Ray& ray, unsigned row, unsigned col, const float corners[4], RayHit& hit)const;
+
+	// Cells covered by the block at (row, col) of the given level, clamped to the map.
+	void GetBlockRange(unsigned level, unsigned row, unsigned col, 
+		unsigned& row0, unsigned& col0, unsigned& row1, unsigned& col1)const;
+
+private:
+	unsigned mCellRows;
+	unsigned mCellCols;
+	unsigned mBlockCells;
+
+	std::vector<Level> mLevels;
+};
+
+#endif // HEIGHTMAPPYRAMID_H
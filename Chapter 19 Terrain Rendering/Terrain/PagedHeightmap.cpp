@@ -0,0 +1,707 @@
+//***************************************************************************************
+// PagedHeightmap.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "PagedHeightmap.h"
+#include "TerrainLodSelector.h"
+#include "FilePath.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const unsigned TileFileMagic   = 0x50414854; // "THAP"
+	const unsigned TileFileVersion = 2;
+
+	// Target number of overview samples along each side of a tile.
+	const unsigned OverviewSamplesPerTile = 16;
+
+	// Interpolates the cell (row, col) of a grid like Terrain::GetHeight, where
+	// (s, t) in [0,1]^2 is the position inside the cell.
+	//
+	// A*--*B
+	//  | /|
+	//  |/ |
+	// C*--*D
+	float InterpolateCell(float A, float B, float C, float D, float s, float t)
+	{
+		if( s + t <= 1.0f )
+			return A + s*(B - A) + t*(C - A);
+		else
+			return D + (1.0f - s)*(C - D) + (1.0f - t)*(B - D);
+	}
+
+	float Clamp(float x, float low, float high)
+	{
+		return x < low ? low : (x > high ? high : x);
+	}
+}
+
+PagedHeightmap::PagedHeightmap()
+: mCellSpacing(1.0f), mMemoryBudget(0), mResidentBytes(0), mPendingCount(0), mFrame(0), mQuit(false)
+{
+	memset(&mHeader, 0, sizeof(mHeader));
+}
+
+PagedHeightmap::~PagedHeightmap()
+{
+	Close();
+}
+
+bool PagedHeightmap::WriteTiles(const std::wstring& filename, const float* heights, const unsigned* blend,
+								unsigned width, unsigned height, unsigned tileCells)
+{
+	if( width < 2 || height < 2 || tileCells == 0 || (tileCells & (tileCells-1)) != 0 )
+		return false;
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic     = TileFileMagic;
+	header.Version   = TileFileVersion;
+	header.Width     = width;
+	header.Height    = height;
+	header.TileCells = tileCells;
+	header.TileRows  = (height - 2)/tileCells + 1;
+	header.TileCols  = (width  - 2)/tileCells + 1;
+	header.NumLods   = TerrainLodSelector::GetNumLods(tileCells);
+
+	header.OverviewStep   = std::max(1u, tileCells/OverviewSamplesPerTile);
+	header.OverviewWidth  = (width  - 2)/header.OverviewStep + 2;
+	header.OverviewHeight = (height - 2)/header.OverviewStep + 2;
+
+	size_t numTiles = (size_t)header.TileRows*header.TileCols;
+	size_t overviewSize = (size_t)header.OverviewWidth*header.OverviewHeight;
+
+	header.TileDataOffset = sizeof(FileHeader) + numTiles*sizeof(DirectX::XMFLOAT2) + 
+		numTiles*header.NumLods*sizeof(float) + overviewSize*(sizeof(float) + sizeof(unsigned));
+
+	// The overview samples every OverviewStep-th texel; the last row and column
+	// sample the map border so the overview covers the whole map.
+	std::vector<float> overview(overviewSize);
+	std::vector<unsigned> overviewBlend(overviewSize, 0);
+	for(unsigned i = 0; i < header.OverviewHeight; ++i)
+	{
+		unsigned row = std::min(i*header.OverviewStep, height-1);
+		for(unsigned j = 0; j < header.OverviewWidth; ++j)
+		{
+			unsigned col = std::min(j*header.OverviewStep, width-1);
+			overview[i*header.OverviewWidth + j] = heights[row*width + col];
+			if( blend )
+				overviewBlend[i*header.OverviewWidth + j] = blend[row*width + col];
+		}
+	}
+
+	std::ofstream fout(NativePath(filename), std::ios_base::binary);
+	if( !fout )
+		return false;
+
+	// Tiles store (tileCells+3)^2 texels starting one texel before their first
+	// cell.  The apron and the tiles on the far borders are clamped to the map.
+	unsigned tileSide = tileCells + 3;
+	size_t tileTexels = (size_t)tileSide*tileSide;
+
+	std::vector<DirectX::XMFLOAT2> boundsY(numTiles);
+	std::vector<float> errors(numTiles*header.NumLods);
+	std::vector<float> tileHeights(tileTexels);
+	std::vector<unsigned> tileBlend(tileTexels, 0);
+
+	// The tiles are written first, at their offsets, so only one is assembled at a time.
+	fout.seekp((std::streamoff)header.TileDataOffset);
+	for(unsigned ti = 0; ti < header.TileRows; ++ti)
+	{
+		for(unsigned tj = 0; tj < header.TileCols; ++tj)
+		{
+			size_t tileId = ti*header.TileCols + tj;
+
+			for(unsigned i = 0; i < tileSide; ++i)
+			{
+				unsigned row = (unsigned)std::min(std::max((int)(ti*tileCells + i) - 1, 0), (int)height-1);
+				for(unsigned j = 0; j < tileSide; ++j)
+				{
+					unsigned col = (unsigned)std::min(std::max((int)(tj*tileCells + j) - 1, 0), (int)width-1);
+
+					tileHeights[i*tileSide + j] = heights[row*width + col];
+					if( blend )
+						tileBlend[i*tileSide + j] = blend[row*width + col];
+				}
+			}
+
+			// Bounds of the texels touched by the tile's cells, without the apron.
+			float minY = +FLT_MAX;
+			float maxY = -FLT_MAX;
+			for(unsigned i = 1; i <= tileCells+1; ++i)
+			{
+				for(unsigned j = 1; j <= tileCells+1; ++j)
+				{
+					minY = std::min(minY, tileHeights[i*tileSide + j]);
+					maxY = std::max(maxY, tileHeights[i*tileSide + j]);
+				}
+			}
+			boundsY[tileId] = DirectX::XMFLOAT2(minY, maxY);
+
+			TerrainLodSelector::ComputePatchErrors(&tileHeights[tileSide+1], tileSide, tileCells, 
+				&errors[tileId*header.NumLods]);
+
+			fout.write((const char*)&tileHeights[0], (std::streamsize)(tileTexels*sizeof(float)));
+			fout.write((const char*)&tileBlend[0], (std::streamsize)(tileTexels*sizeof(unsigned)));
+		}
+	}
+
+	fout.seekp(0);
+	fout.write((const char*)&header, sizeof(header));
+	fout.write((const char*)&boundsY[0], (std::streamsize)(boundsY.size()*sizeof(DirectX::XMFLOAT2)));
+	fout.write((const char*)&errors[0], (std::streamsize)(errors.size()*sizeof(float)));
+	fout.write((const char*)&overview[0], (std::streamsize)(overview.size()*sizeof(float)));
+	fout.write((const char*)&overviewBlend[0], (std::streamsize)(overviewBlend.size()*sizeof(unsigned)));
+
+	return fout.good();
+}
+
+bool PagedHeightmap::Open(const std::wstring& filename, float cellSpacing, size_t memoryBudget)
+{
+	Close();
+
+	std::ifstream fin(NativePath(filename), std::ios_base::binary);
+	if( !fin )
+		return false;
+
+	FileHeader header;
+	fin.read((char*)&header, sizeof(header));
+	if( !fin || header.Magic != TileFileMagic || header.Version != TileFileVersion ||
+		header.Width < 2 || header.Height < 2 || header.OverviewStep == 0 ||
+		header.TileCells == 0 || (header.TileCells & (header.TileCells-1)) != 0 )
+	{
+		return false;
+	}
+
+	// The table sizes must be the ones WriteTiles derives from the map size, or
+	// the reads below and the tile lookups would run past them.
+	if( header.TileRows != (header.Height-2)/header.TileCells + 1 ||
+		header.TileCols != (header.Width -2)/header.TileCells + 1 ||
+		header.NumLods  != TerrainLodSelector::GetNumLods(header.TileCells) ||
+		header.OverviewWidth  != (header.Width -2)/header.OverviewStep + 2 ||
+		header.OverviewHeight != (header.Height-2)/header.OverviewStep + 2 )
+	{
+		return false;
+	}
+
+	size_t numTiles = (size_t)header.TileRows*header.TileCols;
+	size_t overviewSize = (size_t)header.OverviewWidth*header.OverviewHeight;
+
+	if( header.TileDataOffset != sizeof(FileHeader) + numTiles*sizeof(DirectX::XMFLOAT2) + 
+		numTiles*header.NumLods*sizeof(float) + overviewSize*(sizeof(float) + sizeof(unsigned)) )
+	{
+		return false;
+	}
+
+	std::vector<DirectX::XMFLOAT2> boundsY(numTiles);
+	std::vector<float> errors(numTiles*header.NumLods);
+	std::vector<float> overview(overviewSize);
+	std::vector<unsigned> overviewBlend(overviewSize);
+
+	fin.read((char*)&boundsY[0], (std::streamsize)(boundsY.size()*sizeof(DirectX::XMFLOAT2)));
+	fin.read((char*)&errors[0], (std::streamsize)(errors.size()*sizeof(float)));
+	fin.read((char*)&overview[0], (std::streamsize)(overview.size()*sizeof(float)));
+	fin.read((char*)&overviewBlend[0], (std::streamsize)(overviewBlend.size()*sizeof(unsigned)));
+	if( !fin )
+		return false;
+
+	mFilename     = filename;
+	mHeader       = header;
+	mCellSpacing  = cellSpacing;
+	mMemoryBudget = memoryBudget;
+	mTileBoundsY.swap(boundsY);
+	mTileErrors.swap(errors);
+	mOverview.swap(overview);
+	mOverviewBlend.swap(overviewBlend);
+
+	mTiles.resize(numTiles);
+	for(size_t i = 0; i < numTiles; ++i)
+	{
+		mTiles[i].State = TileNotResident;
+		mTiles[i].Slot  = -1;
+		mTiles[i].LastWantedFrame = 0;
+	}
+
+	// Requests are only made while resident and pending tiles fit the budget, so
+	// there is always a free slot for a loaded tile.  Slot 0 is handed out first.
+	for(unsigned slot = GetMaxResidentTiles(); slot-- > 0; )
+		mFreeSlots.push_back((int)slot);
+
+	mFrame = 0;
+	mQuit  = false;
+	mLoader = std::thread(&PagedHeightmap::LoaderMain, this);
+
+	return true;
+}
+
+void PagedHeightmap::Close()
+{
+	if( mLoader.joinable() )
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mRequestCV.notify_all();
+		mLoader.join();
+	}
+
+	mRequests.clear();
+	mLoaded.clear();
+	mTiles.clear();
+	mLru.clear();
+	mFreeSlots.clear();
+	mInstalled.clear();
+	mTileBoundsY.clear();
+	mTileErrors.clear();
+	mOverview.clear();
+	mOverviewBlend.clear();
+	mResidentBytes = 0;
+	mPendingCount  = 0;
+	memset(&mHeader, 0, sizeof(mHeader));
+}
+
+bool PagedHeightmap::IsOpen()const
+{
+	return !mTiles.empty();
+}
+
+void PagedHeightmap::UpdateResidency(float x, float z, float radius)
+{
+	if( mTiles.empty() )
+		return;
+
+	InstallLoadedTiles();
+
+	++mFrame;
+
+	//
+	// Find the tiles that overlap the circle, nearest first.
+	//
+
+	float tileSize = mHeader.TileCells*mCellSpacing;
+	float c = (x + 0.5f*GetWidth()) / tileSize;
+	float d = (0.5f*GetDepth() - z) / tileSize;
+	float r = radius / tileSize;
+
+	int col0 = std::max(0, (int)floorf(c - r));
+	int col1 = std::min((int)mHeader.TileCols-1, (int)floorf(c + r));
+	int row0 = std::max(0, (int)floorf(d - r));
+	int row1 = std::min((int)mHeader.TileRows-1, (int)floorf(d + r));
+
+	std::vector<std::pair<float, unsigned> > wanted;
+	for(int i = row0; i <= row1; ++i)
+	{
+		for(int j = col0; j <= col1; ++j)
+		{
+			// Distance from the point to the tile's square, in tiles.
+			float dx = std::max(0.0f, std::max(j - c, c - (j+1)));
+			float dz = std::max(0.0f, std::max(i - d, d - (i+1)));
+			float distSq = dx*dx + dz*dz;
+
+			if( distSq <= r*r )
+				wanted.push_back(std::make_pair(distSq, (unsigned)(i*mHeader.TileCols + j)));
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+
+	for(size_t k = 0; k < wanted.size(); ++k)
+		mTiles[wanted[k].second].LastWantedFrame = mFrame;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	// Drop queued requests for tiles that are no longer wanted.
+	size_t numKept = 0;
+	for(size_t k = 0; k < mRequests.size(); ++k)
+	{
+		unsigned id = mRequests[k];
+		if( mTiles[id].LastWantedFrame == mFrame )
+		{
+			mRequests[numKept++] = id;
+		}
+		else
+		{
+			mTiles[id].State = TileNotResident;
+			--mPendingCount;
+		}
+	}
+	mRequests.resize(numKept);
+
+	// Keep the wanted resident tiles at the front of the LRU list, and request 
+	// the missing ones while there is room for them.
+	size_t tileBytes = GetTileBytes();
+	for(size_t k = 0; k < wanted.size(); ++k)
+	{
+		Tile& tile = mTiles[wanted[k].second];
+		if( tile.State == TileResident )
+			mLru.splice(mLru.begin(), mLru, tile.LruPosition);
+	}
+
+	bool requested = false;
+	for(size_t k = 0; k < wanted.size(); ++k)
+	{
+		unsigned id = wanted[k].second;
+		if( mTiles[id].State != TileNotResident )
+			continue;
+
+		while( mResidentBytes + (mPendingCount + 1)*tileBytes > mMemoryBudget )
+		{
+			if( !EvictOneUnwanted() )
+				break;
+		}
+
+		// Everything resident is wanted and nearer than this tile.
+		if( mResidentBytes + (mPendingCount + 1)*tileBytes > mMemoryBudget )
+			break;
+
+		mTiles[id].State = TilePending;
+		mRequests.push_back(id);
+		++mPendingCount;
+		requested = true;
+	}
+
+	lock.unlock();
+
+	if( requested )
+		mRequestCV.notify_one();
+}
+
+void PagedHeightmap::TakeInstalledTiles(std::vector<unsigned>& tileIds)
+{
+	tileIds.swap(mInstalled);
+	mInstalled.clear();
+}
+
+unsigned PagedHeightmap::GetHeightmapWidth()const
+{
+	return mHeader.Width;
+}
+
+unsigned PagedHeightmap::GetHeightmapHeight()const
+{
+	return mHeader.Height;
+}
+
+float PagedHeightmap::GetWidth()const
+{
+	return (mHeader.Width-1)*mCellSpacing;
+}
+
+float PagedHeightmap::GetDepth()const
+{
+	return (mHeader.Height-1)*mCellSpacing;
+}
+
+float PagedHeightmap::GetHeight(float x, float z)const
+{
+	if( mTiles.empty() )
+		return 0.0f;
+
+	// Transform from terrain local space to "cell" space, clamped to the map.
+	float c = (x + 0.5f*GetWidth()) /  mCellSpacing;
+	float d = (z - 0.5f*GetDepth()) / -mCellSpacing;
+
+	c = Clamp(c, 0.0f, (float)(mHeader.Width-1));
+	d = Clamp(d, 0.0f, (float)(mHeader.Height-1));
+
+	const Tile* tile;
+	unsigned tileRow, tileCol;
+	GetTileCell(std::min((unsigned)d, mHeader.Height-2), std::min((unsigned)c, mHeader.Width-2), tile, tileRow, tileCol);
+
+	if( tile->State == TileResident )
+		return SampleTile(*tile, tileRow, tileCol, c, d);
+
+	return SampleOverview(c, d);
+}
+
+void PagedHeightmap::GetCell(unsigned row, unsigned col, float corners[4])const
+{
+	row = std::min(row, mHeader.Height-2);
+	col = std::min(col, mHeader.Width-2);
+
+	const Tile* tile;
+	unsigned tileRow, tileCol;
+	GetTileCell(row, col, tile, tileRow, tileCol);
+
+	if( tile->State == TileResident )
+	{
+		unsigned tileSide = GetTileSide();
+		const float* texel = &tile->Heights[(row - tileRow*mHeader.TileCells + 1)*tileSide + 
+			(col - tileCol*mHeader.TileCells + 1)];
+
+		corners[0] = texel[0];
+		corners[1] = texel[1];
+		corners[2] = texel[tileSide];
+		corners[3] = texel[tileSide+1];
+		return;
+	}
+
+	float c = (float)col;
+	float d = (float)row;
+	corners[0] = SampleOverview(c, d);
+	corners[1] = SampleOverview(c + 1.0f, d);
+	corners[2] = SampleOverview(c, d + 1.0f);
+	corners[3] = SampleOverview(c + 1.0f, d + 1.0f);
+}
+
+unsigned PagedHeightmap::GetTileCells()const
+{
+	return mHeader.TileCells;
+}
+
+unsigned PagedHeightmap::GetTileRows()const
+{
+	return mHeader.TileRows;
+}
+
+unsigned PagedHeightmap::GetTileCols()const
+{
+	return mHeader.TileCols;
+}
+
+bool PagedHeightmap::IsTileResident(unsigned row, unsigned col)const
+{
+	return mTiles[row*mHeader.TileCols + col].State == TileResident;
+}
+
+const DirectX::XMFLOAT2& PagedHeightmap::GetTileBoundsY(unsigned row, unsigned col)const
+{
+	return mTileBoundsY[row*mHeader.TileCols + col];
+}
+
+unsigned PagedHeightmap::GetNumLods()const
+{
+	return mHeader.NumLods;
+}
+
+const float* PagedHeightmap::GetTileErrors(unsigned row, unsigned col)const
+{
+	return &mTileErrors[(row*mHeader.TileCols + col)*mHeader.NumLods];
+}
+
+unsigned PagedHeightmap::GetMaxResidentTiles()const
+{
+	if( mTiles.empty() )
+		return 0;
+
+	return (unsigned)std::min(mTiles.size(), mMemoryBudget / GetTileBytes());
+}
+
+int PagedHeightmap::GetTileSlot(unsigned row, unsigned col)const
+{
+	return mTiles[row*mHeader.TileCols + col].Slot;
+}
+
+unsigned PagedHeightmap::GetTileSide()const
+{
+	return mHeader.TileCells + 3;
+}
+
+const float* PagedHeightmap::GetTileHeights(unsigned row, unsigned col)const
+{
+	return &mTiles[row*mHeader.TileCols + col].Heights[0];
+}
+
+const unsigned* PagedHeightmap::GetTileBlend(unsigned row, unsigned col)const
+{
+	return &mTiles[row*mHeader.TileCols + col].Blend[0];
+}
+
+unsigned PagedHeightmap::GetOverviewStep()const
+{
+	return mHeader.OverviewStep;
+}
+
+unsigned PagedHeightmap::GetOverviewWidth()const
+{
+	return mHeader.OverviewWidth;
+}
+
+unsigned PagedHeightmap::GetOverviewHeight()const
+{
+	return mHeader.OverviewHeight;
+}
+
+const float* PagedHeightmap::GetOverviewHeights()const
+{
+	return &mOverview[0];
+}
+
+const unsigned* PagedHeightmap::GetOverviewBlend()const
+{
+	return &mOverviewBlend[0];
+}
+
+size_t PagedHeightmap::GetResidentBytes()const
+{
+	// The tiles plus the tables that are always resident.
+	return mResidentBytes + mTileBoundsY.size()*sizeof(DirectX::XMFLOAT2) + mTileErrors.size()*sizeof(float) +
+		mOverview.size()*sizeof(float) + mOverviewBlend.size()*sizeof(unsigned) + mTiles.size()*sizeof(Tile);
+}
+
+void PagedHeightmap::LoaderMain()
+{
+	// The loader has its own stream so reads never contend with the main thread.
+	std::ifstream fin(NativePath(mFilename), std::ios_base::binary);
+
+	size_t tileSide  = GetTileSide();
+	size_t tileCount = tileSide*tileSide;
+
+	for(;;)
+	{
+		unsigned id;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mRequestCV.wait(lock, [this]{ return mQuit || !mRequests.empty(); });
+			if( mQuit )
+				return;
+
+			id = mRequests.front();
+			mRequests.pop_front();
+		}
+
+		std::vector<float> heights(tileCount);
+		std::vector<unsigned> blend(tileCount);
+
+		fin.clear();
+		fin.seekg((std::streamoff)(mHeader.TileDataOffset + (unsigned long long)id*GetTileBytes()));
+		fin.read((char*)&heights[0], (std::streamsize)(tileCount*sizeof(float)));
+		fin.read((char*)&blend[0], (std::streamsize)(tileCount*sizeof(unsigned)));
+
+		// A failed read leaves the tile on the overview.
+		if( !fin )
+		{
+			heights.clear();
+			blend.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mLoaded.push_back(LoadedTile());
+		mLoaded.back().Id = id;
+		mLoaded.back().Heights.swap(heights);
+		mLoaded.back().Blend.swap(blend);
+	}
+}
+
+void PagedHeightmap::InstallLoadedTiles()
+{
+	std::vector<LoadedTile> loaded;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		loaded.swap(mLoaded);
+	}
+
+	for(size_t k = 0; k < loaded.size(); ++k)
+	{
+		Tile& tile = mTiles[loaded[k].Id];
+		--mPendingCount;
+
+		if( loaded[k].Heights.empty() || mFreeSlots.empty() )
+		{
+			tile.State = TileNotResident;
+			continue;
+		}
+
+		tile.State = TileResident;
+		tile.Heights.swap(loaded[k].Heights);
+		tile.Blend.swap(loaded[k].Blend);
+
+		tile.Slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+		mInstalled.push_back(loaded[k].Id);
+
+		mLru.push_front(loaded[k].Id);
+		tile.LruPosition = mLru.begin();
+		mResidentBytes += GetTileBytes();
+	}
+
+	// Requests are only made while there is room, but the budget may have been
+	// filled by tiles that were wanted when they were requested.
+	while( mResidentBytes > mMemoryBudget && EvictOneUnwanted() )
+	{
+	}
+}
+
+bool PagedHeightmap::EvictOneUnwanted()
+{
+	if( mLru.empty() )
+		return false;
+
+	unsigned id = mLru.back();
+	Tile& tile = mTiles[id];
+
+	// Wanted tiles are kept at the front, so if the least recently used tile is
+	// wanted, all of them are.
+	if( tile.LastWantedFrame == mFrame )
+		return false;
+
+	mLru.pop_back();
+
+	tile.State = TileNotResident;
+	std::vector<float>().swap(tile.Heights);
+	std::vector<unsigned>().swap(tile.Blend);
+	mResidentBytes -= GetTileBytes();
+
+	mFreeSlots.push_back(tile.Slot);
+	tile.Slot = -1;
+
+	return true;
+}
+
+void PagedHeightmap::GetTileCell(unsigned row, unsigned col, const Tile*& tile, unsigned& tileRow, unsigned& tileCol)const
+{
+	// Cells past the last whole tile belong to the last tile.
+	tileRow = std::min(row / mHeader.TileCells, mHeader.TileRows-1);
+	tileCol = std::min(col / mHeader.TileCells, mHeader.TileCols-1);
+	tile = &mTiles[tileRow*mHeader.TileCols + tileCol];
+}
+
+float PagedHeightmap::SampleTile(const Tile& tile, unsigned tileRow, unsigned tileCol, float c, float d)const
+{
+	unsigned tileSide = GetTileSide();
+
+	// Position relative to the tile.  The tile has TileCells cells each way, so 
+	// the far edge of the map maps into its last cell.
+	float tc = c - (float)(tileCol*mHeader.TileCells);
+	float td = d - (float)(tileRow*mHeader.TileCells);
+
+	unsigned col = std::min((unsigned)tc, mHeader.TileCells-1);
+	unsigned row = std::min((unsigned)td, mHeader.TileCells-1);
+
+	// Skip the apron.
+	const float* texel = &tile.Heights[(row+1)*tileSide + col+1];
+
+	return InterpolateCell(texel[0], texel[1], texel[tileSide], texel[tileSide+1], 
+		tc - (float)col, td - (float)row);
+}
+
+float PagedHeightmap::SampleOverview(float c, float d)const
+{
+	unsigned step = mHeader.OverviewStep;
+	unsigned ow   = mHeader.OverviewWidth;
+
+	unsigned col = std::min((unsigned)c / step, mHeader.OverviewWidth-2);
+	unsigned row = std::min((unsigned)d / step, mHeader.OverviewHeight-2);
+
+	// The last overview row and column sample the map border, so their cells can
+	// be narrower than step.
+	float c0 = (float)(col*step);
+	float d0 = (float)(row*step);
+	float c1 = (float)std::min((col+1)*step, mHeader.Width-1);
+	float d1 = (float)std::min((row+1)*step, mHeader.Height-1);
+
+	const float* texel = &mOverview[row*ow + col];
+
+	return InterpolateCell(texel[0], texel[1], texel[ow], texel[ow+1], 
+		(c - c0)/(c1 - c0), (d - d0)/(d1 - d0));
+}
+
+size_t PagedHeightmap::GetTileBytes()const
+{
+	size_t tileSide = GetTileSide();
+	return tileSide*tileSide*(sizeof(float) + sizeof(unsigned));
+}
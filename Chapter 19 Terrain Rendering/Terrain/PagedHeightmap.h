@@ -0,0 +1,202 @@
+//***************************************************************************************
+// PagedHeightmap.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Heightmap and blend map split into square tiles on disk, of which only the 
+// tiles near the camera are kept in memory.  Tiles are read on a background thread
+// and evicted least recently used first when the memory budget is exceeded.  The 
+// per-tile height bounds and LOD errors and a coarse overview of the whole map are
+// always resident, so GetHeight still answers (at lower resolution) where a tile
+// is not loaded.
+//
+// Each resident tile occupies one of GetMaxResidentTiles slots, so a renderer can
+// mirror the resident tiles in a texture array indexed by slot.  Tiles carry a one
+// texel apron around their cells so they can be sampled for normals on their own.
+//
+// The layout matches Terrain: the map is centered on the origin with rows running
+// from +z to -z.  Only depends on DirectXMath and the standard library.
+//***************************************************************************************
+
+#ifndef PAGEDHEIGHTMAP_H
+#define PAGEDHEIGHTMAP_H
+
+#include <DirectXMath.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PagedHeightmap
+{
+public:
+	PagedHeightmap();
+	~PagedHeightmap();
+
+	// Writes a width x height heightmap and blend map, stored row by row, as a tile
+	// file with tileCells x tileCells cells per tile.  The blend weights are RGBA8
+	// texels (red in the low byte); with no blend map all weights are zero.  
+	// tileCells must be a power of two.
+	static bool WriteTiles(const std::wstring& filename, const float* heights, const unsigned* blend,
+		unsigned width, unsigned height, unsigned tileCells);
+
+	// Opens a tile file and loads its bounds, errors and overview.  No tiles are 
+	// resident until UpdateResidency requests them.  Returns false if the file is
+	// missing or its header is inconsistent.
+	bool Open(const std::wstring& filename, float cellSpacing, size_t memoryBudget);
+	void Close();
+
+	bool IsOpen()const;
+
+	// Call once per frame.  Installs tiles that finished loading, then requests 
+	// the tiles within radius of (x, z), nearest first, as far as the memory budget
+	// allows.  Queued requests that are no longer wanted are dropped.
+	void UpdateResidency(float x, float z, float radius);
+
+	// Replaces tileIds with the tiles that became resident since the last call. 
+	// Some may have been evicted again since.
+	void TakeInstalledTiles(std::vector<unsigned>& tileIds);
+
+	// Heightmap size in texels.
+	unsigned GetHeightmapWidth()const;
+	unsigned GetHeightmapHeight()const;
+
+	float GetWidth()const;
+	float GetDepth()const;
+
+	// Height at (x, z) from the resident tile if there is one, otherwise from the
+	// overview.  Points outside the map are clamped to its border.
+	float GetHeight(float x, float z)const;
+
+	// Heights of the corners of cell (row, col) in the order of 
+	// CompressedHeightmap::GetCell, from the resident tile or the overview.
+	void GetCell(unsigned row, unsigned col, float corners[4])const;
+
+	unsigned GetTileCells()const;
+	unsigned GetTileRows()const;
+	unsigned GetTileCols()const;
+	bool IsTileResident(unsigned row, unsigned col)const;
+
+	// (min, max) height of a tile; always available.
+	const DirectX::XMFLOAT2& GetTileBoundsY(unsigned row, unsigned col)const;
+
+	// Errors of the tile as a patch at each LOD, as computed by 
+	// TerrainLodSelector::ComputePatchErrors; always available.
+	unsigned GetNumLods()const;
+	const float* GetTileErrors(unsigned row, unsigned col)const;
+
+	// Slot of a resident tile in [0, GetMaxResidentTiles()), or -1.
+	unsigned GetMaxResidentTiles()const;
+	int GetTileSlot(unsigned row, unsigned col)const;
+
+	// Texels of a resident tile: GetTileSide()^2 heights and blend weights, row by
+	// row, starting one texel up and left of the tile's first cell.
+	unsigned GetTileSide()const;
+	const float* GetTileHeights(unsigned row, unsigned col)const;
+	const unsigned* GetTileBlend(unsigned row, unsigned col)const;
+
+	// The overview samples every GetOverviewStep()-th texel; its last row and 
+	// column sample the far border.
+	unsigned GetOverviewStep()const;
+	unsigned GetOverviewWidth()const;
+	unsigned GetOverviewHeight()const;
+	const float* GetOverviewHeights()const;
+	const unsigned* GetOverviewBlend()const;
+
+	size_t GetResidentBytes()const;
+
+private:
+	PagedHeightmap(const PagedHeightmap& rhs);
+	PagedHeightmap& operator=(const PagedHeightmap& rhs);
+
+private:
+	struct FileHeader
+	{
+		unsigned Magic;
+		unsigned Version;
+		unsigned Width;
+		unsigned Height;
+		unsigned TileCells;
+		unsigned TileRows;
+		unsigned TileCols;
+		unsigned NumLods;
+		unsigned OverviewStep;
+		unsigned OverviewWidth;
+		unsigned OverviewHeight;
+		unsigned long long TileDataOffset;
+	};
+
+	enum TileState
+	{
+		TileNotResident,
+		TilePending,     // requested; queued or being read by the loader
+		TileResident
+	};
+
+	struct Tile
+	{
+		TileState State;
+
+		// (TileCells+3)^2 texels: the tile's cells plus a one texel apron, so a
+		// tile answers queries on its own.
+		std::vector<float> Heights;
+		std::vector<unsigned> Blend;
+
+		int Slot;
+
+		std::list<unsigned>::iterator LruPosition;
+
+		// Last UpdateResidency call that wanted this tile.
+		unsigned LastWantedFrame;
+	};
+
+	struct LoadedTile
+	{
+		unsigned Id;
+		std::vector<float> Heights;
+		std::vector<unsigned> Blend;
+	};
+
+	void LoaderMain();
+	void InstallLoadedTiles();
+	bool EvictOneUnwanted();
+
+	void GetTileCell(unsigned row, unsigned col, const Tile*& tile, unsigned& tileRow, unsigned& tileCol)const;
+	float SampleTile(const Tile& tile, unsigned tileRow, unsigned tileCol, float c, float d)const;
+	float SampleOverview(float c, float d)const;
+
+	size_t GetTileBytes()const;
+
+private:
+	std::wstring mFilename;
+	FileHeader mHeader;
+	float mCellSpacing;
+	size_t mMemoryBudget;
+
+	std::vector<DirectX::XMFLOAT2> mTileBoundsY;
+	std::vector<float> mTileErrors;
+	std::vector<float> mOverview;
+	std::vector<unsigned> mOverviewBlend;
+
+	std::vector<Tile> mTiles;
+
+	// Most recently used tiles at the front.
+	std::list<unsigned> mLru;
+	std::vector<int> mFreeSlots;
+	std::vector<unsigned> mInstalled;
+	size_t mResidentBytes;
+	unsigned mPendingCount;
+	unsigned mFrame;
+
+	// Loader thread state.  mRequests and mLoaded are shared with the thread and
+	// guarded by mMutex; everything else is only touched by the owning thread.
+	std::thread mLoader;
+	std::mutex mMutex;
+	std::condition_variable mRequestCV;
+	std::deque<unsigned> mRequests;
+	std::vector<LoadedTile> mLoaded;
+	bool mQuit;
+};
+
+#endif // PAGEDHEIGHTMAP_H
@@ -7,15 +7,100 @@
 #include "LightHelper.h"
 #include "Effects.h"
 #include "Vertex.h"
+#include "ParallelFor.h"
+#include "MappedFile.h"
+#include <DDSTextureLoader.h>
 #include <fstream>
 #include <sstream>
 
+namespace
+{
+	//
+	// Row kernels for the separable smoothing filter.  Each processes four floats at 
+	// a time with unaligned SIMD loads and finishes the remainder with scalar code.
+	//
+
+	// dst[k] = (a[k] + b[k]) / 2
+	void AverageRows2(const float* a, const float* b, float* dst, UINT n)
+	{
+		XMVECTOR half = XMVectorReplicate(0.5f);
+
+		UINT k = 0;
+		for(; k + 4 <= n; k += 4)
+		{
+			XMVECTOR va = XMLoadFloat4((const XMFLOAT4*)&a[k]);
+			XMVECTOR vb = XMLoadFloat4((const XMFLOAT4*)&b[k]);
+			XMStoreFloat4((XMFLOAT4*)&dst[k], XMVectorMultiply(XMVectorAdd(va, vb), half));
+		}
+
+		for(; k < n; ++k)
+			dst[k] = (a[k] + b[k])*0.5f;
+	}
+
+	// dst[k] = (a[k] + b[k] + c[k]) / 3
+	void AverageRows3(const float* a, const float* b, const float* c, float* dst, UINT n)
+	{
+		const float third = 1.0f/3.0f;
+		XMVECTOR vThird = XMVectorReplicate(third);
+
+		UINT k = 0;
+		for(; k + 4 <= n; k += 4)
+		{
+			XMVECTOR va = XMLoadFloat4((const XMFLOAT4*)&a[k]);
+			XMVECTOR vb = XMLoadFloat4((const XMFLOAT4*)&b[k]);
+			XMVECTOR vc = XMLoadFloat4((const XMFLOAT4*)&c[k]);
+			XMStoreFloat4((XMFLOAT4*)&dst[k], XMVectorMultiply(XMVectorAdd(XMVectorAdd(va, vb), vc), vThird));
+		}
+
+		for(; k < n; ++k)
+			dst[k] = (a[k] + b[k] + c[k])*third;
+	}
+
+	// Averages each element of a row with its left and right neighbors.  The two
+	// end elements only have one neighbor, so they are handled outside the loop
+	// instead of bounds checking every element.
+	void AverageRowNeighbors(const float* src, float* dst, UINT n)
+	{
+		if( n == 1 )
+		{
+			dst[0] = src[0];
+			return;
+		}
+
+		dst[0]   = (src[0] + src[1])*0.5f;
+		dst[n-1] = (src[n-2] + src[n-1])*0.5f;
+
+		// The interior is the three-way average of the row shifted left, unshifted,
+		// and shifted right.
+		AverageRows3(src, src + 1, src + 2, dst + 1, n - 2);
+	}
+
+	// Largest projected height error, in pixels, that Draw accepts when picking
+	// patch LODs.
+	const float LodPixelTolerance = 2.0f;
+
+	// Matches PatchLod in Terrain.fx.
+	struct PatchLodGpu
+	{
+		XMFLOAT4 EdgeTess;
+		float InsideTess;
+	};
+}
+
 Terrain::Terrain() : 
 	mQuadPatchVB(0), 
 	mQuadPatchIB(0), 
+	mPatchLodBuffer(0),
+	mPatchLodSRV(0),
 	mLayerMapArraySRV(0), 
 	mBlendMapSRV(0), 
 	mHeightMapSRV(0),
+	mTileHeightArray(0),
+	mTileBlendArray(0),
+	mTileHeightArraySRV(0),
+	mTileBlendArraySRV(0),
+	mTileSlotBuffer(0),
+	mTileSlotSRV(0),
 	mNumPatchVertices(0),
 	mNumPatchQuadFaces(0),
 	mNumPatchVertRows(0),
@@ -33,9 +118,17 @@ Terrain::~Terrain()
 {
 	ReleaseCOM(mQuadPatchVB);
 	ReleaseCOM(mQuadPatchIB);
+	ReleaseCOM(mPatchLodBuffer);
+	ReleaseCOM(mPatchLodSRV);
 	ReleaseCOM(mLayerMapArraySRV);
 	ReleaseCOM(mBlendMapSRV);
 	ReleaseCOM(mHeightMapSRV);
+	ReleaseCOM(mTileHeightArray);
+	ReleaseCOM(mTileBlendArray);
+	ReleaseCOM(mTileHeightArraySRV);
+	ReleaseCOM(mTileBlendArraySRV);
+	ReleaseCOM(mTileSlotBuffer);
+	ReleaseCOM(mTileSlotSRV);
 }
 
 float Terrain::GetWidth()const
@@ -52,6 +145,10 @@ float Terrain::GetDepth()const
 
 float Terrain::GetHeight(float x, float z)const
 {
+	// Tiles that are not resident answer from the overview.
+	if( mPagedHeightmap.IsOpen() )
+		return mPagedHeightmap.GetHeight(x, z);
+
 	// Transform from terrain local space to "cell" space.
 	float c = (x + 0.5f*GetWidth()) /  mInfo.CellSpacing;
 	float d = (z - 0.5f*GetDepth()) / -mInfo.CellSpacing;
@@ -65,10 +162,13 @@ float Terrain::GetHeight(float x, float z)const
 	//  | /|
 	//  |/ |
 	// C*--*D
-	float A = mHeightmap[row*mInfo.HeightmapWidth + col];
-	float B = mHeightmap[row*mInfo.HeightmapWidth + col + 1];
-	float C = mHeightmap[(row+1)*mInfo.HeightmapWidth + col];
-	float D = mHeightmap[(row+1)*mInfo.HeightmapWidth + col + 1];
+	float corners[4];
+	mHeightmap.GetCell(row, col, corners);
+
+	float A = corners[0];
+	float B = corners[1];
+	float C = corners[2];
+	float D = corners[3];
 
 	// Where we are relative to the cell.
 	float s = c - (float)col;
@@ -89,6 +189,147 @@ float Terrain::GetHeight(float x, float z)const
 	}
 }
 
+bool Terrain::RayTerrainIntersect(FXMVECTOR rayPos, FXMVECTOR rayDir, TerrainHit& hit, float maxDist)const
+{
+	// Transform the ray to the grid space of the height pyramid: one unit per cell
+	// in x and z, with z increasing along the rows.  The parameter t is unchanged.
+	float halfWidth = 0.5f*GetWidth();
+	float halfDepth = 0.5f*GetDepth();
+	float invSpacing = 1.0f / mInfo.CellSpacing;
+
+	XMFLOAT3 pos;
+	XMFLOAT3 dir;
+	XMStoreFloat3(&pos, rayPos);
+	XMStoreFloat3(&dir, rayDir);
+
+	XMFLOAT3 gridPos((pos.x + halfWidth)*invSpacing, pos.y, (halfDepth - pos.z)*invSpacing);
+	XMFLOAT3 gridDir(dir.x*invSpacing, dir.y, -dir.z*invSpacing);
+
+	float t;
+	XMFLOAT3 n;
+	bool found = mPagedHeightmap.IsOpen() ? 
+		mHeightPyramid.IntersectRay(mPagedHeightmap, gridPos, gridDir, maxDist, t, n) :
+		mHeightPyramid.IntersectRay(mHeightmap, gridPos, gridDir, maxDist, t, n);
+	if( !found )
+		return false;
+
+	hit.T = t;
+	XMStoreFloat3(&hit.Position, rayPos + t*rayDir);
+
+	// Normals transform by the inverse transpose of the grid-to-local scaling.
+	XMVECTOR normal = XMVectorSet(n.x*invSpacing, n.y, -n.z*invSpacing, 0.0f);
+	XMStoreFloat3(&hit.Normal, XMVector3Normalize(normal));
+
+	return true;
+}
+
+void Terrain::GetHeights(const float* x, const float* z, float* heights, UINT count)const
+{
+	ParallelFor::Run(count, 4096, [=](size_t begin, size_t end)
+	{
+		SampleHeights(x + begin, z + begin, heights + begin, 0, 0, 0, (UINT)(end - begin));
+	});
+}
+
+void Terrain::GetHeightsAndNormals(const float* x, const float* z, float* heights, 
+								   float* normalX, float* normalY, float* normalZ, UINT count)const
+{
+	ParallelFor::Run(count, 4096, [=](size_t begin, size_t end)
+	{
+		SampleHeights(x + begin, z + begin, heights + begin, 
+			normalX + begin, normalY + begin, normalZ + begin, (UINT)(end - begin));
+	});
+}
+
+bool Terrain::SaveHeightmap(const std::wstring& filename, bool entropyCode)const
+{
+	if( mPagedHeightmap.IsOpen() )
+		return false;
+
+	return mHeightmap.Write(filename, entropyCode);
+}
+
+bool Terrain::SaveTiles(ID3D11Device* device, ID3D11DeviceContext* dc, const std::wstring& filename)const
+{
+	if( mPagedHeightmap.IsOpen() )
+		return false;
+
+	const UINT width  = mInfo.HeightmapWidth;
+	const UINT height = mInfo.HeightmapHeight;
+
+	std::vector<float> heights(width*height);
+	mHeightmap.Decode(&heights[0]);
+
+	// Load the blend map again into a texture the CPU can read.
+	ID3D11Texture2D* blendTex = 0;
+	HR(CreateDDSTextureFromFileEx(device, mInfo.BlendMapFilename.c_str(), 0, D3D11_USAGE_STAGING, 0, 
+		D3D11_CPU_ACCESS_READ, 0, DirectX::DX11::DDS_LOADER_DEFAULT, (ID3D11Resource**)&blendTex, nullptr, 0));
+
+	D3D11_TEXTURE2D_DESC blendDesc;
+	blendTex->GetDesc(&blendDesc);
+
+	// Only uncompressed 8-bit RGBA blend maps are supported.
+	bool bgra = blendDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM;
+	if( !bgra && blendDesc.Format != DXGI_FORMAT_R8G8B8A8_UNORM )
+	{
+		ReleaseCOM(blendTex);
+		return false;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedTex;
+	HR(dc->Map(blendTex, 0, D3D11_MAP_READ, 0, &mappedTex));
+
+	// Resample the top mip bilinearly to one texel per heightmap texel, which is 
+	// how the tiles store it.
+	std::vector<UINT> blend(width*height);
+	for(UINT i = 0; i < height; ++i)
+	{
+		float v = height > 1 ? (float)i*(blendDesc.Height-1)/(height-1) : 0.0f;
+		UINT y0 = MathHelper::Min((UINT)v, blendDesc.Height-1);
+		UINT y1 = MathHelper::Min(y0+1, blendDesc.Height-1);
+		float ty = v - (float)y0;
+
+		const BYTE* row0 = (const BYTE*)mappedTex.pData + y0*mappedTex.RowPitch;
+		const BYTE* row1 = (const BYTE*)mappedTex.pData + y1*mappedTex.RowPitch;
+
+		for(UINT j = 0; j < width; ++j)
+		{
+			float u = width > 1 ? (float)j*(blendDesc.Width-1)/(width-1) : 0.0f;
+			UINT x0 = MathHelper::Min((UINT)u, blendDesc.Width-1);
+			UINT x1 = MathHelper::Min(x0+1, blendDesc.Width-1);
+			float tx = u - (float)x0;
+
+			UINT texel = 0;
+			for(int k = 0; k < 4; ++k)
+			{
+				// BGRA maps swap red and blue.
+				int channel = (bgra && k != 3) ? 2-k : k;
+
+				float top    = row0[4*x0+channel] + tx*(row0[4*x1+channel] - row0[4*x0+channel]);
+				float bottom = row1[4*x0+channel] + tx*(row1[4*x1+channel] - row1[4*x0+channel]);
+				UINT value = (UINT)(top + ty*(bottom - top) + 0.5f);
+
+				texel |= MathHelper::Min(value, 255u) << (8*k);
+			}
+
+			blend[i*width + j] = texel;
+		}
+	}
+
+	dc->Unmap(blendTex, 0);
+	ReleaseCOM(blendTex);
+
+	return PagedHeightmap::WriteTiles(filename, &heights[0], &blend[0], width, height, CellsPerPatch);
+}
+
+size_t Terrain::GetResidentBytes()const
+{
+	size_t heightmapBytes = mPagedHeightmap.IsOpen() ? 
+		mPagedHeightmap.GetResidentBytes() : mHeightmap.GetResidentBytes();
+
+	return heightmapBytes + mHeightPyramid.GetResidentBytes() + mLodSelector.GetResidentBytes();
+}
+
 XMMATRIX Terrain::GetWorld()const
 {
 	return XMLoadFloat4x4(&mWorld);
@@ -103,6 +344,13 @@ void Terrain::Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo
 {
 	mInfo = initInfo;
 
+	// In paged mode the map size comes from the tile file.
+	if( !mInfo.TileFilename.empty() && OpenTiles() )
+	{
+		mInfo.HeightmapWidth  = mPagedHeightmap.GetHeightmapWidth();
+		mInfo.HeightmapHeight = mPagedHeightmap.GetHeightmapHeight();
+	}
+
 	// Divide heightmap into patches such that each patch has CellsPerPatch.
 	mNumPatchVertRows = ((mInfo.HeightmapHeight-1) / CellsPerPatch) + 1;
 	mNumPatchVertCols = ((mInfo.HeightmapWidth-1) / CellsPerPatch) + 1;
@@ -110,13 +358,37 @@ void Terrain::Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo
 	mNumPatchVertices  = mNumPatchVertRows*mNumPatchVertCols;
 	mNumPatchQuadFaces = (mNumPatchVertRows-1)*(mNumPatchVertCols-1);
 
-	LoadHeightmap();
-	Smooth();
-	CalcAllPatchBoundsY();
+	// Heights are loaded and smoothed at full precision, then kept compressed.
+	// Paged terrain has no full resolution heights; its tiles are final.
+	std::vector<float> heights;
+	if( !mPagedHeightmap.IsOpen() )
+	{
+		if( mInfo.HeightMapFormat == HeightmapCompressed )
+		{
+			LoadCompressedHeightmap(heights);
+		}
+		else
+		{
+			LoadHeightmap(heights);
+			Smooth(heights, 1);
+			mHeightmap.Build(&heights[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight, CellsPerPatch);
+		}
+
+		// Continue with the decoded heights so that the bounds, the GPU heightmap and
+		// the CPU queries all describe the same surface.
+		mHeightmap.Decode(&heights[0]);
+	}
+
+	CalcAllPatchBoundsY(heights);
 
 	BuildQuadPatchVB(device);
 	BuildQuadPatchIB(device);
-	BuildHeightmapSRV(device);
+	BuildPatchLodBuffer(device);
+
+	if( mPagedHeightmap.IsOpen() )
+		BuildTileResources(device);
+	else
+		BuildHeightmapSRV(device, &heights[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight);
 
 	std::vector<std::wstring> layerFilenames;
 	layerFilenames.push_back(mInfo.LayerMapFilename0);
@@ -126,28 +398,42 @@ void Terrain::Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo
 	layerFilenames.push_back(mInfo.LayerMapFilename4);
 	mLayerMapArraySRV = d3dHelper::CreateTexture2DArraySRV(device, dc, layerFilenames);
 
-	HR(D3DX11CreateShaderResourceViewFromFile(device, 
-		mInfo.BlendMapFilename.c_str(), 0, 0, &mBlendMapSRV, 0));
+	if( !mPagedHeightmap.IsOpen() )
+	{
+		HR(D3DX11CreateShaderResourceViewFromFile(device, 
+			mInfo.BlendMapFilename.c_str(), 0, 0, &mBlendMapSRV, 0));
+	}
 }
 
 void Terrain::Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight lights[3])
 {
+	// The LODs are chosen for the current viewport.
+	UINT numViewports = 1;
+	D3D11_VIEWPORT viewport;
+	dc->RSGetViewports(&numViewports, &viewport);
+
+	if( mPagedHeightmap.IsOpen() )
+		UpdateTileResidency(dc, cam);
+
+	SelectPatchLods(cam, viewport.Height, LodPixelTolerance, mVisiblePatches);
+	if( mVisiblePatches.empty() )
+		return;
+
+	UpdatePatchBuffers(dc);
+
 	dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
 	dc->IASetInputLayout(InputLayouts::Terrain);
 
 	UINT stride = sizeof(Vertex::Terrain);
     UINT offset = 0;
     dc->IASetVertexBuffers(0, 1, &mQuadPatchVB, &stride, &offset);
-	dc->IASetIndexBuffer(mQuadPatchIB, DXGI_FORMAT_R16_UINT, 0);
+	dc->IASetIndexBuffer(mQuadPatchIB, DXGI_FORMAT_R32_UINT, 0);
 
 	XMMATRIX viewProj = cam.ViewProj();
 	XMMATRIX world  = XMLoadFloat4x4(&mWorld);
 	XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
 	XMMATRIX worldViewProj = world*viewProj;
 
-	XMFLOAT4 worldPlanes[6];
-	ExtractFrustumPlanes(worldPlanes, viewProj);
-
 	// Set per frame constants.
 	Effects::TerrainFX->SetViewProj(viewProj);
 	Effects::TerrainFX->SetEyePosW(cam.GetPosition());
@@ -155,18 +441,31 @@ void Terrain::Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight
 	Effects::TerrainFX->SetFogColor(Colors::Silver);
 	Effects::TerrainFX->SetFogStart(15.0f);
 	Effects::TerrainFX->SetFogRange(175.0f);
-	Effects::TerrainFX->SetMinDist(20.0f);
-	Effects::TerrainFX->SetMaxDist(500.0f);
-	Effects::TerrainFX->SetMinTess(0.0f);
-	Effects::TerrainFX->SetMaxTess(6.0f);
 	Effects::TerrainFX->SetTexelCellSpaceU(1.0f / mInfo.HeightmapWidth);
 	Effects::TerrainFX->SetTexelCellSpaceV(1.0f / mInfo.HeightmapHeight);
 	Effects::TerrainFX->SetWorldCellSpace(mInfo.CellSpacing);
-	Effects::TerrainFX->SetWorldFrustumPlanes(worldPlanes);
 	
 	Effects::TerrainFX->SetLayerMapArray(mLayerMapArraySRV);
 	Effects::TerrainFX->SetBlendMap(mBlendMapSRV);
 	Effects::TerrainFX->SetHeightMap(mHeightMapSRV);
+	Effects::TerrainFX->SetPatchLods(mPatchLodSRV);
+
+	// Paged mode: mHeightMapSRV and mBlendMapSRV hold the overview, and resident
+	// tiles are looked up in the tile arrays.
+	Effects::TerrainFX->SetPaged(mPagedHeightmap.IsOpen());
+	if( mPagedHeightmap.IsOpen() )
+	{
+		Effects::TerrainFX->SetHeightmapCells(XMFLOAT2((float)(mInfo.HeightmapWidth-1), (float)(mInfo.HeightmapHeight-1)));
+		Effects::TerrainFX->SetTileGrid(XMFLOAT2((float)mPagedHeightmap.GetTileCols(), (float)mPagedHeightmap.GetTileRows()));
+		Effects::TerrainFX->SetTileCells((float)mPagedHeightmap.GetTileCells());
+		Effects::TerrainFX->SetTileSide((float)mPagedHeightmap.GetTileSide());
+		Effects::TerrainFX->SetOverviewStep((float)mPagedHeightmap.GetOverviewStep());
+		Effects::TerrainFX->SetOverviewSize(XMFLOAT2((float)mPagedHeightmap.GetOverviewWidth(), (float)mPagedHeightmap.GetOverviewHeight()));
+
+		Effects::TerrainFX->SetTileHeightMapArray(mTileHeightArraySRV);
+		Effects::TerrainFX->SetTileBlendMapArray(mTileBlendArraySRV);
+		Effects::TerrainFX->SetTileSlots(mTileSlotSRV);
+	}
 
 	Effects::TerrainFX->SetMaterial(mMat);
 
@@ -179,7 +478,7 @@ void Terrain::Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight
         ID3DX11EffectPass* pass = tech->GetPassByIndex(i);
 		pass->Apply(0, dc);
 
-		dc->DrawIndexed(mNumPatchQuadFaces*4, 0, 0);
+		dc->DrawIndexed((UINT)mVisiblePatches.size()*4, 0, 0);
 	}	
 
 	// FX sets tessellation stages, but it does not disable them.  So do that here
@@ -188,129 +487,337 @@ void Terrain::Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight
 	dc->DSSetShader(0, 0, 0);
 }
 
-void Terrain::LoadHeightmap()
+const HeightmapPyramid& Terrain::GetHeightPyramid()const
 {
-	// A height for each vertex
-	std::vector<unsigned char> in( mInfo.HeightmapWidth * mInfo.HeightmapHeight );
+	return mHeightPyramid;
+}
 
-	// Open the file.
-	std::ifstream inFile;
-	inFile.open(mInfo.HeightMapFilename.c_str(), std::ios_base::binary);
+void Terrain::SelectPatchLods(const Camera& cam, float viewportHeight, float pixelTolerance,
+							  std::vector<TerrainPatchLod>& patches)const
+{
+	// The selector works in terrain local space.
+	XMMATRIX world = XMLoadFloat4x4(&mWorld);
+	XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
 
-	if(inFile)
-	{
-		// Read the RAW bytes.
-		inFile.read((char*)&in[0], (std::streamsize)in.size());
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(planes, world*cam.ViewProj());
+
+	XMFLOAT3 eyePos;
+	XMStoreFloat3(&eyePos, XMVector3TransformCoord(cam.GetPositionXM(), invWorld));
 
-		// Done with file.
-		inFile.close();
+	TerrainLodSelector::Settings settings;
+	settings.PixelTolerance = pixelTolerance;
+	settings.ViewportHeight = viewportHeight;
+	settings.FovY           = cam.GetFovY();
+
+	mLodSelector.Select(eyePos, planes, settings, patches);
+}
+
+void Terrain::LoadHeightmap(std::vector<float>& heightmap)
+{
+	const UINT width  = mInfo.HeightmapWidth;
+	const UINT height = mInfo.HeightmapHeight;
+
+	// A height for each vertex
+	heightmap.assign(width*height, 0.0f);
+
+	UINT bytesPerTexel = 1;
+	switch(mInfo.HeightMapFormat)
+	{
+	case HeightmapR16:  bytesPerTexel = 2; break;
+	case HeightmapR32F: bytesPerTexel = 4; break;
 	}
 
-	// Copy the array data into a float array and scale it.
-	mHeightmap.resize(mInfo.HeightmapHeight * mInfo.HeightmapWidth, 0);
-	for(UINT i = 0; i < mInfo.HeightmapHeight * mInfo.HeightmapWidth; ++i)
+	// Map the file instead of reading it into a staging buffer; the texels are
+	// converted straight from the mapped view into the float heightmap.  Like 
+	// before, a missing file leaves the terrain flat.
+	MappedFile file;
+	if( !file.Open(mInfo.HeightMapFilename) )
+		return;
+
+	if( file.GetSize() < (UINT64)width*height*bytesPerTexel )
 	{
-		mHeightmap[i] = (in[i] / 255.0f)*mInfo.HeightScale;
+		MessageBox(0, (mInfo.HeightMapFilename + L" is smaller than the heightmap dimensions.").c_str(), 0, 0);
+		return;
 	}
-}
 
-void Terrain::Smooth()
-{
-	std::vector<float> dest( mHeightmap.size() );
+	const BYTE* data = file.GetData();
+	const HeightmapFormat format = mInfo.HeightMapFormat;
+	const float heightScale = mInfo.HeightScale;
+	float* heights = &heightmap[0];
 
-	for(UINT i = 0; i < mInfo.HeightmapHeight; ++i)
+	// Convert in bands of rows on the worker threads.  Each band touches a 
+	// contiguous range of the file, so pages are faulted in sequentially.
+	ParallelFor::Run(height, 32, [=](size_t begin, size_t end)
 	{
-		for(UINT j = 0; j < mInfo.HeightmapWidth; ++j)
+		size_t first = begin*width;
+		size_t last  = end*width;
+
+		switch(format)
 		{
-			dest[i*mInfo.HeightmapWidth+j] = Average(i,j);
+		case HeightmapR8:
+			for(size_t k = first; k < last; ++k)
+				heights[k] = (data[k] / 255.0f)*heightScale;
+			break;
+
+		case HeightmapR16:
+			for(size_t k = first; k < last; ++k)
+			{
+				USHORT h = (USHORT)(data[2*k] | (data[2*k+1] << 8));
+				heights[k] = (h / 65535.0f)*heightScale;
+			}
+			break;
+
+		case HeightmapR32F:
+			for(size_t k = first; k < last; ++k)
+			{
+				// The view is only guaranteed to be byte aligned.
+				float h;
+				memcpy(&h, data + 4*k, sizeof(float));
+				heights[k] = h*heightScale;
+			}
+			break;
 		}
+	});
+}
+
+bool Terrain::OpenTiles()
+{
+	if( !mPagedHeightmap.Open(mInfo.TileFilename, mInfo.CellSpacing, mInfo.TileMemoryBudget) )
+	{
+		MessageBox(0, (mInfo.TileFilename + L" is missing or not a tile file; loading the whole heightmap.").c_str(), 0, 0);
+		return false;
+	}
+
+	// The tiles double as the patches.
+	if( mPagedHeightmap.GetTileCells() != (UINT)CellsPerPatch )
+	{
+		MessageBox(0, (mInfo.TileFilename + L" does not use patch sized tiles; loading the whole heightmap.").c_str(), 0, 0);
+		mPagedHeightmap.Close();
+		return false;
 	}
 
-	// Replace the old heightmap with the filtered one.
-	mHeightmap = dest;
+	return true;
 }
 
-bool Terrain::InBounds(int i, int j)
+void Terrain::LoadCompressedHeightmap(std::vector<float>& heights)
 {
-	// True if ij are valid indices; false otherwise.
-	return 
-		i >= 0 && i < (int)mInfo.HeightmapHeight && 
-		j >= 0 && j < (int)mInfo.HeightmapWidth;
+	heights.resize(mInfo.HeightmapWidth*mInfo.HeightmapHeight);
+
+	if( !mHeightmap.Read(mInfo.HeightMapFilename) )
+	{
+		// Like a missing RAW file, leave the terrain flat.
+		std::fill(heights.begin(), heights.end(), 0.0f);
+		mHeightmap.Build(&heights[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight, CellsPerPatch);
+		return;
+	}
+
+	if( mHeightmap.GetWidth() != mInfo.HeightmapWidth || mHeightmap.GetHeight() != mInfo.HeightmapHeight ||
+		mHeightmap.GetTileCells() != (UINT)CellsPerPatch )
+	{
+		MessageBox(0, (mInfo.HeightMapFilename + L" does not match the heightmap dimensions.").c_str(), 0, 0);
+
+		std::fill(heights.begin(), heights.end(), 0.0f);
+		mHeightmap.Build(&heights[0], mInfo.HeightmapWidth, mInfo.HeightmapHeight, CellsPerPatch);
+	}
 }
 
-float Terrain::Average(int i, int j)
+void Terrain::Smooth(std::vector<float>& heightmap, UINT numIterations)
 {
-	// Function computes the average height of the ij element.
-	// It averages itself with its eight neighbor pixels.  Note
-	// that if a pixel is missing neighbor, we just don't include it
-	// in the average--that is, edge pixels don't have a neighbor pixel.
+	// Each iteration averages every height with its eight neighbors; heights on the 
+	// border only average with the neighbors that exist.  Because the valid 
+	// neighbors always form a rectangle, this 3x3 average is separable: average
+	// each row horizontally, then average the results vertically.  Repeated
+	// iterations approach a Gaussian blur.
 	//
-	// ----------
-	// | 1| 2| 3|
-	// ----------
-	// |4 |ij| 6|
-	// ----------
-	// | 7| 8| 9|
-	// ----------
-
-	float avg = 0.0f;
-	float num = 0.0f;
-
-	// Use int to allow negatives.  If we use UINT, @ i=0, m=i-1=UINT_MAX
-	// and no iterations of the outer for loop occur.
-	for(int m = i-1; m <= i+1; ++m)
-	{
-		for(int n = j-1; n <= j+1; ++n)
+	// The horizontal pass writes to a scratch buffer and the vertical pass writes
+	// back to the heightmap, so the two buffers are allocated once for all iterations.
+	// Both passes work on independent rows and are split across threads.
+
+	const UINT width  = mInfo.HeightmapWidth;
+	const UINT height = mInfo.HeightmapHeight;
+
+	if( width == 0 || height == 0 )
+		return;
+
+	std::vector<float> temp( heightmap.size() );
+
+	float* heights = &heightmap[0];
+	float* rowAvg  = &temp[0];
+
+	for(UINT iter = 0; iter < numIterations; ++iter)
+	{
+		ParallelFor::Run(height, 64, [=](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i)
+				AverageRowNeighbors(heights + i*width, rowAvg + i*width, width);
+		});
+
+		ParallelFor::Run(height, 64, [=](size_t begin, size_t end)
 		{
-			if( InBounds(m,n) )
+			for(size_t i = begin; i < end; ++i)
 			{
-				avg += mHeightmap[m*mInfo.HeightmapWidth + n];
-				num += 1.0f;
+				float* dst = heights + i*width;
+				const float* row = rowAvg + i*width;
+
+				if( height == 1 )
+					std::copy(row, row + width, dst);
+				else if( i == 0 )
+					AverageRows2(row, row + width, dst, width);
+				else if( i == height-1 )
+					AverageRows2(row - width, row, dst, width);
+				else
+					AverageRows3(row - width, row, row + width, dst, width);
 			}
-		}
+		});
 	}
-
-	return avg / num;
 }
 
-void Terrain::CalcAllPatchBoundsY()
+void Terrain::CalcAllPatchBoundsY(const std::vector<float>& heights)
 {
-	mPatchBoundsY.resize(mNumPatchQuadFaces);
+	// The per-patch bounds are the tile bounds of the compressed or paged 
+	// heightmap, whose tiles cover the same cells as the patches.  The pyramid adds
+	// the bounds of larger blocks for culling and ray casts; ray casts get the 
+	// bounds of single cells from the heightmap.
+	const bool paged = mPagedHeightmap.IsOpen();
+
+	UINT tileRows = paged ? mPagedHeightmap.GetTileRows() : mHeightmap.GetTileRows();
+	UINT tileCols = paged ? mPagedHeightmap.GetTileCols() : mHeightmap.GetTileCols();
+
+	std::vector<XMFLOAT2> tileBounds(tileRows*tileCols);
+	for(UINT i = 0; i < tileRows; ++i)
+	{
+		for(UINT j = 0; j < tileCols; ++j)
+		{
+			tileBounds[i*tileCols + j] = paged ? 
+				mPagedHeightmap.GetTileBoundsY(i, j) : mHeightmap.GetTileBoundsY(i, j);
+		}
+	}
+
+	mHeightPyramid.Build(&tileBounds[0], mInfo.HeightmapHeight-1, mInfo.HeightmapWidth-1, CellsPerPatch);
 
-	// For each patch
-	for(UINT i = 0; i < mNumPatchVertRows-1; ++i)
+	// Tessellation errors of the whole patches.  The tile file stores them; 
+	// otherwise they come from the full resolution heights that are only around
+	// while loading.
+	UINT patchRows = (mInfo.HeightmapHeight-1) / CellsPerPatch;
+	UINT patchCols = (mInfo.HeightmapWidth-1) / CellsPerPatch;
+	UINT numLods   = TerrainLodSelector::GetNumLods(CellsPerPatch);
+
+	std::vector<float> patchErrors(patchRows*patchCols*numLods);
+	if( paged )
 	{
-		for(UINT j = 0; j < mNumPatchVertCols-1; ++j)
+		for(UINT i = 0; i < patchRows; ++i)
 		{
-			CalcPatchBoundsY(i, j);
+			for(UINT j = 0; j < patchCols; ++j)
+			{
+				const float* errors = mPagedHeightmap.GetTileErrors(i, j);
+				std::copy(errors, errors + numLods, &patchErrors[(i*patchCols + j)*numLods]);
+			}
 		}
 	}
+	else
+	{
+		ParallelFor::Run(patchRows, 1, [&](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				for(UINT j = 0; j < patchCols; ++j)
+				{
+					TerrainLodSelector::ComputePatchErrors(&heights[i*CellsPerPatch*mInfo.HeightmapWidth + j*CellsPerPatch],
+						mInfo.HeightmapWidth, CellsPerPatch, &patchErrors[(i*patchCols + j)*numLods]);
+				}
+			}
+		});
+	}
+
+	mLodSelector.Init(&mHeightPyramid, mInfo.CellSpacing, patchErrors.empty() ? 0 : &patchErrors[0]);
 }
 
-void Terrain::CalcPatchBoundsY(UINT i, UINT j)
+bool Terrain::SetHeights(ID3D11DeviceContext* dc, const float* heights, UINT row0, UINT col0, UINT numRows, UINT numCols)
 {
-	// Scan the heightmap values this patch covers and compute the min/max height.
+	if( mPagedHeightmap.IsOpen() )
+		return false;
+
+	UINT tileRow0, tileCol0, tileRow1, tileCol1;
+	mHeightmap.Update(heights, row0, col0, numRows, numCols, tileRow0, tileCol0, tileRow1, tileCol1);
+	if( tileRow0 >= tileRow1 || tileCol0 >= tileCol1 )
+		return true;
 
-	UINT x0 = j*CellsPerPatch;
-	UINT x1 = (j+1)*CellsPerPatch;
+	UINT numTileRows = tileRow1 - tileRow0;
+	UINT numTileCols = tileCol1 - tileCol0;
 
-	UINT y0 = i*CellsPerPatch;
-	UINT y1 = (i+1)*CellsPerPatch;
+	std::vector<XMFLOAT2> tileBounds(numTileRows*numTileCols);
+	for(UINT i = 0; i < numTileRows; ++i)
+	{
+		for(UINT j = 0; j < numTileCols; ++j)
+			tileBounds[i*numTileCols + j] = mHeightmap.GetTileBoundsY(tileRow0 + i, tileCol0 + j);
+	}
+
+	mHeightPyramid.Update(&tileBounds[0], tileRow0, tileCol0, tileRow1, tileCol1);
 
-	float minY = +MathHelper::Infinity;
-	float maxY = -MathHelper::Infinity;
-	for(UINT y = y0; y <= y1; ++y)
+	// The changed tiles are the patches whose errors change, decoded like in Init.
+	UINT numLods = TerrainLodSelector::GetNumLods(CellsPerPatch);
+	UINT side    = CellsPerPatch+1;
+
+	std::vector<float> patchErrors(numTileRows*numTileCols*numLods);
+	ParallelFor::Run(numTileRows*numTileCols, 1, [&](size_t begin, size_t end)
 	{
-		for(UINT x = x0; x <= x1; ++x)
+		std::vector<float> patch(side*side);
+		for(size_t k = begin; k < end; ++k)
 		{
-			UINT k = y*mInfo.HeightmapWidth + x;
-			minY = MathHelper::Min(minY, mHeightmap[k]);
-			maxY = MathHelper::Max(maxY, mHeightmap[k]);
+			UINT i = tileRow0 + (UINT)k/numTileCols;
+			UINT j = tileCol0 + (UINT)k%numTileCols;
+			if( (i+1)*CellsPerPatch >= mInfo.HeightmapHeight || (j+1)*CellsPerPatch >= mInfo.HeightmapWidth )
+				continue;
+
+			for(UINT r = 0; r < side; ++r)
+			{
+				for(UINT c = 0; c < side; ++c)
+					patch[r*side + c] = mHeightmap.GetTexel(i*CellsPerPatch + r, j*CellsPerPatch + c);
+			}
+
+			TerrainLodSelector::ComputePatchErrors(&patch[0], side, CellsPerPatch, &patchErrors[k*numLods]);
 		}
+	});
+
+	mLodSelector.UpdatePatchErrors(&patchErrors[0], tileRow0, tileCol0, tileRow1, tileCol1);
+
+	// Upload the texels owned by the changed tiles.
+	UINT texRow0 = tileRow0*CellsPerPatch;
+	UINT texCol0 = tileCol0*CellsPerPatch;
+	UINT texRow1 = tileRow1 == mHeightmap.GetTileRows() ? mInfo.HeightmapHeight : tileRow1*CellsPerPatch;
+	UINT texCol1 = tileCol1 == mHeightmap.GetTileCols() ? mInfo.HeightmapWidth  : tileCol1*CellsPerPatch;
+
+	UINT texWidth = texCol1 - texCol0;
+	std::vector<HALF> texels((texRow1 - texRow0)*texWidth);
+	for(UINT r = texRow0; r < texRow1; ++r)
+	{
+		for(UINT c = texCol0; c < texCol1; ++c)
+			texels[(r - texRow0)*texWidth + c - texCol0] = XMConvertFloatToHalf(mHeightmap.GetTexel(r, c));
 	}
 
-	UINT patchID = i*(mNumPatchVertCols-1)+j;
-	mPatchBoundsY[patchID] = XMFLOAT2(minY, maxY);
+	D3D11_BOX box;
+	box.left   = texCol0;
+	box.right  = texCol1;
+	box.top    = texRow0;
+	box.bottom = texRow1;
+	box.front  = 0;
+	box.back   = 1;
+
+	ID3D11Resource* hmapTex = 0;
+	mHeightMapSRV->GetResource(&hmapTex);
+	dc->UpdateSubresource(hmapTex, 0, &box, &texels[0], texWidth*sizeof(HALF), 0);
+	ReleaseCOM(hmapTex);
+
+	return true;
+}
+
+void Terrain::GetCell(UINT row, UINT col, float corners[4])const
+{
+	if( mPagedHeightmap.IsOpen() )
+		mPagedHeightmap.GetCell(row, col, corners);
+	else
+		mHeightmap.GetCell(row, col, corners);
 }
 
 void Terrain::BuildQuadPatchVB(ID3D11Device* device)
@@ -340,16 +847,6 @@ void Terrain::BuildQuadPatchVB(ID3D11Device* device)
 		}
 	}
 
-	// Store axis-aligned bounding box y-bounds in upper-left patch corner.
-	for(UINT i = 0; i < mNumPatchVertRows-1; ++i)
-	{
-		for(UINT j = 0; j < mNumPatchVertCols-1; ++j)
-		{
-			UINT patchID = i*(mNumPatchVertCols-1)+j;
-			patchVertices[i*mNumPatchVertCols+j].BoundsY = mPatchBoundsY[patchID];
-		}
-	}
-
     D3D11_BUFFER_DESC vbd;
     vbd.Usage = D3D11_USAGE_IMMUTABLE;
 	vbd.ByteWidth = sizeof(Vertex::Terrain) * patchVertices.size();
@@ -365,44 +862,87 @@ void Terrain::BuildQuadPatchVB(ID3D11Device* device)
 
 void Terrain::BuildQuadPatchIB(ID3D11Device* device)
 {
-	std::vector<USHORT> indices(mNumPatchQuadFaces*4); // 4 indices per quad face
+	// Filled by UpdatePatchBuffers with the visible patches, so it is dynamic and
+	// sized for the case where every patch is visible.
+	D3D11_BUFFER_DESC ibd;
+    ibd.Usage = D3D11_USAGE_DYNAMIC;
+	// 32-bit indices, since paged maps can have more than 64K patch vertices.
+	ibd.ByteWidth = sizeof(UINT) * mNumPatchQuadFaces*4; // 4 indices per quad face
+    ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    ibd.MiscFlags = 0;
+	ibd.StructureByteStride = 0;
+
+    HR(device->CreateBuffer(&ibd, 0, &mQuadPatchIB));
+}
+
+void Terrain::BuildPatchLodBuffer(ID3D11Device* device)
+{
+	D3D11_BUFFER_DESC bd;
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = sizeof(PatchLodGpu) * mNumPatchQuadFaces;
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.StructureByteStride = sizeof(PatchLodGpu);
+    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+
+    HR(device->CreateBuffer(&bd, 0, &mPatchLodBuffer));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+	srvDesc.BufferEx.FirstElement = 0;
+	srvDesc.BufferEx.Flags = 0;
+	srvDesc.BufferEx.NumElements = mNumPatchQuadFaces;
+
+	HR(device->CreateShaderResourceView(mPatchLodBuffer, &srvDesc, &mPatchLodSRV));
+}
+
+void Terrain::UpdatePatchBuffers(ID3D11DeviceContext* dc)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedData;
 
-	// Iterate over each quad and compute indices.
-	int k = 0;
-	for(UINT i = 0; i < mNumPatchVertRows-1; ++i)
+	// The control points of each visible patch.  Patch ids are row major over the
+	// patch grid, as are the vertices of mQuadPatchVB.
+	HR(dc->Map(mQuadPatchIB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+	UINT* indices = reinterpret_cast<UINT*>(mappedData.pData);
+	for(size_t p = 0; p < mVisiblePatches.size(); ++p)
 	{
-		for(UINT j = 0; j < mNumPatchVertCols-1; ++j)
-		{
-			// Top row of 2x2 quad patch
-			indices[k]   = i*mNumPatchVertCols+j;
-			indices[k+1] = i*mNumPatchVertCols+j+1;
+		UINT i = mVisiblePatches[p].PatchId / (mNumPatchVertCols-1);
+		UINT j = mVisiblePatches[p].PatchId % (mNumPatchVertCols-1);
 
-			// Bottom row of 2x2 quad patch
-			indices[k+2] = (i+1)*mNumPatchVertCols+j;
-			indices[k+3] = (i+1)*mNumPatchVertCols+j+1;
+		// Top row of 2x2 quad patch
+		indices[4*p]   = i*mNumPatchVertCols+j;
+		indices[4*p+1] = i*mNumPatchVertCols+j+1;
 
-			k += 4; // next quad
-		}
+		// Bottom row of 2x2 quad patch
+		indices[4*p+2] = (i+1)*mNumPatchVertCols+j;
+		indices[4*p+3] = (i+1)*mNumPatchVertCols+j+1;
 	}
 
-	D3D11_BUFFER_DESC ibd;
-    ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(USHORT) * indices.size();
-    ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    ibd.CPUAccessFlags = 0;
-    ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
+	dc->Unmap(mQuadPatchIB, 0);
 
-    D3D11_SUBRESOURCE_DATA iinitData;
-    iinitData.pSysMem = &indices[0];
-    HR(device->CreateBuffer(&ibd, &iinitData, &mQuadPatchIB));
+	// The hull shader finds the factors of patch p of the draw at index p.
+	HR(dc->Map(mPatchLodBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+	PatchLodGpu* lods = reinterpret_cast<PatchLodGpu*>(mappedData.pData);
+	for(size_t p = 0; p < mVisiblePatches.size(); ++p)
+	{
+		const TerrainPatchLod& patch = mVisiblePatches[p];
+
+		lods[p].EdgeTess   = XMFLOAT4(patch.EdgeTess[0], patch.EdgeTess[1], patch.EdgeTess[2], patch.EdgeTess[3]);
+		lods[p].InsideTess = patch.InsideTess;
+	}
+
+	dc->Unmap(mPatchLodBuffer, 0);
 }
 
-void Terrain::BuildHeightmapSRV(ID3D11Device* device)
+void Terrain::BuildHeightmapSRV(ID3D11Device* device, const float* heights, UINT width, UINT height)
 {
 	D3D11_TEXTURE2D_DESC texDesc;
-	texDesc.Width = mInfo.HeightmapWidth;
-	texDesc.Height = mInfo.HeightmapHeight;
+	texDesc.Width = width;
+	texDesc.Height = height;
     texDesc.MipLevels = 1;
 	texDesc.ArraySize = 1;
 	texDesc.Format    = DXGI_FORMAT_R16_FLOAT;
@@ -414,12 +954,12 @@ void Terrain::BuildHeightmapSRV(ID3D11Device* device)
 	texDesc.MiscFlags = 0;
 
 	// HALF is defined in xnamath.h, for storing 16-bit float.
-	std::vector<HALF> hmap(mHeightmap.size());
-	std::transform(mHeightmap.begin(), mHeightmap.end(), hmap.begin(), XMConvertFloatToHalf);
+	std::vector<HALF> hmap(width*height);
+	std::transform(heights, heights + hmap.size(), hmap.begin(), XMConvertFloatToHalf);
 	
 	D3D11_SUBRESOURCE_DATA data;
 	data.pSysMem = &hmap[0];
-    data.SysMemPitch = mInfo.HeightmapWidth*sizeof(HALF);
+    data.SysMemPitch = width*sizeof(HALF);
     data.SysMemSlicePitch = 0;
 
 	ID3D11Texture2D* hmapTex = 0;
@@ -434,4 +974,250 @@ void Terrain::BuildHeightmapSRV(ID3D11Device* device)
 
 	// SRV saves reference.
 	ReleaseCOM(hmapTex);
-}
\ No newline at end of file
+}
+
+void Terrain::BuildTileResources(ID3D11Device* device)
+{
+	//
+	// The overview stands in for the heightmap and blend map.
+	//
+
+	UINT overviewWidth  = mPagedHeightmap.GetOverviewWidth();
+	UINT overviewHeight = mPagedHeightmap.GetOverviewHeight();
+
+	BuildHeightmapSRV(device, mPagedHeightmap.GetOverviewHeights(), overviewWidth, overviewHeight);
+
+	D3D11_TEXTURE2D_DESC texDesc;
+	texDesc.Width = overviewWidth;
+	texDesc.Height = overviewHeight;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = 1;
+	texDesc.Format    = DXGI_FORMAT_R8G8B8A8_UNORM;
+	texDesc.SampleDesc.Count   = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags = 0;
+	texDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA data;
+	data.pSysMem = mPagedHeightmap.GetOverviewBlend();
+	data.SysMemPitch = overviewWidth*sizeof(UINT);
+	data.SysMemSlicePitch = 0;
+
+	ID3D11Texture2D* blendTex = 0;
+	HR(device->CreateTexture2D(&texDesc, &data, &blendTex));
+	HR(device->CreateShaderResourceView(blendTex, 0, &mBlendMapSRV));
+	ReleaseCOM(blendTex);
+
+	//
+	// One array slice per resident tile slot.  Slices are filled as tiles arrive.
+	//
+
+	UINT tileSide = mPagedHeightmap.GetTileSide();
+
+	texDesc.Width = tileSide;
+	texDesc.Height = tileSide;
+	texDesc.ArraySize = MathHelper::Max(mPagedHeightmap.GetMaxResidentTiles(), 1u);
+	texDesc.Format = DXGI_FORMAT_R16_FLOAT;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	HR(device->CreateTexture2D(&texDesc, 0, &mTileHeightArray));
+	HR(device->CreateShaderResourceView(mTileHeightArray, 0, &mTileHeightArraySRV));
+
+	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	HR(device->CreateTexture2D(&texDesc, 0, &mTileBlendArray));
+	HR(device->CreateShaderResourceView(mTileBlendArray, 0, &mTileBlendArraySRV));
+
+	//
+	// Slot of every tile; none are resident yet.
+	//
+
+	UINT numTiles = mPagedHeightmap.GetTileRows()*mPagedHeightmap.GetTileCols();
+	mTileSlots.assign(numTiles, -1);
+
+	D3D11_BUFFER_DESC bd;
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = sizeof(int) * numTiles;
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.StructureByteStride = 0;
+    bd.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA slotData;
+	slotData.pSysMem = &mTileSlots[0];
+	slotData.SysMemPitch = 0;
+	slotData.SysMemSlicePitch = 0;
+
+    HR(device->CreateBuffer(&bd, &slotData, &mTileSlotBuffer));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_R32_SINT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = numTiles;
+
+	HR(device->CreateShaderResourceView(mTileSlotBuffer, &srvDesc, &mTileSlotSRV));
+}
+
+void Terrain::UpdateTileResidency(ID3D11DeviceContext* dc, const Camera& cam)
+{
+	// Residency is centered on the camera in terrain local space.
+	XMMATRIX world = XMLoadFloat4x4(&mWorld);
+	XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+
+	XMFLOAT3 eyePos;
+	XMStoreFloat3(&eyePos, XMVector3TransformCoord(cam.GetPositionXM(), invWorld));
+
+	mPagedHeightmap.UpdateResidency(eyePos.x, eyePos.z, mInfo.TileResidencyRadius);
+
+	// Copy the tiles that arrived to their slots.  A tile may already have been
+	// evicted again, and its slot handed to a tile later in the list.
+	mPagedHeightmap.TakeInstalledTiles(mInstalledTiles);
+
+	UINT tileCols = mPagedHeightmap.GetTileCols();
+	UINT tileSide = mPagedHeightmap.GetTileSide();
+	std::vector<HALF> tileHeights(tileSide*tileSide);
+
+	for(size_t k = 0; k < mInstalledTiles.size(); ++k)
+	{
+		UINT row = mInstalledTiles[k] / tileCols;
+		UINT col = mInstalledTiles[k] % tileCols;
+
+		int slot = mPagedHeightmap.GetTileSlot(row, col);
+		if( slot < 0 )
+			continue;
+
+		const float* heights = mPagedHeightmap.GetTileHeights(row, col);
+		std::transform(heights, heights + tileHeights.size(), tileHeights.begin(), XMConvertFloatToHalf);
+
+		UINT subresource = D3D11CalcSubresource(0, slot, 1);
+		dc->UpdateSubresource(mTileHeightArray, subresource, 0, &tileHeights[0], tileSide*sizeof(HALF), 0);
+		dc->UpdateSubresource(mTileBlendArray, subresource, 0, mPagedHeightmap.GetTileBlend(row, col), tileSide*sizeof(UINT), 0);
+	}
+
+	// Republish the slot table when any tile arrived or left.
+	bool changed = false;
+	for(size_t id = 0; id < mTileSlots.size(); ++id)
+	{
+		int slot = mPagedHeightmap.GetTileSlot((UINT)id / tileCols, (UINT)id % tileCols);
+		if( mTileSlots[id] != slot )
+		{
+			mTileSlots[id] = slot;
+			changed = true;
+		}
+	}
+
+	if( changed )
+	{
+		D3D11_MAPPED_SUBRESOURCE mappedData;
+		HR(dc->Map(mTileSlotBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+		memcpy(mappedData.pData, &mTileSlots[0], mTileSlots.size()*sizeof(int));
+		dc->Unmap(mTileSlotBuffer, 0);
+	}
+}
+
+void Terrain::SampleHeights(const float* x, const float* z, float* heights, 
+							float* normalX, float* normalY, float* normalZ, UINT count)const
+{
+	XMVECTOR one = XMVectorSplatOne();
+
+	for(UINT i = 0; i < count; i += 4)
+	{
+		// Copy a partial last group to the stack so all loads and stores are 4 wide.
+		UINT n = MathHelper::Min(count - i, 4u);
+
+		XMFLOAT4 xs(x[i], 0.0f, 0.0f, 0.0f);
+		XMFLOAT4 zs(z[i], 0.0f, 0.0f, 0.0f);
+		for(UINT k = 1; k < n; ++k)
+		{
+			(&xs.x)[k] = x[i+k];
+			(&zs.x)[k] = z[i+k];
+		}
+
+		XMVECTOR h, dhdx, dhdz;
+		SampleHeights4(XMLoadFloat4(&xs), XMLoadFloat4(&zs), h, dhdx, dhdz);
+
+		XMFLOAT4 hs;
+		XMStoreFloat4(&hs, h);
+		for(UINT k = 0; k < n; ++k)
+			heights[i+k] = (&hs.x)[k];
+
+		if( normalX == 0 )
+			continue;
+
+		// The surface is y = h(x, z), so its normal is (-dh/dx, 1, -dh/dz) normalized.
+		XMVECTOR invLength = XMVectorReciprocalSqrt(dhdx*dhdx + dhdz*dhdz + one);
+
+		XMFLOAT4 nx, ny, nz;
+		XMStoreFloat4(&nx, -dhdx*invLength);
+		XMStoreFloat4(&ny, invLength);
+		XMStoreFloat4(&nz, -dhdz*invLength);
+		for(UINT k = 0; k < n; ++k)
+		{
+			normalX[i+k] = (&nx.x)[k];
+			normalY[i+k] = (&ny.x)[k];
+			normalZ[i+k] = (&nz.x)[k];
+		}
+	}
+}
+
+void Terrain::SampleHeights4(FXMVECTOR x, FXMVECTOR z, XMVECTOR& height, XMVECTOR& dhdx, XMVECTOR& dhdz)const
+{
+	// This is GetHeight for four points at once; see it for the cell layout.
+	const float invSpacing = 1.0f / mInfo.CellSpacing;
+
+	XMVECTOR one = XMVectorSplatOne();
+
+	// Transform from terrain local space to "cell" space and clamp to the grid.
+	XMVECTOR c = (x + XMVectorReplicate(0.5f*GetWidth()))*invSpacing;
+	XMVECTOR d = (XMVectorReplicate(0.5f*GetDepth()) - z)*invSpacing;
+
+	XMVECTOR maxCell = XMVectorSet((float)(mInfo.HeightmapWidth-2), (float)(mInfo.HeightmapHeight-2), 0.0f, 0.0f);
+	c = XMVectorClamp(c, XMVectorZero(), XMVectorSplatX(maxCell) + one);
+	d = XMVectorClamp(d, XMVectorZero(), XMVectorSplatY(maxCell) + one);
+
+	// The last row and column of texels start no cell, so points on the far
+	// border use the cell before them with s or t equal to 1.
+	XMVECTOR col = XMVectorMin(XMVectorFloor(c), XMVectorSplatX(maxCell));
+	XMVECTOR row = XMVectorMin(XMVectorFloor(d), XMVectorSplatY(maxCell));
+
+	XMVECTOR s = c - col;
+	XMVECTOR t = d - row;
+
+	// SSE has no gather, so fetch the four corners of each point's cell with
+	// scalar loads.
+	XMFLOAT4 colf, rowf;
+	XMStoreFloat4(&colf, col);
+	XMStoreFloat4(&rowf, row);
+
+	XMFLOAT4 A, B, C, D;
+	for(int k = 0; k < 4; ++k)
+	{
+		float corners[4];
+		GetCell((UINT)(&rowf.x)[k], (UINT)(&colf.x)[k], corners);
+
+		(&A.x)[k] = corners[0];
+		(&B.x)[k] = corners[1];
+		(&C.x)[k] = corners[2];
+		(&D.x)[k] = corners[3];
+	}
+
+	XMVECTOR a = XMLoadFloat4(&A);
+	XMVECTOR b = XMLoadFloat4(&B);
+	XMVECTOR cc = XMLoadFloat4(&C);
+	XMVECTOR dd = XMLoadFloat4(&D);
+
+	// Evaluate both triangles and select per lane instead of branching.
+	XMVECTOR lower = XMVectorGreater(s + t, one);
+
+	XMVECTOR upperHeight = a + s*(b - a) + t*(cc - a);
+	XMVECTOR lowerHeight = dd + (one - s)*(cc - dd) + (one - t)*(b - dd);
+	height = XMVectorSelect(upperHeight, lowerHeight, lower);
+
+	// Slopes with respect to s and t, then to x and z (z runs opposite to t).
+	XMVECTOR dhds = XMVectorSelect(b - a, dd - cc, lower);
+	XMVECTOR dhdt = XMVectorSelect(cc - a, dd - b, lower);
+
+	dhdx = dhds*invSpacing;
+	dhdz = -dhdt*invSpacing;
+}
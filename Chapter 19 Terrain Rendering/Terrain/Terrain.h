@@ -8,16 +8,45 @@
 #define TERRAIN_H
 
 #include "d3dUtil.h"
+#include "CompressedHeightmap.h"
+#include "PagedHeightmap.h"
+#include "HeightmapPyramid.h"
+#include "TerrainLodSelector.h"
 
 class Camera;
 struct DirectionalLight;
 
+///<summary>
+/// Result of a terrain ray cast, in terrain local space.
+///</summary>
+struct TerrainHit
+{
+	float T;
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+};
+
 class Terrain
 {
 public:
+	// Texel formats of the RAW heightmap file.  Integer formats are normalized to
+	// [0, 1]; float heights are used as is.  All are then multiplied by HeightScale
+	// and smoothed.
+	//
+	// HeightmapCompressed is a file written by SaveHeightmap.  Its heights are 
+	// final, so HeightScale and smoothing are not applied again.
+	enum HeightmapFormat
+	{
+		HeightmapR8,    // 8-bit unsigned
+		HeightmapR16,   // 16-bit unsigned, little endian
+		HeightmapR32F,  // 32-bit float
+		HeightmapCompressed
+	};
+
 	struct InitInfo
 	{
 		std::wstring HeightMapFilename;
+		HeightmapFormat HeightMapFormat;
 		std::wstring LayerMapFilename0;
 		std::wstring LayerMapFilename1;
 		std::wstring LayerMapFilename2;
@@ -28,6 +57,15 @@ public:
 		UINT HeightmapWidth;
 		UINT HeightmapHeight;
 		float CellSpacing;
+
+		// Paged mode.  If TileFilename names a file written by SaveTiles, the
+		// heightmap, blend map and patch bounds are read from its tiles instead,
+		// and only the tiles within TileResidencyRadius of the camera are kept,
+		// up to TileMemoryBudget bytes.  The height and blend map settings above
+		// are then ignored.  Leave TileFilename empty to load the whole map.
+		std::wstring TileFilename;
+		size_t TileMemoryBudget;
+		float TileResidencyRadius;
 	};
 
 public:
@@ -38,23 +76,74 @@ public:
 	float GetDepth()const;
 	float GetHeight(float x, float z)const;
 
+	// Intersects a terrain local space ray with the heightfield surface (the same
+	// triangles GetHeight interpolates).  Returns true and fills out hit with the
+	// nearest hit with 0 <= t <= maxDist; t is measured in units of the rayDir length.
+	bool RayTerrainIntersect(FXMVECTOR rayPos, FXMVECTOR rayDir, TerrainHit& hit, 
+		float maxDist = MathHelper::Infinity)const;
+
+	// Batched GetHeight for count points given as separate x and z arrays.  Points
+	// are processed four at a time with SIMD math, and large batches are split 
+	// across threads.  Points outside the terrain are clamped to its border.
+	void GetHeights(const float* x, const float* z, float* heights, UINT count)const;
+
+	// Like GetHeights, but also returns the unit surface normal of the triangle
+	// each point lies on, as separate x, y, z arrays.
+	void GetHeightsAndNormals(const float* x, const float* z, float* heights, 
+		float* normalX, float* normalY, float* normalZ, UINT count)const;
+
+	// Writes the resident heightmap for loading with HeightmapCompressed.  With
+	// entropyCode the file is smaller but takes longer to load.
+	bool SaveHeightmap(const std::wstring& filename, bool entropyCode)const;
+
+	// Writes the heightmap and the blend map (resampled to the heightmap size) as
+	// a tile file for paged mode.  Only available when the whole map is loaded.
+	bool SaveTiles(ID3D11Device* device, ID3D11DeviceContext* dc, const std::wstring& filename)const;
+
+	// Bytes kept resident for CPU queries and LOD selection: the compressed 
+	// heightmap or the resident tiles, the height pyramid and the patch errors.
+	size_t GetResidentBytes()const;
+
 	XMMATRIX GetWorld()const;
 	void SetWorld(CXMMATRIX M);
 
 	void Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo& initInfo);
 
+	// In paged mode, also updates the resident tiles around the camera.
 	void Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight lights[3]);
 
+	// Replaces the numRows x numCols heights starting at texel (row0, col0), given
+	// row by row, and refreshes only the tiles, pyramid entries, patch errors and
+	// heightmap texels they affect.  Returns false in paged mode, whose tiles are 
+	// read only.
+	bool SetHeights(ID3D11DeviceContext* dc, const float* heights, UINT row0, UINT col0, UINT numRows, UINT numCols);
+
+	// Min/max height pyramid of the heightmap, for culling and ray queries.
+	const HeightmapPyramid& GetHeightPyramid()const;
+
+	// Culls the patches against the camera frustum and picks a tessellation LOD
+	// for each visible one from its projected height error.  Draw submits exactly
+	// these patches with these tessellation factors.
+	void SelectPatchLods(const Camera& cam, float viewportHeight, float pixelTolerance,
+		std::vector<TerrainPatchLod>& patches)const;
+
 private:
-	void LoadHeightmap();
-	void Smooth();
-	bool InBounds(int i, int j);
-	float Average(int i, int j);
-	void CalcAllPatchBoundsY();
-	void CalcPatchBoundsY(UINT i, UINT j);
+	void LoadHeightmap(std::vector<float>& heights);
+	void LoadCompressedHeightmap(std::vector<float>& heights);
+	bool OpenTiles();
+	void Smooth(std::vector<float>& heights, UINT numIterations);
+	void CalcAllPatchBoundsY(const std::vector<float>& heights);
+	void GetCell(UINT row, UINT col, float corners[4])const;
+	void SampleHeights(const float* x, const float* z, float* heights, 
+		float* normalX, float* normalY, float* normalZ, UINT count)const;
+	void SampleHeights4(FXMVECTOR x, FXMVECTOR z, XMVECTOR& height, XMVECTOR& dhdx, XMVECTOR& dhdz)const;
 	void BuildQuadPatchVB(ID3D11Device* device);
 	void BuildQuadPatchIB(ID3D11Device* device);
-	void BuildHeightmapSRV(ID3D11Device* device);
+	void BuildPatchLodBuffer(ID3D11Device* device);
+	void UpdatePatchBuffers(ID3D11DeviceContext* dc);
+	void BuildHeightmapSRV(ID3D11Device* device, const float* heights, UINT width, UINT height);
+	void BuildTileResources(ID3D11Device* device);
+	void UpdateTileResidency(ID3D11DeviceContext* dc, const Camera& cam);
 
 private:
 
@@ -64,12 +153,27 @@ private:
 	static const int CellsPerPatch = 64;
 
 	ID3D11Buffer* mQuadPatchVB;
+
+	// Rewritten every frame with the visible patches only, and their tessellation
+	// factors in the same order.
 	ID3D11Buffer* mQuadPatchIB;
+	ID3D11Buffer* mPatchLodBuffer;
+	ID3D11ShaderResourceView* mPatchLodSRV;
 
 	ID3D11ShaderResourceView* mLayerMapArraySRV;
 	ID3D11ShaderResourceView* mBlendMapSRV;
 	ID3D11ShaderResourceView* mHeightMapSRV;
 
+	// Paged mode only.  mHeightMapSRV and mBlendMapSRV hold the overview, and the
+	// resident tiles are copied to their slots in the tile arrays.  mTileSlotBuffer
+	// has the slot of every tile, or -1, for the shaders.
+	ID3D11Texture2D* mTileHeightArray;
+	ID3D11Texture2D* mTileBlendArray;
+	ID3D11ShaderResourceView* mTileHeightArraySRV;
+	ID3D11ShaderResourceView* mTileBlendArraySRV;
+	ID3D11Buffer* mTileSlotBuffer;
+	ID3D11ShaderResourceView* mTileSlotSRV;
+
 	InitInfo mInfo;
 
 	UINT mNumPatchVertices;
@@ -82,8 +186,18 @@ private:
 
 	Material mMat;
 
-	std::vector<XMFLOAT2> mPatchBoundsY;
-	std::vector<float> mHeightmap;
+	// Heights for CPU queries, quantized in patch sized tiles.  The tile bounds
+	// double as the patch bounds.
+	CompressedHeightmap mHeightmap;
+
+	// Used instead of mHeightmap in paged mode.
+	PagedHeightmap mPagedHeightmap;
+	std::vector<unsigned> mInstalledTiles;
+	std::vector<int> mTileSlots;
+
+	HeightmapPyramid mHeightPyramid;
+	TerrainLodSelector mLodSelector;
+	std::vector<TerrainPatchLod> mVisiblePatches;
 };
 
 #endif // TERRAIN_H
\ No newline at end of file
@@ -117,6 +117,7 @@ bool TerrainApp::Init()
 
 	Terrain::InitInfo tii;
 	tii.HeightMapFilename = L"Textures/terrain.raw";
+	tii.HeightMapFormat   = Terrain::HeightmapR8;
 	tii.LayerMapFilename0 = L"Textures/grass.dds";
 	tii.LayerMapFilename1 = L"Textures/darkdirt.dds";
 	tii.LayerMapFilename2 = L"Textures/stone.dds";
@@ -128,6 +129,12 @@ bool TerrainApp::Init()
 	tii.HeightmapHeight = 2049;
 	tii.CellSpacing = 0.5f;
 
+	// Set TileFilename to a file written by Terrain::SaveTiles to page the terrain
+	// in around the camera instead.
+	tii.TileFilename = L"";
+	tii.TileMemoryBudget = 64*1024*1024;
+	tii.TileResidencyRadius = 300.0f;
+
 	mTerrain.Init(md3dDevice, md3dImmediateContext, tii);
 	return true;
 }
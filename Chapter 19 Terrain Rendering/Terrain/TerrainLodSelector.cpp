@@ -0,0 +1,290 @@
+//***************************************************************************************
+// TerrainLodSelector.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "TerrainLodSelector.h"
+#include <algorithm>
+#include <cmath>
+
+TerrainLodSelector::Settings::Settings()
+	: PixelTolerance(2.0f),
+	ViewportHeight(600.0f),
+	FovY(0.25f*3.1415926535f)
+{
+}
+
+TerrainLodSelector::TerrainLodSelector()
+: mPyramid(0), mPatchCells(0), mMaxLod(0), mPatchRows(0), mPatchCols(0), mCellSpacing(1.0f)
+{
+}
+
+TerrainLodSelector::~TerrainLodSelector()
+{
+}
+
+void TerrainLodSelector::Init(const HeightmapPyramid* pyramid, float cellSpacing, const float* patchErrors)
+{
+	mPyramid     = pyramid;
+	mPatchCells  = pyramid->GetBlockCells();
+	mCellSpacing = cellSpacing;
+	mMaxLod      = GetNumLods(mPatchCells)-1;
+
+	// Like Terrain, only whole patches are used.
+	mPatchRows = 0;
+	mPatchCols = 0;
+	if( mPatchCells > 0 )
+	{
+		mPatchRows = mPyramid->GetCellRows() / mPatchCells;
+		mPatchCols = mPyramid->GetCellCols() / mPatchCells;
+	}
+
+	size_t count = mPatchRows*mPatchCols*(mMaxLod+1);
+	if( count > 0 )
+		mPatchErrors.assign(patchErrors, patchErrors + count);
+	else
+		mPatchErrors.clear();
+}
+
+void TerrainLodSelector::UpdatePatchErrors(const float* patchErrors, unsigned patchRow0, unsigned patchCol0, 
+										   unsigned patchRow1, unsigned patchCol1)
+{
+	unsigned numLods  = mMaxLod+1;
+	unsigned srcPitch = (patchCol1 - patchCol0)*numLods;
+
+	unsigned row1 = std::min(patchRow1, mPatchRows);
+	unsigned col1 = std::min(patchCol1, mPatchCols);
+	if( patchRow0 >= row1 || patchCol0 >= col1 )
+		return;
+
+	for(unsigned i = patchRow0; i < row1; ++i)
+	{
+		const float* src = patchErrors + (i - patchRow0)*srcPitch;
+		std::copy(src, src + (col1 - patchCol0)*numLods, &mPatchErrors[(i*mPatchCols + patchCol0)*numLods]);
+	}
+}
+
+unsigned TerrainLodSelector::GetNumLods(unsigned patchCells)
+{
+	unsigned lods = 1;
+	while( (1u << (lods-1)) < patchCells )
+		++lods;
+
+	return lods;
+}
+
+void TerrainLodSelector::ComputePatchErrors(const float* heights, unsigned rowPitch, unsigned patchCells, float* errors)
+{
+	unsigned maxLod = GetNumLods(patchCells)-1;
+
+	// Min/max of every cell's corners, then merged 2x2 in place.  At LOD l the 
+	// patch has 2^l quads a side, and the surface can deviate from a quad by at 
+	// most the height range of the cells it covers.  At the finest LOD the quads 
+	// are the cells themselves and there is no error.
+	std::vector<DirectX::XMFLOAT2> bounds(patchCells*patchCells);
+	for(unsigned i = 0; i < patchCells; ++i)
+	{
+		const float* row0 = heights + i*rowPitch;
+		const float* row1 = row0 + rowPitch;
+		for(unsigned j = 0; j < patchCells; ++j)
+		{
+			bounds[i*patchCells + j] = DirectX::XMFLOAT2(
+				std::min(std::min(row0[j], row0[j+1]), std::min(row1[j], row1[j+1])),
+				std::max(std::max(row0[j], row0[j+1]), std::max(row1[j], row1[j+1])));
+		}
+	}
+
+	errors[maxLod] = 0.0f;
+	unsigned blocks = patchCells;
+	for(unsigned lod = maxLod; lod-- > 0; )
+	{
+		unsigned fine = blocks;
+		blocks /= 2;
+
+		float maxRange = 0.0f;
+		for(unsigned i = 0; i < blocks; ++i)
+		{
+			for(unsigned j = 0; j < blocks; ++j)
+			{
+				const DirectX::XMFLOAT2& a = bounds[(2*i)*fine + 2*j];
+				const DirectX::XMFLOAT2& b = bounds[(2*i)*fine + 2*j+1];
+				const DirectX::XMFLOAT2& c = bounds[(2*i+1)*fine + 2*j];
+				const DirectX::XMFLOAT2& d = bounds[(2*i+1)*fine + 2*j+1];
+
+				// Reading row 2i of the finer level only touches entries at or 
+				// after i*blocks + j, so the merge can run in place.
+				DirectX::XMFLOAT2& merged = bounds[i*blocks + j];
+				merged = DirectX::XMFLOAT2(
+					std::min(std::min(a.x, b.x), std::min(c.x, d.x)),
+					std::max(std::max(a.y, b.y), std::max(c.y, d.y)));
+
+				maxRange = std::max(maxRange, merged.y - merged.x);
+			}
+		}
+
+		errors[lod] = maxRange;
+	}
+}
+
+unsigned TerrainLodSelector::GetPatchRows()const
+{
+	return mPatchRows;
+}
+
+unsigned TerrainLodSelector::GetPatchCols()const
+{
+	return mPatchCols;
+}
+
+const float* TerrainLodSelector::GetPatchErrors(unsigned patchRow, unsigned patchCol)const
+{
+	return &mPatchErrors[(patchRow*mPatchCols + patchCol)*(mMaxLod+1)];
+}
+
+void TerrainLodSelector::Select(const DirectX::XMFLOAT3& eyePos, const DirectX::XMFLOAT4 planes[6], 
+								const Settings& settings, std::vector<TerrainPatchLod>& patches)const
+{
+	patches.clear();
+	if( mPatchRows == 0 || mPatchCols == 0 )
+		return;
+
+	std::vector<unsigned> visible;
+	unsigned top = mPyramid->GetNumLevels()-1;
+	Select(top, 0, 0, planes, visible);
+
+	// A height error e at distance d projects to e*k/d pixels.
+	float k = settings.ViewportHeight / (2.0f*tanf(0.5f*settings.FovY));
+	float errorScale = k / settings.PixelTolerance;
+
+	patches.resize(visible.size());
+	for(size_t p = 0; p < visible.size(); ++p)
+	{
+		unsigned id  = visible[p];
+		unsigned row = id / mPatchCols;
+		unsigned col = id % mPatchCols;
+
+		unsigned lod = ComputeLod(row, col, eyePos, errorScale);
+
+		// The LOD of a neighbor only depends on the neighbor and the eye, so both
+		// patches sharing an edge compute the same max and the edge matches even 
+		// when the neighbor itself was culled.
+		unsigned neighborLod[4] = { lod, lod, lod, lod };
+		if( col > 0 )            neighborLod[0] = ComputeLod(row, col-1, eyePos, errorScale);
+		if( row > 0 )            neighborLod[1] = ComputeLod(row-1, col, eyePos, errorScale);
+		if( col+1 < mPatchCols ) neighborLod[2] = ComputeLod(row, col+1, eyePos, errorScale);
+		if( row+1 < mPatchRows ) neighborLod[3] = ComputeLod(row+1, col, eyePos, errorScale);
+
+		TerrainPatchLod& patch = patches[p];
+		patch.PatchId    = id;
+		patch.Lod        = lod;
+		patch.InsideTess = (float)(1u << lod);
+		for(int e = 0; e < 4; ++e)
+			patch.EdgeTess[e] = (float)(1u << std::max(lod, neighborLod[e]));
+	}
+}
+
+size_t TerrainLodSelector::GetResidentBytes()const
+{
+	return mPatchErrors.size()*sizeof(float);
+}
+
+void TerrainLodSelector::GetBlockBox(unsigned level, unsigned row, unsigned col, Box& box)const
+{
+	// Cells covered by the block, clamped to the whole patches.
+	unsigned size = mPatchCells << level;
+	unsigned row0 = row*size;
+	unsigned col0 = col*size;
+	unsigned row1 = std::min(row0 + size, mPatchRows*mPatchCells);
+	unsigned col1 = std::min(col0 + size, mPatchCols*mPatchCells);
+
+	float halfWidth = 0.5f*mPyramid->GetCellCols()*mCellSpacing;
+	float halfDepth = 0.5f*mPyramid->GetCellRows()*mCellSpacing;
+
+	const DirectX::XMFLOAT2& boundsY = mPyramid->GetBounds(level, row, col);
+
+	box.Center[0] = -halfWidth + 0.5f*(col0 + col1)*mCellSpacing;
+	box.Center[1] = 0.5f*(boundsY.x + boundsY.y);
+	box.Center[2] = halfDepth - 0.5f*(row0 + row1)*mCellSpacing;
+
+	box.Extents[0] = 0.5f*(col1 - col0)*mCellSpacing;
+	box.Extents[1] = 0.5f*(boundsY.y - boundsY.x);
+	box.Extents[2] = 0.5f*(row1 - row0)*mCellSpacing;
+}
+
+void TerrainLodSelector::Select(unsigned level, unsigned row, unsigned col, const DirectX::XMFLOAT4 planes[6],
+								std::vector<unsigned>& visible)const
+{
+	// Skip blocks that only cover the partial patches past the last whole one.
+	unsigned patches = 1u << level;
+	if( row*patches >= mPatchRows || col*patches >= mPatchCols )
+		return;
+
+	Box box;
+	GetBlockBox(level, row, col, box);
+
+	// Same box/plane test as the hull shader, but also detect blocks entirely
+	// inside so their patches are accepted without further tests.
+	bool inside = true;
+	for(int i = 0; i < 6; ++i)
+	{
+		const DirectX::XMFLOAT4& p = planes[i];
+
+		float r = box.Extents[0]*fabsf(p.x) + box.Extents[1]*fabsf(p.y) + box.Extents[2]*fabsf(p.z);
+		float s = box.Center[0]*p.x + box.Center[1]*p.y + box.Center[2]*p.z + p.w;
+
+		if( s + r < 0.0f )
+			return;
+
+		if( s - r < 0.0f )
+			inside = false;
+	}
+
+	if( inside || level == 0 )
+	{
+		// Patches covered by the block.
+		unsigned i0 = row*patches;
+		unsigned j0 = col*patches;
+		unsigned i1 = std::min(i0 + patches, mPatchRows);
+		unsigned j1 = std::min(j0 + patches, mPatchCols);
+
+		for(unsigned i = i0; i < i1; ++i)
+		{
+			for(unsigned j = j0; j < j1; ++j)
+				visible.push_back(i*mPatchCols + j);
+		}
+		return;
+	}
+
+	for(unsigned i = 2*row; i < std::min(2*row+2, mPyramid->GetLevelRows(level-1)); ++i)
+	{
+		for(unsigned j = 2*col; j < std::min(2*col+2, mPyramid->GetLevelCols(level-1)); ++j)
+			Select(level-1, i, j, planes, visible);
+	}
+}
+
+unsigned TerrainLodSelector::ComputeLod(unsigned patchRow, unsigned patchCol, 
+										const DirectX::XMFLOAT3& eyePos, float errorScale)const
+{
+	Box box;
+	GetBlockBox(0, patchRow, patchCol, box);
+
+	// Distance from the eye to the patch box.
+	float eye[3] = { eyePos.x, eyePos.y, eyePos.z };
+	float distSq = 0.0f;
+	for(int i = 0; i < 3; ++i)
+	{
+		float d = std::max(0.0f, fabsf(eye[i] - box.Center[i]) - box.Extents[i]);
+		distSq += d*d;
+	}
+	float dist = std::max(sqrtf(distSq), mCellSpacing);
+
+	// Coarsest LOD whose projected error is within tolerance.  The errors only 
+	// shrink as the LOD increases.
+	const float* errors = GetPatchErrors(patchRow, patchCol);
+	for(unsigned lod = 0; lod < mMaxLod; ++lod)
+	{
+		if( errors[lod]*errorScale <= dist )
+			return lod;
+	}
+
+	return mMaxLod;
+}
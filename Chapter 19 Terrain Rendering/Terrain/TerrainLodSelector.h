@@ -0,0 +1,120 @@
+//***************************************************************************************
+// TerrainLodSelector.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// CPU side terrain LOD selection.  Walks the min/max height pyramid top down to
+// cull blocks of patches against the frustum, then picks a tessellation level for
+// each visible patch from a screen space error metric.  The pyramid starts at
+// patch granularity; the error of each patch at each tessellation level is 
+// computed from the heights with ComputePatchErrors, and recomputed for the 
+// patches whose heights change.  Edge factors are shared between neighbors so
+// the tessellated patches meet without cracks.
+//
+// The patch grid and edge order match Terrain and Terrain.fx: patches are 
+// patchCells x patchCells cells, rows run from +z to -z, and the edges are
+// ordered left (-x), top (+z), right (+x), bottom (-z).
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef TERRAINLODSELECTOR_H
+#define TERRAINLODSELECTOR_H
+
+#include "HeightmapPyramid.h"
+
+///<summary>
+/// A visible patch and its tessellation factors.  Lod is the log2 of InsideTess,
+/// from 0 (one quad) to the selector's maximum (e.g., 6 for 64x64 quads).
+///</summary>
+struct TerrainPatchLod
+{
+	unsigned PatchId;
+	unsigned Lod;
+	float EdgeTess[4];
+	float InsideTess;
+};
+
+class TerrainLodSelector
+{
+public:
+	struct Settings
+	{
+		Settings();
+
+		// Largest allowed projected height error, in pixels.
+		float PixelTolerance;
+
+		// Viewport height in pixels and vertical field of view in radians.
+		float ViewportHeight;
+		float FovY;
+	};
+
+public:
+	TerrainLodSelector();
+	~TerrainLodSelector();
+
+	// The pyramid's blocks are the patches, and its block size must be a power of
+	// two.  Keeps a pointer to the pyramid, which must outlive the selector.
+	// patchErrors holds GetNumLods(patchCells) errors per whole patch, patch after
+	// patch in row order, as computed by ComputePatchErrors.
+	void Init(const HeightmapPyramid* pyramid, float cellSpacing, const float* patchErrors);
+
+	// Replaces the errors of the patches [patchRow0, patchRow1) x [patchCol0, 
+	// patchCol1) after their heights changed.  patchErrors holds the new errors of
+	// just those patches, laid out like the ones given to Init.  Patches past the 
+	// last whole one are ignored.
+	void UpdatePatchErrors(const float* patchErrors, unsigned patchRow0, unsigned patchCol0, 
+		unsigned patchRow1, unsigned patchCol1);
+
+	// Number of tessellation levels of a patch, from one quad to one per cell.
+	static unsigned GetNumLods(unsigned patchCells);
+
+	// Largest height error of the patch whose upper-left texel is heights[0] at
+	// each LOD, written to errors[0..GetNumLods(patchCells)-1].  rowPitch is the
+	// number of texels between rows.
+	static void ComputePatchErrors(const float* heights, unsigned rowPitch, unsigned patchCells, float* errors);
+
+	unsigned GetPatchRows()const;
+	unsigned GetPatchCols()const;
+
+	// Errors of a whole patch at each LOD, as given to Init or UpdatePatchErrors.
+	const float* GetPatchErrors(unsigned patchRow, unsigned patchCol)const;
+
+	// Replaces patches with the patches not outside the frustum planes (inward
+	// facing, as given by ExtractFrustumPlanes in terrain local space), each 
+	// tagged with its LOD and tessellation factors.
+	void Select(const DirectX::XMFLOAT3& eyePos, const DirectX::XMFLOAT4 planes[6], const Settings& settings,
+		std::vector<TerrainPatchLod>& patches)const;
+
+	// Memory used by the patch errors.
+	size_t GetResidentBytes()const;
+
+private:
+	struct Box
+	{
+		float Center[3];
+		float Extents[3];
+	};
+
+	void GetBlockBox(unsigned level, unsigned row, unsigned col, Box& box)const;
+
+	void Select(unsigned level, unsigned row, unsigned col, const DirectX::XMFLOAT4 planes[6],
+		std::vector<unsigned>& visible)const;
+
+	unsigned ComputeLod(unsigned patchRow, unsigned patchCol, const DirectX::XMFLOAT3& eyePos, float errorScale)const;
+
+private:
+	const HeightmapPyramid* mPyramid;
+
+	unsigned mPatchCells;
+	unsigned mMaxLod;
+	unsigned mPatchRows;
+	unsigned mPatchCols;
+	float mCellSpacing;
+
+	// mPatchErrors[patchId*(mMaxLod+1) + lod] is the largest height error of 
+	// the patch when tessellated at that LOD.
+	std::vector<float> mPatchErrors;
+};
+
+#endif // TERRAINLODSELECTOR_H
@@ -23,7 +23,6 @@ namespace Vertex
 	{
 		XMFLOAT3 Pos;
 		XMFLOAT2 Tex;
-		XMFLOAT2 BoundsY;
 	};
 }
 
@@ -33,7 +32,7 @@ public:
 	// Init like const int A::a[4] = {0, 1, 2, 3}; in .cpp file.
 	static const D3D11_INPUT_ELEMENT_DESC Pos[1];
 	static const D3D11_INPUT_ELEMENT_DESC Basic32[3];
-	static const D3D11_INPUT_ELEMENT_DESC Terrain[3];
+	static const D3D11_INPUT_ELEMENT_DESC Terrain[2];
 };
 
 class InputLayouts
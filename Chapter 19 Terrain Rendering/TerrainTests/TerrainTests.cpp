@@ -0,0 +1,866 @@
+//***************************************************************************************
+// TerrainTests.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Console program that checks the terrain's CPU side modules against brute force
+// versions of what they compute.  It does not create a window or a Direct3D
+// device, and the modules only depend on DirectXMath and the standard library, so
+// it also builds and runs headless on Linux with the CMakeLists.txt next to this
+// file (where ctest runs it).
+//
+//      compressed - CompressedHeightmap quantization error, cell decoding, tile
+//                   bounds, and raw and entropy coded files.
+//      pyramid    - HeightmapPyramid ray casts against a loop over every cell.
+//      paged      - PagedHeightmap tiles, slots and residency within the budget.
+//      lod        - TerrainLodSelector culling against a per-patch frustum test,
+//                   and matching edge factors between neighbors.
+//      update     - Height edits through CompressedHeightmap::Update, 
+//                   HeightmapPyramid::Update and UpdatePatchErrors against a 
+//                   full rebuild.
+//
+// Usage:
+//      TerrainTests
+//
+// Scratch files are written to the working directory.  Returns 0 if every check
+// passed.
+//***************************************************************************************
+
+#include "../Terrain/CompressedHeightmap.h"
+#include "../Terrain/HeightmapPyramid.h"
+#include "../Terrain/PagedHeightmap.h"
+#include "../Terrain/TerrainLodSelector.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned PatchCells = 64;
+
+	int gNumFailed = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if( !ok )
+		{
+			printf("    FAILED: %s\n", what);
+			gNumFailed++;
+		}
+	}
+
+	// Hills with some high frequency detail, so the tiles have different ranges.
+	void MakeHeights(unsigned width, unsigned height, std::vector<float>& heights)
+	{
+		heights.resize(width*height);
+		for(unsigned i = 0; i < height; ++i)
+		{
+			for(unsigned j = 0; j < width; ++j)
+			{
+				heights[i*width + j] = 20.0f*sinf(i*0.05f)*cosf(j*0.07f) +
+					3.0f*sinf(i*0.9f + j*0.4f);
+			}
+		}
+	}
+
+	void GetTileBounds(const CompressedHeightmap& heightmap, std::vector<XMFLOAT2>& bounds)
+	{
+		bounds.resize(heightmap.GetTileRows()*heightmap.GetTileCols());
+		for(unsigned i = 0; i < heightmap.GetTileRows(); ++i)
+		{
+			for(unsigned j = 0; j < heightmap.GetTileCols(); ++j)
+				bounds[i*heightmap.GetTileCols() + j] = heightmap.GetTileBoundsY(i, j);
+		}
+	}
+
+	// Moller-Trumbore, for the brute force ray cast.
+	bool IntersectRayTriangle(const float o[3], const float d[3],
+		const float a[3], const float b[3], const float c[3], float& t)
+	{
+		float e1[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+		float e2[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+
+		float p[3] = { d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0] };
+		float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+		if( fabsf(det) < 1e-12f )
+			return false;
+
+		float invDet = 1.0f / det;
+
+		float s[3] = { o[0]-a[0], o[1]-a[1], o[2]-a[2] };
+		float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * invDet;
+		if( u < 0.0f || u > 1.0f )
+			return false;
+
+		float q[3] = { s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0] };
+		float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * invDet;
+		if( v < 0.0f || u + v > 1.0f )
+			return false;
+
+		t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * invDet;
+		return t >= 0.0f;
+	}
+
+	// Nearest hit with the two triangles of every cell, split like the pyramid's.
+	bool IntersectRayBruteForce(const std::vector<float>& heights, unsigned width, unsigned height,
+		const float o[3], const float d[3], float& tBest)
+	{
+		bool found = false;
+		tBest = FLT_MAX;
+		for(unsigned i = 0; i+1 < height; ++i)
+		{
+			for(unsigned j = 0; j+1 < width; ++j)
+			{
+				float a[3] = { (float)j,   heights[i*width + j],       (float)i   };
+				float b[3] = { (float)j+1, heights[i*width + j+1],     (float)i   };
+				float c[3] = { (float)j,   heights[(i+1)*width + j],   (float)i+1 };
+				float e[3] = { (float)j+1, heights[(i+1)*width + j+1], (float)i+1 };
+
+				float t;
+				if( IntersectRayTriangle(o, d, a, b, c, t) && t < tBest )
+				{
+					tBest = t;
+					found = true;
+				}
+				if( IntersectRayTriangle(o, d, e, c, b, t) && t < tBest )
+				{
+					tBest = t;
+					found = true;
+				}
+			}
+		}
+
+		return found;
+	}
+
+	// Inward facing planes of a perspective frustum looking from eye toward target,
+	// in the form ExtractFrustumPlanes gives.
+	void BuildFrustumPlanes(const float eye[3], const float target[3], float fovY, float aspect,
+		float zn, float zf, XMFLOAT4 planes[6])
+	{
+		float f[3] = { target[0]-eye[0], target[1]-eye[1], target[2]-eye[2] };
+		float len = sqrtf(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+		f[0] /= len; f[1] /= len; f[2] /= len;
+
+		// right = worldUp x forward, up = forward x right
+		float r[3] = { f[2], 0.0f, -f[0] };
+		len = sqrtf(r[0]*r[0] + r[2]*r[2]);
+		r[0] /= len; r[2] /= len;
+		float u[3] = { f[1]*r[2] - f[2]*r[1], f[2]*r[0] - f[0]*r[2], f[0]*r[1] - f[1]*r[0] };
+
+		float halfY = 0.5f*fovY;
+		float halfX = atanf(aspect*tanf(halfY));
+
+		float n[6][3];
+		for(int k = 0; k < 3; ++k)
+		{
+			n[0][k] =  r[k]*cosf(halfX) + f[k]*sinf(halfX); // left
+			n[1][k] = -r[k]*cosf(halfX) + f[k]*sinf(halfX); // right
+			n[2][k] =  u[k]*cosf(halfY) + f[k]*sinf(halfY); // bottom
+			n[3][k] = -u[k]*cosf(halfY) + f[k]*sinf(halfY); // top
+			n[4][k] =  f[k];                                // near
+			n[5][k] = -f[k];                                // far
+		}
+
+		for(int p = 0; p < 6; ++p)
+		{
+			float dot = n[p][0]*eye[0] + n[p][1]*eye[1] + n[p][2]*eye[2];
+			planes[p] = XMFLOAT4(n[p][0], n[p][1], n[p][2], -dot);
+		}
+		planes[4].w -= zn;
+		planes[5].w += zf;
+	}
+
+	void TestCompressedHeightmap()
+	{
+		printf("compressed\n");
+
+		const unsigned width  = 301;
+		const unsigned height = 257;
+		std::vector<float> heights;
+		MakeHeights(width, height, heights);
+
+		CompressedHeightmap heightmap;
+		heightmap.Build(&heights[0], width, height, PatchCells);
+		Check(heightmap.GetTileRows() == (height-2)/PatchCells + 1 &&
+			heightmap.GetTileCols() == (width-2)/PatchCells + 1, "tile grid size");
+
+		std::vector<float> decoded(width*height);
+		heightmap.Decode(&decoded[0]);
+
+		// Every texel is within the quantization step of its tile, and each cell's
+		// corners agree with the decoded map and lie within its tile's bounds.
+		bool quantizeOk = true;
+		bool cellsOk    = true;
+		bool boundsOk   = true;
+		for(unsigned i = 0; i < height; ++i)
+		{
+			for(unsigned j = 0; j < width; ++j)
+			{
+				unsigned tileRow = std::min(i / PatchCells, heightmap.GetTileRows()-1);
+				unsigned tileCol = std::min(j / PatchCells, heightmap.GetTileCols()-1);
+				const XMFLOAT2& b = heightmap.GetTileBoundsY(tileRow, tileCol);
+
+				float maxError = (b.y - b.x)/131070.0f + 1e-5f*std::max(1.0f, fabsf(heights[i*width + j]));
+				if( fabsf(decoded[i*width + j] - heights[i*width + j]) > maxError )
+					quantizeOk = false;
+
+				if( heightmap.GetTexel(i, j) != decoded[i*width + j] )
+					cellsOk = false;
+
+				if( i+1 == height || j+1 == width )
+					continue;
+
+				float corners[4];
+				heightmap.GetCell(i, j, corners);
+				if( corners[0] != decoded[i*width + j]     || corners[1] != decoded[i*width + j+1] ||
+					corners[2] != decoded[(i+1)*width + j] || corners[3] != decoded[(i+1)*width + j+1] )
+				{
+					cellsOk = false;
+				}
+
+				for(int k = 0; k < 4; ++k)
+				{
+					if( corners[k] < b.x || corners[k] > b.y )
+						boundsOk = false;
+				}
+			}
+		}
+		Check(quantizeOk, "quantization error within (max - min) / 131070");
+		Check(cellsOk, "GetCell and GetTexel match Decode");
+		Check(boundsOk, "tile bounds contain their cells");
+
+		// Both file formats read back the exact samples that were written.
+		for(int entropyCode = 0; entropyCode < 2; ++entropyCode)
+		{
+			Check(heightmap.Write(L"TerrainTests.hmap", entropyCode != 0), "Write");
+
+			CompressedHeightmap read;
+			Check(read.Read(L"TerrainTests.hmap"), "Read");
+
+			std::vector<float> readHeights(width*height);
+			if( read.GetWidth() == width && read.GetHeight() == height )
+				read.Decode(&readHeights[0]);
+			Check(readHeights == decoded, entropyCode ? "entropy coded file round trip" : "raw file round trip");
+		}
+
+		// A truncated file is rejected.
+		std::vector<char> bytes;
+		{
+			std::ifstream fin("TerrainTests.hmap", std::ios_base::binary);
+			bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		}
+		{
+			std::ofstream fout("TerrainTests.hmap", std::ios_base::binary);
+			fout.write(&bytes[0], (std::streamsize)(bytes.size()/2));
+		}
+		CompressedHeightmap truncated;
+		Check(!truncated.Read(L"TerrainTests.hmap"), "truncated file rejected");
+
+		std::remove("TerrainTests.hmap");
+	}
+
+	void TestHeightmapPyramid()
+	{
+		printf("pyramid\n");
+
+		const unsigned width  = 301;
+		const unsigned height = 257;
+		std::vector<float> heights;
+		MakeHeights(width, height, heights);
+
+		CompressedHeightmap heightmap;
+		heightmap.Build(&heights[0], width, height, PatchCells);
+		heightmap.Decode(&heights[0]);
+
+		std::vector<XMFLOAT2> tileBounds;
+		GetTileBounds(heightmap, tileBounds);
+
+		HeightmapPyramid pyramid;
+		pyramid.Build(&tileBounds[0], height-1, width-1, PatchCells);
+
+		// A 4x5 tile grid needs 4 levels of a few entries each.
+		Check(pyramid.GetNumLevels() == 4, "level count");
+		Check(pyramid.GetResidentBytes() < 1024, "pyramid stays per patch");
+
+		// Random rays from above the map, including axis aligned ones, compared
+		// against the nearest hit over every cell.
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		int numHits       = 0;
+		int numMismatches = 0;
+		for(int r = 0; r < 300; ++r)
+		{
+			float o[3] = { -50.0f + 400.0f*unit(rng), 30.0f + 20.0f*unit(rng), -50.0f + 360.0f*unit(rng) };
+			float target[3] = { width*unit(rng), -25.0f + 30.0f*unit(rng), height*unit(rng) };
+			float d[3] = { target[0]-o[0], target[1]-o[1], target[2]-o[2] };
+			if( r % 7 == 0 )
+				d[0] = 0.0f;
+			if( r % 11 == 0 )
+				d[2] = 0.0f;
+
+			float tBrute;
+			bool bruteHit = IntersectRayBruteForce(heights, width, height, o, d, tBrute);
+
+			float t;
+			XMFLOAT3 normal;
+			bool hit = pyramid.IntersectRay(heightmap, XMFLOAT3(o[0], o[1], o[2]), XMFLOAT3(d[0], d[1], d[2]),
+				FLT_MAX, t, normal);
+
+			if( bruteHit )
+				numHits++;
+
+			if( hit != bruteHit || (hit && fabsf(t - tBrute) > 1e-4f*std::max(1.0f, tBrute)) )
+				numMismatches++;
+		}
+		printf("    %d of 300 rays hit\n", numHits);
+		Check(numHits > 0, "some rays hit");
+		Check(numMismatches == 0, "ray casts match brute force");
+
+		// A ray starting past tMax from the surface misses.
+		float t;
+		XMFLOAT3 normal;
+		Check(!pyramid.IntersectRay(heightmap, XMFLOAT3(150.0f, 100.0f, 128.0f), XMFLOAT3(0.0f, -1.0f, 0.0f),
+			10.0f, t, normal), "tMax respected");
+	}
+
+	void TestPagedHeightmap()
+	{
+		printf("paged\n");
+
+		const unsigned width  = 301;
+		const unsigned height = 257;
+		std::vector<float> heights;
+		MakeHeights(width, height, heights);
+
+		std::vector<unsigned> blend(width*height);
+		for(unsigned k = 0; k < width*height; ++k)
+			blend[k] = k;
+
+		Check(PagedHeightmap::WriteTiles(L"TerrainTests.tiles", &heights[0], &blend[0], width, height, PatchCells),
+			"WriteTiles");
+
+		// A budget of six tiles, so moving the center has to evict.
+		const size_t tileBytes = (PatchCells+3)*(PatchCells+3)*(sizeof(float) + sizeof(unsigned));
+
+		PagedHeightmap paged;
+		Check(paged.Open(L"TerrainTests.tiles", 1.0f, 6*tileBytes), "Open");
+		if( !paged.IsOpen() )
+			return;
+
+		Check(paged.GetTileRows() == (height-2)/PatchCells + 1 &&
+			paged.GetTileCols() == (width-2)/PatchCells + 1, "tile grid size");
+		Check(paged.GetMaxResidentTiles() == 6, "slots fit the budget");
+
+		// The errors stored with the tiles are the ones the selector computes.
+		std::vector<float> errors(TerrainLodSelector::GetNumLods(PatchCells));
+		TerrainLodSelector::ComputePatchErrors(&heights[PatchCells*width + PatchCells], width, PatchCells, &errors[0]);
+		Check(std::equal(errors.begin(), errors.end(), paged.GetTileErrors(1, 1)), "tile errors");
+
+		const float centers[3][2] = { { -100.0f, 90.0f }, { 0.0f, 0.0f }, { 120.0f, -100.0f } };
+		for(int c = 0; c < 3; ++c)
+		{
+			float x = centers[c][0];
+			float z = centers[c][1];
+
+			unsigned centerRow = std::min((unsigned)(0.5f*paged.GetDepth() - z) / PatchCells, paged.GetTileRows()-1);
+			unsigned centerCol = std::min((unsigned)(x + 0.5f*paged.GetWidth()) / PatchCells, paged.GetTileCols()-1);
+
+			// Give the loader thread time to read the requested tiles.
+			for(int frame = 0; frame < 400 && !paged.IsTileResident(centerRow, centerCol); ++frame)
+			{
+				paged.UpdateResidency(x, z, 100.0f);
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+			for(int frame = 0; frame < 20; ++frame)
+			{
+				paged.UpdateResidency(x, z, 100.0f);
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+			Check(paged.IsTileResident(centerRow, centerCol), "tile under the center is resident");
+
+			// Resident tiles have distinct slots within the budget and the same
+			// texels as the full maps.
+			std::vector<int> slotUsed(paged.GetMaxResidentTiles(), 0);
+			unsigned numResident = 0;
+			bool slotsOk  = true;
+			bool texelsOk = true;
+			for(unsigned tileRow = 0; tileRow < paged.GetTileRows(); ++tileRow)
+			{
+				for(unsigned tileCol = 0; tileCol < paged.GetTileCols(); ++tileCol)
+				{
+					if( !paged.IsTileResident(tileRow, tileCol) )
+					{
+						if( paged.GetTileSlot(tileRow, tileCol) != -1 )
+							slotsOk = false;
+						continue;
+					}
+
+					numResident++;
+					int slot = paged.GetTileSlot(tileRow, tileCol);
+					if( slot < 0 || slot >= (int)slotUsed.size() || slotUsed[slot]++ )
+						slotsOk = false;
+
+					unsigned row1 = tileRow+1 == paged.GetTileRows() ? height-1 : (tileRow+1)*PatchCells;
+					unsigned col1 = tileCol+1 == paged.GetTileCols() ? width-1 : (tileCol+1)*PatchCells;
+					const unsigned* tileBlend = paged.GetTileBlend(tileRow, tileCol);
+					unsigned side = paged.GetTileSide();
+
+					for(unsigned i = tileRow*PatchCells; i < row1; ++i)
+					{
+						for(unsigned j = tileCol*PatchCells; j < col1; ++j)
+						{
+							float corners[4];
+							paged.GetCell(i, j, corners);
+							if( corners[0] != heights[i*width + j]     || corners[1] != heights[i*width + j+1] ||
+								corners[2] != heights[(i+1)*width + j] || corners[3] != heights[(i+1)*width + j+1] )
+							{
+								texelsOk = false;
+							}
+
+							unsigned ti = i - tileRow*PatchCells + 1;
+							unsigned tj = j - tileCol*PatchCells + 1;
+							if( tileBlend[ti*side + tj] != blend[i*width + j] )
+								texelsOk = false;
+						}
+					}
+				}
+			}
+			Check(numResident <= paged.GetMaxResidentTiles(), "resident tiles within the budget");
+			Check(slotsOk, "slots distinct and in range");
+			Check(texelsOk, "resident tiles match the full maps");
+		}
+
+		paged.Close();
+
+		// A header with no tile rows is rejected.
+		{
+			std::fstream file("TerrainTests.tiles", std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			file.seekp(5*sizeof(unsigned));
+			unsigned zero = 0;
+			file.write((const char*)&zero, sizeof(zero));
+		}
+		PagedHeightmap corrupt;
+		Check(!corrupt.Open(L"TerrainTests.tiles", 1.0f, 6*tileBytes), "corrupt header rejected");
+
+		std::remove("TerrainTests.tiles");
+	}
+
+	void TestLodSelector()
+	{
+		printf("lod\n");
+
+		const unsigned width  = 513;
+		const unsigned height = 513;
+		const float cellSpacing = 2.0f;
+
+		for(int flat = 0; flat < 2; ++flat)
+		{
+			std::vector<float> heights;
+			MakeHeights(width, height, heights);
+			if( flat )
+				std::fill(heights.begin(), heights.end(), 5.0f);
+
+			CompressedHeightmap heightmap;
+			heightmap.Build(&heights[0], width, height, PatchCells);
+
+			std::vector<XMFLOAT2> tileBounds;
+			GetTileBounds(heightmap, tileBounds);
+
+			HeightmapPyramid pyramid;
+			pyramid.Build(&tileBounds[0], height-1, width-1, PatchCells);
+
+			const unsigned patchRows = (height-1) / PatchCells;
+			const unsigned patchCols = (width-1) / PatchCells;
+			const unsigned numLods   = TerrainLodSelector::GetNumLods(PatchCells);
+
+			std::vector<float> errors(patchRows*patchCols*numLods);
+			for(unsigned i = 0; i < patchRows; ++i)
+			{
+				for(unsigned j = 0; j < patchCols; ++j)
+				{
+					TerrainLodSelector::ComputePatchErrors(&heights[i*PatchCells*width + j*PatchCells], width,
+						PatchCells, &errors[(i*patchCols + j)*numLods]);
+				}
+			}
+
+			TerrainLodSelector selector;
+			selector.Init(&pyramid, cellSpacing, &errors[0]);
+			Check(selector.GetPatchRows() == patchRows && selector.GetPatchCols() == patchCols, "patch grid size");
+
+			float eye[3]    = { -300.0f, 60.0f, 200.0f };
+			float target[3] = { 100.0f, 0.0f, -50.0f };
+			XMFLOAT4 planes[6];
+			BuildFrustumPlanes(eye, target, 0.25f*3.1415926535f, 800.0f/600.0f, 1.0f, 1000.0f, planes);
+
+			TerrainLodSelector::Settings settings;
+			std::vector<TerrainPatchLod> patches;
+			selector.Select(XMFLOAT3(eye[0], eye[1], eye[2]), planes, settings, patches);
+
+			// The patches not outside any plane, testing each patch's own box.
+			float halfWidth = 0.5f*(width-1)*cellSpacing;
+			float halfDepth = 0.5f*(height-1)*cellSpacing;
+			float extent    = 0.5f*PatchCells*cellSpacing;
+
+			std::vector<char> expected(patchRows*patchCols, 0);
+			for(unsigned i = 0; i < patchRows; ++i)
+			{
+				for(unsigned j = 0; j < patchCols; ++j)
+				{
+					const XMFLOAT2& b = heightmap.GetTileBoundsY(i, j);
+					float center[3]  = { -halfWidth + (j + 0.5f)*PatchCells*cellSpacing, 0.5f*(b.x + b.y),
+						halfDepth - (i + 0.5f)*PatchCells*cellSpacing };
+					float extents[3] = { extent, 0.5f*(b.y - b.x), extent };
+
+					bool outside = false;
+					for(int p = 0; p < 6; ++p)
+					{
+						float r = extents[0]*fabsf(planes[p].x) + extents[1]*fabsf(planes[p].y) + extents[2]*fabsf(planes[p].z);
+						float s = center[0]*planes[p].x + center[1]*planes[p].y + center[2]*planes[p].z + planes[p].w;
+						if( s + r < 0.0f )
+							outside = true;
+					}
+					expected[i*patchCols + j] = !outside;
+				}
+			}
+
+			std::vector<char> selected(patchRows*patchCols, 0);
+			std::vector<const TerrainPatchLod*> byId(patchRows*patchCols, (const TerrainPatchLod*)0);
+			bool lodsOk = true;
+			for(size_t p = 0; p < patches.size(); ++p)
+			{
+				const TerrainPatchLod& patch = patches[p];
+				if( patch.PatchId >= selected.size() || selected[patch.PatchId] )
+				{
+					lodsOk = false;
+					continue;
+				}
+				selected[patch.PatchId] = 1;
+				byId[patch.PatchId] = &patch;
+
+				if( patch.Lod >= numLods || patch.InsideTess != (float)(1u << patch.Lod) )
+					lodsOk = false;
+				for(int e = 0; e < 4; ++e)
+				{
+					if( patch.EdgeTess[e] < patch.InsideTess )
+						lodsOk = false;
+				}
+				if( flat && patch.Lod != 0 )
+					lodsOk = false;
+			}
+			printf("    %s: %u of %u patches visible\n", flat ? "flat" : "hills", (unsigned)patches.size(), patchRows*patchCols);
+			Check(!patches.empty() && patches.size() < expected.size(), "frustum sees part of the map");
+			Check(selected == expected, "culling matches per-patch box test");
+			Check(lodsOk, flat ? "flat terrain uses LOD 0" : "LODs and factors consistent");
+
+			// Visible neighbors use the same factor on their shared edge.
+			bool edgesOk = true;
+			for(unsigned i = 0; i < patchRows; ++i)
+			{
+				for(unsigned j = 0; j < patchCols; ++j)
+				{
+					const TerrainPatchLod* patch = byId[i*patchCols + j];
+					if( !patch )
+						continue;
+
+					const TerrainPatchLod* right = j+1 < patchCols ? byId[i*patchCols + j+1] : 0;
+					const TerrainPatchLod* below = i+1 < patchRows ? byId[(i+1)*patchCols + j] : 0;
+					if( right && patch->EdgeTess[2] != right->EdgeTess[0] )
+						edgesOk = false;
+					if( below && patch->EdgeTess[3] != below->EdgeTess[1] )
+						edgesOk = false;
+				}
+			}
+			Check(edgesOk, "shared edges match");
+		}
+	}
+
+	// Errors of every whole patch of a width x height map, from its decoded heights.
+	void ComputeAllPatchErrors(const CompressedHeightmap& heightmap, std::vector<float>& errors)
+	{
+		const unsigned width     = heightmap.GetWidth();
+		const unsigned patchRows = (heightmap.GetHeight()-1) / PatchCells;
+		const unsigned patchCols = (width-1) / PatchCells;
+		const unsigned numLods   = TerrainLodSelector::GetNumLods(PatchCells);
+
+		std::vector<float> heights(width*heightmap.GetHeight());
+		heightmap.Decode(&heights[0]);
+
+		errors.resize(patchRows*patchCols*numLods);
+		for(unsigned i = 0; i < patchRows; ++i)
+		{
+			for(unsigned j = 0; j < patchCols; ++j)
+			{
+				TerrainLodSelector::ComputePatchErrors(&heights[i*PatchCells*width + j*PatchCells], width,
+					PatchCells, &errors[(i*patchCols + j)*numLods]);
+			}
+		}
+	}
+
+	bool SamePatchLods(const std::vector<TerrainPatchLod>& a, const std::vector<TerrainPatchLod>& b)
+	{
+		if( a.size() != b.size() )
+			return false;
+
+		for(size_t p = 0; p < a.size(); ++p)
+		{
+			if( a[p].PatchId != b[p].PatchId || a[p].Lod != b[p].Lod || a[p].InsideTess != b[p].InsideTess ||
+				!std::equal(a[p].EdgeTess, a[p].EdgeTess + 4, b[p].EdgeTess) )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void TestHeightUpdate()
+	{
+		printf("update\n");
+
+		// Partial tiles on the far borders, and one partial patch row and column.
+		const unsigned width  = 451;
+		const unsigned height = 389;
+		std::vector<float> heights;
+		MakeHeights(width, height, heights);
+
+		CompressedHeightmap heightmap;
+		heightmap.Build(&heights[0], width, height, PatchCells);
+
+		std::vector<XMFLOAT2> tileBounds;
+		GetTileBounds(heightmap, tileBounds);
+
+		HeightmapPyramid pyramid;
+		pyramid.Build(&tileBounds[0], height-1, width-1, PatchCells);
+
+		std::vector<float> errors;
+		ComputeAllPatchErrors(heightmap, errors);
+
+		TerrainLodSelector selector;
+		selector.Init(&pyramid, 1.0f, &errors[0]);
+
+		const unsigned numLods = TerrainLodSelector::GetNumLods(PatchCells);
+		const unsigned side    = PatchCells+1;
+
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		bool untouchedOk = true;
+		bool heightsOk   = true;
+		bool boundsOk    = true;
+		bool pyramidOk   = true;
+		bool errorsOk    = true;
+		bool selectOk    = true;
+		unsigned numChangedTiles = 0;
+		float maxTileRange = 0.0f;
+
+		const int numEdits = 12;
+		for(int edit = 0; edit < numEdits; ++edit)
+		{
+			// Mounds of random size anywhere, including over the borders and the 
+			// last row and column.
+			unsigned numRows = 1 + (unsigned)(unit(rng)*100.0f);
+			unsigned numCols = 1 + (unsigned)(unit(rng)*100.0f);
+			unsigned row0 = std::min((unsigned)(unit(rng)*height), height-1);
+			unsigned col0 = std::min((unsigned)(unit(rng)*width), width-1);
+			if( edit == 0 )
+			{
+				row0 = height - numRows/2 - 1;
+				col0 = width - numCols/2 - 1;
+			}
+			numRows = std::min(numRows, height - row0);
+			numCols = std::min(numCols, width - col0);
+
+			float peak = -30.0f + 60.0f*unit(rng);
+			std::vector<float> mound(numRows*numCols);
+			for(unsigned i = 0; i < numRows; ++i)
+			{
+				for(unsigned j = 0; j < numCols; ++j)
+				{
+					float y = 2.0f*(i + 0.5f)/numRows - 1.0f;
+					float x = 2.0f*(j + 0.5f)/numCols - 1.0f;
+					float h = heights[(row0 + i)*width + col0 + j] + peak*std::max(0.0f, 1.0f - x*x - y*y);
+
+					mound[i*numCols + j] = h;
+					heights[(row0 + i)*width + col0 + j] = h;
+				}
+			}
+
+			std::vector<float> before(width*height);
+			heightmap.Decode(&before[0]);
+
+			// The same steps as Terrain::SetHeights.
+			unsigned tileRow0, tileCol0, tileRow1, tileCol1;
+			heightmap.Update(&mound[0], row0, col0, numRows, numCols, tileRow0, tileCol0, tileRow1, tileCol1);
+			numChangedTiles += (tileRow1 - tileRow0)*(tileCol1 - tileCol0);
+
+			unsigned numTileCols = tileCol1 - tileCol0;
+			std::vector<XMFLOAT2> changedBounds((tileRow1 - tileRow0)*numTileCols);
+			std::vector<float> changedErrors(changedBounds.size()*numLods);
+			std::vector<float> patch(side*side);
+			for(unsigned i = tileRow0; i < tileRow1; ++i)
+			{
+				for(unsigned j = tileCol0; j < tileCol1; ++j)
+				{
+					unsigned k = (i - tileRow0)*numTileCols + j - tileCol0;
+					changedBounds[k] = heightmap.GetTileBoundsY(i, j);
+
+					if( (i+1)*PatchCells >= height || (j+1)*PatchCells >= width )
+						continue;
+
+					for(unsigned r = 0; r < side; ++r)
+					{
+						for(unsigned c = 0; c < side; ++c)
+							patch[r*side + c] = heightmap.GetTexel(i*PatchCells + r, j*PatchCells + c);
+					}
+					TerrainLodSelector::ComputePatchErrors(&patch[0], side, PatchCells, &changedErrors[k*numLods]);
+				}
+			}
+			pyramid.Update(&changedBounds[0], tileRow0, tileCol0, tileRow1, tileCol1);
+			selector.UpdatePatchErrors(&changedErrors[0], tileRow0, tileCol0, tileRow1, tileCol1);
+
+			// Texels outside the changed tiles keep their exact decoded heights.  The
+			// rest follow the edited heights within half a step for Build and for
+			// each edit so far, which quantize them again.
+			for(size_t k = 0; k < tileBounds.size(); ++k)
+				maxTileRange = std::max(maxTileRange, tileBounds[k].y - tileBounds[k].x);
+			for(unsigned i = tileRow0; i < tileRow1; ++i)
+			{
+				for(unsigned j = tileCol0; j < tileCol1; ++j)
+				{
+					const XMFLOAT2& b = heightmap.GetTileBoundsY(i, j);
+					maxTileRange = std::max(maxTileRange, b.y - b.x);
+				}
+			}
+
+			std::vector<float> decoded(width*height);
+			heightmap.Decode(&decoded[0]);
+			for(unsigned i = 0; i < height; ++i)
+			{
+				for(unsigned j = 0; j < width; ++j)
+				{
+					unsigned tileRow = std::min(i / PatchCells, heightmap.GetTileRows()-1);
+					unsigned tileCol = std::min(j / PatchCells, heightmap.GetTileCols()-1);
+					bool changed = tileRow >= tileRow0 && tileRow < tileRow1 && tileCol >= tileCol0 && tileCol < tileCol1;
+
+					if( !changed && decoded[i*width + j] != before[i*width + j] )
+						untouchedOk = false;
+
+					float maxError = (edit+2)*maxTileRange/131070.0f + 1e-5f*std::max(1.0f, fabsf(heights[i*width + j]));
+					if( fabsf(decoded[i*width + j] - heights[i*width + j]) > maxError )
+						heightsOk = false;
+				}
+			}
+
+			// Tile bounds are exactly the range of their cells' corners.
+			for(unsigned ti = 0; ti < heightmap.GetTileRows(); ++ti)
+			{
+				for(unsigned tj = 0; tj < heightmap.GetTileCols(); ++tj)
+				{
+					float minY = +FLT_MAX;
+					float maxY = -FLT_MAX;
+					for(unsigned i = ti*PatchCells; i < std::min((ti+1)*PatchCells, height-1); ++i)
+					{
+						for(unsigned j = tj*PatchCells; j < std::min((tj+1)*PatchCells, width-1); ++j)
+						{
+							float corners[4];
+							heightmap.GetCell(i, j, corners);
+							minY = std::min(minY, *std::min_element(corners, corners + 4));
+							maxY = std::max(maxY, *std::max_element(corners, corners + 4));
+						}
+					}
+
+					const XMFLOAT2& b = heightmap.GetTileBoundsY(ti, tj);
+					if( b.x != minY || b.y != maxY )
+						boundsOk = false;
+				}
+			}
+
+			// The pyramid and the selector match ones rebuilt from scratch.
+			GetTileBounds(heightmap, tileBounds);
+			HeightmapPyramid rebuilt;
+			rebuilt.Build(&tileBounds[0], height-1, width-1, PatchCells);
+			for(unsigned level = 0; level < rebuilt.GetNumLevels(); ++level)
+			{
+				for(unsigned i = 0; i < rebuilt.GetLevelRows(level); ++i)
+				{
+					for(unsigned j = 0; j < rebuilt.GetLevelCols(level); ++j)
+					{
+						const XMFLOAT2& a = pyramid.GetBounds(level, i, j);
+						const XMFLOAT2& b = rebuilt.GetBounds(level, i, j);
+						if( a.x != b.x || a.y != b.y )
+							pyramidOk = false;
+					}
+				}
+			}
+
+			ComputeAllPatchErrors(heightmap, errors);
+			TerrainLodSelector rebuiltSelector;
+			rebuiltSelector.Init(&rebuilt, 1.0f, &errors[0]);
+
+			for(unsigned i = 0; i < selector.GetPatchRows(); ++i)
+			{
+				for(unsigned j = 0; j < selector.GetPatchCols(); ++j)
+				{
+					if( !std::equal(selector.GetPatchErrors(i, j), selector.GetPatchErrors(i, j) + numLods, 
+						rebuiltSelector.GetPatchErrors(i, j)) )
+					{
+						errorsOk = false;
+					}
+				}
+			}
+
+			for(int view = 0; view < 4; ++view)
+			{
+				float eye[3]    = { -250.0f + 500.0f*unit(rng), 5.0f + 60.0f*unit(rng), -220.0f + 440.0f*unit(rng) };
+				float target[3] = { -100.0f + 200.0f*unit(rng), 0.0f, -100.0f + 200.0f*unit(rng) };
+				XMFLOAT4 planes[6];
+				BuildFrustumPlanes(eye, target, 0.25f*3.1415926535f, 800.0f/600.0f, 1.0f, 1000.0f, planes);
+
+				TerrainLodSelector::Settings settings;
+				settings.PixelTolerance = 0.5f;
+
+				std::vector<TerrainPatchLod> a, b;
+				selector.Select(XMFLOAT3(eye[0], eye[1], eye[2]), planes, settings, a);
+				rebuiltSelector.Select(XMFLOAT3(eye[0], eye[1], eye[2]), planes, settings, b);
+				if( !SamePatchLods(a, b) )
+					selectOk = false;
+			}
+		}
+
+		printf("    %d edits refreshed %u tiles of %u\n", numEdits, numChangedTiles, 
+			numEdits*heightmap.GetTileRows()*heightmap.GetTileCols());
+		Check(untouchedOk, "tiles outside the edits unchanged");
+		Check(heightsOk, "updated heights follow the edits");
+		Check(boundsOk, "updated tile bounds are tight");
+		Check(pyramidOk, "updated pyramid matches a full rebuild");
+		Check(errorsOk, "updated patch errors match a full rebuild");
+		Check(selectOk, "updated selector picks the same LODs");
+	}
+}
+
+int main()
+{
+	TestCompressedHeightmap();
+	TestHeightmapPyramid();
+	TestPagedHeightmap();
+	TestLodSelector();
+	TestHeightUpdate();
+
+	if( gNumFailed > 0 )
+	{
+		printf("%d checks failed\n", gNumFailed);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,246 @@
+//***************************************************************************************
+// AmbientOcclusionBaker.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "AmbientOcclusionBaker.h"
+#include "Octree.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Integer hash used to derive a per-triangle random rotation from the seed.
+	unsigned HashUint(unsigned x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	float ToUnitFloat(unsigned x)
+	{
+		return (x >> 8) * (1.0f / 16777216.0f);
+	}
+}
+
+AmbientOcclusionBaker::Settings::Settings()
+	: SamplesPerPass(16),
+	MinSamples(32),
+	MaxSamples(256),
+	MaxStandardError(0.02f),
+	MaxOcclusionDist(FLT_MAX),
+	SurfaceOffset(0.001f),
+	Seed(0)
+{
+}
+
+AmbientOcclusionBaker::AmbientOcclusionBaker()
+	: mRayCount(0)
+{
+}
+
+AmbientOcclusionBaker::~AmbientOcclusionBaker()
+{
+}
+
+void AmbientOcclusionBaker::Bake(const std::vector<XMFLOAT3>& positions, const std::vector<unsigned>& indices,
+								 const Octree& octree, const Settings& settings)
+{
+	mSettings = settings;
+	mSettings.SamplesPerPass = std::max(mSettings.SamplesPerPass, 1u);
+
+	InitTriangles(positions, indices);
+
+	// Triangles that still need samples.
+	std::vector<unsigned> active;
+	active.reserve(mTriangles.size());
+	for(unsigned i = 0; i < mTriangles.size(); ++i)
+	{
+		if( !mTriangles[i].Converged )
+			active.push_back(i);
+	}
+
+	// Progressive passes: every pass adds a few more samples to each unconverged
+	// triangle, so easy (fully open or fully closed) triangles drop out early and
+	// the remaining passes only work on the noisy ones.
+	while( !active.empty() )
+	{
+		ParallelFor::Run(active.size(), 64, [&](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				TriangleState& tri = mTriangles[active[i]];
+
+				unsigned numSamples = std::min(mSettings.SamplesPerPass, mSettings.MaxSamples - tri.NumSamples);
+				SampleTriangle(tri, octree, numSamples);
+
+				tri.Converged = IsConverged(tri);
+			}
+		});
+
+		unsigned numActive = 0;
+		for(unsigned i = 0; i < active.size(); ++i)
+		{
+			if( !mTriangles[active[i]].Converged )
+				active[numActive++] = active[i];
+		}
+		active.resize(numActive);
+	}
+
+	//
+	// Average the triangle estimates onto the vertices that share them.
+	//
+
+	unsigned vcount = positions.size();
+	unsigned tcount = indices.size()/3;
+
+	mVertexAmbientAccess.assign(vcount, 0.0f);
+	std::vector<int> vertexSharedCount(vcount, 0);
+
+	mRayCount = 0;
+	for(unsigned i = 0; i < tcount; ++i)
+	{
+		const TriangleState& tri = mTriangles[i];
+		mRayCount += tri.NumSamples;
+
+		// Degenerate triangles were never sampled; treat them as unoccluded.
+		float ambientAccess = tri.NumSamples > 0 ?
+			(float)tri.NumUnoccluded / tri.NumSamples : 1.0f;
+
+		for(unsigned k = 0; k < 3; ++k)
+		{
+			unsigned v = indices[i*3+k];
+			mVertexAmbientAccess[v] += ambientAccess;
+			vertexSharedCount[v]++;
+		}
+	}
+
+	// Finish average by dividing by the number of samples we added.
+	for(unsigned i = 0; i < vcount; ++i)
+	{
+		if( vertexSharedCount[i] > 0 )
+			mVertexAmbientAccess[i] /= vertexSharedCount[i];
+		else
+			mVertexAmbientAccess[i] = 1.0f;
+	}
+}
+
+const std::vector<float>& AmbientOcclusionBaker::GetVertexAmbientAccess()const
+{
+	return mVertexAmbientAccess;
+}
+
+unsigned long long AmbientOcclusionBaker::GetRayCount()const
+{
+	return mRayCount;
+}
+
+void AmbientOcclusionBaker::InitTriangles(const std::vector<XMFLOAT3>& positions, const std::vector<unsigned>& indices)
+{
+	unsigned tcount = indices.size()/3;
+	mTriangles.resize(tcount);
+
+	for(unsigned i = 0; i < tcount; ++i)
+	{
+		TriangleState& tri = mTriangles[i];
+
+		XMVECTOR v0 = XMLoadFloat3(&positions[indices[i*3+0]]);
+		XMVECTOR v1 = XMLoadFloat3(&positions[indices[i*3+1]]);
+		XMVECTOR v2 = XMLoadFloat3(&positions[indices[i*3+2]]);
+
+		XMVECTOR edge0 = v1 - v0;
+		XMVECTOR edge1 = v2 - v0;
+		XMVECTOR cross = XMVector3Cross(edge0, edge1);
+
+		tri.NumSamples    = 0;
+		tri.NumUnoccluded = 0;
+
+		// Skip triangles with no area; they have no well defined normal.
+		tri.Converged = XMVectorGetX(XMVector3LengthSq(cross)) <= 1e-20f;
+		if( tri.Converged )
+			continue;
+
+		XMVECTOR normal = XMVector3Normalize(cross);
+
+		// Build an orthonormal basis around the normal, starting from the world
+		// axis that is least parallel to it.
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal);
+		XMVECTOR axis = fabsf(n.x) < 0.6f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) :
+			(fabsf(n.y) < 0.6f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
+		XMVECTOR tangent   = XMVector3Normalize(XMVector3Cross(axis, normal));
+		XMVECTOR bitangent = XMVector3Cross(normal, tangent);
+
+		// Offset to avoid self intersection.
+		XMVECTOR centroid = (v0 + v1 + v2)/3.0f + mSettings.SurfaceOffset*normal;
+
+		XMStoreFloat3(&tri.Centroid, centroid);
+		XMStoreFloat3(&tri.Normal, normal);
+		XMStoreFloat3(&tri.Tangent, tangent);
+		XMStoreFloat3(&tri.Bitangent, bitangent);
+
+		unsigned h = HashUint(mSettings.Seed ^ HashUint(i));
+		tri.ShiftU = ToUnitFloat(h);
+		tri.ShiftV = ToUnitFloat(HashUint(h));
+	}
+}
+
+void AmbientOcclusionBaker::SampleTriangle(TriangleState& tri, const Octree& octree, unsigned numSamples)const
+{
+	// The R2 sequence is a 2D low-discrepancy sequence that can be extended one
+	// point at a time, so consecutive passes keep filling in the gaps left by
+	// earlier ones instead of clumping like independent random samples.
+	const double Alpha0 = 0.7548776662466927;
+	const double Alpha1 = 0.5698402909980532;
+
+	XMVECTOR centroid  = XMLoadFloat3(&tri.Centroid);
+	XMVECTOR normal    = XMLoadFloat3(&tri.Normal);
+	XMVECTOR tangent   = XMLoadFloat3(&tri.Tangent);
+	XMVECTOR bitangent = XMLoadFloat3(&tri.Bitangent);
+
+	for(unsigned j = 0; j < numSamples; ++j)
+	{
+		unsigned n = tri.NumSamples + j + 1;
+
+		double u = tri.ShiftU + n*Alpha0;
+		double v = tri.ShiftV + n*Alpha1;
+		u -= floor(u);
+		v -= floor(v);
+
+		// Map the unit square to a uniformly distributed direction on the
+		// hemisphere about the normal.
+		float cosTheta = (float)u;
+		float sinTheta = sqrtf(std::max(0.0f, 1.0f - cosTheta*cosTheta));
+		float phi      = 2.0f*XM_PI*(float)v;
+
+		XMVECTOR dir = (sinTheta*cosf(phi))*tangent + (sinTheta*sinf(phi))*bitangent + cosTheta*normal;
+
+		if( !octree.RayOctreeIntersect(centroid, dir, mSettings.MaxOcclusionDist) )
+			tri.NumUnoccluded++;
+	}
+
+	tri.NumSamples += numSamples;
+}
+
+bool AmbientOcclusionBaker::IsConverged(const TriangleState& tri)const
+{
+	if( tri.NumSamples >= mSettings.MaxSamples )
+		return true;
+
+	if( tri.NumSamples < mSettings.MinSamples )
+		return false;
+
+	// Each ray is a Bernoulli trial, so the standard error of the estimated
+	// unoccluded fraction p after n rays is sqrt(p(1-p)/n).
+	float p = (float)tri.NumUnoccluded / tri.NumSamples;
+	float variance = p*(1.0f - p) / tri.NumSamples;
+
+	return variance <= mSettings.MaxStandardError*mSettings.MaxStandardError;
+}
@@ -0,0 +1,96 @@
+//***************************************************************************************
+// AmbientOcclusionBaker.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Precomputes per-vertex ambient accessibility for a static mesh by casting
+// rays against an Octree.  Triangles are processed in parallel, and each
+// triangle is sampled progressively in passes until its estimate converges.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef AMBIENTOCCLUSIONBAKER_H
+#define AMBIENTOCCLUSIONBAKER_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+class Octree;
+
+class AmbientOcclusionBaker
+{
+public:
+	struct Settings
+	{
+		Settings();
+
+		// Each pass casts SamplesPerPass rays per unconverged triangle.  Zero is
+		// treated as one.
+		unsigned SamplesPerPass;
+
+		// A triangle is never stopped before MinSamples rays and always stopped
+		// after MaxSamples rays.
+		unsigned MinSamples;
+		unsigned MaxSamples;
+
+		// A triangle is converged once the standard error of its ambient access
+		// estimate drops below this value.
+		float MaxStandardError;
+
+		// Intersections farther than this do not count as occluding.
+		float MaxOcclusionDist;
+
+		// Ray origins are pushed off the surface along the normal by this amount
+		// to avoid self intersection.
+		float SurfaceOffset;
+
+		// Seeds the sample sequence.  The same seed gives the same result no
+		// matter how many threads are used.
+		unsigned Seed;
+	};
+
+public:
+	AmbientOcclusionBaker();
+	~AmbientOcclusionBaker();
+
+	void Bake(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<unsigned>& indices,
+		const Octree& octree, const Settings& settings);
+
+	// Ambient access in [0, 1] for each vertex; 1 means fully unoccluded.
+	const std::vector<float>& GetVertexAmbientAccess()const;
+
+	// Total number of rays cast by the last Bake.
+	unsigned long long GetRayCount()const;
+
+private:
+	struct TriangleState
+	{
+		DirectX::XMFLOAT3 Centroid;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT3 Tangent;
+		DirectX::XMFLOAT3 Bitangent;
+
+		// Rotation applied to the low-discrepancy sequence for this triangle so
+		// neighbouring triangles do not share sample directions.
+		float ShiftU;
+		float ShiftV;
+
+		unsigned NumSamples;
+		unsigned NumUnoccluded;
+		bool Converged;
+	};
+
+	void InitTriangles(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<unsigned>& indices);
+	void SampleTriangle(TriangleState& tri, const Octree& octree, unsigned numSamples)const;
+	bool IsConverged(const TriangleState& tri)const;
+
+private:
+	Settings mSettings;
+
+	std::vector<TriangleState> mTriangles;
+	std::vector<float> mVertexAmbientAccess;
+
+	unsigned long long mRayCount;
+};
+
+#endif // AMBIENTOCCLUSIONBAKER_H
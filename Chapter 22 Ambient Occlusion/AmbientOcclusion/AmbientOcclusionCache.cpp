@@ -0,0 +1,205 @@
+//***************************************************************************************
+// AmbientOcclusionCache.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "AmbientOcclusionCache.h"
+#include "Octree.h"
+#include "FilePath.h"
+#include <fstream>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned CacheMagic   = 0x31434F41; // "AOC1"
+
+	// Bump whenever the file layout, the octree build or the bake changes in a 
+	// way that makes old caches invalid.
+	const unsigned CacheVersion = 3;
+
+	// Sections start on 16 byte boundaries.
+	const unsigned long long SectionAlignment = 16;
+
+	unsigned long long AlignUp(unsigned long long x)
+	{
+		return (x + SectionAlignment - 1) & ~(SectionAlignment - 1);
+	}
+
+	// 64-bit FNV-1a.
+	unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for(size_t i = 0; i < size; ++i)
+		{
+			hash ^= p[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	unsigned long long HashValue(unsigned long long hash, const T& value)
+	{
+		return HashBytes(hash, &value, sizeof(T));
+	}
+
+	void WritePadding(std::ofstream& fout, unsigned long long offset)
+	{
+		static const char zeros[SectionAlignment] = {0};
+		unsigned long long padding = AlignUp(offset) - offset;
+		fout.write(zeros, (std::streamsize)padding);
+	}
+}
+
+AmbientOcclusionCache::AmbientOcclusionCache()
+	: mHeader(0)
+{
+}
+
+AmbientOcclusionCache::~AmbientOcclusionCache()
+{
+	Close();
+}
+
+unsigned long long AmbientOcclusionCache::ComputeMeshKey(const std::vector<XMFLOAT3>& positions, const std::vector<unsigned>& indices)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+
+	hash = HashValue(hash, CacheVersion);
+
+	hash = HashValue(hash, (unsigned)positions.size());
+	if( !positions.empty() )
+		hash = HashBytes(hash, &positions[0], sizeof(XMFLOAT3)*positions.size());
+
+	hash = HashValue(hash, (unsigned)indices.size());
+	if( !indices.empty() )
+		hash = HashBytes(hash, &indices[0], sizeof(unsigned)*indices.size());
+
+	return hash;
+}
+
+unsigned long long AmbientOcclusionCache::ComputeBakeKey(unsigned long long meshKey, const AmbientOcclusionBaker::Settings& settings)
+{
+	unsigned long long hash = meshKey;
+
+	// Hash the settings field by field so struct padding never affects the key.
+	hash = HashValue(hash, settings.SamplesPerPass);
+	hash = HashValue(hash, settings.MinSamples);
+	hash = HashValue(hash, settings.MaxSamples);
+	hash = HashValue(hash, settings.MaxStandardError);
+	hash = HashValue(hash, settings.MaxOcclusionDist);
+	hash = HashValue(hash, settings.SurfaceOffset);
+	hash = HashValue(hash, settings.Seed);
+
+	return hash;
+}
+
+bool AmbientOcclusionCache::Save(const std::wstring& filename, unsigned long long meshKey, unsigned long long bakeKey, unsigned triangleCount,
+								 const Octree& octree, const std::vector<float>& vertexAmbientAccess)
+{
+	std::vector<OctreePackedNode> nodes;
+	std::vector<unsigned> leafTriangles;
+	octree.Pack(nodes, leafTriangles);
+
+	FileHeader header;
+	header.Magic              = CacheMagic;
+	header.Version            = CacheVersion;
+	header.MeshKey            = meshKey;
+	header.BakeKey            = bakeKey;
+	header.VertexCount        = (unsigned)vertexAmbientAccess.size();
+	header.TriangleCount      = triangleCount;
+	header.NodeCount          = (unsigned)nodes.size();
+	header.LeafTriangleCount  = (unsigned)leafTriangles.size();
+	header.NodeOffset         = AlignUp(sizeof(FileHeader));
+	header.LeafTriangleOffset = AlignUp(header.NodeOffset + sizeof(OctreePackedNode)*nodes.size());
+	header.AmbientAccessOffset = AlignUp(header.LeafTriangleOffset + sizeof(unsigned)*leafTriangles.size());
+	header.FileSize           = header.AmbientAccessOffset + sizeof(float)*vertexAmbientAccess.size();
+
+	std::ofstream fout(NativePath(filename), std::ios_base::binary);
+	if(!fout)
+		return false;
+
+	fout.write((const char*)&header, sizeof(FileHeader));
+	WritePadding(fout, sizeof(FileHeader));
+
+	if( !nodes.empty() )
+		fout.write((const char*)&nodes[0], (std::streamsize)(sizeof(OctreePackedNode)*nodes.size()));
+	WritePadding(fout, header.NodeOffset + sizeof(OctreePackedNode)*nodes.size());
+
+	if( !leafTriangles.empty() )
+		fout.write((const char*)&leafTriangles[0], (std::streamsize)(sizeof(unsigned)*leafTriangles.size()));
+	WritePadding(fout, header.LeafTriangleOffset + sizeof(unsigned)*leafTriangles.size());
+
+	if( !vertexAmbientAccess.empty() )
+		fout.write((const char*)&vertexAmbientAccess[0], (std::streamsize)(sizeof(float)*vertexAmbientAccess.size()));
+
+	return fout.good();
+}
+
+bool AmbientOcclusionCache::Open(const std::wstring& filename, unsigned long long meshKey, unsigned vertexCount, unsigned triangleCount)
+{
+	Close();
+
+	if( !mFile.Open(filename) )
+		return false;
+
+	unsigned long long size = mFile.GetSize();
+	if( size < sizeof(FileHeader) )
+	{
+		Close();
+		return false;
+	}
+
+	const FileHeader* header = (const FileHeader*)mFile.GetData();
+
+	bool valid = 
+		header->Magic         == CacheMagic &&
+		header->Version       == CacheVersion &&
+		header->MeshKey       == meshKey &&
+		header->VertexCount   == vertexCount &&
+		header->TriangleCount == triangleCount &&
+		header->FileSize      == size;
+
+	// Every section must lie inside the file.
+	valid = valid &&
+		header->NodeOffset <= size &&
+		(unsigned long long)header->NodeCount*sizeof(OctreePackedNode) <= size - header->NodeOffset &&
+		header->LeafTriangleOffset <= size &&
+		(unsigned long long)header->LeafTriangleCount*sizeof(unsigned) <= size - header->LeafTriangleOffset &&
+		header->AmbientAccessOffset <= size &&
+		(unsigned long long)header->VertexCount*sizeof(float) <= size - header->AmbientAccessOffset;
+
+	if( !valid )
+	{
+		Close();
+		return false;
+	}
+
+	mHeader = header;
+	return true;
+}
+
+void AmbientOcclusionCache::Close()
+{
+	mHeader = 0;
+	mFile.Close();
+}
+
+const float* AmbientOcclusionCache::GetVertexAmbientAccess(unsigned long long bakeKey)const
+{
+	if( mHeader == 0 || mHeader->BakeKey != bakeKey )
+		return 0;
+
+	return (const float*)(mFile.GetData() + mHeader->AmbientAccessOffset);
+}
+
+bool AmbientOcclusionCache::LoadOctree(Octree& octree, const std::vector<XMFLOAT3>& vertices, const std::vector<unsigned>& indices)const
+{
+	if( mHeader == 0 )
+		return false;
+
+	const OctreePackedNode* nodes = (const OctreePackedNode*)(mFile.GetData() + mHeader->NodeOffset);
+	const unsigned* leafTriangles     = (const unsigned*)(mFile.GetData() + mHeader->LeafTriangleOffset);
+
+	return octree.Unpack(vertices, indices, nodes, mHeader->NodeCount, leafTriangles, mHeader->LeafTriangleCount);
+}
@@ -0,0 +1,74 @@
+//***************************************************************************************
+// AmbientOcclusionCache.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Versioned binary cache of a built Octree and the baked per-vertex ambient
+// access for a mesh.  The octree is keyed by a hash of the mesh alone and the
+// ambient access by a hash of the mesh and the bake settings, so changing the
+// settings reuses the cached octree and only re-bakes.  A stale cache is detected
+// and ignored.  Loading memory maps the file.
+//
+// Only depends on DirectXMath and the standard library (and MappedFile) so it 
+// can be used by headless tools.
+//***************************************************************************************
+
+#ifndef AMBIENTOCCLUSIONCACHE_H
+#define AMBIENTOCCLUSIONCACHE_H
+
+#include "MappedFile.h"
+#include "AmbientOcclusionBaker.h"
+
+class Octree;
+struct OctreePackedNode;
+
+class AmbientOcclusionCache
+{
+public:
+	AmbientOcclusionCache();
+	~AmbientOcclusionCache();
+
+	// Hash of everything the octree depends on.
+	static unsigned long long ComputeMeshKey(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<unsigned>& indices);
+
+	// Hash of everything the baked ambient access depends on.
+	static unsigned long long ComputeBakeKey(unsigned long long meshKey, const AmbientOcclusionBaker::Settings& settings);
+
+	static bool Save(const std::wstring& filename, unsigned long long meshKey, unsigned long long bakeKey, unsigned triangleCount,
+		const Octree& octree, const std::vector<float>& vertexAmbientAccess);
+
+	// Maps the cache file and validates it against the mesh key and size.  Returns
+	// false if the file is missing, corrupt, from another version, or stale.
+	bool Open(const std::wstring& filename, unsigned long long meshKey, unsigned vertexCount, unsigned triangleCount);
+	void Close();
+
+	// Points into the mapped file; valid until Close.  Returns null if the cached
+	// values were baked with other settings.
+	const float* GetVertexAmbientAccess(unsigned long long bakeKey)const;
+
+	bool LoadOctree(Octree& octree, const std::vector<DirectX::XMFLOAT3>& vertices, const std::vector<unsigned>& indices)const;
+
+private:
+	AmbientOcclusionCache(const AmbientOcclusionCache& rhs);
+	AmbientOcclusionCache& operator=(const AmbientOcclusionCache& rhs);
+
+private:
+	struct FileHeader
+	{
+		unsigned Magic;
+		unsigned Version;
+		unsigned long long MeshKey;
+		unsigned long long BakeKey;
+		unsigned VertexCount;
+		unsigned TriangleCount;
+		unsigned NodeCount;
+		unsigned LeafTriangleCount;
+		unsigned long long NodeOffset;
+		unsigned long long LeafTriangleOffset;
+		unsigned long long AmbientAccessOffset;
+		unsigned long long FileSize;
+	};
+
+	MappedFile mFile;
+	const FileHeader* mHeader;
+};
+
+#endif // AMBIENTOCCLUSIONCACHE_H
@@ -18,6 +18,8 @@
 #include "Vertex.h"
 #include "Camera.h"
 #include "Octree.h"
+#include "AmbientOcclusionBaker.h"
+#include "AmbientOcclusionCache.h"
 
 class AmbientOcclusionApp : public D3DApp 
 {
@@ -221,62 +223,54 @@ void AmbientOcclusionApp::BuildVertexAmbientOcclusion(
 	for(UINT i = 0; i < vcount; ++i)
 		positions[i] = vertices[i].Pos;
 
-	Octree octree;
-	octree.Build(positions, indices);
-
-	// For each vertex, count how many triangles contain the vertex.
-	std::vector<int> vertexSharedCount(vcount);
-	for(UINT i = 0; i < tcount; ++i)
-	{
-		UINT i0 = indices[i*3+0];
-		UINT i1 = indices[i*3+1];
-		UINT i2 = indices[i*3+2];
-
-		XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-		XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-		XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-		XMVECTOR edge0 = v1 - v0;
-		XMVECTOR edge1 = v2 - v0;
+	AmbientOcclusionBaker::Settings settings;
 
-		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(edge0, edge1));
+	// Distance (in model space) beyond which an intersection no longer counts
+	// as occluding a triangle.  The skull is about 7 units tall.
+	settings.MaxOcclusionDist = 2.0f;
 
-		XMVECTOR centroid = (v0 + v1 + v2)/3.0f;
+	// If a cache baked from this exact mesh with these settings exists, use it 
+	// and skip both the octree build and the bake.  If only the settings differ,
+	// the cached octree is still good and just the bake is redone.
+	const std::wstring cacheFilename = L"Models/skull.aocache";
+	UINT64 meshKey = AmbientOcclusionCache::ComputeMeshKey(positions, indices);
+	UINT64 bakeKey = AmbientOcclusionCache::ComputeBakeKey(meshKey, settings);
 
-		// Offset to avoid self intersection.
-		centroid += 0.001f*normal;
+	Octree octree;
+	bool octreeLoaded = false;
 
-		const int NumSampleRays = 32;
-		float numUnoccluded = 0;
-		for(int j = 0; j < NumSampleRays; ++j)
+	AmbientOcclusionCache cache;
+	if( cache.Open(cacheFilename, meshKey, vcount, tcount) )
+	{
+		const float* ambientAccess = cache.GetVertexAmbientAccess(bakeKey);
+		if( ambientAccess )
 		{
-			XMVECTOR randomDir = MathHelper::RandHemisphereUnitVec3(normal);
-
-			// TODO: Technically we should not count intersections that are far 
-			// away as occluding the triangle, but this is OK for demo.
-			if( !octree.RayOctreeIntersect(centroid, randomDir) )
+			for(UINT i = 0; i < vcount; ++i)
 			{
-				numUnoccluded++;
+				vertices[i].AmbientAccess = ambientAccess[i];
 			}
+			return;
 		}
-		
-		float ambientAccess = numUnoccluded / NumSampleRays;
 
-		// Average with vertices that share this face.
-		vertices[i0].AmbientAccess += ambientAccess;
-		vertices[i1].AmbientAccess += ambientAccess;
-		vertices[i2].AmbientAccess += ambientAccess;
+		octreeLoaded = cache.LoadOctree(octree, positions, indices);
 
-		vertexSharedCount[i0]++;
-		vertexSharedCount[i1]++;
-		vertexSharedCount[i2]++;
+		// Unmap before the file is rewritten below.
+		cache.Close();
 	}
 
-	// Finish average by dividing by the number of samples we added.
+	if( !octreeLoaded )
+		octree.Build(positions, indices);
+
+	AmbientOcclusionBaker baker;
+	baker.Bake(positions, indices, octree, settings);
+
+	const std::vector<float>& ambientAccess = baker.GetVertexAmbientAccess();
 	for(UINT i = 0; i < vcount; ++i)
 	{
-		vertices[i].AmbientAccess /= vertexSharedCount[i];
+		vertices[i].AmbientAccess = ambientAccess[i];
 	}
+
+	AmbientOcclusionCache::Save(cacheFilename, meshKey, bakeKey, tcount, octree, ambientAccess);
 }
 
 void AmbientOcclusionApp::BuildSkullGeometryBuffers()
@@ -0,0 +1,227 @@
+//***************************************************************************************
+// AoBake.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Console program that bakes the per-vertex ambient access of a mesh and writes
+// the AmbientOcclusionCache the AmbientOcclusion demo loads at startup, so the
+// bake can be done offline (e.g. on a build machine) instead of on first run.
+// It does not create a window or a Direct3D device, and only depends on
+// DirectXMath and the standard library, so it also builds and runs headless on
+// Linux with the CMakeLists.txt next to this file.
+//
+// Like the demo, an up to date cache is left alone, and if only the settings
+// changed the cached octree is reused and just the bake is redone.
+//
+// Usage:
+//      AoBake [options] [model.txt [output.aocache]]
+//
+//      -samples n    rays per pass for each unconverged triangle
+//      -min n        minimum rays per triangle
+//      -max n        maximum rays per triangle
+//      -error e      standard error at which a triangle is converged
+//      -maxdist d    distance beyond which hits no longer occlude
+//      -offset d     distance ray origins are pushed off the surface
+//      -seed n       seed of the sample sequence
+//
+// With no model the demo's skull is baked with the demo's settings.  The output
+// defaults to the model filename with its extension replaced by .aocache.
+//
+//***************************************************************************************
+
+#include "../../Common/Octree.h"
+#include "../AmbientOcclusion/AmbientOcclusionBaker.h"
+#include "../AmbientOcclusion/AmbientOcclusionCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Reads the positions and triangles of a .txt model (the skull format).
+	bool LoadTxtMesh(const std::string& filename, std::vector<XMFLOAT3>& positions, std::vector<unsigned>& indices)
+	{
+		std::ifstream fin(filename.c_str());
+		if(!fin)
+			return false;
+
+		unsigned vcount = 0;
+		unsigned tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		positions.resize(vcount);
+		for(unsigned i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 normal;
+			fin >> positions[i].x >> positions[i].y >> positions[i].z;
+			fin >> normal.x >> normal.y >> normal.z;
+		}
+
+		fin >> ignore;
+		fin >> ignore;
+		fin >> ignore;
+
+		indices.resize(3*tcount);
+		for(unsigned i = 0; i < 3*tcount; ++i)
+			fin >> indices[i];
+
+		if( fin.fail() )
+			return false;
+
+		for(size_t i = 0; i < indices.size(); ++i)
+		{
+			if( indices[i] >= vcount )
+				return false;
+		}
+
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		printf("usage: AoBake [-samples n] [-min n] [-max n] [-error e] [-maxdist d] [-offset d] [-seed n]\n");
+		printf("              [model.txt [output.aocache]]\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	AmbientOcclusionBaker::Settings settings;
+
+	// Same as AmbientOcclusionApp::BuildVertexAmbientOcclusion, so the default
+	// run writes the cache the demo looks for.
+	settings.MaxOcclusionDist = 2.0f;
+
+	std::vector<std::string> filenames;
+	for(int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if( arg[0] != '-' )
+		{
+			filenames.push_back(arg);
+			continue;
+		}
+
+		if( i + 1 >= argc )
+		{
+			PrintUsage();
+			return 2;
+		}
+		const char* value = argv[++i];
+
+		if(      strcmp(arg, "-samples") == 0 ) settings.SamplesPerPass   = (unsigned)strtoul(value, 0, 10);
+		else if( strcmp(arg, "-min") == 0 )     settings.MinSamples       = (unsigned)strtoul(value, 0, 10);
+		else if( strcmp(arg, "-max") == 0 )     settings.MaxSamples       = (unsigned)strtoul(value, 0, 10);
+		else if( strcmp(arg, "-error") == 0 )   settings.MaxStandardError = (float)atof(value);
+		else if( strcmp(arg, "-maxdist") == 0 ) settings.MaxOcclusionDist = (float)atof(value);
+		else if( strcmp(arg, "-offset") == 0 )  settings.SurfaceOffset    = (float)atof(value);
+		else if( strcmp(arg, "-seed") == 0 )    settings.Seed             = (unsigned)strtoul(value, 0, 10);
+		else
+		{
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if( filenames.size() > 2 )
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	std::string modelFilename = filenames.size() > 0 ? filenames[0] : "../AmbientOcclusion/Models/skull.txt";
+	std::string cacheFilename;
+	if( filenames.size() > 1 )
+	{
+		cacheFilename = filenames[1];
+	}
+	else
+	{
+		size_t dot = modelFilename.find_last_of('.');
+		size_t slash = modelFilename.find_last_of("/\\");
+		if( dot != std::string::npos && (slash == std::string::npos || dot > slash) )
+			cacheFilename = modelFilename.substr(0, dot);
+		else
+			cacheFilename = modelFilename;
+		cacheFilename += ".aocache";
+	}
+
+	// The cache takes wide names like the rest of the demo code; the paths here
+	// are ASCII.
+	std::wstring cacheFilenameW(cacheFilename.begin(), cacheFilename.end());
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned> indices;
+	if( !LoadTxtMesh(modelFilename, positions, indices) || indices.empty() )
+	{
+		printf("%s: could not load\n", modelFilename.c_str());
+		return 1;
+	}
+
+	unsigned vcount = (unsigned)positions.size();
+	unsigned tcount = (unsigned)indices.size()/3;
+	printf("%s: %u vertices, %u triangles\n", modelFilename.c_str(), vcount, tcount);
+
+	unsigned long long meshKey = AmbientOcclusionCache::ComputeMeshKey(positions, indices);
+	unsigned long long bakeKey = AmbientOcclusionCache::ComputeBakeKey(meshKey, settings);
+
+	Octree octree;
+	bool octreeLoaded = false;
+
+	AmbientOcclusionCache cache;
+	if( cache.Open(cacheFilenameW, meshKey, vcount, tcount) )
+	{
+		if( cache.GetVertexAmbientAccess(bakeKey) )
+		{
+			printf("%s: up to date\n", cacheFilename.c_str());
+			return 0;
+		}
+
+		octreeLoaded = cache.LoadOctree(octree, positions, indices);
+
+		// Unmap before the file is rewritten below.
+		cache.Close();
+	}
+
+	Clock::time_point start = Clock::now();
+	if( !octreeLoaded )
+	{
+		octree.Build(positions, indices);
+		printf("  octree build: %.1f ms\n", 1000.0*SecondsSince(start));
+	}
+	else
+	{
+		printf("  octree loaded from cache\n");
+	}
+
+	start = Clock::now();
+	AmbientOcclusionBaker baker;
+	baker.Bake(positions, indices, octree, settings);
+	double bakeSeconds = SecondsSince(start);
+
+	printf("  bake: %.1f ms, %llu rays (%.2f Mrays/s)\n", 1000.0*bakeSeconds, baker.GetRayCount(),
+		bakeSeconds > 0.0 ? baker.GetRayCount() / bakeSeconds * 1e-6 : 0.0);
+
+	if( !AmbientOcclusionCache::Save(cacheFilenameW, meshKey, bakeKey, tcount, octree, baker.GetVertexAmbientAccess()) )
+	{
+		printf("%s: could not write\n", cacheFilename.c_str());
+		return 1;
+	}
+
+	printf("  wrote %s\n", cacheFilename.c_str());
+	return 0;
+}
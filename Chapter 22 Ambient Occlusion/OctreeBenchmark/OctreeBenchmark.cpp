@@ -0,0 +1,507 @@
+//***************************************************************************************
+// OctreeBenchmark.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Console program that measures Octree build cost and ray query throughput.  It
+// does not create a window or a Direct3D device, and only depends on DirectXMath
+// and the standard library, so it also builds and runs headless on Linux with
+// the CMakeLists.txt next to this file.  Both builds define OCTREE_QUERY_STATS
+// to get the traversal counters.
+//
+// For each mesh it builds the octree and fires three ray sets:
+//
+//      camera - closest hit, one ray per pixel of a 256x256 view of the mesh (coherent).
+//      ao     - any hit with a max distance, 32 hemisphere rays from triangle centroids.
+//      random - closest hit, rays from a sphere around the mesh to random points
+//               inside its bounds (incoherent).
+//
+// A subset of each ray set is also run through a brute force loop over all the
+// triangles to give a baseline and to check that the octree returns the same hits.
+//
+// Usage:
+//      OctreeBenchmark [model.txt | model.m3d]...
+//
+// With no arguments the skull, car and M3D models that ship with the demos are used.
+//
+//***************************************************************************************
+
+#include "../../Common/Octree.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#ifndef OCTREE_QUERY_STATS
+#error OctreeBenchmark needs the octree traversal counters; define OCTREE_QUERY_STATS.
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	struct Mesh
+	{
+		std::string Name;
+		std::vector<XMFLOAT3> Positions;
+		std::vector<unsigned> Indices;
+	};
+
+	struct RaySet
+	{
+		std::string Name;
+		std::vector<XMFLOAT3> Origins;
+		std::vector<XMFLOAT3> Dirs;
+		float MaxDist;
+		bool AnyHit;
+	};
+
+	struct QueryResult
+	{
+		double Seconds;
+		std::vector<float> HitDist; // FLT_MAX for a miss.
+		OctreeQueryStats Stats;
+	};
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Moller-Trumbore, for the brute force baseline.
+	bool IntersectRayTriangle(FXMVECTOR origin, FXMVECTOR dir, FXMVECTOR v0, GXMVECTOR v1, CXMVECTOR v2, float& t)
+	{
+		XMVECTOR e1 = v1 - v0;
+		XMVECTOR e2 = v2 - v0;
+
+		XMVECTOR p = XMVector3Cross(dir, e2);
+		float det = XMVectorGetX(XMVector3Dot(e1, p));
+		if( fabsf(det) < 1e-20f )
+			return false;
+
+		float invDet = 1.0f / det;
+
+		XMVECTOR s = origin - v0;
+		float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+		if( u < 0.0f || u > 1.0f )
+			return false;
+
+		XMVECTOR q = XMVector3Cross(s, e1);
+		float v = XMVectorGetX(XMVector3Dot(dir, q)) * invDet;
+		if( v < 0.0f || u + v > 1.0f )
+			return false;
+
+		t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+		return t >= 0.0f;
+	}
+
+	// Reads the "VertexCount/TriangleCount" text format used by skull.txt and car.txt.
+	bool LoadTxtMesh(const std::string& filename, Mesh& mesh)
+	{
+		std::ifstream fin(filename.c_str());
+		if(!fin)
+			return false;
+
+		unsigned vcount = 0;
+		unsigned tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		mesh.Positions.resize(vcount);
+		for(unsigned i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 normal;
+			fin >> mesh.Positions[i].x >> mesh.Positions[i].y >> mesh.Positions[i].z;
+			fin >> normal.x >> normal.y >> normal.z;
+		}
+
+		fin >> ignore;
+		fin >> ignore;
+		fin >> ignore;
+
+		mesh.Indices.resize(3*tcount);
+		for(unsigned i = 0; i < 3*tcount; ++i)
+			fin >> mesh.Indices[i];
+
+		return !fin.fail();
+	}
+
+	// Reads just the positions and triangles of an .m3d file (static or skinned).
+	bool LoadM3dMesh(const std::string& filename, Mesh& mesh)
+	{
+		std::ifstream fin(filename.c_str());
+		if(!fin)
+			return false;
+
+		unsigned numMaterials = 0;
+		unsigned numVertices  = 0;
+		unsigned numTriangles = 0;
+		std::string ignore;
+
+		fin >> ignore; // file header text
+		fin >> ignore >> numMaterials;
+		fin >> ignore >> numVertices;
+		fin >> ignore >> numTriangles;
+
+		mesh.Positions.reserve(numVertices);
+
+		std::string token;
+		while( fin >> token )
+		{
+			if( token == "Position:" )
+			{
+				XMFLOAT3 p;
+				fin >> p.x >> p.y >> p.z;
+				mesh.Positions.push_back(p);
+			}
+			else if( token.find("Triangles") != std::string::npos )
+			{
+				mesh.Indices.resize(3*numTriangles);
+				for(unsigned i = 0; i < 3*numTriangles; ++i)
+					fin >> mesh.Indices[i];
+				break;
+			}
+		}
+
+		return !fin.fail() && mesh.Positions.size() == numVertices;
+	}
+
+	bool LoadMesh(const std::string& filename, Mesh& mesh)
+	{
+		size_t slash = filename.find_last_of("/\\");
+		mesh.Name = slash == std::string::npos ? filename : filename.substr(slash+1);
+
+		if( filename.size() > 4 && filename.substr(filename.size()-4) == ".m3d" )
+			return LoadM3dMesh(filename, mesh);
+
+		return LoadTxtMesh(filename, mesh);
+	}
+
+	void ComputeBounds(const Mesh& mesh, XMFLOAT3& center, float& radius)
+	{
+		XMVECTOR vmin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vmax = XMVectorReplicate(-FLT_MAX);
+		for(size_t i = 0; i < mesh.Positions.size(); ++i)
+		{
+			XMVECTOR P = XMLoadFloat3(&mesh.Positions[i]);
+			vmin = XMVectorMin(vmin, P);
+			vmax = XMVectorMax(vmax, P);
+		}
+
+		XMStoreFloat3(&center, 0.5f*(vmin + vmax));
+		radius = 0.5f*XMVectorGetX(XMVector3Length(vmax - vmin));
+	}
+
+	XMFLOAT3 RandUnitVec3(std::mt19937& rng)
+	{
+		// Uniform direction on the unit sphere.
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		float z   = dist(rng);
+		float phi = XM_PI*dist(rng);
+		float r   = sqrtf(std::max(0.0f, 1.0f - z*z));
+
+		return XMFLOAT3(r*cosf(phi), r*sinf(phi), z);
+	}
+
+	void BuildCameraRays(const XMFLOAT3& center, float radius, RaySet& rays)
+	{
+		const unsigned Width  = 256;
+		const unsigned Height = 256;
+		const float TanHalfFovY = tanf(0.125f*XM_PI);
+
+		rays.Name    = "camera";
+		rays.MaxDist = FLT_MAX;
+		rays.AnyHit  = false;
+
+		XMVECTOR target = XMLoadFloat3(&center);
+		XMVECTOR eye    = target + XMVectorSet(0.0f, 0.3f*radius, -2.5f*radius, 0.0f);
+		XMVECTOR look   = XMVector3Normalize(target - eye);
+		XMVECTOR right  = XMVector3Normalize(XMVector3Cross(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), look));
+		XMVECTOR up     = XMVector3Cross(look, right);
+
+		XMFLOAT3 origin;
+		XMStoreFloat3(&origin, eye);
+
+		for(unsigned i = 0; i < Height; ++i)
+		{
+			for(unsigned j = 0; j < Width; ++j)
+			{
+				float x = (2.0f*(j + 0.5f)/Width  - 1.0f)*TanHalfFovY;
+				float y = (1.0f - 2.0f*(i + 0.5f)/Height)*TanHalfFovY;
+
+				XMFLOAT3 dir;
+				XMStoreFloat3(&dir, XMVector3Normalize(look + x*right + y*up));
+
+				rays.Origins.push_back(origin);
+				rays.Dirs.push_back(dir);
+			}
+		}
+	}
+
+	void BuildAmbientOcclusionRays(const Mesh& mesh, float radius, std::mt19937& rng, RaySet& rays)
+	{
+		const unsigned NumTriangles = 2048;
+		const unsigned RaysPerTriangle = 32;
+
+		rays.Name    = "ao";
+		rays.MaxDist = 0.25f*radius;
+		rays.AnyHit  = true;
+
+		unsigned tcount = (unsigned)(mesh.Indices.size()/3);
+		std::uniform_int_distribution<unsigned> pickTri(0, tcount-1);
+
+		for(unsigned i = 0; i < NumTriangles; ++i)
+		{
+			unsigned tri = pickTri(rng);
+
+			XMVECTOR v0 = XMLoadFloat3(&mesh.Positions[mesh.Indices[tri*3+0]]);
+			XMVECTOR v1 = XMLoadFloat3(&mesh.Positions[mesh.Indices[tri*3+1]]);
+			XMVECTOR v2 = XMLoadFloat3(&mesh.Positions[mesh.Indices[tri*3+2]]);
+
+			XMVECTOR cross = XMVector3Cross(v1 - v0, v2 - v0);
+			if( XMVectorGetX(XMVector3LengthSq(cross)) <= 1e-20f )
+				continue;
+
+			XMVECTOR normal = XMVector3Normalize(cross);
+
+			XMFLOAT3 origin;
+			XMStoreFloat3(&origin, (v0 + v1 + v2)/3.0f + 0.001f*normal);
+
+			for(unsigned j = 0; j < RaysPerTriangle; ++j)
+			{
+				// Flip directions in the lower hemisphere to the upper one.
+				XMFLOAT3 d = RandUnitVec3(rng);
+				XMVECTOR dir = XMLoadFloat3(&d);
+				if( XMVectorGetX(XMVector3Dot(dir, normal)) < 0.0f )
+					dir = -dir;
+
+				XMStoreFloat3(&d, dir);
+				rays.Origins.push_back(origin);
+				rays.Dirs.push_back(d);
+			}
+		}
+	}
+
+	void BuildRandomRays(const XMFLOAT3& center, float radius, std::mt19937& rng, RaySet& rays)
+	{
+		const unsigned NumRays = 65536;
+
+		rays.Name    = "random";
+		rays.MaxDist = FLT_MAX;
+		rays.AnyHit  = false;
+
+		XMVECTOR C = XMLoadFloat3(&center);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		for(unsigned i = 0; i < NumRays; ++i)
+		{
+			XMFLOAT3 d = RandUnitVec3(rng);
+			XMVECTOR origin = C + 1.5f*radius*XMLoadFloat3(&d);
+
+			// Random point inside the bounding sphere.
+			XMFLOAT3 e = RandUnitVec3(rng);
+			XMVECTOR target = C + radius*unit(rng)*XMLoadFloat3(&e);
+
+			XMFLOAT3 o, dir;
+			XMStoreFloat3(&o, origin);
+			XMStoreFloat3(&dir, XMVector3Normalize(target - origin));
+
+			rays.Origins.push_back(o);
+			rays.Dirs.push_back(dir);
+		}
+	}
+
+	void RunOctree(Octree& octree, const RaySet& rays, QueryResult& result)
+	{
+		result.HitDist.resize(rays.Origins.size());
+		result.Stats.NodesVisited = 0;
+		result.Stats.TrianglesTested = 0;
+
+		// Timed pass without counters, then a counted pass for the traversal stats.
+		for(int pass = 0; pass < 2; ++pass)
+		{
+			octree.SetQueryStats(pass == 0 ? 0 : &result.Stats);
+
+			Clock::time_point start = Clock::now();
+			for(size_t i = 0; i < rays.Origins.size(); ++i)
+			{
+				XMVECTOR origin = XMLoadFloat3(&rays.Origins[i]);
+				XMVECTOR dir    = XMLoadFloat3(&rays.Dirs[i]);
+
+				if( rays.AnyHit )
+				{
+					bool hit = octree.RayOctreeIntersect(origin, dir, rays.MaxDist);
+					result.HitDist[i] = hit ? 0.0f : FLT_MAX;
+				}
+				else
+				{
+					OctreeHit hit;
+					bool found = octree.RayOctreeClosestHit(origin, dir, hit, rays.MaxDist);
+					result.HitDist[i] = found ? hit.T : FLT_MAX;
+				}
+			}
+
+			if( pass == 0 )
+				result.Seconds = SecondsSince(start);
+		}
+
+		octree.SetQueryStats(0);
+	}
+
+	void RunBruteForce(const Mesh& mesh, const RaySet& rays, size_t numRays, QueryResult& result)
+	{
+		result.HitDist.resize(numRays);
+		result.Stats.NodesVisited = 0;
+		result.Stats.TrianglesTested = 0;
+
+		unsigned tcount = (unsigned)(mesh.Indices.size()/3);
+
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < numRays; ++i)
+		{
+			XMVECTOR origin = XMLoadFloat3(&rays.Origins[i]);
+			XMVECTOR dir    = XMLoadFloat3(&rays.Dirs[i]);
+
+			float tmin = FLT_MAX;
+			for(unsigned k = 0; k < tcount; ++k)
+			{
+				XMVECTOR v0 = XMLoadFloat3(&mesh.Positions[mesh.Indices[k*3+0]]);
+				XMVECTOR v1 = XMLoadFloat3(&mesh.Positions[mesh.Indices[k*3+1]]);
+				XMVECTOR v2 = XMLoadFloat3(&mesh.Positions[mesh.Indices[k*3+2]]);
+
+				float t = 0.0f;
+				if( IntersectRayTriangle(origin, dir, v0, v1, v2, t) && t <= rays.MaxDist && t < tmin )
+				{
+					tmin = t;
+					if( rays.AnyHit )
+						break;
+				}
+			}
+
+			result.HitDist[i] = (rays.AnyHit && tmin != FLT_MAX) ? 0.0f : tmin;
+			result.Stats.TrianglesTested += tcount;
+		}
+		result.Seconds = SecondsSince(start);
+	}
+
+	unsigned CountMismatches(const QueryResult& a, const QueryResult& b, size_t numRays)
+	{
+		unsigned mismatches = 0;
+		for(size_t i = 0; i < numRays; ++i)
+		{
+			bool hitA = a.HitDist[i] != FLT_MAX;
+			bool hitB = b.HitDist[i] != FLT_MAX;
+
+			if( hitA != hitB || (hitA && fabsf(a.HitDist[i] - b.HitDist[i]) > 1e-3f*(1.0f + b.HitDist[i])) )
+				mismatches++;
+		}
+		return mismatches;
+	}
+
+	void BenchmarkMesh(const Mesh& mesh)
+	{
+		unsigned tcount = (unsigned)(mesh.Indices.size()/3);
+
+		printf("\n%s: %u vertices, %u triangles\n", mesh.Name.c_str(), (unsigned)mesh.Positions.size(), tcount);
+
+		Clock::time_point start = Clock::now();
+		Octree octree;
+		octree.Build(mesh.Positions, mesh.Indices);
+		double buildSeconds = SecondsSince(start);
+
+		printf("  octree build: %.1f ms, %u nodes, %.2f MB\n", 
+			1000.0*buildSeconds, octree.GetNodeCount(), octree.GetMemoryUsage()/(1024.0*1024.0));
+
+		XMFLOAT3 center;
+		float radius;
+		ComputeBounds(mesh, center, radius);
+
+		// Fixed seed so runs are comparable.
+		std::mt19937 rng(1234);
+
+		RaySet raySets[3];
+		BuildCameraRays(center, radius, raySets[0]);
+		BuildAmbientOcclusionRays(mesh, radius, rng, raySets[1]);
+		BuildRandomRays(center, radius, rng, raySets[2]);
+
+		printf("  %-8s %9s %9s %7s %11s %11s %12s %10s\n", 
+			"rays", "count", "Mrays/s", "hit%", "nodes/ray", "tris/ray", "brute Mr/s", "mismatch");
+
+		for(int s = 0; s < 3; ++s)
+		{
+			const RaySet& rays = raySets[s];
+			size_t numRays = rays.Origins.size();
+			if( numRays == 0 )
+				continue;
+
+			QueryResult octreeResult;
+			RunOctree(octree, rays, octreeResult);
+
+			unsigned hits = 0;
+			for(size_t i = 0; i < numRays; ++i)
+			{
+				if( octreeResult.HitDist[i] != FLT_MAX )
+					hits++;
+			}
+
+			// Brute force is O(triangles) per ray, so only run a subset.
+			size_t numBruteRays = std::min(numRays, (size_t)(1 << 22) / std::max(tcount/64, 1u));
+			numBruteRays = std::max(numBruteRays, (size_t)std::min(numRays, (size_t)256));
+
+			QueryResult bruteResult;
+			RunBruteForce(mesh, rays, numBruteRays, bruteResult);
+
+			printf("  %-8s %9u %9.2f %6.1f%% %11.1f %11.1f %12.3f %6u/%u\n",
+				rays.Name.c_str(),
+				(unsigned)numRays,
+				numRays / octreeResult.Seconds / 1e6,
+				100.0*hits/numRays,
+				(double)octreeResult.Stats.NodesVisited/numRays,
+				(double)octreeResult.Stats.TrianglesTested/numRays,
+				numBruteRays / bruteResult.Seconds / 1e6,
+				CountMismatches(octreeResult, bruteResult, numBruteRays),
+				(unsigned)numBruteRays);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> filenames;
+	for(int i = 1; i < argc; ++i)
+		filenames.push_back(argv[i]);
+
+	if( filenames.empty() )
+	{
+		filenames.push_back("../AmbientOcclusion/Models/skull.txt");
+		filenames.push_back("../../Chapter 16 Picking/Picking/Models/car.txt");
+		filenames.push_back("../../Chapter 23 Meshes/MeshView/Models/base.m3d");
+		filenames.push_back("../../Chapter 23 Meshes/MeshView/Models/pillar1.m3d");
+		filenames.push_back("../../Chapter 23 Meshes/MeshView/Models/rock.m3d");
+		filenames.push_back("../../Chapter 23 Meshes/MeshView/Models/stairs.m3d");
+		filenames.push_back("../../Chapter 23 Meshes/MeshView/Models/tree.m3d");
+		filenames.push_back("../../Chapter 25 Character Animation/SkinnedMesh/Models/soldier.m3d");
+	}
+
+	int numFailed = 0;
+	for(size_t i = 0; i < filenames.size(); ++i)
+	{
+		Mesh mesh;
+		if( !LoadMesh(filenames[i], mesh) || mesh.Indices.empty() )
+		{
+			printf("\n%s: could not load\n", filenames[i].c_str());
+			numFailed++;
+			continue;
+		}
+
+		BenchmarkMesh(mesh);
+	}
+
+	return numFailed == 0 ? 0 : 1;
+}
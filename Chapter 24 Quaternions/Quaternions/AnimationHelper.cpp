@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "AnimationHelper.h"
+#include "KeyframeSearch.h"
 
 Keyframe::Keyframe()
 	: TimePos(0.0f),
@@ -31,6 +32,12 @@ float BoneAnimation::GetEndTime()const
 }
 
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	UINT cursor = 0;
+	Interpolate(t, cursor, M);
+}
+
+void BoneAnimation::Interpolate(float t, UINT& cursor, XMFLOAT4X4& M)const
 {
 	if( t <= Keyframes.front().TimePos )
 	{
@@ -40,6 +47,8 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 
 		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
 		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+
+		cursor = 0;
 	}
 	else if( t >= Keyframes.back().TimePos )
 	{
@@ -49,33 +58,36 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 
 		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
 		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+
+		cursor = Keyframes.size()-2;
 	}
 	else
 	{
-		for(UINT i = 0; i < Keyframes.size()-1; ++i)
-		{
-			if( t >= Keyframes[i].TimePos && t <= Keyframes[i+1].TimePos )
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
+		UINT i = FindKeyframe(t, cursor);
+		cursor = i;
 
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+		XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+		XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
 
-				break;
-			}
-		}
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
 	}
+}
+
+UINT BoneAnimation::FindKeyframe(float t, UINT cursor)const
+{
+	return KeyframeSearch::Find(&Keyframes[0], Keyframes.size(), t, cursor,
+		[](const Keyframe& key) { return key.TimePos; });
 }
\ No newline at end of file
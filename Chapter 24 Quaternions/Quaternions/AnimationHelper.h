@@ -37,6 +37,17 @@ struct BoneAnimation
 
     void Interpolate(float t, XMFLOAT4X4& M)const;
 
+	// Same as above, but the search for the two keyframes that bound t starts 
+	// from cursor, which is then updated to the first of the two.  Keep one 
+	// cursor per bone per animated object and pass it to every call: moving 
+	// forward in time then finds the keyframes in constant time, and jumps 
+	// fall back to a binary search.  Any value is a valid cursor; start with 0.
+	void Interpolate(float t, UINT& cursor, XMFLOAT4X4& M)const;
+
+	// Index i of the keyframes i and i+1 that bound t, which must lie strictly
+	// between the start and end times, searching from cursor.
+	UINT FindKeyframe(float t, UINT cursor)const;
+
 	std::vector<Keyframe> Keyframes; 	
 
 };
@@ -83,6 +83,7 @@ private:
 	Camera mCam;
 
 	float mAnimTimePos;
+	UINT mSkullAnimCursor;
 	BoneAnimation mSkullAnimation;
 
 	POINT mLastMousePos;
@@ -108,7 +109,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 QuatApp::QuatApp(HINSTANCE hInstance)
 : D3DApp(hInstance), mShapesVB(0), mShapesIB(0), mSkullVB(0), mSkullIB(0), 
   mFloorTexSRV(0), mStoneTexSRV(0), mBrickTexSRV(0),
-  mSkullIndexCount(0), mAnimTimePos(0.0f)
+  mSkullIndexCount(0), mAnimTimePos(0.0f), mSkullAnimCursor(0)
 {
 	mMainWndCaption = L"Quaternion Demo";
 	
@@ -275,7 +276,7 @@ void QuatApp::UpdateScene(float dt)
 		mAnimTimePos = 0.0f;
 	}
 
-	mSkullAnimation.Interpolate(mAnimTimePos, mSkullWorld);
+	mSkullAnimation.Interpolate(mAnimTimePos, mSkullAnimCursor, mSkullWorld);
 }
 
 void QuatApp::DrawScene()
@@ -0,0 +1,770 @@
+//***************************************************************************************
+// AnimationTests.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Console program that checks the animation code that does not need Direct3D
+// against brute force versions of what it computes.  It does not create a window
+// or a Direct3D device, so it also builds and runs headless on Linux with the
+// CMakeLists.txt next to this file (where ctest runs it).
+//
+//      keyframe search - KeyframeSearch, the cursor based keyframe lookup shared
+//                        by BoneAnimation (Chapters 24 and 25), PackedClip and
+//                        CompressedClip, against a linear scan.  The keyframe
+//                        lists are random and include runs of equal times.  Each
+//                        list is sampled forward in small steps with a kept
+//                        cursor (the playback case), at random times with a kept
+//                        cursor (seeks), and with arbitrary cursors.
+//      cpu skinning    - CpuSkinning against SkinnedVS evaluated one vertex at a
+//                        time, on random meshes and bone palettes.
+//      compressed clip - The smallest three quaternion encoding on random and
+//                        axis aligned rotations, and CompressedClip against the
+//                        PackedClip it was built from: at every key of random
+//                        clips no bone end may move more than the error bound.
+//                        Also checks constant track and key removal decisions,
+//                        two key clips, and tracks too large to quantize.
+//
+// Usage:
+//      AnimationTests
+//
+// Returns 0 if every check passed.
+//***************************************************************************************
+
+#include "../../Common/KeyframeSearch.h"
+#include "../SkinnedMesh/AnimationClip.h"
+#include "../SkinnedMesh/CompressedClip.h"
+#include "../SkinnedMesh/CpuSkinning.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Key
+	{
+		float TimePos;
+		float Value;
+	};
+
+	int gNumFailed = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if( !ok )
+		{
+			printf("    FAILED: %s\n", what);
+			gNumFailed++;
+		}
+	}
+
+	// The interval the search must return: the last i with times[i] <= t, which
+	// for t strictly inside the keyframe times also has t < times[i+1].
+	unsigned FindLinear(const std::vector<float>& times, float t)
+	{
+		unsigned i = 0;
+		while( i+2 < times.size() && times[i+1] <= t )
+			++i;
+
+		return i;
+	}
+
+	bool IsValidInterval(const std::vector<float>& times, float t, unsigned i)
+	{
+		return i+1 < times.size() && times[i] <= t && t < times[i+1];
+	}
+
+	void TestKeyframeSearch()
+	{
+		printf("keyframe search\n");
+
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		bool forwardOk = true;
+		bool seekOk    = true;
+		bool cursorOk  = true;
+		bool keysOk    = true;
+		unsigned numLookups = 0;
+
+		for(int list = 0; list < 200; ++list)
+		{
+			// 2 to 2000 keyframes, about a quarter of them repeating the previous time.
+			unsigned count = 2 + (list < 100 ? list : (unsigned)(unit(rng)*2000.0f));
+
+			std::vector<float> times(count);
+			std::vector<Key> keys(count);
+			float time = unit(rng);
+			for(unsigned k = 0; k < count; ++k)
+			{
+				if( k == 0 || k+1 == count || unit(rng) > 0.25f )
+					time += 0.01f + 0.1f*unit(rng);
+
+				times[k] = time;
+				keys[k].TimePos = time;
+				keys[k].Value = (float)k;
+			}
+
+			float start = times.front();
+			float end   = times.back();
+
+			// Playback: small forward steps, wrapping to the start like a looped clip.
+			unsigned cursor = 0;
+			float t = start;
+			for(int step = 0; step < 3000; ++step)
+			{
+				t += 0.02f*unit(rng);
+				if( t >= end )
+					t = start + (t - end);
+				if( t <= start || t >= end )
+					continue;
+
+				unsigned i = KeyframeSearch::Find(&times[0], count, t, cursor);
+				if( !IsValidInterval(times, t, i) || i != FindLinear(times, t) )
+					forwardOk = false;
+				cursor = i;
+				numLookups++;
+			}
+
+			// Seeks: random times, reusing the cursor of the previous lookup.
+			cursor = 0;
+			for(int seek = 0; seek < 200; ++seek)
+			{
+				t = start + (end - start)*unit(rng);
+				if( t <= start || t >= end )
+					continue;
+
+				unsigned i = KeyframeSearch::Find(&times[0], count, t, cursor);
+				if( !IsValidInterval(times, t, i) || i != FindLinear(times, t) )
+					seekOk = false;
+				cursor = i;
+				numLookups++;
+			}
+
+			// Any cursor is valid, including ones past the end.
+			const unsigned cursors[] = { 0u, count/2, count-2, count-1, count, 0xffffffffu };
+			for(int c = 0; c < 6; ++c)
+			{
+				t = start + (end - start)*unit(rng);
+				if( t <= start || t >= end )
+					continue;
+
+				unsigned i = KeyframeSearch::Find(&times[0], count, t, cursors[c]);
+				if( !IsValidInterval(times, t, i) || i != FindLinear(times, t) )
+					cursorOk = false;
+				numLookups++;
+			}
+
+			// Exactly on a keyframe time, through the keyframe struct overload.
+			for(unsigned k = 1; k+1 < count; ++k)
+			{
+				t = times[k];
+				if( t >= end )
+					continue;
+
+				unsigned i = KeyframeSearch::Find(&keys[0], count, t, k-1,
+					[](const Key& key) { return key.TimePos; });
+				if( !IsValidInterval(times, t, i) || i != FindLinear(times, t) )
+					keysOk = false;
+				numLookups++;
+			}
+		}
+
+		printf("    %u lookups\n", numLookups);
+		Check(forwardOk, "forward playback with a kept cursor");
+		Check(seekOk, "random seeks with a kept cursor");
+		Check(cursorOk, "arbitrary cursors");
+		Check(keysOk, "keyframe times and struct keys");
+	}
+
+	// Same layout as Vertex::PosNormalTexTanSkinned, so the mesh is read through
+	// strides like the demo's vertices.
+	struct SkinnedVertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+		XMFLOAT2 Tex;
+		XMFLOAT4 TangentU;
+		XMFLOAT3 Weights;
+		unsigned char BoneIndices[4];
+	};
+
+	// SkinnedVS in NormalMap.fx for one vertex, with the normal and tangent 
+	// normalized like CpuSkinning returns them.
+	void SkinVertex(const SkinnedVertex& v, const XMFLOAT4X4* palette, 
+		XMFLOAT3& pos, XMFLOAT3& normal, XMFLOAT3& tangent)
+	{
+		float weights[4] = { v.Weights.x, v.Weights.y, v.Weights.z, 0.0f };
+		weights[3] = 1.0f - weights[0] - weights[1] - weights[2];
+
+		float p[3] = { 0.0f, 0.0f, 0.0f };
+		float n[3] = { 0.0f, 0.0f, 0.0f };
+		float t[3] = { 0.0f, 0.0f, 0.0f };
+		for(int i = 0; i < 4; ++i)
+		{
+			const XMFLOAT4X4& M = palette[v.BoneIndices[i]];
+			for(int c = 0; c < 3; ++c)
+			{
+				p[c] += weights[i]*(v.Pos.x*M(0, c) + v.Pos.y*M(1, c) + v.Pos.z*M(2, c) + M(3, c));
+				n[c] += weights[i]*(v.Normal.x*M(0, c) + v.Normal.y*M(1, c) + v.Normal.z*M(2, c));
+				t[c] += weights[i]*(v.TangentU.x*M(0, c) + v.TangentU.y*M(1, c) + v.TangentU.z*M(2, c));
+			}
+		}
+
+		float nl = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+		float tl = sqrtf(t[0]*t[0] + t[1]*t[1] + t[2]*t[2]);
+
+		pos     = XMFLOAT3(p[0], p[1], p[2]);
+		normal  = XMFLOAT3(n[0]/nl, n[1]/nl, n[2]/nl);
+		tangent = XMFLOAT3(t[0]/tl, t[1]/tl, t[2]/tl);
+	}
+
+	float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		float d[3] = { a.x - b.x, a.y - b.y, a.z - b.z };
+		return sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+	}
+
+	bool SameVectors(const XMFLOAT3* a, const XMFLOAT3* b, unsigned count)
+	{
+		for(unsigned i = 0; i < count; ++i)
+		{
+			if( a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z )
+				return false;
+		}
+
+		return true;
+	}
+
+	void TestCpuSkinning()
+	{
+		printf("cpu skinning\n");
+
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+		// Rigid bones with a uniform scale each, as the shader assumes for normals.
+		const unsigned numBones = 58;
+		std::vector<XMFLOAT4X4> palette(numBones);
+		for(unsigned b = 0; b < numBones; ++b)
+		{
+			XMVECTOR axis = XMVector3Normalize(XMVectorSet(signedUnit(rng), signedUnit(rng), signedUnit(rng), 0.0f));
+			XMMATRIX M = XMMatrixScalingFromVector(XMVectorReplicate(0.5f + unit(rng))) * 
+				XMMatrixRotationQuaternion(XMQuaternionRotationAxis(axis, 6.28f*unit(rng))) * 
+				XMMatrixTranslation(20.0f*signedUnit(rng), 20.0f*signedUnit(rng), 20.0f*signedUnit(rng));
+			XMStoreFloat4x4(&palette[b], M);
+		}
+
+		// Counts that fill whole blocks, leave 1 to 3 lanes of the last block empty,
+		// and span several parallel tasks.
+		const unsigned counts[] = { 1, 2, 3, 4, 5, 7, 8, 1023, 4096, 10001 };
+
+		float maxPosError     = 0.0f;
+		float maxNormalError  = 0.0f;
+		float maxTangentError = 0.0f;
+		bool paddingOk        = true;
+		bool optionalOk       = true;
+		for(int c = 0; c < 10; ++c)
+		{
+			unsigned count = counts[c];
+
+			std::vector<SkinnedVertex> vertices(count);
+			for(unsigned i = 0; i < count; ++i)
+			{
+				SkinnedVertex& v = vertices[i];
+				v.Pos = XMFLOAT3(10.0f*signedUnit(rng), 10.0f*signedUnit(rng), 10.0f*signedUnit(rng));
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(signedUnit(rng), signedUnit(rng), signedUnit(rng), 0.0f)));
+				v.Tex = XMFLOAT2(unit(rng), unit(rng));
+
+				XMVECTOR tangent = XMVector3Cross(XMLoadFloat3(&v.Normal), XMVectorSet(signedUnit(rng), signedUnit(rng), signedUnit(rng), 0.0f));
+				XMStoreFloat4(&v.TangentU, XMVectorSetW(XMVector3Normalize(tangent), 1.0f));
+
+				// One to four influences, zero weights on the unused ones.
+				unsigned numInfluences = 1 + (unsigned)(unit(rng)*4.0f) % 4;
+				float w[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				float sum = 0.0f;
+				for(unsigned k = 0; k < numInfluences; ++k)
+				{
+					w[k] = 0.1f + unit(rng);
+					sum += w[k];
+				}
+				v.Weights = XMFLOAT3(w[0]/sum, w[1]/sum, w[2]/sum);
+
+				for(int k = 0; k < 4; ++k)
+					v.BoneIndices[k] = (unsigned char)(unit(rng)*numBones) % numBones;
+			}
+
+			CpuSkinning::MeshDesc desc;
+			desc.NumVertices = count;
+			desc.Stride      = sizeof(SkinnedVertex);
+			desc.Positions   = &vertices[0].Pos;
+			desc.Normals     = &vertices[0].Normal;
+			desc.Tangents    = &vertices[0].TangentU;
+			desc.Weights     = &vertices[0].Weights;
+			desc.BoneIndices = vertices[0].BoneIndices;
+
+			CpuSkinning skinning;
+			skinning.Build(desc);
+			if( skinning.GetVertexCount() != count || !skinning.HasNormals() || !skinning.HasTangents() )
+				optionalOk = false;
+
+			// Guard elements past the end of each output catch writes from the (up
+			// to three) padded lanes of the last block.
+			const XMFLOAT3 guard(1234.0f, 5678.0f, 9012.0f);
+			std::vector<XMFLOAT3> positions(count+3, guard);
+			std::vector<XMFLOAT3> normals(count+3, guard);
+			std::vector<XMFLOAT3> tangents(count+3, guard);
+			skinning.Skin(&palette[0], &positions[0], &normals[0], &tangents[0]);
+
+			const std::vector<XMFLOAT3>* outputs[3] = { &positions, &normals, &tangents };
+			for(int k = 0; k < 3; ++k)
+			{
+				for(unsigned i = count; i < count+3; ++i)
+				{
+					const XMFLOAT3& v = (*outputs[k])[i];
+					if( v.x != guard.x || v.y != guard.y || v.z != guard.z )
+						paddingOk = false;
+				}
+			}
+
+			for(unsigned i = 0; i < count; ++i)
+			{
+				XMFLOAT3 pos, normal, tangent;
+				SkinVertex(vertices[i], &palette[0], pos, normal, tangent);
+
+				// Positions reach about 50 units from the origin.
+				maxPosError     = std::max(maxPosError, Distance(pos, positions[i]) / 50.0f);
+				maxNormalError  = std::max(maxNormalError, Distance(normal, normals[i]));
+				maxTangentError = std::max(maxTangentError, Distance(tangent, tangents[i]));
+			}
+
+			// Positions only: null outputs, and a mesh without normals or tangents.
+			std::vector<XMFLOAT3> positionsOnly(count+3);
+			skinning.Skin(&palette[0], &positionsOnly[0], 0, 0);
+			if( !SameVectors(&positionsOnly[0], &positions[0], count) )
+				optionalOk = false;
+
+			desc.Normals  = 0;
+			desc.Tangents = 0;
+			CpuSkinning positionSkinning;
+			positionSkinning.Build(desc);
+
+			std::fill(normals.begin(), normals.end(), guard);
+			positionSkinning.Skin(&palette[0], &positionsOnly[0], &normals[0], 0);
+			if( positionSkinning.HasNormals() || positionSkinning.HasTangents() || 
+				!SameVectors(&positionsOnly[0], &positions[0], count) ||
+				normals[0].x != guard.x )
+			{
+				optionalOk = false;
+			}
+		}
+
+		printf("    max errors: position %g (relative), normal %g, tangent %g\n", 
+			maxPosError, maxNormalError, maxTangentError);
+		Check(maxPosError < 1e-5f, "positions match SkinnedVS");
+		Check(maxNormalError < 1e-3f, "normals match SkinnedVS");
+		Check(maxTangentError < 1e-3f, "tangents match SkinnedVS");
+		Check(paddingOk, "padded lanes are not written");
+		Check(optionalOk, "normals and tangents are optional");
+	}
+
+	// Angle of the rotation from q0 to q1, in double precision.
+	double RotationAngle(FXMVECTOR q0, FXMVECTOR q1)
+	{
+		XMFLOAT4 a, b;
+		XMStoreFloat4(&a, q0);
+		XMStoreFloat4(&b, q1);
+
+		double dot = (double)a.x*b.x + (double)a.y*b.y + (double)a.z*b.z + (double)a.w*b.w;
+		double sign = dot < 0.0 ? -1.0 : 1.0;
+
+		double dx = a.x - sign*b.x, dy = a.y - sign*b.y, dz = a.z - sign*b.z, dw = a.w - sign*b.w;
+		double sx = a.x + sign*b.x, sy = a.y + sign*b.y, sz = a.z + sign*b.z, sw = a.w + sign*b.w;
+		return 4.0*atan2(sqrt(dx*dx + dy*dy + dz*dz + dw*dw), sqrt(sx*sx + sy*sy + sz*sz + sw*sw));
+	}
+
+	// How far the end of a bone of length boneLength moves between two local 
+	// transforms; the error CompressedClip bounds.
+	float BoneError(const BoneTransform& a, const BoneTransform& b, float boneLength)
+	{
+		XMFLOAT3 scaleDiff;
+		XMStoreFloat3(&scaleDiff, XMVectorAbs(XMLoadFloat3(&a.Scale) - XMLoadFloat3(&b.Scale)));
+
+		return Distance(a.Translation, b.Translation) + 
+			boneLength*(float)RotationAngle(XMLoadFloat4(&a.RotationQuat), XMLoadFloat4(&b.RotationQuat)) +
+			boneLength*std::max(scaleDiff.x, std::max(scaleDiff.y, scaleDiff.z));
+	}
+
+	// The bone lengths CompressedClip::Build measures: the distance to the
+	// farthest child in the first pose, or for bones without children the 
+	// distance to the parent.
+	std::vector<float> BoneLengths(const AnimationClip& clip, const std::vector<int>& hierarchy)
+	{
+		unsigned numBones = (unsigned)hierarchy.size();
+		std::vector<float> lengths(numBones, 0.0f);
+		for(unsigned b = 0; b < numBones; ++b)
+		{
+			float d = Distance(clip.BoneAnimations[b].Keyframes[0].Translation, XMFLOAT3(0.0f, 0.0f, 0.0f));
+			if( hierarchy[b] >= 0 )
+				lengths[hierarchy[b]] = std::max(lengths[hierarchy[b]], d);
+		}
+
+		for(unsigned b = 0; b < numBones; ++b)
+		{
+			if( lengths[b] <= 0.0f )
+			{
+				float d = Distance(clip.BoneAnimations[b].Keyframes[0].Translation, XMFLOAT3(0.0f, 0.0f, 0.0f));
+				lengths[b] = d > 0.0f ? d : 1.0f;
+			}
+		}
+
+		return lengths;
+	}
+
+	// Largest bone error of the compressed clip at the keys of the clip it was
+	// built from.
+	float MaxKeyError(const PackedClip& packed, const CompressedClip& compressed, const std::vector<float>& boneLengths)
+	{
+		unsigned numBones = packed.BoneCount();
+		std::vector<BoneTransform> expected(numBones);
+		std::vector<BoneTransform> sampled(numBones);
+
+		unsigned packedCursor = 0;
+		unsigned compressedCursor = 0;
+		float maxError = 0.0f;
+		for(unsigned k = 0; k < packed.KeyCount(); ++k)
+		{
+			float t = packed.GetKeyTime(k);
+			packed.Sample(t, packedCursor, &expected[0]);
+			compressed.Sample(t, compressedCursor, &sampled[0]);
+
+			for(unsigned b = 0; b < numBones; ++b)
+				maxError = std::max(maxError, BoneError(sampled[b], expected[b], boneLengths[b]));
+		}
+
+		return maxError;
+	}
+
+	// One bone animation with a key at each of the times.  The bone sits at 
+	// offset from its parent, and each of its tracks follows a sum of sines of
+	// the given amplitude (radians for rotation) plus noise.
+	struct TrackMotion
+	{
+		float Amplitude;
+		float Frequency;
+		float Noise;
+	};
+
+	BoneAnimation MakeBoneAnimation(const std::vector<float>& times, const XMFLOAT3& offset, 
+		const TrackMotion& rotation, const TrackMotion& translation, const TrackMotion& scale,
+		std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		XMVECTOR axis = XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f) + XMVectorSet(0.0f, 0.0f, 0.01f, 0.0f));
+		XMVECTOR baseRotation = XMQuaternionRotationAxis(axis, 3.0f*unit(rng));
+		float phase = 3.0f*unit(rng);
+
+		BoneAnimation anim;
+		anim.Keyframes.resize(times.size());
+		for(size_t k = 0; k < times.size(); ++k)
+		{
+			float t = times[k];
+			Keyframe& key = anim.Keyframes[k];
+			key.TimePos = t;
+
+			float r = rotation.Amplitude*sinf(rotation.Frequency*t + phase) + rotation.Noise*unit(rng);
+			XMStoreFloat4(&key.RotationQuat, XMQuaternionMultiply(baseRotation, XMQuaternionRotationAxis(axis, r)));
+
+			float p = translation.Amplitude*sinf(translation.Frequency*t + phase);
+			key.Translation = XMFLOAT3(
+				offset.x + p + translation.Noise*unit(rng),
+				offset.y + 0.5f*p + translation.Noise*unit(rng),
+				offset.z + translation.Noise*unit(rng));
+
+			float s = scale.Amplitude*sinf(scale.Frequency*t + phase);
+			key.Scale = XMFLOAT3(
+				1.0f + s + scale.Noise*unit(rng),
+				1.0f + s + scale.Noise*unit(rng),
+				1.0f + scale.Noise*unit(rng));
+		}
+
+		return anim;
+	}
+
+	std::vector<float> MakeKeyTimes(unsigned count, float step, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		std::vector<float> times(count);
+		float t = unit(rng);
+		for(unsigned k = 0; k < count; ++k)
+		{
+			times[k] = t;
+			t += step*(0.5f + unit(rng));
+		}
+
+		return times;
+	}
+
+	// A single bone clip whose tracks move by the given fractions of maxError
+	// (as bone error) at alternating keys.
+	AnimationClip MakeWobbleClip(float maxError, float rotation, float translation, float scale)
+	{
+		AnimationClip clip;
+		clip.BoneAnimations.resize(1);
+
+		std::vector<Keyframe>& keys = clip.BoneAnimations[0].Keyframes;
+		keys.resize(64);
+		for(unsigned k = 0; k < keys.size(); ++k)
+		{
+			float w = (k % 2) ? maxError : 0.0f;
+
+			// The bone has no children, so its length is its distance to the
+			// parent, 1.
+			keys[k].TimePos = k/30.0f;
+			keys[k].Translation = XMFLOAT3(1.0f + translation*w, 0.0f, 0.0f);
+			keys[k].Scale = XMFLOAT3(1.0f + scale*w, 1.0f, 1.0f);
+			XMStoreFloat4(&keys[k].RotationQuat, XMQuaternionRotationAxis(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), rotation*w));
+		}
+
+		return clip;
+	}
+
+	void TestCompressedClip()
+	{
+		printf("compressed clip\n");
+
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		//
+		// Smallest three round trip.  The three smaller components are rounded by
+		// at most d = 1/(32767*sqrt(2)) and the recomputed largest one by at most
+		// 3d, so the quaternion moves by at most sqrt(12)*d and the rotation by 
+		// twice that, 1.5e-4 radians.
+		//
+
+		std::vector<XMFLOAT4> quats;
+		quats.push_back(XMFLOAT4(1.0f, 0.0f, 0.0f, 0.0f));
+		quats.push_back(XMFLOAT4(0.0f, -1.0f, 0.0f, 0.0f));
+		quats.push_back(XMFLOAT4(0.0f, 0.0f, 1.0f, 0.0f));
+		quats.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, -1.0f));
+		quats.push_back(XMFLOAT4(0.5f, 0.5f, 0.5f, 0.5f));
+		quats.push_back(XMFLOAT4(-0.5f, 0.5f, -0.5f, 0.5f));
+		quats.push_back(XMFLOAT4(0.70710678f, 0.0f, -0.70710678f, 0.0f));
+		for(int i = 0; i < 100000; ++i)
+		{
+			XMFLOAT4 q;
+			XMStoreFloat4(&q, XMQuaternionNormalize(XMVectorSet(unit(rng), unit(rng), unit(rng), unit(rng))));
+			quats.push_back(q);
+		}
+
+		float maxAngle = 0.0f;
+		float maxLengthError = 0.0f;
+		for(size_t i = 0; i < quats.size(); ++i)
+		{
+			XMVECTOR q = XMLoadFloat4(&quats[i]);
+
+			unsigned short packed[3];
+			CompressedClip::EncodeQuaternion(q, packed);
+			XMVECTOR decoded = CompressedClip::DecodeQuaternion(packed);
+
+			maxAngle = std::max(maxAngle, (float)RotationAngle(q, decoded));
+			maxLengthError = std::max(maxLengthError, fabsf(XMVectorGetX(XMVector4Length(decoded)) - 1.0f));
+		}
+
+		printf("    smallest three: max angle %g rad, max length error %g\n", maxAngle, maxLengthError);
+		Check(maxAngle < 2e-4f, "smallest three decodes to the encoded rotation");
+		Check(maxLengthError < 1e-5f, "smallest three decodes to a unit quaternion");
+
+		//
+		// Random clips: a chain and a branching hierarchy, with still, smooth and
+		// noisy bones, and several error bounds.
+		//
+
+		const float maxErrors[] = { 0.1f, 0.01f, 0.001f };
+
+		bool boundOk = true;
+		bool buildOk = true;
+		bool keysRemovedOk = true;
+		float worstRatio = 0.0f;
+
+		for(int c = 0; c < 12; ++c)
+		{
+			unsigned numBones = 1 + (unsigned)(c*3 % 13);
+			std::vector<int> hierarchy(numBones);
+			for(unsigned b = 0; b < numBones; ++b)
+				hierarchy[b] = b == 0 ? -1 : (c % 2 ? (int)b-1 : (int)(b-1)/2);
+
+			unsigned numKeys = c < 2 ? 2 + c : 50 + 40*c;
+			std::vector<float> times = MakeKeyTimes(numKeys, 1.0f/30.0f, rng);
+
+			AnimationClip clip;
+			clip.BoneAnimations.resize(numBones);
+			for(unsigned b = 0; b < numBones; ++b)
+			{
+				XMFLOAT3 offset(unit(rng), 1.0f + unit(rng), unit(rng));
+
+				TrackMotion still = { 0.0f, 0.0f, 0.0f };
+				TrackMotion rotation = still;
+				TrackMotion translation = still;
+				TrackMotion scale = still;
+
+				switch( b % 4 )
+				{
+				case 1:
+					rotation.Amplitude = 1.0f;
+					rotation.Frequency = 2.0f;
+					translation.Amplitude = 0.2f;
+					translation.Frequency = 3.0f;
+					break;
+				case 2:
+					rotation.Amplitude = 0.5f;
+					rotation.Frequency = 7.0f;
+					rotation.Noise = 0.01f;
+					translation.Noise = 0.002f;
+					break;
+				case 3:
+					scale.Amplitude = 0.3f;
+					scale.Frequency = 1.0f;
+					rotation.Noise = 0.0005f;
+					break;
+				}
+
+				clip.BoneAnimations[b] = MakeBoneAnimation(times, offset, rotation, translation, scale, rng);
+			}
+
+			PackedClip packed;
+			packed.Build(clip);
+			std::vector<float> boneLengths = BoneLengths(clip, hierarchy);
+
+			for(int e = 0; e < 3; ++e)
+			{
+				CompressedClip compressed;
+				if( !compressed.Build(packed, hierarchy, maxErrors[e]) )
+					buildOk = false;
+
+				float error = MaxKeyError(packed, compressed, boneLengths);
+				worstRatio = std::max(worstRatio, error / maxErrors[e]);
+				if( error > maxErrors[e]*1.0001f )
+					boundOk = false;
+
+				if( compressed.KeyCount() > packed.KeyCount() || 
+					(numKeys > 100 && e == 0 && compressed.KeyCount() >= packed.KeyCount()) )
+				{
+					keysRemovedOk = false;
+				}
+			}
+		}
+
+		printf("    random clips: worst key error %.3f of the bound\n", worstRatio);
+		Check(buildOk, "random clips compress within the bound");
+		Check(boundOk, "no bone end moves more than the bound at any key");
+		Check(keysRemovedOk, "keys are removed");
+
+		//
+		// Tracks that are each within half the bound, but not together, cannot
+		// all be constant.  A single track that is stays constant, so its clip
+		// is as small as a still one.
+		//
+
+		const float wobbleError = 0.01f;
+		std::vector<int> rootOnly(1, -1);
+
+		PackedClip still, single, together;
+		still.Build(MakeWobbleClip(wobbleError, 0.0f, 0.0f, 0.0f));
+		single.Build(MakeWobbleClip(wobbleError, 0.4f, 0.0f, 0.0f));
+		together.Build(MakeWobbleClip(wobbleError, 0.2f, 0.2f, 0.2f));
+
+		CompressedClip stillCompressed, singleCompressed, togetherCompressed;
+		stillCompressed.Build(still, rootOnly, wobbleError);
+		singleCompressed.Build(single, rootOnly, wobbleError);
+		togetherCompressed.Build(together, rootOnly, wobbleError);
+
+		Check(singleCompressed.GetResidentBytes() == stillCompressed.GetResidentBytes(), 
+			"a track within half the bound is constant");
+		Check(togetherCompressed.GetResidentBytes() > stillCompressed.GetResidentBytes(), 
+			"constant tracks are bounded together");
+
+		//
+		// Linear motion interpolates exactly, so however long the clip, only its
+		// ends are kept.
+		//
+
+		std::vector<float> linearTimes(5000);
+		for(unsigned k = 0; k < linearTimes.size(); ++k)
+			linearTimes[k] = k/30.0f;
+
+		AnimationClip linear;
+		linear.BoneAnimations.resize(3);
+		for(unsigned b = 0; b < 3; ++b)
+		{
+			std::vector<Keyframe>& keys = linear.BoneAnimations[b].Keyframes;
+			keys.resize(linearTimes.size());
+			for(unsigned k = 0; k < keys.size(); ++k)
+			{
+				float t = linearTimes[k];
+				keys[k].TimePos = t;
+				keys[k].Translation = XMFLOAT3(0.01f*t, 1.0f + 0.002f*t*b, 0.0f);
+			}
+		}
+
+		PackedClip linearPacked;
+		linearPacked.Build(linear);
+		std::vector<int> chain(3);
+		chain[0] = -1; chain[1] = 0; chain[2] = 1;
+
+		CompressedClip linearCompressed;
+		linearCompressed.Build(linearPacked, chain, 0.01f);
+		printf("    linear clip: %u keys to %u\n", linearPacked.KeyCount(), linearCompressed.KeyCount());
+		Check(linearCompressed.KeyCount() == 2, "spans are not capped");
+
+		//
+		// A translation range too large for 16 bits at the bound cannot meet it,
+		// even when every key is kept (two keys).
+		//
+
+		AnimationClip far;
+		far.BoneAnimations.resize(1);
+		far.BoneAnimations[0].Keyframes.resize(2);
+		far.BoneAnimations[0].Keyframes[0].Translation = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		far.BoneAnimations[0].Keyframes[1].TimePos = 1.0f;
+		far.BoneAnimations[0].Keyframes[1].Translation = XMFLOAT3(0.0f, 0.0f, 1000.0f);
+
+		// Keys at the ends of the range quantize exactly, so add one in between.
+		Keyframe middle = far.BoneAnimations[0].Keyframes[1];
+		middle.TimePos = 0.5f;
+		middle.Translation = XMFLOAT3(0.2f, 0.0f, 123.4567f);
+		AnimationClip farMiddle = far;
+		farMiddle.BoneAnimations[0].Keyframes.insert(farMiddle.BoneAnimations[0].Keyframes.begin() + 1, middle);
+
+		PackedClip farPacked, farMiddlePacked;
+		farPacked.Build(far);
+		farMiddlePacked.Build(farMiddle);
+
+		CompressedClip farCompressed;
+		Check(farCompressed.Build(farPacked, rootOnly, 0.001f) && farCompressed.KeyCount() == 2, 
+			"two key clips are checked and kept");
+		Check(!farCompressed.Build(farMiddlePacked, rootOnly, 0.001f), 
+			"quantization beyond the bound is reported");
+	}
+}
+
+int main()
+{
+	TestKeyframeSearch();
+	TestCpuSkinning();
+	TestCompressedClip();
+
+	if( gNumFailed > 0 )
+	{
+		printf("%d checks failed\n", gNumFailed);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
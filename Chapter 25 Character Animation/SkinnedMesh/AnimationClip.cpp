@@ -0,0 +1,118 @@
+//***************************************************************************************
+// AnimationClip.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "AnimationClip.h"
+#include "KeyframeSearch.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+Keyframe::Keyframe()
+	: TimePos(0.0f),
+	Translation(0.0f, 0.0f, 0.0f),
+	Scale(1.0f, 1.0f, 1.0f),
+	RotationQuat(0.0f, 0.0f, 0.0f, 1.0f)
+{
+}
+
+Keyframe::~Keyframe()
+{
+}
+ 
+float BoneAnimation::GetStartTime()const
+{
+	// Keyframes are sorted by time, so first keyframe gives start time.
+	return Keyframes.front().TimePos;
+}
+
+float BoneAnimation::GetEndTime()const
+{
+	// Keyframes are sorted by time, so last keyframe gives end time.
+	float f = Keyframes.back().TimePos;
+
+	return f;
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	if( t <= Keyframes.front().TimePos )
+	{
+		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
+		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
+		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
+
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+	else if( t >= Keyframes.back().TimePos )
+	{
+		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
+		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
+		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
+
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+	else
+	{
+		unsigned i = FindKeyframe(t, 0);
+
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
+
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
+
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
+
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
+
+		XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+		XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+		XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+}
+
+unsigned BoneAnimation::FindKeyframe(float t, unsigned cursor)const
+{
+	return KeyframeSearch::Find(&Keyframes[0], Keyframes.size(), t, cursor,
+		[](const Keyframe& key) { return key.TimePos; });
+}
+
+float AnimationClip::GetClipStartTime()const
+{
+	// Find smallest start time over all bones in this clip.
+	float t = FLT_MAX;
+	for(unsigned i = 0; i < BoneAnimations.size(); ++i)
+	{
+		t = std::min(t, BoneAnimations[i].GetStartTime());
+	}
+
+	return t;
+}
+
+float AnimationClip::GetClipEndTime()const
+{
+	// Find largest end time over all bones in this clip.
+	float t = 0.0f;
+	for(unsigned i = 0; i < BoneAnimations.size(); ++i)
+	{
+		t = std::max(t, BoneAnimations[i].GetEndTime());
+	}
+
+	return t;
+}
+
+void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
+{
+	for(unsigned i = 0; i < BoneAnimations.size(); ++i)
+	{
+		BoneAnimations[i].Interpolate(t, boneTransforms[i]);
+	}
+}
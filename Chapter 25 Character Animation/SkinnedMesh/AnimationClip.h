@@ -0,0 +1,68 @@
+//***************************************************************************************
+// AnimationClip.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Keyframed bone animations, as loaded from a model file.  SkinnedData repacks
+// them into PackedClips or CompressedClips for sampling.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef ANIMATIONCLIP_H
+#define ANIMATIONCLIP_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+///<summary>
+/// A Keyframe defines the bone transformation at an instant in time.
+///</summary>
+struct Keyframe
+{
+	Keyframe();
+	~Keyframe();
+
+    float TimePos;
+	DirectX::XMFLOAT3 Translation;
+	DirectX::XMFLOAT3 Scale;
+	DirectX::XMFLOAT4 RotationQuat;
+};
+
+///<summary>
+/// A BoneAnimation is defined by a list of keyframes.  For time
+/// values inbetween two keyframes, we interpolate between the
+/// two nearest keyframes that bound the time.  
+///
+/// We assume an animation always has two keyframes.
+///</summary>
+struct BoneAnimation
+{
+	float GetStartTime()const;
+	float GetEndTime()const;
+
+    void Interpolate(float t, DirectX::XMFLOAT4X4& M)const;
+
+	// Index i of the keyframes i and i+1 that bound t, which must lie strictly
+	// between the start and end times, searching from cursor (see KeyframeSearch).
+	unsigned FindKeyframe(float t, unsigned cursor)const;
+
+	std::vector<Keyframe> Keyframes; 	
+
+};
+
+///<summary>
+/// Examples of AnimationClips are "Walk", "Run", "Attack", "Defend".
+/// An AnimationClip requires a BoneAnimation for every bone to form
+/// the animation clip.    
+///</summary>
+struct AnimationClip
+{
+	float GetClipStartTime()const;
+	float GetClipEndTime()const;
+
+    void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms)const;
+
+    std::vector<BoneAnimation> BoneAnimations; 	
+};
+
+#endif // ANIMATIONCLIP_H
@@ -0,0 +1,309 @@
+//***************************************************************************************
+// AnimationSystem.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "AnimationSystem.h"
+#include "ParallelFor.h"
+#include "PoseBlend.h"
+
+namespace
+{
+	// Instances per parallel task.  An instance takes a few microseconds, so
+	// several are batched to keep the scheduling overhead small.
+	const size_t InstancesPerTask = 8;
+}
+
+AnimationSystem::InstanceState::InstanceState()
+	: TimeSinceEvaluation(0.0f), EvaluationSpan(0.0f), HasPose(false)
+{
+}
+
+AnimationSystem::AnimationSystem()
+	: mOffscreenBudget(UINT_MAX), mNextOffscreen(0),
+	  mEvaluatedInstanceCount(0), mInterpolatedInstanceCount(0),
+	  mEvaluatedBoneCount(0), mInterpolatedBoneCount(0)
+{
+}
+
+AnimationSystem::~AnimationSystem()
+{
+}
+
+UINT AnimationSystem::AddInstance(SkinnedModelInstance* instance)
+{
+	mInstances.push_back(instance);
+	mPaletteOffsets.push_back(mPalettes.size());
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	mPalettes.resize(mPalettes.size() + instance->Model->SkinnedData.BoneCount(), identity);
+
+	mBoundsCenters.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+	mBoundsExtents.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+	mStates.push_back(InstanceState());
+	mActions.push_back(SkipUpdate);
+
+	return mInstances.size()-1;
+}
+
+void AnimationSystem::Clear()
+{
+	mInstances.clear();
+	mPaletteOffsets.clear();
+	mPalettes.clear();
+	mBoundsCenters.clear();
+	mBoundsExtents.clear();
+	mStates.clear();
+	mActions.clear();
+	mNextOffscreen = 0;
+}
+
+UINT AnimationSystem::InstanceCount()const
+{
+	return mInstances.size();
+}
+
+void AnimationSystem::Update(float dt)
+{
+	for(UINT i = 0; i < mInstances.size(); ++i)
+	{
+		mInstances[i]->Advance(dt);
+	}
+
+	ScheduleUpdates(dt);
+	RequestPoses();
+
+	// Blend the poses of each instance, walk its hierarchy and bound the result.
+	ParallelFor::Run(mInstances.size(), InstancesPerTask, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			if( mActions[i] != SkipUpdate )
+				UpdateInstance((UINT)i);
+		}
+	});
+}
+
+void AnimationSystem::SetOffscreenBudget(UINT instancesPerUpdate)
+{
+	mOffscreenBudget = instancesPerUpdate;
+}
+
+void AnimationSystem::SetPoseTimeQuantum(float seconds)
+{
+	mPoseCache.SetTimeQuantum(seconds);
+}
+
+UINT AnimationSystem::GetSampledPoseCount()const
+{
+	return mPoseCache.GetSampledPoseCount();
+}
+
+UINT AnimationSystem::GetRequestedPoseCount()const
+{
+	return mPoseCache.GetRequestCount();
+}
+
+UINT AnimationSystem::GetEvaluatedInstanceCount()const
+{
+	return mEvaluatedInstanceCount;
+}
+
+UINT AnimationSystem::GetInterpolatedInstanceCount()const
+{
+	return mInterpolatedInstanceCount;
+}
+
+UINT AnimationSystem::GetEvaluatedBoneCount()const
+{
+	return mEvaluatedBoneCount;
+}
+
+UINT AnimationSystem::GetInterpolatedBoneCount()const
+{
+	return mInterpolatedBoneCount;
+}
+
+void AnimationSystem::ScheduleUpdates(float dt)
+{
+	UINT numInstances = mInstances.size();
+	UINT numOffscreen = 0;
+
+	for(UINT i = 0; i < numInstances; ++i)
+	{
+		const SkinnedModelInstance& instance = *mInstances[i];
+		InstanceState& state = mStates[i];
+
+		state.TimeSinceEvaluation += dt;
+
+		if( !instance.Visible )
+		{
+			// Start over from a fresh pose once it is seen again.
+			mActions[i] = SkipUpdate;
+			state.HasPose = false;
+			++numOffscreen;
+		}
+		else if( instance.Lod.UpdateInterval <= 0.0f )
+		{
+			// The key poses are not kept up to date, so if the LOD drops to a
+			// nonzero interval later, start over from a fresh key pose instead of
+			// interpolating toward a stale one.
+			mActions[i] = EvaluatePose;
+			state.HasPose = false;
+			state.TimeSinceEvaluation = 0.0f;
+		}
+		else if( !state.HasPose || state.TimeSinceEvaluation >= instance.Lod.UpdateInterval )
+		{
+			mActions[i] = EvaluateKeyPose;
+
+			state.EvaluationSpan = state.HasPose ? state.TimeSinceEvaluation : 0.0f;
+			state.TimeSinceEvaluation = 0.0f;
+			state.HasPose = true;
+		}
+		else
+		{
+			mActions[i] = InterpolatePose;
+		}
+	}
+
+	// Spend the budget on the off-screen instances, continuing from where the
+	// last Update stopped.
+	UINT budget = MathHelper::Min(mOffscreenBudget, numOffscreen);
+	for(UINT n = 0; n < budget; )
+	{
+		UINT i = mNextOffscreen;
+		mNextOffscreen = (mNextOffscreen + 1) % numInstances;
+
+		if( !mInstances[i]->Visible )
+		{
+			mActions[i] = EvaluatePose;
+			++n;
+		}
+	}
+
+	mEvaluatedInstanceCount = 0;
+	mInterpolatedInstanceCount = 0;
+	mEvaluatedBoneCount = 0;
+	mInterpolatedBoneCount = 0;
+
+	for(UINT i = 0; i < numInstances; ++i)
+	{
+		if( mActions[i] == SkipUpdate )
+			continue;
+
+		const SkinnedModelInstance& instance = *mInstances[i];
+		UINT numBones = instance.Model->SkinnedData.GetLodBoneCount(instance.Lod.MaxBoneDepth);
+
+		if( mActions[i] == InterpolatePose )
+		{
+			++mInterpolatedInstanceCount;
+			mInterpolatedBoneCount += numBones;
+		}
+		else
+		{
+			++mEvaluatedInstanceCount;
+			mEvaluatedBoneCount += numBones;
+		}
+	}
+}
+
+void AnimationSystem::RequestPoses()
+{
+	mPoseCache.Clear();
+	mFirstRequests.clear();
+
+	for(UINT i = 0; i < mInstances.size(); ++i)
+	{
+		mFirstRequests.push_back(mPoseCache.GetRequestCount());
+
+		if( mActions[i] != EvaluatePose && mActions[i] != EvaluateKeyPose )
+			continue;
+
+		mSources.clear();
+		mInstances[i]->GetPoseSources(mSources);
+
+		for(UINT j = 0; j < mSources.size(); ++j)
+		{
+			mPoseCache.Request(&mInstances[i]->Model->SkinnedData, mSources[j].ClipIndex,
+				mSources[j].TimePos, mSources[j].KeyframeCursor);
+		}
+	}
+
+	mPoseCache.Evaluate();
+
+	mSourcePoses.resize(mPoseCache.GetRequestCount());
+	for(UINT i = 0; i < mSourcePoses.size(); ++i)
+	{
+		mSourcePoses[i] = mPoseCache.GetPose(i);
+	}
+}
+
+void AnimationSystem::UpdateInstance(UINT i)
+{
+	SkinnedModelInstance& instance = *mInstances[i];
+	InstanceState& state = mStates[i];
+	const SkinnedData& skinnedData = instance.Model->SkinnedData;
+
+	UINT numBones = skinnedData.BoneCount();
+	PoseBuffer& pose = instance.Pose;
+	if( pose.LocalTransforms.size() != numBones )
+	{
+		pose.LocalTransforms.resize(numBones);
+		pose.ToRootTransforms.resize(numBones);
+	}
+
+	if( mActions[i] == EvaluatePose )
+	{
+		instance.BlendPose(&mSourcePoses[mFirstRequests[i]], &pose.LocalTransforms[0]);
+	}
+	else
+	{
+		if( mActions[i] == EvaluateKeyPose )
+		{
+			state.PreviousPose.swap(state.LatestPose);
+			state.LatestPose.resize(numBones);
+			instance.BlendPose(&mSourcePoses[mFirstRequests[i]], &state.LatestPose[0]);
+
+			if( state.EvaluationSpan <= 0.0f )
+				state.PreviousPose = state.LatestPose;
+		}
+
+		// The pose evaluated at the start of the span is reached at its end, so 
+		// the motion stays continuous at the cost of running one span behind.
+		float s = 1.0f;
+		if( state.EvaluationSpan > 0.0f )
+			s = MathHelper::Min(state.TimeSinceEvaluation / state.EvaluationSpan, 1.0f);
+
+		PoseBlend::Lerp(&state.PreviousPose[0], &state.LatestPose[0], s, 0, numBones, 
+			&pose.LocalTransforms[0]);
+	}
+
+	XMFLOAT4X4* palette = &mPalettes[mPaletteOffsets[i]];
+
+	skinnedData.ToFinalTransforms(&pose.LocalTransforms[0], &pose.ToRootTransforms[0],
+		palette, instance.Lod.MaxBoneDepth);
+
+	instance.Model->BoneBounds.GetAnimatedBounds(palette, mBoundsCenters[i], mBoundsExtents[i]);
+}
+
+const XMFLOAT4X4* AnimationSystem::GetPalette(UINT instanceIndex)const
+{
+	return &mPalettes[mPaletteOffsets[instanceIndex]];
+}
+
+UINT AnimationSystem::GetPaletteSize(UINT instanceIndex)const
+{
+	return mInstances[instanceIndex]->Model->SkinnedData.BoneCount();
+}
+
+const std::vector<XMFLOAT4X4>& AnimationSystem::GetPalettes()const
+{
+	return mPalettes;
+}
+
+void AnimationSystem::GetBounds(UINT instanceIndex, XMFLOAT3& center, XMFLOAT3& extents)const
+{
+	center  = mBoundsCenters[instanceIndex];
+	extents = mBoundsExtents[instanceIndex];
+}
@@ -0,0 +1,154 @@
+//***************************************************************************************
+// AnimationSystem.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Updates many skinned model instances in parallel.  The final transforms of
+// all the instances are written into one contiguous array of bone palettes, so
+// they can be uploaded to the GPU in one go.
+//
+// Each frame the clip poses the instances blend are requested from a PoseCache
+// first, so a pose needed by several instances (same model, clip and quantized
+// time, e.g. a crowd playing the same idle loop, or the reference pose of an 
+// additive layer) is sampled once and shared.
+//
+// How much work each instance gets is set by its AnimationLod: fewer bones, and
+// fewer pose evaluations with interpolation in between.  Instances that are not
+// Visible are updated round-robin within a budget.
+//***************************************************************************************
+
+#ifndef ANIMATIONSYSTEM_H
+#define ANIMATIONSYSTEM_H
+
+#include "SkinnedModel.h"
+#include "PoseCache.h"
+
+class AnimationSystem
+{
+public:
+	AnimationSystem();
+	~AnimationSystem();
+
+	// Adds an instance and reserves a palette of Model->SkinnedData.BoneCount()
+	// matrices for it.  Returns the index of the instance, which is used to look
+	// up its palette.  The instance is not owned and must outlive the system, and
+	// its Model must not change after it has been added.
+	UINT AddInstance(SkinnedModelInstance* instance);
+
+	void Clear();
+
+	UINT InstanceCount()const;
+
+	// Advances every instance by dt and writes its final transforms into its
+	// palette.  Every pose sample and every instance is evaluated by exactly one
+	// thread, so the result is the same no matter how many threads are used.
+	//
+	// The palettes of instances that are not Visible, and were not updated within
+	// the off-screen budget, are left as they were.
+	void Update(float dt);
+
+	// At most this many instances that are not Visible are updated per Update, 
+	// taking turns, so their palettes and bounds do not go too stale.  They are 
+	// evaluated without interpolation.  The default updates all of them.
+	void SetOffscreenBudget(UINT instancesPerUpdate);
+
+	// Instances playing the same clip within this many seconds of each other
+	// share a pose (see PoseCache).  0, the default, only shares identical times.
+	void SetPoseTimeQuantum(float seconds);
+
+	// Number of clip poses sampled by the last Update, and the number the
+	// instances asked for before sharing.
+	UINT GetSampledPoseCount()const;
+	UINT GetRequestedPoseCount()const;
+
+	// Work done by the last Update: the instances whose pose was evaluated from
+	// their clips, and those interpolated between two earlier poses, and the 
+	// bones of each that were walked through the hierarchy (see 
+	// SkinnedData::GetLodBoneCount).
+	UINT GetEvaluatedInstanceCount()const;
+	UINT GetInterpolatedInstanceCount()const;
+	UINT GetEvaluatedBoneCount()const;
+	UINT GetInterpolatedBoneCount()const;
+
+	// Final transforms of an instance, valid until the next Update.
+	const XMFLOAT4X4* GetPalette(UINT instanceIndex)const;
+	UINT GetPaletteSize(UINT instanceIndex)const;
+
+	// The palettes of all the instances, back to back in the order they were added.
+	const std::vector<XMFLOAT4X4>& GetPalettes()const;
+
+	// Axis-aligned box of an instance's skinned mesh in its model space (before
+	// World), computed from its palette with Model->BoneBounds.  Valid until the
+	// next Update.
+	void GetBounds(UINT instanceIndex, XMFLOAT3& center, XMFLOAT3& extents)const;
+
+private:
+	enum UpdateAction
+	{
+		SkipUpdate,
+
+		// Evaluates the pose and shows it.
+		EvaluatePose,
+
+		// Evaluates the pose and shows the previous evaluation, to interpolate 
+		// toward this one until the next.
+		EvaluateKeyPose,
+
+		// Interpolates between the last two evaluations.
+		InterpolatePose
+	};
+
+	// For interpolating an instance with an AnimationLod::UpdateInterval.
+	struct InstanceState
+	{
+		InstanceState();
+
+		// Time since the pose was last evaluated, and between the last two 
+		// evaluations (0 if there is only one).
+		float TimeSinceEvaluation;
+		float EvaluationSpan;
+
+		// Whether LatestPose holds a pose to interpolate from.
+		bool HasPose;
+
+		std::vector<BoneTransform> PreviousPose;
+		std::vector<BoneTransform> LatestPose;
+	};
+
+	void ScheduleUpdates(float dt);
+	void RequestPoses();
+	void UpdateInstance(UINT instanceIndex);
+
+private:
+	std::vector<SkinnedModelInstance*> mInstances;
+
+	// Index of the first matrix of each instance's palette in mPalettes.
+	std::vector<UINT> mPaletteOffsets;
+
+	std::vector<XMFLOAT4X4> mPalettes;
+
+	std::vector<XMFLOAT3> mBoundsCenters;
+	std::vector<XMFLOAT3> mBoundsExtents;
+
+	std::vector<InstanceState> mStates;
+	std::vector<UpdateAction> mActions;
+
+	UINT mOffscreenBudget;
+
+	// The off-screen instance to update first next time.
+	UINT mNextOffscreen;
+
+	UINT mEvaluatedInstanceCount;
+	UINT mInterpolatedInstanceCount;
+	UINT mEvaluatedBoneCount;
+	UINT mInterpolatedBoneCount;
+
+	PoseCache mPoseCache;
+
+	// For each instance, the index of its first pose request, and for each
+	// request its pose.
+	std::vector<UINT> mFirstRequests;
+	std::vector<const BoneTransform*> mSourcePoses;
+
+	std::vector<PoseSource> mSources;
+};
+
+#endif // ANIMATIONSYSTEM_H
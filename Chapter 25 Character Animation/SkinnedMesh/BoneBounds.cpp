@@ -0,0 +1,122 @@
+//***************************************************************************************
+// BoneBounds.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "BoneBounds.h"
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace
+{
+	template<typename T>
+	const T& VertexData(const T* first, unsigned stride, unsigned i)
+	{
+		return *reinterpret_cast<const T*>(reinterpret_cast<const unsigned char*>(first) + (size_t)i*stride);
+	}
+}
+
+BoneBounds::BoneBounds()
+	: mNumBones(0)
+{
+}
+
+BoneBounds::~BoneBounds()
+{
+}
+
+void BoneBounds::Build(const CpuSkinning::MeshDesc& mesh, unsigned numBones)
+{
+	mNumBones = numBones;
+
+	std::vector<XMFLOAT3> boneMin(numBones, XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX));
+	std::vector<XMFLOAT3> boneMax(numBones, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+	for(unsigned i = 0; i < mesh.NumVertices; ++i)
+	{
+		XMVECTOR pos = XMLoadFloat3(&VertexData(mesh.Positions, mesh.Stride, i));
+
+		const XMFLOAT3& w = VertexData(mesh.Weights, mesh.Stride, i);
+		const unsigned char* bones = &VertexData(mesh.BoneIndices, mesh.Stride, i);
+
+		// The fourth weight is implied, as in the shader.
+		float weights[4] = { w.x, w.y, w.z, 1.0f - w.x - w.y - w.z };
+
+		for(int j = 0; j < 4; ++j)
+		{
+			if( weights[j] <= 0.0f || bones[j] >= numBones )
+				continue;
+
+			unsigned b = bones[j];
+			XMStoreFloat3(&boneMin[b], XMVectorMin(XMLoadFloat3(&boneMin[b]), pos));
+			XMStoreFloat3(&boneMax[b], XMVectorMax(XMLoadFloat3(&boneMax[b]), pos));
+		}
+	}
+
+	mCenters.assign(numBones, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	mExtents.assign(numBones, XMFLOAT3(-1.0f, -1.0f, -1.0f));
+	mBoundedBones.clear();
+
+	for(unsigned b = 0; b < numBones; ++b)
+	{
+		if( boneMin[b].x > boneMax[b].x )
+			continue;
+
+		XMVECTOR vMin = XMLoadFloat3(&boneMin[b]);
+		XMVECTOR vMax = XMLoadFloat3(&boneMax[b]);
+
+		XMStoreFloat3(&mCenters[b], 0.5f*(vMin+vMax));
+		XMStoreFloat3(&mExtents[b], 0.5f*(vMax-vMin));
+		mBoundedBones.push_back(b);
+	}
+}
+
+unsigned BoneBounds::BoneCount()const
+{
+	return mNumBones;
+}
+
+bool BoneBounds::HasBounds(unsigned bone)const
+{
+	return mExtents[bone].x >= 0.0f;
+}
+
+void BoneBounds::GetBoneBounds(unsigned bone, XMFLOAT3& center, XMFLOAT3& extents)const
+{
+	center  = mCenters[bone];
+	extents = mExtents[bone];
+}
+
+bool BoneBounds::GetAnimatedBounds(const XMFLOAT4X4* palette, XMFLOAT3& center, XMFLOAT3& extents)const
+{
+	if( mBoundedBones.empty() )
+		return false;
+
+	XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+	XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+
+	for(size_t i = 0; i < mBoundedBones.size(); ++i)
+	{
+		unsigned b = mBoundedBones[i];
+		XMMATRIX M = XMLoadFloat4x4(&palette[b]);
+
+		// The box center goes through the whole transform.  The half extents along
+		// each world axis are the box's extents projected onto it, which is the
+		// absolute value of the linear part times the extents (row vectors).
+		XMVECTOR c = XMVector3Transform(XMLoadFloat3(&mCenters[b]), M);
+
+		const XMFLOAT3& e = mExtents[b];
+		XMVECTOR r =
+			e.x*XMVectorAbs(M.r[0]) +
+			e.y*XMVectorAbs(M.r[1]) +
+			e.z*XMVectorAbs(M.r[2]);
+
+		vMin = XMVectorMin(vMin, c - r);
+		vMax = XMVectorMax(vMax, c + r);
+	}
+
+	XMStoreFloat3(&center, 0.5f*(vMin+vMax));
+	XMStoreFloat3(&extents, 0.5f*(vMax-vMin));
+
+	return true;
+}
@@ -0,0 +1,54 @@
+//***************************************************************************************
+// BoneBounds.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Bounds of a skinned mesh in any pose, computed from the bone palette alone.
+//
+// Each bone gets the axis-aligned box of the bind pose vertices it influences.
+// A skinned vertex is a weighted average of the vertex transformed by each of
+// its bones, so it lies within the union of those bones' boxes transformed by
+// their final transforms.  Transforming one box per bone is far cheaper than
+// skinning the vertices, and the result is conservative for any pose.  Only
+// depends on DirectXMath and the standard library.
+//***************************************************************************************
+
+#ifndef BONEBOUNDS_H
+#define BONEBOUNDS_H
+
+#include "CpuSkinning.h"
+
+class BoneBounds
+{
+public:
+	BoneBounds();
+	~BoneBounds();
+
+	// Computes the box of each of numBones bones from the vertices that have
+	// a nonzero weight for it.  Only the positions, weights and bone indices of
+	// the mesh are read.
+	void Build(const CpuSkinning::MeshDesc& mesh, unsigned numBones);
+
+	unsigned BoneCount()const;
+
+	// False if no vertex is weighted to the bone.
+	bool HasBounds(unsigned bone)const;
+
+	// Bind pose box of a bone, in the mesh's space.
+	void GetBoneBounds(unsigned bone, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents)const;
+
+	// Box containing the mesh skinned with the palette (final transforms, as given
+	// by SkinnedData::GetFinalTransforms).  Returns false, and leaves the box
+	// alone, if the mesh had no vertices.
+	bool GetAnimatedBounds(const DirectX::XMFLOAT4X4* palette,
+		DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents)const;
+
+private:
+	unsigned mNumBones;
+
+	std::vector<DirectX::XMFLOAT3> mCenters;
+	std::vector<DirectX::XMFLOAT3> mExtents;
+
+	// The bones that have vertices, so the others are skipped without a test.
+	std::vector<unsigned> mBoundedBones;
+};
+
+#endif // BONEBOUNDS_H
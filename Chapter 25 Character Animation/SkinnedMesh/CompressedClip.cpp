@@ -0,0 +1,550 @@
+//***************************************************************************************
+// CompressedClip.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "CompressedClip.h"
+#include "KeyframeSearch.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// The three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)].
+	const float QuatComponentMax = 0.70710678f;
+	const float QuatComponentSteps = 32767.0f;
+
+	const float RangeSteps = 65535.0f;
+
+	// Normalized lerp from q0 to q1, or to -q1 if that is closer.
+	XMVECTOR QuaternionNlerp(FXMVECTOR q0, FXMVECTOR q1, float t)
+	{
+		XMVECTOR q1Near = XMVectorGetX(XMQuaternionDot(q0, q1)) < 0.0f ? -q1 : q1;
+		return XMQuaternionNormalize(XMVectorLerp(q0, q1Near, t));
+	}
+
+	// Angle of the rotation from q0 to q1.  That is twice the angle between q0 
+	// and q1 (or -q1) as 4D unit vectors, which is 2*atan2(|q0 - q1|, |q0 + q1|).
+	// Unlike acos of their dot product, this stays accurate for the tiny angles
+	// the error bound is about.
+	float RotationAngle(FXMVECTOR q0, FXMVECTOR q1)
+	{
+		XMVECTOR q1Near = XMVectorGetX(XMQuaternionDot(q0, q1)) < 0.0f ? -q1 : q1;
+
+		float d = XMVectorGetX(XMVector4Length(q0 - q1Near));
+		float s = XMVectorGetX(XMVector4Length(q0 + q1Near));
+		return 4.0f*atan2f(d, s);
+	}
+
+	float MaxComponent(FXMVECTOR v)
+	{
+		XMFLOAT3 a;
+		XMStoreFloat3(&a, XMVectorAbs(v));
+		return std::max(a.x, std::max(a.y, a.z));
+	}
+
+	// How far the end of a bone of length boneLength moves between two transforms.
+	float BoneError(FXMVECTOR translation, FXMVECTOR scale, FXMVECTOR rotationQuat,
+		const BoneTransform& reference, float boneLength)
+	{
+		XMVECTOR refTranslation = XMLoadFloat3(&reference.Translation);
+		XMVECTOR refScale = XMLoadFloat3(&reference.Scale);
+		XMVECTOR refRotation = XMLoadFloat4(&reference.RotationQuat);
+
+		float translationError = XMVectorGetX(XMVector3Length(translation - refTranslation));
+		float rotationError = boneLength*RotationAngle(rotationQuat, refRotation);
+		float scaleError = boneLength*MaxComponent(scale - refScale);
+
+		return translationError + rotationError + scaleError;
+	}
+
+	unsigned short Quantize(float x, float minValue, float step)
+	{
+		if( step <= 0.0f )
+			return 0;
+
+		float q = (x - minValue) / step + 0.5f;
+		return (unsigned short)std::min(std::max(q, 0.0f), RangeSteps);
+	}
+}
+
+CompressedClip::CompressedClip()
+	: mNumBones(0), mKeyStride(0)
+{
+}
+
+CompressedClip::~CompressedClip()
+{
+}
+
+bool CompressedClip::Build(const PackedClip& clip, const std::vector<int>& boneHierarchy, float maxError)
+{
+	mNumBones = clip.BoneCount();
+	mKeyStride = 0;
+
+	mKeyTimes.clear();
+	mBones.assign(mNumBones, BoneTracks());
+	mSamples.clear();
+
+	unsigned numKeys = clip.KeyCount();
+	if( numKeys == 0 )
+		return true;
+
+	// The pose at every key of the clip.
+	std::vector<BoneTransform> keys(numKeys*mNumBones);
+
+	unsigned cursor = 0;
+	for(unsigned k = 0; k < numKeys; ++k)
+	{
+		clip.Sample(clip.GetKeyTime(k), cursor, &keys[k*mNumBones]);
+	}
+
+	//
+	// Bone lengths: the distance to the farthest child, or for bones without
+	// children the distance to the parent.
+	//
+
+	std::vector<float> parentDistances(mNumBones);
+	std::vector<float> boneLengths(mNumBones, 0.0f);
+
+	for(unsigned b = 0; b < mNumBones; ++b)
+	{
+		parentDistances[b] = XMVectorGetX(XMVector3Length(XMLoadFloat3(&keys[b].Translation)));
+
+		int parentIndex = boneHierarchy[b];
+		if( parentIndex >= 0 )
+			boneLengths[parentIndex] = std::max(boneLengths[parentIndex], parentDistances[b]);
+	}
+
+	for(unsigned b = 0; b < mNumBones; ++b)
+	{
+		if( boneLengths[b] <= 0.0f )
+			boneLengths[b] = parentDistances[b] > 0.0f ? parentDistances[b] : 1.0f;
+	}
+
+	//
+	// Store tracks as constants (their first key) as long as the bone error of
+	// holding all of the bone's constant tracks at once stays within half the 
+	// error bound, which leaves the other half for key removal.  The error of a
+	// bone is the sum of its track errors, so each track's error is measured at
+	// every key, and the fewest animated tracks that get the sum within the
+	// bound are picked.
+	//
+
+	float constantError = 0.5f*maxError;
+
+	// Rotation, translation and scale error at each key.
+	std::vector<XMFLOAT3> trackErrors(numKeys);
+
+	for(unsigned b = 0; b < mNumBones; ++b)
+	{
+		BoneTracks& bone = mBones[b];
+		float boneLength = boneLengths[b];
+
+		const BoneTransform& first = keys[b];
+		XMVECTOR q0 = XMLoadFloat4(&first.RotationQuat);
+		XMVECTOR p0 = XMLoadFloat3(&first.Translation);
+		XMVECTOR s0 = XMLoadFloat3(&first.Scale);
+
+		XMVECTOR pMin = p0;
+		XMVECTOR pMax = p0;
+		XMVECTOR sMin = s0;
+		XMVECTOR sMax = s0;
+
+		for(unsigned k = 0; k < numKeys; ++k)
+		{
+			const BoneTransform& key = keys[k*mNumBones + b];
+			XMVECTOR q = XMLoadFloat4(&key.RotationQuat);
+			XMVECTOR p = XMLoadFloat3(&key.Translation);
+			XMVECTOR s = XMLoadFloat3(&key.Scale);
+
+			trackErrors[k].x = boneLength*RotationAngle(q0, q);
+			trackErrors[k].y = XMVectorGetX(XMVector3Length(p - p0));
+			trackErrors[k].z = boneLength*MaxComponent(s - s0);
+
+			pMin = XMVectorMin(pMin, p);
+			pMax = XMVectorMax(pMax, p);
+			sMin = XMVectorMin(sMin, s);
+			sMax = XMVectorMax(sMax, s);
+		}
+
+		// Of the sets of animated tracks (as TrackFlags) within the bound, keep
+		// the one with the fewest tracks, then the least error.  Animating all
+		// three has no constant error, so it is the fallback.
+		unsigned animatedMask = AnimatedRotation | AnimatedTranslation | AnimatedScale;
+		float bestError = 0.0f;
+		unsigned bestCount = 3;
+
+		for(unsigned mask = 0; mask < 7; ++mask)
+		{
+			unsigned count = (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1);
+			if( count > bestCount )
+				continue;
+
+			float error = 0.0f;
+			for(unsigned k = 0; k < numKeys; ++k)
+			{
+				float keyError = 0.0f;
+				if( !(mask & AnimatedRotation) )    keyError += trackErrors[k].x;
+				if( !(mask & AnimatedTranslation) ) keyError += trackErrors[k].y;
+				if( !(mask & AnimatedScale) )       keyError += trackErrors[k].z;
+
+				error = std::max(error, keyError);
+			}
+
+			if( error <= constantError && (count < bestCount || error < bestError) )
+			{
+				animatedMask = mask;
+				bestError = error;
+				bestCount = count;
+			}
+		}
+
+		bone.Flags = animatedMask;
+		bone.Rotation = first.RotationQuat;
+		bone.TranslationMin = first.Translation;
+		bone.TranslationStep = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		bone.ScaleMin = first.Scale;
+		bone.ScaleStep = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		if( bone.Flags & AnimatedRotation )
+		{
+			bone.RotationOffset = mKeyStride;
+			mKeyStride += 3;
+		}
+
+		if( bone.Flags & AnimatedTranslation )
+		{
+			bone.TranslationOffset = mKeyStride;
+			mKeyStride += 3;
+
+			XMStoreFloat3(&bone.TranslationMin, pMin);
+			XMStoreFloat3(&bone.TranslationStep, (pMax - pMin) / RangeSteps);
+		}
+
+		if( bone.Flags & AnimatedScale )
+		{
+			bone.ScaleOffset = mKeyStride;
+			mKeyStride += 3;
+
+			XMStoreFloat3(&bone.ScaleMin, sMin);
+			XMStoreFloat3(&bone.ScaleStep, (sMax - sMin) / RangeSteps);
+		}
+	}
+
+	//
+	// Quantize every key, and decode it again to get what sampling will give.
+	//
+
+	std::vector<unsigned short> samples(numKeys*mKeyStride);
+	std::vector<BoneTransform> decoded(keys.size());
+
+	for(unsigned k = 0; k < numKeys; ++k)
+	{
+		unsigned short* keySamples = mKeyStride > 0 ? &samples[k*mKeyStride] : 0;
+
+		for(unsigned b = 0; b < mNumBones; ++b)
+		{
+			const BoneTracks& bone = mBones[b];
+			const BoneTransform& key = keys[k*mNumBones + b];
+
+			if( bone.Flags & AnimatedRotation )
+				EncodeQuaternion(XMLoadFloat4(&key.RotationQuat), keySamples + bone.RotationOffset);
+
+			if( bone.Flags & AnimatedTranslation )
+			{
+				unsigned short* p = keySamples + bone.TranslationOffset;
+				p[0] = Quantize(key.Translation.x, bone.TranslationMin.x, bone.TranslationStep.x);
+				p[1] = Quantize(key.Translation.y, bone.TranslationMin.y, bone.TranslationStep.y);
+				p[2] = Quantize(key.Translation.z, bone.TranslationMin.z, bone.TranslationStep.z);
+			}
+
+			if( bone.Flags & AnimatedScale )
+			{
+				unsigned short* s = keySamples + bone.ScaleOffset;
+				s[0] = Quantize(key.Scale.x, bone.ScaleMin.x, bone.ScaleStep.x);
+				s[1] = Quantize(key.Scale.y, bone.ScaleMin.y, bone.ScaleStep.y);
+				s[2] = Quantize(key.Scale.z, bone.ScaleMin.z, bone.ScaleStep.z);
+			}
+
+			XMVECTOR T, S, Q;
+			DecodeKey(bone, keySamples, T, S, Q);
+
+			BoneTransform& d = decoded[k*mNumBones + b];
+			XMStoreFloat3(&d.Translation, T);
+			XMStoreFloat3(&d.Scale, S);
+			XMStoreFloat4(&d.RotationQuat, Q);
+		}
+	}
+
+	//
+	// Remove keys.  From each key kept, find the farthest key whose interpolation
+	// with it reproduces every key in between within the error bound: double the
+	// span until it fails, then binary search between the last span that passed
+	// and the first that failed.  Checking a span costs its length, so this is
+	// O(n log n) instead of the O(n^2) of extending the span one key at a time.
+	// The spans that pass are not strictly monotonic, so this may stop short of 
+	// the farthest key, but every span it keeps has been checked.
+	//
+
+	auto spanWithinError = [&](unsigned k0, unsigned k1) -> bool
+	{
+		float t0 = clip.GetKeyTime(k0);
+		float t1 = clip.GetKeyTime(k1);
+
+		for(unsigned m = k0+1; m < k1; ++m)
+		{
+			float s = (clip.GetKeyTime(m) - t0) / (t1 - t0);
+
+			for(unsigned b = 0; b < mNumBones; ++b)
+			{
+				const BoneTransform& a = decoded[k0*mNumBones + b];
+				const BoneTransform& c = decoded[k1*mNumBones + b];
+
+				XMVECTOR T = XMVectorLerp(XMLoadFloat3(&a.Translation), XMLoadFloat3(&c.Translation), s);
+				XMVECTOR S = XMVectorLerp(XMLoadFloat3(&a.Scale), XMLoadFloat3(&c.Scale), s);
+				XMVECTOR Q = QuaternionNlerp(XMLoadFloat4(&a.RotationQuat), XMLoadFloat4(&c.RotationQuat), s);
+
+				if( BoneError(T, S, Q, keys[m*mNumBones + b], boneLengths[b]) > maxError )
+					return false;
+			}
+		}
+
+		return true;
+	};
+
+	std::vector<unsigned> keptKeys;
+	keptKeys.push_back(0);
+
+	unsigned lastKey = numKeys-1;
+	while( keptKeys.back() < lastKey )
+	{
+		unsigned k0 = keptKeys.back();
+		unsigned maxSpan = lastKey - k0;
+
+		// A span of one key has nothing in between, so it always passes.
+		unsigned good = 1;
+		unsigned bad = maxSpan + 1;
+
+		for(unsigned span = 2; good < maxSpan; span *= 2)
+		{
+			span = std::min(span, maxSpan);
+			if( !spanWithinError(k0, k0 + span) )
+			{
+				bad = span;
+				break;
+			}
+
+			good = span;
+		}
+
+		while( bad - good > 1 )
+		{
+			unsigned span = good + (bad - good)/2;
+			if( spanWithinError(k0, k0 + span) )
+				good = span;
+			else
+				bad = span;
+		}
+
+		keptKeys.push_back(k0 + good);
+	}
+
+	//
+	// The spans only check the keys in between.  The kept keys are reproduced by
+	// their decoded values, which carry the quantization error, so check those
+	// too.  Only a track whose range is too large for 16 bits at this error
+	// bound fails here.
+	//
+
+	bool withinError = true;
+	for(unsigned i = 0; i < keptKeys.size() && withinError; ++i)
+	{
+		unsigned k = keptKeys[i];
+		for(unsigned b = 0; b < mNumBones; ++b)
+		{
+			const BoneTransform& d = decoded[k*mNumBones + b];
+
+			float error = BoneError(XMLoadFloat3(&d.Translation), XMLoadFloat3(&d.Scale),
+				XMLoadFloat4(&d.RotationQuat), keys[k*mNumBones + b], boneLengths[b]);
+			if( error > maxError )
+			{
+				withinError = false;
+				break;
+			}
+		}
+	}
+
+	mKeyTimes.resize(keptKeys.size());
+	mSamples.resize(keptKeys.size()*mKeyStride);
+
+	for(unsigned i = 0; i < keptKeys.size(); ++i)
+	{
+		mKeyTimes[i] = clip.GetKeyTime(keptKeys[i]);
+
+		if( mKeyStride > 0 )
+		{
+			std::copy(&samples[keptKeys[i]*mKeyStride], &samples[keptKeys[i]*mKeyStride] + mKeyStride,
+				&mSamples[i*mKeyStride]);
+		}
+	}
+
+	return withinError;
+}
+
+unsigned CompressedClip::BoneCount()const
+{
+	return mNumBones;
+}
+
+unsigned CompressedClip::KeyCount()const
+{
+	return mKeyTimes.size();
+}
+
+float CompressedClip::GetClipStartTime()const
+{
+	return mKeyTimes.empty() ? 0.0f : mKeyTimes.front();
+}
+
+float CompressedClip::GetClipEndTime()const
+{
+	return mKeyTimes.empty() ? 0.0f : mKeyTimes.back();
+}
+
+void CompressedClip::Sample(float t, unsigned& cursor, BoneTransform* localTransforms)const
+{
+	if( mKeyTimes.empty() )
+		return;
+
+	// Keys k0 and k1 bound t, and s is how far t is from k0 to k1.
+	unsigned k0, k1;
+	float s;
+
+	if( t <= mKeyTimes.front() || mKeyTimes.size() == 1 )
+	{
+		k0 = k1 = 0;
+		s = 0.0f;
+		cursor = 0;
+	}
+	else if( t >= mKeyTimes.back() )
+	{
+		k0 = k1 = mKeyTimes.size()-1;
+		s = 0.0f;
+		cursor = k0-1;
+	}
+	else
+	{
+		k0 = FindKey(t, cursor);
+		k1 = k0+1;
+		s = (t - mKeyTimes[k0]) / (mKeyTimes[k1] - mKeyTimes[k0]);
+		cursor = k0;
+	}
+
+	const unsigned short* samples0 = mKeyStride > 0 ? &mSamples[k0*mKeyStride] : 0;
+	const unsigned short* samples1 = mKeyStride > 0 ? &mSamples[k1*mKeyStride] : 0;
+
+	for(unsigned b = 0; b < mNumBones; ++b)
+	{
+		XMVECTOR p0, s0, q0;
+		XMVECTOR p1, s1, q1;
+		DecodeKey(mBones[b], samples0, p0, s0, q0);
+		DecodeKey(mBones[b], samples1, p1, s1, q1);
+
+		XMStoreFloat3(&localTransforms[b].Translation, XMVectorLerp(p0, p1, s));
+		XMStoreFloat3(&localTransforms[b].Scale, XMVectorLerp(s0, s1, s));
+		XMStoreFloat4(&localTransforms[b].RotationQuat, QuaternionNlerp(q0, q1, s));
+	}
+}
+
+size_t CompressedClip::GetResidentBytes()const
+{
+	return mKeyTimes.size()*sizeof(float) + mBones.size()*sizeof(BoneTracks) +
+		mSamples.size()*sizeof(unsigned short);
+}
+
+void CompressedClip::EncodeQuaternion(FXMVECTOR q, unsigned short packed[3])
+{
+	XMFLOAT4 v;
+	XMStoreFloat4(&v, q);
+	float c[4] = { v.x, v.y, v.z, v.w };
+
+	unsigned largest = 0;
+	for(unsigned i = 1; i < 4; ++i)
+	{
+		if( fabsf(c[i]) > fabsf(c[largest]) )
+			largest = i;
+	}
+
+	// q and -q are the same rotation, so make the dropped component positive.
+	float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+	unsigned n = 0;
+	for(unsigned i = 0; i < 4; ++i)
+	{
+		if( i == largest )
+			continue;
+
+		float x = (sign*c[i] / QuatComponentMax)*0.5f + 0.5f;
+		packed[n++] = (unsigned short)std::min(std::max(x*QuatComponentSteps + 0.5f, 0.0f), QuatComponentSteps);
+	}
+
+	// The index of the dropped component goes in the top bits of the first two
+	// samples.
+	packed[0] |= (unsigned short)((largest & 1) << 15);
+	packed[1] |= (unsigned short)((largest >> 1) << 15);
+}
+
+XMVECTOR CompressedClip::DecodeQuaternion(const unsigned short packed[3])
+{
+	unsigned largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+
+	float c[4];
+	float sumSquares = 0.0f;
+
+	unsigned n = 0;
+	for(unsigned i = 0; i < 4; ++i)
+	{
+		if( i == largest )
+			continue;
+
+		float x = ((packed[n++] & 0x7fff) / QuatComponentSteps * 2.0f - 1.0f)*QuatComponentMax;
+		c[i] = x;
+		sumSquares += x*x;
+	}
+
+	c[largest] = sqrtf(std::max(1.0f - sumSquares, 0.0f));
+
+	return XMVectorSet(c[0], c[1], c[2], c[3]);
+}
+
+void CompressedClip::DecodeKey(const BoneTracks& bone, const unsigned short* keySamples,
+							   XMVECTOR& translation, XMVECTOR& scale, XMVECTOR& rotationQuat)const
+{
+	if( bone.Flags & AnimatedRotation )
+		rotationQuat = DecodeQuaternion(keySamples + bone.RotationOffset);
+	else
+		rotationQuat = XMLoadFloat4(&bone.Rotation);
+
+	translation = XMLoadFloat3(&bone.TranslationMin);
+	if( bone.Flags & AnimatedTranslation )
+	{
+		const unsigned short* p = keySamples + bone.TranslationOffset;
+		XMVECTOR steps = XMVectorSet((float)p[0], (float)p[1], (float)p[2], 0.0f);
+		translation += steps*XMLoadFloat3(&bone.TranslationStep);
+	}
+
+	scale = XMLoadFloat3(&bone.ScaleMin);
+	if( bone.Flags & AnimatedScale )
+	{
+		const unsigned short* s = keySamples + bone.ScaleOffset;
+		XMVECTOR steps = XMVectorSet((float)s[0], (float)s[1], (float)s[2], 0.0f);
+		scale += steps*XMLoadFloat3(&bone.ScaleStep);
+	}
+}
+
+unsigned CompressedClip::FindKey(float t, unsigned cursor)const
+{
+	return KeyframeSearch::Find(&mKeyTimes[0], mKeyTimes.size(), t, cursor);
+}
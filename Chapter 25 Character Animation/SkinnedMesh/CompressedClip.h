@@ -0,0 +1,113 @@
+//***************************************************************************************
+// CompressedClip.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// An animation clip compressed for storing large clip libraries in memory, and
+// sampled directly without decompressing it first.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef COMPRESSEDCLIP_H
+#define COMPRESSEDCLIP_H
+
+#include "PackedClip.h"
+
+///<summary>
+/// Each bone has a rotation, translation and scale track.  Tracks that do not
+/// change are stored once as constants, as long as holding all of a bone's
+/// constant tracks together stays within half the error bound.  Animated
+/// rotations are stored in 48 bits with the "smallest three" encoding: the
+/// largest component is dropped (it follows from the other three since the
+/// quaternion has unit length) and the other three are quantized to 15 bits.
+/// Animated translations and scales are quantized to 16 bits per component
+/// within the range of their track.
+///
+/// Keys are then removed wherever interpolating the neighboring keys stays within
+/// the error bound.  The longest span from each kept key is found by doubling it
+/// and then binary searching, so compression is O(n log n) in the key count.  As
+/// in PackedClip the keys are aligned across bones, so sampling does one key 
+/// search for the whole clip.
+///
+/// The error is measured in bone space, as how far a point at the end of the bone
+/// moves: a rotation error of a radians on a bone of length L moves it by a*L.
+///</summary>
+class CompressedClip
+{
+public:
+	CompressedClip();
+	~CompressedClip();
+
+	// Compresses a clip so that at each of its keys, no bone end moves more than
+	// maxError from where the clip puts it.  The bone lengths are measured in
+	// the clip's first pose, using the hierarchy to find each bone's children.
+	// Returns false if quantizing alone moves a kept key beyond maxError (a track
+	// whose range is too large for 16 bits at that error); the clip is still 
+	// built, but does not meet the bound.
+	bool Build(const PackedClip& clip, const std::vector<int>& boneHierarchy, float maxError);
+
+	unsigned BoneCount()const;
+	unsigned KeyCount()const;
+
+	float GetClipStartTime()const;
+	float GetClipEndTime()const;
+
+	// Same as PackedClip::Sample.
+	void Sample(float t, unsigned& cursor, BoneTransform* localTransforms)const;
+
+	// Memory used by the keys and tracks.
+	size_t GetResidentBytes()const;
+
+	// The 48-bit smallest three encoding of a unit quaternion used for the
+	// animated rotations.  Decoding gives q or -q (the same rotation), with the
+	// three smallest components rounded to 15 bits and the largest recomputed.
+	static void EncodeQuaternion(DirectX::FXMVECTOR q, unsigned short packed[3]);
+	static DirectX::XMVECTOR DecodeQuaternion(const unsigned short packed[3]);
+
+private:
+	enum TrackFlags
+	{
+		AnimatedRotation    = 1,
+		AnimatedTranslation = 2,
+		AnimatedScale       = 4
+	};
+
+	struct BoneTracks
+	{
+		unsigned Flags;
+
+		// Offsets of the animated tracks within the samples of a key.
+		unsigned RotationOffset;
+		unsigned TranslationOffset;
+		unsigned ScaleOffset;
+
+		// Value of a constant rotation.
+		DirectX::XMFLOAT4 Rotation;
+
+		// A translation is Min + sample*Step, and a constant one is just Min.  Same
+		// for scale.
+		DirectX::XMFLOAT3 TranslationMin;
+		DirectX::XMFLOAT3 TranslationStep;
+		DirectX::XMFLOAT3 ScaleMin;
+		DirectX::XMFLOAT3 ScaleStep;
+	};
+
+	void DecodeKey(const BoneTracks& bone, const unsigned short* keySamples,
+		DirectX::XMVECTOR& translation, DirectX::XMVECTOR& scale, DirectX::XMVECTOR& rotationQuat)const;
+
+	unsigned FindKey(float t, unsigned cursor)const;
+
+private:
+	unsigned mNumBones;
+
+	// Samples per key for all the animated tracks.
+	unsigned mKeyStride;
+
+	std::vector<float> mKeyTimes;
+	std::vector<BoneTracks> mBones;
+
+	// mKeyStride samples per key, key after key.
+	std::vector<unsigned short> mSamples;
+};
+
+#endif // COMPRESSEDCLIP_H
@@ -0,0 +1,222 @@
+//***************************************************************************************
+// CpuSkinning.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "CpuSkinning.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Blocks of four vertices per parallel task.
+	const size_t BlocksPerTask = 256;
+
+	template<typename T>
+	const T& VertexData(const T* first, unsigned stride, unsigned i)
+	{
+		return *reinterpret_cast<const T*>(reinterpret_cast<const unsigned char*>(first) + (size_t)i*stride);
+	}
+
+	// Element (row, col) of the matrices of four bones.
+	XMVECTOR GatherElement(const XMFLOAT4X4* palette, const unsigned char bones[4], int row, int col)
+	{
+		return XMVectorSet(
+			palette[bones[0]].m[row][col],
+			palette[bones[1]].m[row][col],
+			palette[bones[2]].m[row][col],
+			palette[bones[3]].m[row][col]);
+	}
+
+	void StoreLanes(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, unsigned numVertices, XMFLOAT3* out)
+	{
+		XMFLOAT4 xs, ys, zs;
+		XMStoreFloat4(&xs, x);
+		XMStoreFloat4(&ys, y);
+		XMStoreFloat4(&zs, z);
+
+		for(unsigned i = 0; i < numVertices; ++i)
+		{
+			out[i] = XMFLOAT3((&xs.x)[i], (&ys.x)[i], (&zs.x)[i]);
+		}
+	}
+}
+
+CpuSkinning::MeshDesc::MeshDesc()
+	: NumVertices(0), Stride(0), Positions(0), Normals(0), Tangents(0), Weights(0), BoneIndices(0)
+{
+}
+
+CpuSkinning::CpuSkinning()
+	: mNumVertices(0), mHasNormals(false), mHasTangents(false)
+{
+}
+
+CpuSkinning::~CpuSkinning()
+{
+}
+
+void CpuSkinning::Build(const MeshDesc& desc)
+{
+	mNumVertices = desc.NumVertices;
+	mHasNormals  = desc.Normals != 0;
+	mHasTangents = desc.Tangents != 0;
+
+	// Lanes past the last vertex have zero weights, so they skin to the origin
+	// and are never written out.
+	VertexBlock empty;
+	memset(&empty, 0, sizeof(empty));
+
+	mBlocks.assign((mNumVertices + 3)/4, empty);
+
+	for(unsigned i = 0; i < mNumVertices; ++i)
+	{
+		VertexBlock& block = mBlocks[i/4];
+		unsigned lane = i%4;
+
+		const XMFLOAT3& pos = VertexData(desc.Positions, desc.Stride, i);
+		(&block.PosX.x)[lane] = pos.x;
+		(&block.PosY.x)[lane] = pos.y;
+		(&block.PosZ.x)[lane] = pos.z;
+
+		if( mHasNormals )
+		{
+			const XMFLOAT3& normal = VertexData(desc.Normals, desc.Stride, i);
+			(&block.NormalX.x)[lane] = normal.x;
+			(&block.NormalY.x)[lane] = normal.y;
+			(&block.NormalZ.x)[lane] = normal.z;
+		}
+
+		if( mHasTangents )
+		{
+			const XMFLOAT4& tangent = VertexData(desc.Tangents, desc.Stride, i);
+			(&block.TangentX.x)[lane] = tangent.x;
+			(&block.TangentY.x)[lane] = tangent.y;
+			(&block.TangentZ.x)[lane] = tangent.z;
+		}
+
+		const XMFLOAT3& weights = VertexData(desc.Weights, desc.Stride, i);
+		const unsigned char* bones = &VertexData(desc.BoneIndices, desc.Stride, i);
+
+		(&block.Weights[0].x)[lane] = weights.x;
+		(&block.Weights[1].x)[lane] = weights.y;
+		(&block.Weights[2].x)[lane] = weights.z;
+		(&block.Weights[3].x)[lane] = 1.0f - weights.x - weights.y - weights.z;
+
+		for(int j = 0; j < 4; ++j)
+		{
+			block.BoneIndices[j][lane] = bones[j];
+		}
+	}
+}
+
+unsigned CpuSkinning::GetVertexCount()const
+{
+	return mNumVertices;
+}
+
+bool CpuSkinning::HasNormals()const
+{
+	return mHasNormals;
+}
+
+bool CpuSkinning::HasTangents()const
+{
+	return mHasTangents;
+}
+
+void CpuSkinning::Skin(const XMFLOAT4X4* palette, XMFLOAT3* positions,
+					   XMFLOAT3* normals, XMFLOAT3* tangents)const
+{
+	if( !mHasNormals )
+		normals = 0;
+	if( !mHasTangents )
+		tangents = 0;
+
+	ParallelFor::Run(mBlocks.size(), BlocksPerTask, [=](size_t begin, size_t end)
+	{
+		for(size_t b = begin; b < end; ++b)
+		{
+			unsigned first = (unsigned)b*4;
+			unsigned numVertices = std::min(mNumVertices - first, 4u);
+
+			SkinBlock(mBlocks[b], palette, numVertices, positions + first,
+				normals ? normals + first : 0, tangents ? tangents + first : 0);
+		}
+	});
+}
+
+void CpuSkinning::SkinBlock(const VertexBlock& block, const XMFLOAT4X4* palette, unsigned numVertices,
+							XMFLOAT3* positions, XMFLOAT3* normals, XMFLOAT3* tangents)const
+{
+	//
+	// Blend the bone matrices of each vertex by its weights.  Only the first three
+	// columns are needed: m[3*row + col] holds element (row, col) of the four
+	// blended matrices.
+	//
+
+	XMVECTOR m[12];
+	for(int e = 0; e < 12; ++e)
+		m[e] = XMVectorZero();
+
+	for(int j = 0; j < 4; ++j)
+	{
+		const XMFLOAT4& w = block.Weights[j];
+
+		// Most vertices have fewer than four influences.
+		if( w.x == 0.0f && w.y == 0.0f && w.z == 0.0f && w.w == 0.0f )
+			continue;
+
+		XMVECTOR weights = XMLoadFloat4(&w);
+
+		for(int e = 0; e < 12; ++e)
+		{
+			XMVECTOR element = GatherElement(palette, block.BoneIndices[j], e/3, e%3);
+			m[e] = XMVectorMultiplyAdd(weights, element, m[e]);
+		}
+	}
+
+	//
+	// Transform by the blended matrices (row vectors, as in the shader).
+	//
+
+	XMVECTOR px = XMLoadFloat4(&block.PosX);
+	XMVECTOR py = XMLoadFloat4(&block.PosY);
+	XMVECTOR pz = XMLoadFloat4(&block.PosZ);
+
+	XMVECTOR x = px*m[0] + py*m[3] + pz*m[6] + m[9];
+	XMVECTOR y = px*m[1] + py*m[4] + pz*m[7] + m[10];
+	XMVECTOR z = px*m[2] + py*m[5] + pz*m[8] + m[11];
+
+	StoreLanes(x, y, z, numVertices, positions);
+
+	if( normals )
+	{
+		XMVECTOR nx = XMLoadFloat4(&block.NormalX);
+		XMVECTOR ny = XMLoadFloat4(&block.NormalY);
+		XMVECTOR nz = XMLoadFloat4(&block.NormalZ);
+
+		x = nx*m[0] + ny*m[3] + nz*m[6];
+		y = nx*m[1] + ny*m[4] + nz*m[7];
+		z = nx*m[2] + ny*m[5] + nz*m[8];
+
+		XMVECTOR invLength = XMVectorReciprocalSqrt(x*x + y*y + z*z);
+		StoreLanes(x*invLength, y*invLength, z*invLength, numVertices, normals);
+	}
+
+	if( tangents )
+	{
+		XMVECTOR tx = XMLoadFloat4(&block.TangentX);
+		XMVECTOR ty = XMLoadFloat4(&block.TangentY);
+		XMVECTOR tz = XMLoadFloat4(&block.TangentZ);
+
+		x = tx*m[0] + ty*m[3] + tz*m[6];
+		y = tx*m[1] + ty*m[4] + tz*m[7];
+		z = tx*m[2] + ty*m[5] + tz*m[8];
+
+		XMVECTOR invLength = XMVectorReciprocalSqrt(x*x + y*y + z*z);
+		StoreLanes(x*invLength, y*invLength, z*invLength, numVertices, tangents);
+	}
+}
@@ -0,0 +1,94 @@
+//***************************************************************************************
+// CpuSkinning.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Skins a mesh on the CPU, e.g. for hit boxes, cloth anchors or bounds on a
+// server or in a tool, with the same math as SkinnedVS in NormalMap.fx.
+//
+// The vertices are stored structure-of-arrays in blocks of four, so each block
+// is skinned with one set of SIMD instructions, and the blocks are split across
+// threads.  Only depends on DirectXMath and the standard library so it can be
+// used by headless tools.
+//***************************************************************************************
+
+#ifndef CPUSKINNING_H
+#define CPUSKINNING_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+class CpuSkinning
+{
+public:
+	///<summary>
+	/// Where to read the mesh from.  Each pointer points to the data of the first
+	/// vertex, and the data of the next vertex is Stride bytes further, so an
+	/// interleaved vertex array such as Vertex::PosNormalTexTanSkinned can be
+	/// read in place.  Normals and Tangents may be null.
+	///
+	/// As in the shader, each vertex has four bone influences whose weights sum
+	/// to 1; the fourth weight is 1 minus the other three.
+	///</summary>
+	struct MeshDesc
+	{
+		MeshDesc();
+
+		unsigned NumVertices;
+		unsigned Stride;
+
+		const DirectX::XMFLOAT3* Positions;
+		const DirectX::XMFLOAT3* Normals;
+		const DirectX::XMFLOAT4* Tangents;
+		const DirectX::XMFLOAT3* Weights;
+		const unsigned char* BoneIndices;
+	};
+
+public:
+	CpuSkinning();
+	~CpuSkinning();
+
+	// Copies the mesh into skinning blocks.
+	void Build(const MeshDesc& desc);
+
+	unsigned GetVertexCount()const;
+	bool HasNormals()const;
+	bool HasTangents()const;
+
+	// Skins every vertex with a bone palette (final transforms, as given by
+	// SkinnedData::GetFinalTransforms) and writes NumVertices positions.  Normals
+	// and tangents are written too if the output is not null and the mesh has
+	// them; they are normalized.
+	void Skin(const DirectX::XMFLOAT4X4* palette, DirectX::XMFLOAT3* positions,
+		DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents)const;
+
+private:
+	// Four vertices, component by component.
+	struct VertexBlock
+	{
+		DirectX::XMFLOAT4 PosX;
+		DirectX::XMFLOAT4 PosY;
+		DirectX::XMFLOAT4 PosZ;
+		DirectX::XMFLOAT4 NormalX;
+		DirectX::XMFLOAT4 NormalY;
+		DirectX::XMFLOAT4 NormalZ;
+		DirectX::XMFLOAT4 TangentX;
+		DirectX::XMFLOAT4 TangentY;
+		DirectX::XMFLOAT4 TangentZ;
+
+		// Weights[j] holds influence j of the four vertices, and BoneIndices[j]
+		// the bones of influence j.
+		DirectX::XMFLOAT4 Weights[4];
+		unsigned char BoneIndices[4][4];
+	};
+
+	void SkinBlock(const VertexBlock& block, const DirectX::XMFLOAT4X4* palette, unsigned numVertices,
+		DirectX::XMFLOAT3* positions, DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents)const;
+
+private:
+	unsigned mNumVertices;
+	bool mHasNormals;
+	bool mHasTangents;
+
+	std::vector<VertexBlock> mBlocks;
+};
+
+#endif // CPUSKINNING_H
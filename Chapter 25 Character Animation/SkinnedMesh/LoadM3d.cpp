@@ -40,7 +40,8 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 						std::vector<USHORT>& indices,
 						std::vector<MeshGeometry::Subset>& subsets,
 						std::vector<M3dMaterial>& mats,
-						SkinnedData& skinInfo)
+						SkinnedData& skinInfo,
+						float maxCompressionError)
 {
     std::ifstream fin(filename);
 
@@ -73,7 +74,7 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	    ReadBoneHierarchy(fin, numBones, boneIndexToParentIndex);
 	    ReadAnimationClips(fin, numBones, numAnimationClips, animations);
  
-		skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
+		skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations, maxCompressionError);
 
 	    return true;
 	}
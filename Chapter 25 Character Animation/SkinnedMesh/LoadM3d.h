@@ -28,7 +28,8 @@ public:
 		std::vector<USHORT>& indices,
 		std::vector<MeshGeometry::Subset>& subsets,
 		std::vector<M3dMaterial>& mats,
-		SkinnedData& skinInfo);
+		SkinnedData& skinInfo,
+		float maxCompressionError = 0.0f);
 
 private:
 	void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
@@ -0,0 +1,269 @@
+//***************************************************************************************
+// PackedClip.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "PackedClip.h"
+#include "AnimationClip.h"
+#include "KeyframeSearch.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Evaluates a bone animation at time t like BoneAnimation::Interpolate, but
+	// returns the transform as translation, scale and rotation.
+	void InterpolateBone(const BoneAnimation& anim, float t, unsigned& cursor,
+		XMFLOAT3& translation, XMFLOAT3& scale, XMFLOAT4& rotationQuat)
+	{
+		const std::vector<Keyframe>& keys = anim.Keyframes;
+
+		if( t <= keys.front().TimePos || keys.size() == 1 )
+		{
+			translation  = keys.front().Translation;
+			scale        = keys.front().Scale;
+			rotationQuat = keys.front().RotationQuat;
+			return;
+		}
+
+		if( t >= keys.back().TimePos )
+		{
+			translation  = keys.back().Translation;
+			scale        = keys.back().Scale;
+			rotationQuat = keys.back().RotationQuat;
+			return;
+		}
+
+		unsigned i = anim.FindKeyframe(t, cursor);
+		cursor = i;
+
+		float lerpPercent = (t - keys[i].TimePos) / (keys[i+1].TimePos - keys[i].TimePos);
+
+		XMVECTOR s0 = XMLoadFloat3(&keys[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&keys[i+1].Scale);
+
+		XMVECTOR p0 = XMLoadFloat3(&keys[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&keys[i+1].Translation);
+
+		XMVECTOR q0 = XMLoadFloat4(&keys[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&keys[i+1].RotationQuat);
+
+		XMStoreFloat3(&scale, XMVectorLerp(s0, s1, lerpPercent));
+		XMStoreFloat3(&translation, XMVectorLerp(p0, p1, lerpPercent));
+		XMStoreFloat4(&rotationQuat, XMQuaternionSlerp(q0, q1, lerpPercent));
+	}
+
+	void LerpLanes(const XMFLOAT4& a, const XMFLOAT4& b, FXMVECTOR s, XMFLOAT4& result)
+	{
+		XMStoreFloat4(&result, XMVectorLerpV(XMLoadFloat4(&a), XMLoadFloat4(&b), s));
+	}
+}
+
+XMMATRIX BoneTransform::ToMatrix()const
+{
+	XMVECTOR S = XMLoadFloat3(&Scale);
+	XMVECTOR P = XMLoadFloat3(&Translation);
+	XMVECTOR Q = XMLoadFloat4(&RotationQuat);
+
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	return XMMatrixAffineTransformation(S, zero, Q, P);
+}
+
+PackedClip::PackedClip()
+	: mNumBones(0), mNumGroups(0)
+{
+}
+
+PackedClip::~PackedClip()
+{
+}
+
+void PackedClip::Build(const AnimationClip& clip)
+{
+	mNumBones  = clip.BoneAnimations.size();
+	mNumGroups = (mNumBones + 3)/4;
+
+	// Merge the keyframe times of all the bones.
+	mKeyTimes.clear();
+	for(unsigned b = 0; b < mNumBones; ++b)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[b].Keyframes;
+		for(unsigned k = 0; k < keys.size(); ++k)
+			mKeyTimes.push_back(keys[k].TimePos);
+	}
+
+	std::sort(mKeyTimes.begin(), mKeyTimes.end());
+	mKeyTimes.erase(std::unique(mKeyTimes.begin(), mKeyTimes.end()), mKeyTimes.end());
+
+	// Lanes past the last bone hold the identity so the whole group always
+	// normalizes cleanly.
+	KeyGroup identity;
+	identity.TranslationX = identity.TranslationY = identity.TranslationZ = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	identity.ScaleX = identity.ScaleY = identity.ScaleZ = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	identity.RotationX = identity.RotationY = identity.RotationZ = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	identity.RotationW = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+
+	mKeys.assign(mKeyTimes.size()*mNumGroups, identity);
+
+	for(unsigned b = 0; b < mNumBones; ++b)
+	{
+		const BoneAnimation& anim = clip.BoneAnimations[b];
+		if( anim.Keyframes.empty() )
+			continue;
+
+		unsigned group = b / 4;
+		unsigned lane  = b % 4;
+
+		unsigned cursor = 0;
+		XMVECTOR prevQ = XMVectorZero();
+
+		for(unsigned k = 0; k < mKeyTimes.size(); ++k)
+		{
+			XMFLOAT3 translation, scale;
+			XMFLOAT4 rotationQuat;
+			InterpolateBone(anim, mKeyTimes[k], cursor, translation, scale, rotationQuat);
+
+			// q and -q are the same rotation.  Pick the one closest to the previous
+			// key so that lerping between keys takes the short way around.
+			XMVECTOR Q = XMLoadFloat4(&rotationQuat);
+			if( XMVectorGetX(XMQuaternionDot(Q, prevQ)) < 0.0f )
+			{
+				Q = -Q;
+				XMStoreFloat4(&rotationQuat, Q);
+			}
+			prevQ = Q;
+
+			KeyGroup& g = mKeys[k*mNumGroups + group];
+			(&g.TranslationX.x)[lane] = translation.x;
+			(&g.TranslationY.x)[lane] = translation.y;
+			(&g.TranslationZ.x)[lane] = translation.z;
+			(&g.ScaleX.x)[lane] = scale.x;
+			(&g.ScaleY.x)[lane] = scale.y;
+			(&g.ScaleZ.x)[lane] = scale.z;
+			(&g.RotationX.x)[lane] = rotationQuat.x;
+			(&g.RotationY.x)[lane] = rotationQuat.y;
+			(&g.RotationZ.x)[lane] = rotationQuat.z;
+			(&g.RotationW.x)[lane] = rotationQuat.w;
+		}
+	}
+}
+
+unsigned PackedClip::BoneCount()const
+{
+	return mNumBones;
+}
+
+unsigned PackedClip::KeyCount()const
+{
+	return mKeyTimes.size();
+}
+
+float PackedClip::GetKeyTime(unsigned key)const
+{
+	return mKeyTimes[key];
+}
+
+float PackedClip::GetClipStartTime()const
+{
+	return mKeyTimes.empty() ? 0.0f : mKeyTimes.front();
+}
+
+float PackedClip::GetClipEndTime()const
+{
+	return mKeyTimes.empty() ? 0.0f : mKeyTimes.back();
+}
+
+void PackedClip::Sample(float t, unsigned& cursor, BoneTransform* localTransforms)const
+{
+	if( mKeyTimes.empty() )
+		return;
+
+	// Keys k0 and k1 bound t, and s is how far t is from k0 to k1.
+	unsigned k0, k1;
+	float s;
+
+	if( t <= mKeyTimes.front() || mKeyTimes.size() == 1 )
+	{
+		k0 = k1 = 0;
+		s = 0.0f;
+		cursor = 0;
+	}
+	else if( t >= mKeyTimes.back() )
+	{
+		k0 = k1 = mKeyTimes.size()-1;
+		s = 0.0f;
+		cursor = k0-1;
+	}
+	else
+	{
+		k0 = FindKey(t, cursor);
+		k1 = k0+1;
+		s = (t - mKeyTimes[k0]) / (mKeyTimes[k1] - mKeyTimes[k0]);
+		cursor = k0;
+	}
+
+	const KeyGroup* keys0 = &mKeys[k0*mNumGroups];
+	const KeyGroup* keys1 = &mKeys[k1*mNumGroups];
+
+	XMVECTOR vs = XMVectorReplicate(s);
+
+	for(unsigned g = 0; g < mNumGroups; ++g)
+	{
+		const KeyGroup& a = keys0[g];
+		const KeyGroup& b = keys1[g];
+
+		KeyGroup result;
+		LerpLanes(a.TranslationX, b.TranslationX, vs, result.TranslationX);
+		LerpLanes(a.TranslationY, b.TranslationY, vs, result.TranslationY);
+		LerpLanes(a.TranslationZ, b.TranslationZ, vs, result.TranslationZ);
+		LerpLanes(a.ScaleX, b.ScaleX, vs, result.ScaleX);
+		LerpLanes(a.ScaleY, b.ScaleY, vs, result.ScaleY);
+		LerpLanes(a.ScaleZ, b.ScaleZ, vs, result.ScaleZ);
+
+		// Normalized lerp.  Build made neighboring keys take the short way around.
+		XMVECTOR qx = XMVectorLerpV(XMLoadFloat4(&a.RotationX), XMLoadFloat4(&b.RotationX), vs);
+		XMVECTOR qy = XMVectorLerpV(XMLoadFloat4(&a.RotationY), XMLoadFloat4(&b.RotationY), vs);
+		XMVECTOR qz = XMVectorLerpV(XMLoadFloat4(&a.RotationZ), XMLoadFloat4(&b.RotationZ), vs);
+		XMVECTOR qw = XMVectorLerpV(XMLoadFloat4(&a.RotationW), XMLoadFloat4(&b.RotationW), vs);
+
+		XMVECTOR invLength = XMVectorReciprocalSqrt(qx*qx + qy*qy + qz*qz + qw*qw);
+
+		XMStoreFloat4(&result.RotationX, qx*invLength);
+		XMStoreFloat4(&result.RotationY, qy*invLength);
+		XMStoreFloat4(&result.RotationZ, qz*invLength);
+		XMStoreFloat4(&result.RotationW, qw*invLength);
+
+		StoreGroup(result, 4*g, localTransforms);
+	}
+}
+
+size_t PackedClip::GetResidentBytes()const
+{
+	return mKeyTimes.size()*sizeof(float) + mKeys.size()*sizeof(KeyGroup);
+}
+
+unsigned PackedClip::FindKey(float t, unsigned cursor)const
+{
+	return KeyframeSearch::Find(&mKeyTimes[0], mKeyTimes.size(), t, cursor);
+}
+
+void PackedClip::StoreGroup(const KeyGroup& group, unsigned firstBone, BoneTransform* localTransforms)const
+{
+	unsigned n = std::min(mNumBones - firstBone, 4u);
+
+	for(unsigned lane = 0; lane < n; ++lane)
+	{
+		BoneTransform& bone = localTransforms[firstBone + lane];
+
+		bone.Translation.x  = (&group.TranslationX.x)[lane];
+		bone.Translation.y  = (&group.TranslationY.x)[lane];
+		bone.Translation.z  = (&group.TranslationZ.x)[lane];
+		bone.Scale.x        = (&group.ScaleX.x)[lane];
+		bone.Scale.y        = (&group.ScaleY.x)[lane];
+		bone.Scale.z        = (&group.ScaleZ.x)[lane];
+		bone.RotationQuat.x = (&group.RotationX.x)[lane];
+		bone.RotationQuat.y = (&group.RotationY.x)[lane];
+		bone.RotationQuat.z = (&group.RotationZ.x)[lane];
+		bone.RotationQuat.w = (&group.RotationW.x)[lane];
+	}
+}
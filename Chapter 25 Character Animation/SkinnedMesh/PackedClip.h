@@ -0,0 +1,97 @@
+//***************************************************************************************
+// PackedClip.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// An AnimationClip repacked for sampling many bones with SIMD instructions.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef PACKEDCLIP_H
+#define PACKEDCLIP_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+struct AnimationClip;
+
+///<summary>
+/// Local (to-parent) transform of a bone, kept as separate translation, scale
+/// and rotation so that poses can be blended before they become matrices.
+///</summary>
+struct BoneTransform
+{
+	DirectX::XMFLOAT3 Translation;
+	DirectX::XMFLOAT3 Scale;
+	DirectX::XMFLOAT4 RotationQuat;
+
+	DirectX::XMMATRIX ToMatrix()const;
+};
+
+///<summary>
+/// The keyframe times of all the bones of a clip are merged into one list, and
+/// every bone gets a key at every time, so finding the keys that bound t is one
+/// search for the whole clip instead of one per bone.
+///
+/// Keys are stored structure-of-arrays in groups of four bones: the x components
+/// of the four translations are together, then the y components, and so on.  So
+/// each group of four bones is interpolated with one set of SIMD instructions.
+/// Rotations are interpolated with normalized lerp instead of slerp, which is
+/// indistinguishable at keyframe rates and much cheaper.
+///</summary>
+class PackedClip
+{
+public:
+	PackedClip();
+	~PackedClip();
+
+	// Resamples every bone animation of the clip at the merged keyframe times.
+	void Build(const AnimationClip& clip);
+
+	unsigned BoneCount()const;
+	unsigned KeyCount()const;
+	float GetKeyTime(unsigned key)const;
+
+	float GetClipStartTime()const;
+	float GetClipEndTime()const;
+
+	// Writes the local transform of every bone at time t, which is clamped to the
+	// clip.  The search for the keys that bound t starts from cursor, which is
+	// then updated, so playing forward finds them in constant time; see
+	// BoneAnimation::Interpolate.
+	void Sample(float t, unsigned& cursor, BoneTransform* localTransforms)const;
+
+	// Memory used by the keys.
+	size_t GetResidentBytes()const;
+
+private:
+	// One key time of four bones.
+	struct KeyGroup
+	{
+		DirectX::XMFLOAT4 TranslationX;
+		DirectX::XMFLOAT4 TranslationY;
+		DirectX::XMFLOAT4 TranslationZ;
+		DirectX::XMFLOAT4 ScaleX;
+		DirectX::XMFLOAT4 ScaleY;
+		DirectX::XMFLOAT4 ScaleZ;
+		DirectX::XMFLOAT4 RotationX;
+		DirectX::XMFLOAT4 RotationY;
+		DirectX::XMFLOAT4 RotationZ;
+		DirectX::XMFLOAT4 RotationW;
+	};
+
+	unsigned FindKey(float t, unsigned cursor)const;
+
+	void StoreGroup(const KeyGroup& group, unsigned firstBone, BoneTransform* localTransforms)const;
+
+private:
+	unsigned mNumBones;
+	unsigned mNumGroups;
+
+	std::vector<float> mKeyTimes;
+
+	// mNumGroups groups per key time, key time after key time.
+	std::vector<KeyGroup> mKeys;
+};
+
+#endif // PACKEDCLIP_H
@@ -0,0 +1,73 @@
+//***************************************************************************************
+// PoseBlend.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "PoseBlend.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Normalized lerp from q0 to q1, or to -q1 if that is closer.
+	XMVECTOR QuaternionNlerp(FXMVECTOR q0, FXMVECTOR q1, float t)
+	{
+		XMVECTOR q1Near = XMVectorGetX(XMQuaternionDot(q0, q1)) < 0.0f ? -q1 : q1;
+		return XMQuaternionNormalize(XMVectorLerp(q0, q1Near, t));
+	}
+}
+
+void PoseBlend::Lerp(const BoneTransform* a, const BoneTransform* b, float weight, 
+					 const float* boneMask, unsigned numBones, BoneTransform* result)
+{
+	for(unsigned i = 0; i < numBones; ++i)
+	{
+		float w = boneMask ? weight*boneMask[i] : weight;
+
+		XMVECTOR p0 = XMLoadFloat3(&a[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&b[i].Translation);
+
+		XMVECTOR s0 = XMLoadFloat3(&a[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&b[i].Scale);
+
+		XMVECTOR q0 = XMLoadFloat4(&a[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&b[i].RotationQuat);
+
+		XMStoreFloat3(&result[i].Translation, XMVectorLerp(p0, p1, w));
+		XMStoreFloat3(&result[i].Scale, XMVectorLerp(s0, s1, w));
+		XMStoreFloat4(&result[i].RotationQuat, QuaternionNlerp(q0, q1, w));
+	}
+}
+
+void PoseBlend::Add(const BoneTransform* base, const BoneTransform* additive, 
+					const BoneTransform* reference, float weight, const float* boneMask, 
+					unsigned numBones, BoneTransform* result)
+{
+	XMVECTOR identity = XMQuaternionIdentity();
+
+	for(unsigned i = 0; i < numBones; ++i)
+	{
+		float w = boneMask ? weight*boneMask[i] : weight;
+
+		XMVECTOR basePos = XMLoadFloat3(&base[i].Translation);
+		XMVECTOR addPos  = XMLoadFloat3(&additive[i].Translation);
+		XMVECTOR refPos  = XMLoadFloat3(&reference[i].Translation);
+
+		XMVECTOR baseScale = XMLoadFloat3(&base[i].Scale);
+		XMVECTOR addScale  = XMLoadFloat3(&additive[i].Scale);
+		XMVECTOR refScale  = XMLoadFloat3(&reference[i].Scale);
+
+		XMVECTOR baseQ = XMLoadFloat4(&base[i].RotationQuat);
+		XMVECTOR addQ  = XMLoadFloat4(&additive[i].RotationQuat);
+		XMVECTOR refQ  = XMLoadFloat4(&reference[i].RotationQuat);
+
+		// Scales combine by multiplying, so the difference is a ratio.
+		XMVECTOR deltaScale = XMVectorLerp(XMVectorSplatOne(), addScale / refScale, w);
+
+		// Rotation that takes the reference to the additive pose.  
+		XMVECTOR deltaQ = QuaternionNlerp(identity, XMQuaternionMultiply(addQ, XMQuaternionConjugate(refQ)), w);
+
+		XMStoreFloat3(&result[i].Translation, basePos + (addPos - refPos)*w);
+		XMStoreFloat3(&result[i].Scale, baseScale*deltaScale);
+		XMStoreFloat4(&result[i].RotationQuat, XMQuaternionMultiply(deltaQ, baseQ));
+	}
+}
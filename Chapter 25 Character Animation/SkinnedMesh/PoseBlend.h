@@ -0,0 +1,35 @@
+//***************************************************************************************
+// PoseBlend.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Blends poses given as local (to-parent) bone transforms.  Blending local
+// translation, scale and rotation before the hierarchy pass keeps bone lengths
+// and joint rotations intact, which blending final matrices does not.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.
+//***************************************************************************************
+
+#ifndef POSEBLEND_H
+#define POSEBLEND_H
+
+#include "PackedClip.h"
+
+class PoseBlend
+{
+public:
+	// result = a + (b - a)*w for every bone, where w is weight times the bone's
+	// entry in boneMask, or just weight if boneMask is null.  Rotations are 
+	// normalized lerps along the short arc.  result may be a or b.
+	static void Lerp(const BoneTransform* a, const BoneTransform* b, float weight, 
+		const float* boneMask, unsigned numBones, BoneTransform* result);
+
+	// Adds the difference between an additive pose and its reference pose onto a
+	// base pose: result = base + (additive - reference)*w, with w as in Lerp.
+	// For rotations the difference is the rotation from reference to additive,
+	// and it is applied before the base rotation.  result may be base.
+	static void Add(const BoneTransform* base, const BoneTransform* additive, 
+		const BoneTransform* reference, float weight, const float* boneMask, 
+		unsigned numBones, BoneTransform* result);
+};
+
+#endif // POSEBLEND_H
@@ -0,0 +1,141 @@
+//***************************************************************************************
+// PoseCache.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "PoseCache.h"
+#include "ParallelFor.h"
+
+namespace
+{
+	// Poses sampled per parallel task.  Each takes a few microseconds, so several
+	// are batched to keep the scheduling overhead small.
+	const size_t SamplesPerTask = 8;
+}
+
+PoseCache::PoseCache()
+	: mTimeQuantum(0.0f)
+{
+}
+
+PoseCache::~PoseCache()
+{
+}
+
+void PoseCache::SetTimeQuantum(float seconds)
+{
+	mTimeQuantum = MathHelper::Max(seconds, 0.0f);
+}
+
+float PoseCache::GetTimeQuantum()const
+{
+	return mTimeQuantum;
+}
+
+void PoseCache::Clear()
+{
+	mRequests.clear();
+	mSamples.clear();
+}
+
+UINT PoseCache::Request(const SkinnedData* skinnedData, UINT clipIndex, float timePos, UINT* keyframeCursor)
+{
+	// Snap the time to the nearest multiple of the quantum, clamped to the clip so
+	// that the end pose of a non-looping clip is still reached exactly.
+	if( mTimeQuantum > 0.0f )
+	{
+		float startTime = skinnedData->GetClipStartTime(clipIndex);
+		float endTime = skinnedData->GetClipEndTime(clipIndex);
+
+		timePos = floorf(timePos / mTimeQuantum + 0.5f)*mTimeQuantum;
+		timePos = MathHelper::Clamp(timePos, startTime, endTime);
+	}
+
+	PoseSample request;
+	request.Data = skinnedData;
+	request.ClipIndex = clipIndex;
+	request.TimePos = timePos;
+	request.KeyframeCursor = keyframeCursor;
+	request.Offset = 0;
+	request.Sample = mRequests.size();
+
+	mRequests.push_back(request);
+
+	return mRequests.size()-1;
+}
+
+void PoseCache::Evaluate()
+{
+	// Sort the requests to bring requests for the same pose together.  While 
+	// sorting, Sample holds the index of the request.
+	mSortedRequests = mRequests;
+	std::sort(mSortedRequests.begin(), mSortedRequests.end(), PoseLess);
+
+	mSamples.clear();
+	UINT numTransforms = 0;
+
+	for(UINT i = 0; i < mSortedRequests.size(); ++i)
+	{
+		const PoseSample& request = mSortedRequests[i];
+
+		if( i == 0 || !SamePose(request, mSamples.back()) )
+		{
+			PoseSample sample = request;
+			sample.Offset = numTransforms;
+			mSamples.push_back(sample);
+
+			numTransforms += request.Data->BoneCount();
+		}
+
+		mRequests[request.Sample].Sample = mSamples.size()-1;
+	}
+
+	mSampleTransforms.resize(numTransforms);
+
+	ParallelFor::Run(mSamples.size(), SamplesPerTask, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			const PoseSample& sample = mSamples[i];
+
+			UINT unusedCursor = 0;
+			UINT& cursor = sample.KeyframeCursor ? *sample.KeyframeCursor : unusedCursor;
+
+			sample.Data->SampleClip(sample.ClipIndex, sample.TimePos, cursor, 
+				&mSampleTransforms[sample.Offset]);
+		}
+	});
+}
+
+const BoneTransform* PoseCache::GetPose(UINT request)const
+{
+	return &mSampleTransforms[mSamples[mRequests[request].Sample].Offset];
+}
+
+UINT PoseCache::GetSampledPoseCount()const
+{
+	return mSamples.size();
+}
+
+UINT PoseCache::GetRequestCount()const
+{
+	return mRequests.size();
+}
+
+bool PoseCache::SamePose(const PoseSample& a, const PoseSample& b)
+{
+	return a.Data == b.Data && a.ClipIndex == b.ClipIndex && a.TimePos == b.TimePos;
+}
+
+bool PoseCache::PoseLess(const PoseSample& a, const PoseSample& b)
+{
+	if( a.Data != b.Data )
+		return a.Data < b.Data;
+	if( a.ClipIndex != b.ClipIndex )
+		return a.ClipIndex < b.ClipIndex;
+	if( a.TimePos != b.TimePos )
+		return a.TimePos < b.TimePos;
+
+	// Ties are broken by request order, so the first request of a pose (and its
+	// keyframe cursor) is always the one sampled.
+	return a.Sample < b.Sample;
+}
@@ -0,0 +1,83 @@
+//***************************************************************************************
+// PoseCache.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Per-frame cache of sampled clip poses.  Poses are requested first and sampled
+// afterwards, so every distinct pose is sampled once no matter how many 
+// requests it serves.
+//***************************************************************************************
+
+#ifndef POSECACHE_H
+#define POSECACHE_H
+
+#include "SkinnedData.h"
+
+///<summary>
+/// Requests are keyed by (skeleton, clip, quantized time).  Time is quantized to
+/// multiples of the time quantum, so instances playing the same clip a little
+/// out of sync (e.g. a crowd in an idle loop) share one pose.  With a quantum of 
+/// 0, only requests for exactly the same time are shared.
+///
+/// Sharing happens within a frame: Clear starts a new frame.
+///</summary>
+class PoseCache
+{
+public:
+	PoseCache();
+	~PoseCache();
+
+	void SetTimeQuantum(float seconds);
+	float GetTimeQuantum()const;
+
+	// Forgets all requests and poses.
+	void Clear();
+
+	// Asks for the pose of a clip at a time and returns the index of the request.
+	// keyframeCursor, which may be null, is used and updated if this is the first
+	// request for the pose.
+	UINT Request(const SkinnedData* skinnedData, UINT clipIndex, float timePos, UINT* keyframeCursor);
+
+	// Samples every distinct pose requested since Clear, in parallel.  Which 
+	// request's keyframe cursor is used does not depend on the number of threads.
+	void Evaluate();
+
+	// Local transforms of a request's pose, valid until the next Clear.
+	const BoneTransform* GetPose(UINT request)const;
+
+	// Number of poses sampled by the last Evaluate, and the number of requests
+	// they served.
+	UINT GetSampledPoseCount()const;
+	UINT GetRequestCount()const;
+
+private:
+	// A request for a pose, or a pose to sample, in which case Sample is the 
+	// index of the request it was made from.
+	struct PoseSample
+	{
+		const SkinnedData* Data;
+		UINT ClipIndex;
+		float TimePos;
+		UINT* KeyframeCursor;
+		UINT Offset;
+		UINT Sample;
+	};
+
+	static bool SamePose(const PoseSample& a, const PoseSample& b);
+	static bool PoseLess(const PoseSample& a, const PoseSample& b);
+
+private:
+	float mTimeQuantum;
+
+	// The requests in the order they were made.  After Evaluate, Sample is the
+	// index of the pose that serves the request.
+	std::vector<PoseSample> mRequests;
+
+	// mRequests sorted so that requests for the same pose are together.
+	std::vector<PoseSample> mSortedRequests;
+
+	// The distinct poses and their sampled local transforms, one pose after 
+	// another starting at PoseSample::Offset.
+	std::vector<PoseSample> mSamples;
+	std::vector<BoneTransform> mSampleTransforms;
+};
+
+#endif // POSECACHE_H
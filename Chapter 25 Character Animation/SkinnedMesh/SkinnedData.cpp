@@ -3,164 +3,190 @@
 #include "SkinnedData.h"
 #include "MeshGeometry.h"
 
-Keyframe::Keyframe()
-	: TimePos(0.0f),
-	Translation(0.0f, 0.0f, 0.0f),
-	Scale(1.0f, 1.0f, 1.0f),
-	RotationQuat(0.0f, 0.0f, 0.0f, 1.0f)
+UINT SkinnedData::BoneCount()const
 {
+	return mBoneHierarchy.size();
 }
 
-Keyframe::~Keyframe()
+UINT SkinnedData::ClipCount()const
 {
+	return mClipIndices.size();
 }
- 
-float BoneAnimation::GetStartTime()const
+
+UINT SkinnedData::GetBoneDepth(UINT bone)const
 {
-	// Keyframes are sorted by time, so first keyframe gives start time.
-	return Keyframes.front().TimePos;
+	return mBoneDepths[bone];
 }
 
-float BoneAnimation::GetEndTime()const
+UINT SkinnedData::GetMaxBoneDepth()const
 {
-	// Keyframes are sorted by time, so last keyframe gives end time.
-	float f = Keyframes.back().TimePos;
-
-	return f;
+	return mLodBoneCounts.empty() ? 0 : mLodBoneCounts.size()-1;
 }
 
-void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+UINT SkinnedData::GetLodBoneCount(UINT maxBoneDepth)const
 {
-	if( t <= Keyframes.front().TimePos )
-	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
-	}
-	else if( t >= Keyframes.back().TimePos )
-	{
-		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
-		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
-		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
-
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
-	}
-	else
-	{
-		for(UINT i = 0; i < Keyframes.size()-1; ++i)
-		{
-			if( t >= Keyframes[i].TimePos && t <= Keyframes[i+1].TimePos )
-			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
-
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
-
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
-
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
-
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
-
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	if( mLodBoneCounts.empty() )
+		return 0;
 
-				break;
-			}
-		}
-	}
+	return mLodBoneCounts[MathHelper::Min(maxBoneDepth, GetMaxBoneDepth())];
 }
 
-float AnimationClip::GetClipStartTime()const
+int SkinnedData::GetClipIndex(const std::string& clipName)const
 {
-	// Find smallest start time over all bones in this clip.
-	float t = MathHelper::Infinity;
-	for(UINT i = 0; i < BoneAnimations.size(); ++i)
-	{
-		t = MathHelper::Min(t, BoneAnimations[i].GetStartTime());
-	}
+	auto clip = mClipIndices.find(clipName);
+	if( clip == mClipIndices.end() )
+		return -1;
 
-	return t;
+	return clip->second;
 }
 
-float AnimationClip::GetClipEndTime()const
+float SkinnedData::GetClipStartTime(UINT clipIndex)const
 {
-	// Find largest end time over all bones in this clip.
-	float t = 0.0f;
-	for(UINT i = 0; i < BoneAnimations.size(); ++i)
-	{
-		t = MathHelper::Max(t, BoneAnimations[i].GetEndTime());
-	}
+	if( !mCompressedClips.empty() )
+		return mCompressedClips[clipIndex].GetClipStartTime();
 
-	return t;
+	return mClips[clipIndex].GetClipStartTime();
 }
 
-void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
+float SkinnedData::GetClipEndTime(UINT clipIndex)const
 {
-	for(UINT i = 0; i < BoneAnimations.size(); ++i)
-	{
-		BoneAnimations[i].Interpolate(t, boneTransforms[i]);
-	}
+	if( !mCompressedClips.empty() )
+		return mCompressedClips[clipIndex].GetClipEndTime();
+
+	return mClips[clipIndex].GetClipEndTime();
 }
 
 float SkinnedData::GetClipStartTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipStartTime();
+	return GetClipStartTime(GetClipIndex(clipName));
 }
 
 float SkinnedData::GetClipEndTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipEndTime();
-}
-
-UINT SkinnedData::BoneCount()const
-{
-	return mBoneHierarchy.size();
+	return GetClipEndTime(GetClipIndex(clipName));
 }
 
 void SkinnedData::Set(std::vector<int>& boneHierarchy, 
 		              std::vector<XMFLOAT4X4>& boneOffsets,
-		              std::map<std::string, AnimationClip>& animations)
+		              std::map<std::string, AnimationClip>& animations,
+		              float maxCompressionError)
 {
 	mBoneHierarchy = boneHierarchy;
 	mBoneOffsets   = boneOffsets;
-	mAnimations    = animations;
+
+	// Parents come before their children, so one pass finds every depth.
+	mBoneDepths.resize(mBoneHierarchy.size());
+	mLodBoneCounts.clear();
+	for(UINT i = 0; i < mBoneHierarchy.size(); ++i)
+	{
+		int parentIndex = mBoneHierarchy[i];
+		mBoneDepths[i] = parentIndex < 0 ? 0 : mBoneDepths[parentIndex] + 1;
+
+		if( mLodBoneCounts.size() <= mBoneDepths[i] )
+			mLodBoneCounts.resize(mBoneDepths[i] + 1, 0);
+		++mLodBoneCounts[mBoneDepths[i]];
+	}
+
+	for(UINT d = 1; d < mLodBoneCounts.size(); ++d)
+		mLodBoneCounts[d] += mLodBoneCounts[d-1];
+
+	mClips.resize(animations.size());
+	mCompressedClips.clear();
+	mClipIndices.clear();
+
+	UINT clipIndex = 0;
+	for(auto clip = animations.begin(); clip != animations.end(); ++clip, ++clipIndex)
+	{
+		mClips[clipIndex].Build(clip->second);
+		mClipIndices[clip->first] = clipIndex;
+	}
+
+	if( maxCompressionError > 0.0f )
+	{
+		bool withinError = true;
+
+		mCompressedClips.resize(mClips.size());
+		for(UINT i = 0; i < mClips.size() && withinError; ++i)
+		{
+			withinError = mCompressedClips[i].Build(mClips[i], mBoneHierarchy, maxCompressionError);
+		}
+
+		// Only the compressed clips are kept, unless one of them could not meet 
+		// the error bound; then the clips stay uncompressed.
+		if( withinError )
+			std::vector<PackedClip>().swap(mClips);
+		else
+			mCompressedClips.clear();
+	}
+}
+
+size_t SkinnedData::GetClipBytes()const
+{
+	size_t bytes = 0;
+
+	for(UINT i = 0; i < mClips.size(); ++i)
+		bytes += mClips[i].GetResidentBytes();
+
+	for(UINT i = 0; i < mCompressedClips.size(); ++i)
+		bytes += mCompressedClips[i].GetResidentBytes();
+
+	return bytes;
 }
  
 void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	// A fresh pose buffer allocates, and has no cursor from a previous call so 
+	// the keys are binary searched.
+	UINT keyframeCursor = 0;
+	PoseBuffer pose;
+	GetFinalTransforms(GetClipIndex(clipName), timePos, keyframeCursor, pose, &finalTransforms[0]);
+}
+
+void SkinnedData::GetFinalTransforms(UINT clipIndex, float timePos, UINT& keyframeCursor,
+									 PoseBuffer& pose, XMFLOAT4X4* finalTransforms)const
 {
 	UINT numBones = mBoneOffsets.size();
 
-	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+	if( pose.LocalTransforms.size() != numBones )
+	{
+		pose.LocalTransforms.resize(numBones);
+		pose.ToRootTransforms.resize(numBones);
+	}
+
+	SampleClip(clipIndex, timePos, keyframeCursor, &pose.LocalTransforms[0]);
+	ToFinalTransforms(&pose.LocalTransforms[0], &pose.ToRootTransforms[0], finalTransforms);
+}
+
+void SkinnedData::SampleClip(UINT clipIndex, float timePos, UINT& keyframeCursor, 
+							 BoneTransform* localTransforms)const
+{
+	if( !mCompressedClips.empty() )
+		mCompressedClips[clipIndex].Sample(timePos, keyframeCursor, localTransforms);
+	else
+		mClips[clipIndex].Sample(timePos, keyframeCursor, localTransforms);
+}
 
-	// Interpolate all the bones of this clip at the given time instance.
-	auto clip = mAnimations.find(clipName);
-	clip->second.Interpolate(timePos, toParentTransforms);
+void SkinnedData::ToFinalTransforms(const BoneTransform* localTransforms, 
+									XMFLOAT4X4* toRootTransforms, XMFLOAT4X4* finalTransforms,
+									UINT maxBoneDepth)const
+{
+	UINT numBones = mBoneOffsets.size();
 
 	//
 	// Traverse the hierarchy and transform all the bones to the root space.
 	//
 
-	std::vector<XMFLOAT4X4> toRootTransforms(numBones);
-
 	// The root bone has index 0.  The root bone has no parent, so its toRootTransform
 	// is just its local bone transform.
-	toRootTransforms[0] = toParentTransforms[0];
+	XMStoreFloat4x4(&toRootTransforms[0], localTransforms[0].ToMatrix());
 
 	// Now find the toRootTransform of the children.
 	for(UINT i = 1; i < numBones; ++i)
 	{
-		XMMATRIX toParent = XMLoadFloat4x4(&toParentTransforms[i]);
+		if( mBoneDepths[i] > maxBoneDepth )
+			continue;
+
+		XMMATRIX toParent = localTransforms[i].ToMatrix();
 
 		int parentIndex = mBoneHierarchy[i];
 		XMMATRIX parentToRoot = XMLoadFloat4x4(&toRootTransforms[parentIndex]);
@@ -173,6 +199,14 @@ void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,
 	// Premultiply by the bone offset transform to get the final transform.
 	for(UINT i = 0; i < numBones; ++i)
 	{
+		// The offset undoes the bind pose to root transform, so a bone in its bind 
+		// pose relative to its parent has its parent's final transform.
+		if( mBoneDepths[i] > maxBoneDepth )
+		{
+			finalTransforms[i] = finalTransforms[mBoneHierarchy[i]];
+			continue;
+		}
+
 		XMMATRIX offset = XMLoadFloat4x4(&mBoneOffsets[i]);
 		XMMATRIX toRoot = XMLoadFloat4x4(&toRootTransforms[i]);
 		XMStoreFloat4x4(&finalTransforms[i], XMMatrixMultiply(offset, toRoot));
@@ -2,53 +2,37 @@
 #define SKINNEDDATA_H
 
 #include "d3dUtil.h"
+#include "AnimationClip.h"
+#include "PackedClip.h"
+#include "CompressedClip.h"
 #include <map>
 
 ///<summary>
-/// A Keyframe defines the bone transformation at an instant in time.
+/// A clip at a time whose pose an instance needs this frame.  Poses that several
+/// instances need are only sampled once; see AnimationSystem.
 ///</summary>
-struct Keyframe
+struct PoseSource
 {
-	Keyframe();
-	~Keyframe();
-
-    float TimePos;
-	XMFLOAT3 Translation;
-	XMFLOAT3 Scale;
-	XMFLOAT4 RotationQuat;
+	UINT ClipIndex;
+	float TimePos;
+	UINT* KeyframeCursor;
 };
 
 ///<summary>
-/// A BoneAnimation is defined by a list of keyframes.  For time
-/// values inbetween two keyframes, we interpolate between the
-/// two nearest keyframes that bound the time.  
-///
-/// We assume an animation always has two keyframes.
+/// Working memory for evaluating the pose of one animated instance.  Once it
+/// has been sized by the first call to SkinnedData::GetFinalTransforms, later 
+/// calls do not allocate.
 ///</summary>
-struct BoneAnimation
+struct PoseBuffer
 {
-	float GetStartTime()const;
-	float GetEndTime()const;
-
-    void Interpolate(float t, XMFLOAT4X4& M)const;
-
-	std::vector<Keyframe> Keyframes; 	
-
-};
-
-///<summary>
-/// Examples of AnimationClips are "Walk", "Run", "Attack", "Defend".
-/// An AnimationClip requires a BoneAnimation for every bone to form
-/// the animation clip.    
-///</summary>
-struct AnimationClip
-{
-	float GetClipStartTime()const;
-	float GetClipEndTime()const;
-
-    void Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const;
-
-    std::vector<BoneAnimation> BoneAnimations; 	
+	std::vector<BoneTransform> LocalTransforms;
+	std::vector<XMFLOAT4X4> ToRootTransforms;
+
+	// For blending several clip poses: the clips, and their sampled poses one
+	// after another.
+	std::vector<PoseSource> Sources;
+	std::vector<BoneTransform> SourceTransforms;
+	std::vector<const BoneTransform*> SourcePoses;
 };
 
 class SkinnedData
@@ -56,28 +40,82 @@ class SkinnedData
 public:
 
 	UINT BoneCount()const;
+	UINT ClipCount()const;
+
+	// Depth of a bone in the hierarchy; the root has depth 0.  Bone LODs drop the
+	// bones deeper than some depth (see ToFinalTransforms), and GetLodBoneCount 
+	// gives the number of bones left.
+	UINT GetBoneDepth(UINT bone)const;
+	UINT GetMaxBoneDepth()const;
+	UINT GetLodBoneCount(UINT maxBoneDepth)const;
+
+	// Index of the named clip, or -1 if there is no such clip.  Look the index up
+	// once and use it from then on instead of the name.
+	int GetClipIndex(const std::string& clipName)const;
+
+	float GetClipStartTime(UINT clipIndex)const;
+	float GetClipEndTime(UINT clipIndex)const;
 
 	float GetClipStartTime(const std::string& clipName)const;
 	float GetClipEndTime(const std::string& clipName)const;
 
+	// The clips are stored as PackedClips, which sample fastest, or if 
+	// maxCompressionError is positive as CompressedClips with that error bound, 
+	// which take far less memory.  If a clip cannot be compressed within the 
+	// bound (see CompressedClip::Build), the clips are left uncompressed.
 	void Set(
 		std::vector<int>& boneHierarchy, 
 		std::vector<XMFLOAT4X4>& boneOffsets,
-		std::map<std::string, AnimationClip>& animations);
+		std::map<std::string, AnimationClip>& animations,
+		float maxCompressionError = 0.0f);
+
+	// Memory used by the clips.
+	size_t GetClipBytes()const;
 
-	 // In a real project, you'd want to cache the result if there was a chance
-	 // that you were calling this several times with the same clipName at 
-	 // the same timePos.
+	 // To evaluate many instances that may share poses (same clip at the same 
+	 // time), see PoseCache and AnimationSystem.
     void GetFinalTransforms(const std::string& clipName, float timePos, 
 		 std::vector<XMFLOAT4X4>& finalTransforms)const;
 
+	// Same as above, but the clip is given by index and the intermediate results
+	// are kept in pose, so steady-state evaluation neither allocates nor looks up
+	// strings.  The key search also starts from keyframeCursor (see 
+	// ClipPlayback), so playing the clip forward does not search the keys every
+	// frame.  Each animated instance needs its own PoseBuffer.
+    // finalTransforms must have room for BoneCount() matrices.
+    void GetFinalTransforms(UINT clipIndex, float timePos, UINT& keyframeCursor,
+		 PoseBuffer& pose, XMFLOAT4X4* finalTransforms)const;
+
+	// The two steps of GetFinalTransforms, for callers that blend poses in
+	// between.  SampleClip writes the local transform of every bone of a clip at
+	// timePos (see PackedClip::Sample).  ToFinalTransforms walks the hierarchy to
+	// turn local transforms into final transforms, using toRootTransforms (also 
+	// BoneCount() matrices) as scratch.
+	//
+	// Bones deeper than maxBoneDepth are not evaluated: they are taken to keep 
+	// their bind pose relative to their parent, which makes their final transform
+	// the same as their parent's, so it is just copied.
+	void SampleClip(UINT clipIndex, float timePos, UINT& keyframeCursor, 
+		BoneTransform* localTransforms)const;
+	void ToFinalTransforms(const BoneTransform* localTransforms, 
+		XMFLOAT4X4* toRootTransforms, XMFLOAT4X4* finalTransforms,
+		UINT maxBoneDepth = UINT_MAX)const;
+
 private:
     // Gives parentIndex of ith bone.
 	std::vector<int> mBoneHierarchy;
 
 	std::vector<XMFLOAT4X4> mBoneOffsets;
+
+	// Depth of each bone, and the number of bones at each depth or above.
+	std::vector<UINT> mBoneDepths;
+	std::vector<UINT> mLodBoneCounts;
    
-	std::map<std::string, AnimationClip> mAnimations;
+	// The animation clips, repacked for sampling or compressed (only one of the
+	// two is used), and the index of each by name.
+	std::vector<PackedClip> mClips;
+	std::vector<CompressedClip> mCompressedClips;
+	std::map<std::string, UINT> mClipIndices;
 };
  
 #endif // SKINNEDDATA_H
\ No newline at end of file
@@ -25,6 +25,8 @@
 #include "TextureMgr.h"
 #include "BasicModel.h"
 #include "SkinnedModel.h"
+#include "AnimationSystem.h"
+#include "xnacollision.h"
 
 struct BoundingSphere
 {
@@ -53,6 +55,10 @@ private:
 	void DrawSceneToShadowMap();
 	void DrawScreenQuad(ID3D11ShaderResourceView* srv);
 	void BuildShadowTransform();
+	void BuildCharacterBounds();
+	void CullCharacters();
+	void CullCharacterShadows();
+	void SelectCharacterLods();
 	void BuildShapeGeometryBuffers();
 	void BuildSkullGeometryBuffers();
 	void BuildScreenQuadGeometryBuffers();
@@ -67,6 +73,22 @@ private:
 	SkinnedModelInstance mCharacterInstance1;
 	SkinnedModelInstance mCharacterInstance2;
 
+	// Updates the character instances; the indices of the instances in it give
+	// their bone palettes.
+	AnimationSystem mAnimationSystem;
+	UINT mCharacterAnimIndex1;
+	UINT mCharacterAnimIndex2;
+
+	// World space boxes of the animated characters, from their bone palettes, 
+	// whether they are in the camera frustum, and whether they are in the light's
+	// shadow map volume.
+	XNA::AxisAlignedBox mCharacterBounds1;
+	XNA::AxisAlignedBox mCharacterBounds2;
+	bool mCharacterVisible1;
+	bool mCharacterVisible2;
+	bool mCharacterCastsShadow1;
+	bool mCharacterCastsShadow2;
+
 	ID3D11Buffer* mShapesVB;
 	ID3D11Buffer* mShapesIB;
 
@@ -85,6 +107,9 @@ private:
 	ID3D11ShaderResourceView* mStoneNormalTexSRV;
 	ID3D11ShaderResourceView* mBrickNormalTexSRV;
 
+	// The static scene, and the static scene plus the visible characters as they
+	// are posed this frame, which the shadow map must cover.
+	BoundingSphere mStaticSceneBounds;
 	BoundingSphere mSceneBounds;
 
 	static const int SMapSize = 2048;
@@ -129,6 +154,7 @@ private:
 	UINT mSkullIndexCount;
  
 	Camera mCam;
+	XNA::Frustum mCamFrustum;
 
 	POINT mLastMousePos;
 };
@@ -169,8 +195,14 @@ SkinnedMeshApp::SkinnedMeshApp(HINSTANCE hInstance)
 	// The grid is the "widest object" with a width of 20 and depth of 30.0f, and centered at
 	// the world space origin.  In general, you need to loop over every world space vertex
 	// position and compute the bounding sphere.
-	mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	mSceneBounds.Radius = sqrtf(10.0f*10.0f + 15.0f*15.0f);
+	mStaticSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	mStaticSceneBounds.Radius = sqrtf(10.0f*10.0f + 15.0f*15.0f);
+	mSceneBounds = mStaticSceneBounds;
+
+	mCharacterVisible1 = true;
+	mCharacterVisible2 = true;
+	mCharacterCastsShadow1 = true;
+	mCharacterCastsShadow2 = true;
 
 	XMMATRIX I = XMMatrixIdentity();
 	XMStoreFloat4x4(&mGridWorld, I);
@@ -291,15 +323,20 @@ bool SkinnedMeshApp::Init()
 	BuildSkullGeometryBuffers();
 	BuildScreenQuadGeometryBuffers();
 
-	mCharacterModel = new SkinnedModel(md3dDevice, mTexMgr, "Models\\soldier.m3d", L"Textures\\");
+	// Keep the clips compressed, with every bone end within 0.1 model units
+	// (0.005 world units after the 0.05 scale below) of where the keys put it.
+	mCharacterModel = new SkinnedModel(md3dDevice, mTexMgr, "Models\\soldier.m3d", L"Textures\\", 0.1f);
 	mCharacterInstance1.Model = mCharacterModel;
 	mCharacterInstance2.Model = mCharacterModel;
-	mCharacterInstance1.TimePos = 0.0f;
-	mCharacterInstance2.TimePos = 0.0f;
-	mCharacterInstance1.ClipName = "Take1";
-	mCharacterInstance2.ClipName = "Take1";
-	mCharacterInstance1.FinalTransforms.resize(mCharacterModel->SkinnedData.BoneCount());
-	mCharacterInstance2.FinalTransforms.resize(mCharacterModel->SkinnedData.BoneCount());
+	mCharacterInstance1.Play(mCharacterModel->SkinnedData.GetClipIndex("Take1"));
+	mCharacterInstance2.Play(mCharacterModel->SkinnedData.GetClipIndex("Take1"));
+
+	mCharacterAnimIndex1 = mAnimationSystem.AddInstance(&mCharacterInstance1);
+	mCharacterAnimIndex2 = mAnimationSystem.AddInstance(&mCharacterInstance2);
+
+	// Characters outside the camera frustum may still cast shadows into view, so
+	// keep updating one of them per frame.
+	mAnimationSystem.SetOffscreenBudget(1);
 
 	// Reflect to change coordinate system from the RHS the data was exported out as.
 	XMMATRIX modelScale = XMMatrixScaling(0.05f, 0.05f, -0.05f);
@@ -319,6 +356,9 @@ void SkinnedMeshApp::OnResize()
 
 	mCam.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 
+	// Build the frustum from the projection matrix in view space.
+	ComputeFrustumFromProjection(&mCamFrustum, &mCam.Proj());
+
 	if( mSsao )
 	{
 		mSsao->OnSize(mClientWidth, mClientHeight, mCam.GetFovY(), mCam.GetFarZ());
@@ -346,16 +386,27 @@ void SkinnedMeshApp::UpdateScene(float dt)
 	// Animate the character.
 	// 
 	
-	mCharacterInstance1.Update(dt);
-	mCharacterInstance2.Update(dt);
+	mAnimationSystem.Update(dt);
+	BuildCharacterBounds();
+
+	mCam.UpdateViewMatrix();
+
+	CullCharacters();
+	SelectCharacterLods();
 
 	//
 	// Animate the lights (and hence shadows).
 	//
 
 	BuildShadowTransform();
-
-	mCam.UpdateViewMatrix();
+	CullCharacterShadows();
+
+	std::wostringstream outs;   
+	outs << L"Skinned Mesh Demo" << 
+		L"    " << mAnimationSystem.GetEvaluatedBoneCount() << 
+		L" bones evaluated, " << mAnimationSystem.GetInterpolatedBoneCount() <<
+		L" interpolated";
+	mMainWndCaption = outs.str();
 }
 
 void SkinnedMeshApp::DrawScene()
@@ -589,56 +640,60 @@ void SkinnedMeshApp::DrawScene()
 	for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Instance 1
-
-		world = XMLoadFloat4x4(&mCharacterInstance1.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::NormalMapFX->SetWorld(world);
-		Effects::NormalMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::NormalMapFX->SetWorldViewProj(worldViewProj);
-		Effects::NormalMapFX->SetWorldViewProjTex(worldViewProj*toTexSpace);
-		Effects::NormalMapFX->SetShadowTransform(world*shadowTransform);
-		Effects::NormalMapFX->SetTexTransform(XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		Effects::NormalMapFX->SetBoneTransforms(
-			&mCharacterInstance1.FinalTransforms[0], 
-			mCharacterInstance1.FinalTransforms.size());
-
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+		if( mCharacterVisible1 )
 		{
-			Effects::NormalMapFX->SetMaterial(mCharacterInstance1.Model->Mat[subset]);
-			Effects::NormalMapFX->SetDiffuseMap(mCharacterInstance1.Model->DiffuseMapSRV[subset]);
-			Effects::NormalMapFX->SetNormalMap(mCharacterInstance1.Model->NormalMapSRV[subset]);
+			world = XMLoadFloat4x4(&mCharacterInstance1.World);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-			activeSkinnedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-			mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			Effects::NormalMapFX->SetWorld(world);
+			Effects::NormalMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::NormalMapFX->SetWorldViewProj(worldViewProj);
+			Effects::NormalMapFX->SetWorldViewProjTex(worldViewProj*toTexSpace);
+			Effects::NormalMapFX->SetShadowTransform(world*shadowTransform);
+			Effects::NormalMapFX->SetTexTransform(XMMatrixScaling(1.0f, 1.0f, 1.0f));
+			Effects::NormalMapFX->SetBoneTransforms(
+				mAnimationSystem.GetPalette(mCharacterAnimIndex1), 
+				mAnimationSystem.GetPaletteSize(mCharacterAnimIndex1));
+
+			for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+			{
+				Effects::NormalMapFX->SetMaterial(mCharacterInstance1.Model->Mat[subset]);
+				Effects::NormalMapFX->SetDiffuseMap(mCharacterInstance1.Model->DiffuseMapSRV[subset]);
+				Effects::NormalMapFX->SetNormalMap(mCharacterInstance1.Model->NormalMapSRV[subset]);
+
+				activeSkinnedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+				mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			}
 		}
 
 		// Instance 2
-
-		world = XMLoadFloat4x4(&mCharacterInstance2.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::NormalMapFX->SetWorld(world);
-		Effects::NormalMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::NormalMapFX->SetWorldViewProj(worldViewProj);
-		Effects::NormalMapFX->SetWorldViewProjTex(worldViewProj*toTexSpace);
-		Effects::NormalMapFX->SetShadowTransform(world*shadowTransform);
-		Effects::NormalMapFX->SetTexTransform(XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		
-		Effects::NormalMapFX->SetBoneTransforms(
-			&mCharacterInstance2.FinalTransforms[0], 
-			mCharacterInstance2.FinalTransforms.size());
-
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+		if( mCharacterVisible2 )
 		{
-			Effects::NormalMapFX->SetMaterial(mCharacterInstance2.Model->Mat[subset]);
-			Effects::NormalMapFX->SetDiffuseMap(mCharacterInstance2.Model->DiffuseMapSRV[subset]);
-			Effects::NormalMapFX->SetNormalMap(mCharacterInstance2.Model->NormalMapSRV[subset]);
+			world = XMLoadFloat4x4(&mCharacterInstance2.World);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-			activeSkinnedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-			mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			Effects::NormalMapFX->SetWorld(world);
+			Effects::NormalMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::NormalMapFX->SetWorldViewProj(worldViewProj);
+			Effects::NormalMapFX->SetWorldViewProjTex(worldViewProj*toTexSpace);
+			Effects::NormalMapFX->SetShadowTransform(world*shadowTransform);
+			Effects::NormalMapFX->SetTexTransform(XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		
+			Effects::NormalMapFX->SetBoneTransforms(
+				mAnimationSystem.GetPalette(mCharacterAnimIndex2), 
+				mAnimationSystem.GetPaletteSize(mCharacterAnimIndex2));
+
+			for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+			{
+				Effects::NormalMapFX->SetMaterial(mCharacterInstance2.Model->Mat[subset]);
+				Effects::NormalMapFX->SetDiffuseMap(mCharacterInstance2.Model->DiffuseMapSRV[subset]);
+				Effects::NormalMapFX->SetNormalMap(mCharacterInstance2.Model->NormalMapSRV[subset]);
+
+				activeSkinnedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+				mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			}
 		}
 	}
 	
@@ -832,49 +887,53 @@ void SkinnedMeshApp::DrawSceneToSsaoNormalDepthMap()
 	for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Instance 1
+		if( mCharacterVisible1 )
+		{
+			world = XMLoadFloat4x4(&mCharacterInstance1.World);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldView     = world*view;
+			worldInvTransposeView = worldInvTranspose*view;
+			worldViewProj = world*view*proj;
 
-		world = XMLoadFloat4x4(&mCharacterInstance1.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldView     = world*view;
-		worldInvTransposeView = worldInvTranspose*view;
-		worldViewProj = world*view*proj;
-
-		Effects::SsaoNormalDepthFX->SetWorldView(worldView);
-		Effects::SsaoNormalDepthFX->SetWorldInvTransposeView(worldInvTransposeView);
-		Effects::SsaoNormalDepthFX->SetWorldViewProj(worldViewProj);
-		Effects::SsaoNormalDepthFX->SetTexTransform(XMMatrixIdentity());
-		Effects::SsaoNormalDepthFX->SetBoneTransforms(
-			&mCharacterInstance1.FinalTransforms[0], 
-			mCharacterInstance1.FinalTransforms.size());
+			Effects::SsaoNormalDepthFX->SetWorldView(worldView);
+			Effects::SsaoNormalDepthFX->SetWorldInvTransposeView(worldInvTransposeView);
+			Effects::SsaoNormalDepthFX->SetWorldViewProj(worldViewProj);
+			Effects::SsaoNormalDepthFX->SetTexTransform(XMMatrixIdentity());
+			Effects::SsaoNormalDepthFX->SetBoneTransforms(
+				mAnimationSystem.GetPalette(mCharacterAnimIndex1), 
+				mAnimationSystem.GetPaletteSize(mCharacterAnimIndex1));
 
-		animatedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			animatedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
-		{
-			mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+			{
+				mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			}
 		}
 
 		// Instance 2
+		if( mCharacterVisible2 )
+		{
+			world = XMLoadFloat4x4(&mCharacterInstance2.World);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldView     = world*view;
+			worldInvTransposeView = worldInvTranspose*view;
+			worldViewProj = world*view*proj;
 
-		world = XMLoadFloat4x4(&mCharacterInstance2.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldView     = world*view;
-		worldInvTransposeView = worldInvTranspose*view;
-		worldViewProj = world*view*proj;
-
-		Effects::SsaoNormalDepthFX->SetWorldView(worldView);
-		Effects::SsaoNormalDepthFX->SetWorldInvTransposeView(worldInvTransposeView);
-		Effects::SsaoNormalDepthFX->SetWorldViewProj(worldViewProj);
-		Effects::SsaoNormalDepthFX->SetTexTransform(XMMatrixIdentity());
-		Effects::SsaoNormalDepthFX->SetBoneTransforms(
-			&mCharacterInstance2.FinalTransforms[0], 
-			mCharacterInstance2.FinalTransforms.size());
+			Effects::SsaoNormalDepthFX->SetWorldView(worldView);
+			Effects::SsaoNormalDepthFX->SetWorldInvTransposeView(worldInvTransposeView);
+			Effects::SsaoNormalDepthFX->SetWorldViewProj(worldViewProj);
+			Effects::SsaoNormalDepthFX->SetTexTransform(XMMatrixIdentity());
+			Effects::SsaoNormalDepthFX->SetBoneTransforms(
+				mAnimationSystem.GetPalette(mCharacterAnimIndex2), 
+				mAnimationSystem.GetPaletteSize(mCharacterAnimIndex2));
 
-		animatedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			animatedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 
-		for(UINT subset = 0; subset < mCharacterInstance2.Model->SubsetCount; ++subset)
-		{
-			mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			for(UINT subset = 0; subset < mCharacterInstance2.Model->SubsetCount; ++subset)
+			{
+				mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			}
 		}
 	}
 
@@ -1018,46 +1077,49 @@ void SkinnedMeshApp::DrawSceneToShadowMap()
 	for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Instance 1
+		if( mCharacterCastsShadow1 )
+		{
+			world = XMLoadFloat4x4(&mCharacterInstance1.World);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		world = XMLoadFloat4x4(&mCharacterInstance1.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
-		Effects::BuildShadowMapFX->SetBoneTransforms(
-			&mCharacterInstance1.FinalTransforms[0], 
-			mCharacterInstance1.FinalTransforms.size());
-
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+			Effects::BuildShadowMapFX->SetBoneTransforms(
+				mAnimationSystem.GetPalette(mCharacterAnimIndex1), 
+				mAnimationSystem.GetPaletteSize(mCharacterAnimIndex1));
 
-		animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
-		{
-			mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+			{
+				mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			}
 		}
 
 		// Instance 2
+		if( mCharacterCastsShadow2 )
+		{
+			world = XMLoadFloat4x4(&mCharacterInstance2.World);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		world = XMLoadFloat4x4(&mCharacterInstance2.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
-		Effects::BuildShadowMapFX->SetBoneTransforms(
-			&mCharacterInstance2.FinalTransforms[0], 
-			mCharacterInstance2.FinalTransforms.size());
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+			Effects::BuildShadowMapFX->SetBoneTransforms(
+				mAnimationSystem.GetPalette(mCharacterAnimIndex2), 
+				mAnimationSystem.GetPaletteSize(mCharacterAnimIndex2));
 
-		animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
-		{
-			mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			for(UINT subset = 0; subset < mCharacterInstance2.Model->SubsetCount; ++subset)
+			{
+				mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+			}
 		}
 	}
 
@@ -1097,6 +1159,28 @@ void SkinnedMeshApp::DrawScreenQuad(ID3D11ShaderResourceView* srv)
 
 void SkinnedMeshApp::BuildShadowTransform()
 {
+	// Cover the static scene and the visible characters, so they shadow 
+	// themselves and each other.  Characters out of view are only drawn into the
+	// shadow map if they happen to be in this volume (see CullCharacterShadows);
+	// growing it for them would just spread the shadow map over more area.
+	mSceneBounds = mStaticSceneBounds;
+	XMVECTOR sceneCenter = XMLoadFloat3(&mSceneBounds.Center);
+
+	XNA::AxisAlignedBox* bounds[2] = { &mCharacterBounds1, &mCharacterBounds2 };
+	bool visible[2] = { mCharacterVisible1, mCharacterVisible2 };
+
+	for(int i = 0; i < 2; ++i)
+	{
+		if( !visible[i] )
+			continue;
+
+		XMVECTOR c = XMLoadFloat3(&bounds[i]->Center);
+		XMVECTOR r = XMLoadFloat3(&bounds[i]->Extents);
+
+		float farthest = XMVectorGetX(XMVector3Length(c - sceneCenter) + XMVector3Length(r));
+		mSceneBounds.Radius = MathHelper::Max(mSceneBounds.Radius, farthest);
+	}
+
 	// Only the first "main" light casts a shadow.
 	XMVECTOR lightDir = XMLoadFloat3(&mDirLights[0].Direction);
 	XMVECTOR lightPos = -2.0f*mSceneBounds.Radius*lightDir;
@@ -1132,6 +1216,115 @@ void SkinnedMeshApp::BuildShadowTransform()
 	XMStoreFloat4x4(&mShadowTransform, S);
 }
 
+void SkinnedMeshApp::BuildCharacterBounds()
+{
+	SkinnedModelInstance* instances[2] = { &mCharacterInstance1, &mCharacterInstance2 };
+	UINT animIndices[2] = { mCharacterAnimIndex1, mCharacterAnimIndex2 };
+	XNA::AxisAlignedBox* bounds[2] = { &mCharacterBounds1, &mCharacterBounds2 };
+
+	for(int i = 0; i < 2; ++i)
+	{
+		// Transform the model space box to world space.  The world matrix has a
+		// reflection, so the box is transformed directly rather than decomposing
+		// the matrix: the new half extents are the old ones projected onto the
+		// world axes.
+		XMFLOAT3 center, extents;
+		mAnimationSystem.GetBounds(animIndices[i], center, extents);
+
+		XMMATRIX W = XMLoadFloat4x4(&instances[i]->World);
+
+		XMVECTOR c = XMVector3Transform(XMLoadFloat3(&center), W);
+		XMVECTOR r =
+			extents.x*XMVectorAbs(W.r[0]) +
+			extents.y*XMVectorAbs(W.r[1]) +
+			extents.z*XMVectorAbs(W.r[2]);
+
+		XMStoreFloat3(&bounds[i]->Center, c);
+		XMStoreFloat3(&bounds[i]->Extents, r);
+	}
+}
+
+void SkinnedMeshApp::CullCharacters()
+{
+	// Transform the camera frustum from view space to world space once, and test
+	// the world space boxes against it.
+	XMMATRIX view = mCam.View();
+	XMVECTOR detView = XMMatrixDeterminant(view);
+	XMMATRIX invView = XMMatrixInverse(&detView, view);
+
+	XMVECTOR scale;
+	XMVECTOR rotQuat;
+	XMVECTOR translation;
+	XMMatrixDecompose(&scale, &rotQuat, &translation, invView);
+
+	XNA::Frustum worldFrustum;
+	XNA::TransformFrustum(&worldFrustum, &mCamFrustum, XMVectorGetX(scale), rotQuat, translation);
+
+	mCharacterVisible1 = XNA::IntersectAxisAlignedBoxFrustum(&mCharacterBounds1, &worldFrustum) != 0;
+	mCharacterVisible2 = XNA::IntersectAxisAlignedBoxFrustum(&mCharacterBounds2, &worldFrustum) != 0;
+}
+
+void SkinnedMeshApp::CullCharacterShadows()
+{
+	// The light's view and orthographic projection are both affine, so a world 
+	// space box maps to a box in NDC space the same way BuildCharacterBounds maps
+	// model space boxes to world space.  The character can only land in the shadow
+	// map if that box overlaps the view volume [-1,1]x[-1,1]x[0,1].
+	XMMATRIX lightViewProj = XMLoadFloat4x4(&mLightView)*XMLoadFloat4x4(&mLightProj);
+
+	XNA::AxisAlignedBox* bounds[2] = { &mCharacterBounds1, &mCharacterBounds2 };
+	bool* castsShadow[2] = { &mCharacterCastsShadow1, &mCharacterCastsShadow2 };
+
+	for(int i = 0; i < 2; ++i)
+	{
+		XMFLOAT3 center;
+		XMFLOAT3 extents;
+		XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&bounds[i]->Center), lightViewProj));
+		XMStoreFloat3(&extents,
+			bounds[i]->Extents.x*XMVectorAbs(lightViewProj.r[0]) +
+			bounds[i]->Extents.y*XMVectorAbs(lightViewProj.r[1]) +
+			bounds[i]->Extents.z*XMVectorAbs(lightViewProj.r[2]));
+
+		*castsShadow[i] =
+			center.x - extents.x <=  1.0f && center.x + extents.x >= -1.0f &&
+			center.y - extents.y <=  1.0f && center.y + extents.y >= -1.0f &&
+			center.z - extents.z <=  1.0f && center.z + extents.z >=  0.0f;
+	}
+}
+
+void SkinnedMeshApp::SelectCharacterLods()
+{
+	SkinnedModelInstance* instances[2] = { &mCharacterInstance1, &mCharacterInstance2 };
+	XNA::AxisAlignedBox* bounds[2] = { &mCharacterBounds1, &mCharacterBounds2 };
+	bool visible[2] = { mCharacterVisible1, mCharacterVisible2 };
+
+	XMVECTOR camPos = mCam.GetPositionXM();
+	UINT maxBoneDepth = mCharacterModel->SkinnedData.GetMaxBoneDepth();
+
+	// The LODs take effect in the next update.  Far away, the deepest bones (the
+	// fingers and such) are too small to see, and a lower update rate is hidden
+	// by the interpolation.
+	for(int i = 0; i < 2; ++i)
+	{
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds[i]->Center) - camPos));
+
+		AnimationLod lod;
+		if( distance > 60.0f )
+		{
+			lod.MaxBoneDepth   = maxBoneDepth/2;
+			lod.UpdateInterval = 1.0f/10.0f;
+		}
+		else if( distance > 30.0f )
+		{
+			lod.MaxBoneDepth   = maxBoneDepth > 2 ? maxBoneDepth-2 : maxBoneDepth;
+			lod.UpdateInterval = 1.0f/20.0f;
+		}
+
+		instances[i]->Lod = lod;
+		instances[i]->Visible = visible[i];
+	}
+}
+
 void SkinnedMeshApp::BuildShapeGeometryBuffers()
 {
 	GeometryGenerator::MeshData box;
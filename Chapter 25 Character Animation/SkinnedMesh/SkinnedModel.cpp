@@ -1,16 +1,26 @@
 #include "SkinnedModel.h"
 #include "LoadM3d.h"
+#include "PoseBlend.h"
 
-SkinnedModel::SkinnedModel(ID3D11Device* device, TextureMgr& texMgr, const std::string& modelFilename, const std::wstring& texturePath)
+SkinnedModel::SkinnedModel(ID3D11Device* device, TextureMgr& texMgr, const std::string& modelFilename, const std::wstring& texturePath,
+						   float maxCompressionError)
 {
 	std::vector<M3dMaterial> mats;
 	M3DLoader m3dLoader;
-	m3dLoader.LoadM3d(modelFilename, Vertices, Indices, Subsets, mats, SkinnedData);
+	m3dLoader.LoadM3d(modelFilename, Vertices, Indices, Subsets, mats, SkinnedData, maxCompressionError);
 
 	ModelMesh.SetVertices(device, &Vertices[0], Vertices.size());
 	ModelMesh.SetIndices(device, &Indices[0], Indices.size());
 	ModelMesh.SetSubsetTable(Subsets);
 
+	CpuSkinning::MeshDesc meshDesc;
+	meshDesc.NumVertices = Vertices.size();
+	meshDesc.Stride      = sizeof(Vertex::PosNormalTexTanSkinned);
+	meshDesc.Positions   = &Vertices[0].Pos;
+	meshDesc.Weights     = &Vertices[0].Weights;
+	meshDesc.BoneIndices = &Vertices[0].BoneIndices[0];
+	BoneBounds.Build(meshDesc, SkinnedData.BoneCount());
+
 	SubsetCount = mats.size();
 
 	for(UINT i = 0; i < SubsetCount; ++i)
@@ -29,12 +39,200 @@ SkinnedModel::~SkinnedModel()
 {
 }
 
-void SkinnedModelInstance::Update(float dt)
+ClipPlayback::ClipPlayback()
+	: ClipIndex(0), TimePos(0.0f), Loop(true), KeyframeCursor(0)
+{
+}
+
+void ClipPlayback::Advance(float dt, const SkinnedData& skinnedData)
 {
+	float startTime = skinnedData.GetClipStartTime(ClipIndex);
+	float endTime   = skinnedData.GetClipEndTime(ClipIndex);
+
 	TimePos += dt;
-	Model->SkinnedData.GetFinalTransforms(ClipName, TimePos, FinalTransforms);
 
-	// Loop animation
-	if(TimePos > Model->SkinnedData.GetClipEndTime(ClipName))
-		TimePos = 0.0f;
+	if( TimePos > endTime )
+	{
+		// Wrap around instead of restarting at 0 so the time left over past the end
+		// is not lost, which would make the loop hitch.
+		float length = endTime - startTime;
+		if( Loop && length > 0.0f )
+			TimePos = startTime + fmodf(TimePos - startTime, length);
+		else
+			TimePos = endTime;
+	}
+}
+
+AnimationLayer::AnimationLayer()
+	: Weight(1.0f), Additive(false)
+{
+}
+
+AnimationLod::AnimationLod()
+	: MaxBoneDepth(UINT_MAX), UpdateInterval(0.0f)
+{
+}
+
+SkinnedModelInstance::SkinnedModelInstance()
+	: Model(0), FadeTime(0.0f), FadeDuration(0.0f), Visible(true)
+{
+	XMStoreFloat4x4(&World, XMMatrixIdentity());
+}
+
+void SkinnedModelInstance::Play(UINT clipIndex)
+{
+	Current.ClipIndex = clipIndex;
+	Current.TimePos = Model->SkinnedData.GetClipStartTime(clipIndex);
+	Current.KeyframeCursor = 0;
+
+	FadeTime = FadeDuration = 0.0f;
+}
+
+void SkinnedModelInstance::CrossFade(UINT clipIndex, float duration)
+{
+	// Fading again in the middle of a fade drops the clip that was being faded 
+	// out, which pops a little, but keeps the number of clips sampled bounded.
+	Previous = Current;
+	Play(clipIndex);
+
+	FadeDuration = duration;
+}
+
+bool SkinnedModelInstance::IsFading()const
+{
+	return FadeTime < FadeDuration;
+}
+
+void SkinnedModelInstance::Advance(float dt)
+{
+	const SkinnedData& skinnedData = Model->SkinnedData;
+
+	Current.Advance(dt, skinnedData);
+
+	if( IsFading() )
+	{
+		Previous.Advance(dt, skinnedData);
+		FadeTime += dt;
+	}
+
+	for(UINT i = 0; i < Layers.size(); ++i)
+	{
+		Layers[i].Clip.Advance(dt, skinnedData);
+	}
+}
+
+void SkinnedModelInstance::GetPoseSources(std::vector<PoseSource>& sources)
+{
+	PoseSource source;
+
+	source.ClipIndex = Current.ClipIndex;
+	source.TimePos = Current.TimePos;
+	source.KeyframeCursor = &Current.KeyframeCursor;
+	sources.push_back(source);
+
+	if( IsFading() )
+	{
+		source.ClipIndex = Previous.ClipIndex;
+		source.TimePos = Previous.TimePos;
+		source.KeyframeCursor = &Previous.KeyframeCursor;
+		sources.push_back(source);
+	}
+
+	for(UINT i = 0; i < Layers.size(); ++i)
+	{
+		ClipPlayback& clip = Layers[i].Clip;
+
+		source.ClipIndex = clip.ClipIndex;
+		source.TimePos = clip.TimePos;
+		source.KeyframeCursor = &clip.KeyframeCursor;
+		sources.push_back(source);
+
+		// The reference pose of an additive layer is the clip's first pose, which
+		// is the same for every instance playing the clip and so is shared.
+		if( Layers[i].Additive )
+		{
+			source.TimePos = Model->SkinnedData.GetClipStartTime(clip.ClipIndex);
+			source.KeyframeCursor = 0;
+			sources.push_back(source);
+		}
+	}
+}
+
+void SkinnedModelInstance::BlendPose(const BoneTransform* const* sourcePoses, BoneTransform* localTransforms)const
+{
+	UINT numBones = Model->SkinnedData.BoneCount();
+	UINT next = 0;
+
+	const BoneTransform* current = sourcePoses[next++];
+
+	if( IsFading() )
+	{
+		const BoneTransform* previous = sourcePoses[next++];
+		PoseBlend::Lerp(previous, current, FadeTime / FadeDuration, 0, numBones, localTransforms);
+	}
+	else
+	{
+		std::copy(current, current + numBones, localTransforms);
+	}
+
+	for(UINT i = 0; i < Layers.size(); ++i)
+	{
+		const AnimationLayer& layer = Layers[i];
+		const float* boneMask = layer.BoneMask.empty() ? 0 : &layer.BoneMask[0];
+
+		const BoneTransform* layerPose = sourcePoses[next++];
+
+		if( layer.Additive )
+		{
+			const BoneTransform* referencePose = sourcePoses[next++];
+			PoseBlend::Add(localTransforms, layerPose, referencePose, layer.Weight, 
+				boneMask, numBones, localTransforms);
+		}
+		else
+		{
+			PoseBlend::Lerp(localTransforms, layerPose, layer.Weight, 
+				boneMask, numBones, localTransforms);
+		}
+	}
+}
+
+void SkinnedModelInstance::Update(float dt)
+{
+	Update(dt, &FinalTransforms[0]);
+}
+
+void SkinnedModelInstance::Update(float dt, XMFLOAT4X4* finalTransforms)
+{
+	const SkinnedData& skinnedData = Model->SkinnedData;
+	UINT numBones = skinnedData.BoneCount();
+
+	Advance(dt);
+
+	Pose.Sources.clear();
+	GetPoseSources(Pose.Sources);
+
+	UINT numSources = Pose.Sources.size();
+
+	// Sized on first use and when layers are added, so usually this does not
+	// allocate.
+	Pose.SourceTransforms.resize(numSources*numBones);
+	Pose.SourcePoses.resize(numSources);
+	Pose.LocalTransforms.resize(numBones);
+	Pose.ToRootTransforms.resize(numBones);
+
+	for(UINT i = 0; i < numSources; ++i)
+	{
+		const PoseSource& source = Pose.Sources[i];
+
+		UINT unusedCursor = 0;
+		UINT& cursor = source.KeyframeCursor ? *source.KeyframeCursor : unusedCursor;
+
+		BoneTransform* sourcePose = &Pose.SourceTransforms[i*numBones];
+		skinnedData.SampleClip(source.ClipIndex, source.TimePos, cursor, sourcePose);
+		Pose.SourcePoses[i] = sourcePose;
+	}
+
+	BlendPose(&Pose.SourcePoses[0], &Pose.LocalTransforms[0]);
+	skinnedData.ToFinalTransforms(&Pose.LocalTransforms[0], &Pose.ToRootTransforms[0], finalTransforms,
+		Lod.MaxBoneDepth);
 }
\ No newline at end of file
@@ -5,11 +5,15 @@
 #include "MeshGeometry.h"
 #include "TextureMgr.h"
 #include "Vertex.h"
+#include "BoneBounds.h"
 
 class SkinnedModel
 {
 public:
-	SkinnedModel(ID3D11Device* device, TextureMgr& texMgr, const std::string& modelFilename, const std::wstring& texturePath);
+	// With a positive maxCompressionError the clips are kept compressed; see
+	// SkinnedData::Set.
+	SkinnedModel(ID3D11Device* device, TextureMgr& texMgr, const std::string& modelFilename, const std::wstring& texturePath,
+		float maxCompressionError = 0.0f);
 	~SkinnedModel();
 
 	UINT SubsetCount;
@@ -25,17 +29,115 @@ public:
 
 	MeshGeometry ModelMesh;
 	SkinnedData SkinnedData;
+
+	// Per-bone boxes of the mesh, to bound any pose of it.
+	BoneBounds BoneBounds;
+};
+
+///<summary>
+/// Playback position in one clip.
+///</summary>
+struct ClipPlayback
+{
+	ClipPlayback();
+
+	UINT ClipIndex;
+	float TimePos;
+
+	// Looping clips wrap around at the end; others hold their last pose.
+	bool Loop;
+
+	// Key search position, see PackedClip::Sample.
+	UINT KeyframeCursor;
+
+	void Advance(float dt, const SkinnedData& skinnedData);
+};
+
+///<summary>
+/// A clip blended on top of an instance's base clip.  An override layer blends
+/// toward the clip's pose, and an additive layer adds the difference between the
+/// clip's pose and its first pose, so e.g. a breathing or aiming clip authored on
+/// any stance can be layered over locomotion.
+///</summary>
+struct AnimationLayer
+{
+	AnimationLayer();
+
+	ClipPlayback Clip;
+	float Weight;
+	bool Additive;
+
+	// Per bone multiplier of Weight, e.g. 1 for the upper body and 0 for the 
+	// legs.  Empty means 1 for every bone.
+	std::vector<float> BoneMask;
+};
+
+///<summary>
+/// How much work AnimationSystem spends on an instance, chosen e.g. from its 
+/// distance to the camera or its size on screen.
+///</summary>
+struct AnimationLod
+{
+	AnimationLod();
+
+	// Bones deeper than this in the hierarchy (the root has depth 0) are not 
+	// evaluated, and move rigidly with their parent instead; e.g. fingers and 
+	// face bones can be dropped on distant characters.
+	UINT MaxBoneDepth;
+
+	// Seconds between evaluations of the pose from the clips.  In between, the 
+	// last two evaluated poses are interpolated, so the instance is shown up to 
+	// this far behind its clips.  0 evaluates the pose every update.
+	float UpdateInterval;
 };
 
 struct SkinnedModelInstance
 {
+	SkinnedModelInstance();
+
 	SkinnedModel* Model;
-	float TimePos;
-	std::string ClipName;
 	XMFLOAT4X4 World;
 	std::vector<XMFLOAT4X4> FinalTransforms;
 
+	// The clip being played and, while a cross-fade is in progress (FadeTime < 
+	// FadeDuration), the clip being faded out.
+	ClipPlayback Current;
+	ClipPlayback Previous;
+	float FadeTime;
+	float FadeDuration;
+
+	// Applied over the base pose in order.
+	std::vector<AnimationLayer> Layers;
+
+	// Scratch memory for evaluating FinalTransforms.
+	PoseBuffer Pose;
+
+	// Level of detail, and whether the instance can be seen (e.g. by the camera
+	// or a shadow map); AnimationSystem only updates a few instances that cannot
+	// be seen each frame, in turn.
+	AnimationLod Lod;
+	bool Visible;
+
+	// Starts playing a clip from its beginning, either at once or by fading 
+	// from the current pose over duration seconds.
+	void Play(UINT clipIndex);
+	void CrossFade(UINT clipIndex, float duration);
+
 	void Update(float dt);
+
+	// Same as above, but writes the final transforms to finalTransforms, which
+	// must have room for Model->SkinnedData.BoneCount() matrices, instead of to
+	// FinalTransforms.
+	void Update(float dt, XMFLOAT4X4* finalTransforms);
+
+	// The steps of Update, for AnimationSystem.  Advance moves every clip forward
+	// by dt.  GetPoseSources appends the clip poses the instance blends, and
+	// BlendPose blends them, given in the same order, into local transforms.
+	void Advance(float dt);
+	void GetPoseSources(std::vector<PoseSource>& sources);
+	void BlendPose(const BoneTransform* const* sourcePoses, BoneTransform* localTransforms)const;
+
+	bool IsFading()const;
 };
 
 #endif // SKINNEDMODEL_H
\ No newline at end of file
@@ -0,0 +1,29 @@
+//***************************************************************************************
+// FilePath.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// The demos name files with wide strings.  Microsoft's file streams open those
+// directly; other standard libraries only take narrow names, so NativePath
+// narrows them there (fine for the ASCII paths the headless tools use).
+//
+// Only depends on the standard library so it can be used by headless tools.
+//***************************************************************************************
+
+#ifndef FILEPATH_H
+#define FILEPATH_H
+
+#include <string>
+
+// Name to pass to a std::ifstream or std::ofstream constructor.
+#ifdef _WIN32
+inline const wchar_t* NativePath(const std::wstring& filename)
+{
+	return filename.c_str();
+}
+#else
+inline std::string NativePath(const std::wstring& filename)
+{
+	return std::string(filename.begin(), filename.end());
+}
+#endif
+
+#endif // FILEPATH_H
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// KeyframeSearch.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Finds the two keyframes that bound an animation time, starting from a cursor
+// left by the previous search.  Playing forward, the time is usually still between
+// the same two keyframes or has moved on by one or two, so the search steps
+// forward from the cursor a few times before falling back to a binary search.
+// Any cursor value is valid.
+//
+// Only depends on the standard library so it can be used by headless tools.
+//***************************************************************************************
+
+#ifndef KEYFRAMESEARCH_H
+#define KEYFRAMESEARCH_H
+
+#include <algorithm>
+
+class KeyframeSearch
+{
+public:
+	// Number of keyframes a cursor is stepped forward before falling back to a
+	// binary search.
+	static const unsigned MaxCursorSteps = 4;
+
+	// Returns the index i of the keyframes i and i+1 with
+	// timeOf(keys[i]) <= t < timeOf(keys[i+1]).  The count keys (at least two)
+	// must be sorted by time, and t must lie strictly between the first and last
+	// keyframe times.  Keyframes with equal times are skipped, so the interval
+	// found is never empty.
+	template<typename Key, typename TimeOf>
+	static unsigned Find(const Key* keys, unsigned count, float t, unsigned cursor, TimeOf timeOf)
+	{
+		unsigned last = count-2;
+		unsigned i = std::min(cursor, last);
+
+		if( timeOf(keys[i]) <= t )
+		{
+			unsigned end = std::min(i + MaxCursorSteps, last);
+			for(; i <= end; ++i)
+			{
+				if( t < timeOf(keys[i+1]) )
+					return i;
+			}
+		}
+
+		// Otherwise we seeked (or looped back), so binary search for the first
+		// keyframe after t.  Since t is past the first keyframe time, the keyframe
+		// before it exists.
+		const Key* next = std::upper_bound(keys, keys + count, t,
+			[&](float time, const Key& key) { return time < timeOf(key); });
+
+		return (unsigned)(next - keys) - 1;
+	}
+
+	// Same, for a plain array of keyframe times.
+	static unsigned Find(const float* times, unsigned count, float t, unsigned cursor)
+	{
+		return Find(times, count, t, cursor, [](float time) { return time; });
+	}
+};
+
+#endif // KEYFRAMESEARCH_H
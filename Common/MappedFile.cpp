@@ -0,0 +1,161 @@
+//***************************************************************************************
+// MappedFile.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "MappedFile.h"
+#include "FilePath.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	: mFile(INVALID_HANDLE_VALUE),
+	mMapping(0),
+	mView(0),
+	mSize(0)
+{
+}
+
+#else
+
+MappedFile::MappedFile()
+	: mFile(-1),
+	mView(0),
+	mSize(0)
+{
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if(mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx(mFile, &size) || size.QuadPart == 0 )
+	{
+		Close();
+		return false;
+	}
+	mSize = (unsigned long long)size.QuadPart;
+
+	mMapping = CreateFileMappingW(mFile, 0, PAGE_READONLY, 0, 0, 0);
+	if(mMapping == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mView = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if(mView == 0)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mView)
+	{
+		UnmapViewOfFile(mView);
+		mView = 0;
+	}
+
+	if(mMapping)
+	{
+		CloseHandle(mMapping);
+		mMapping = 0;
+	}
+
+	if(mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+
+	mSize = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::wstring& filename)
+{
+	Close();
+
+	mFile = open(NativePath(filename).c_str(), O_RDONLY);
+	if(mFile < 0)
+		return false;
+
+	struct stat info;
+	if( fstat(mFile, &info) != 0 || info.st_size == 0 )
+	{
+		Close();
+		return false;
+	}
+	mSize = (unsigned long long)info.st_size;
+
+	void* view = mmap(0, (size_t)mSize, PROT_READ, MAP_SHARED, mFile, 0);
+	if(view == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	mView = (const unsigned char*)view;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mView)
+	{
+		munmap((void*)mView, (size_t)mSize);
+		mView = 0;
+	}
+
+	if(mFile >= 0)
+	{
+		close(mFile);
+		mFile = -1;
+	}
+
+	mSize = 0;
+}
+
+#endif
+
+bool MappedFile::IsOpen()const
+{
+	return mView != 0;
+}
+
+const unsigned char* MappedFile::GetData()const
+{
+	return mView;
+}
+
+unsigned long long MappedFile::GetSize()const
+{
+	return mSize;
+}
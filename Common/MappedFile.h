@@ -0,0 +1,51 @@
+//***************************************************************************************
+// MappedFile.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Read-only memory mapping of a whole file.  The OS pages the file in on demand,
+// so large caches can be read without first copying them into a heap buffer.
+//
+// Uses a Win32 file mapping on Windows and mmap elsewhere, so headless tools can
+// use it too.
+//***************************************************************************************
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Maps the file; returns false if it does not exist, is empty, or cannot be mapped.
+	bool Open(const std::wstring& filename);
+	void Close();
+
+	bool IsOpen()const;
+
+	// Start of the mapped view and its size in bytes.  The view stays valid until
+	// Close is called or the MappedFile is destroyed.
+	const unsigned char* GetData()const;
+	unsigned long long GetSize()const;
+
+private:
+	MappedFile(const MappedFile& rhs);
+	MappedFile& operator=(const MappedFile& rhs);
+
+private:
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	int mFile;
+#endif
+	const unsigned char* mView;
+	unsigned long long mSize;
+};
+
+#endif // MAPPEDFILE_H
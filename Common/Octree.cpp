@@ -0,0 +1,873 @@
+//***************************************************************************************
+// Octree.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "Octree.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// 1/dir for the slab test, clamped to +-FLT_MAX.  A zero direction component
+	// would otherwise give an infinite reciprocal, and an origin exactly on that
+	// slab's plane would then give 0*inf = NaN in IntersectRayBox.  Clamped, the
+	// plane distance is 0 and the origin counts as inside the slab.
+	XMVECTOR ReciprocalDir(FXMVECTOR dir)
+	{
+		XMVECTOR invDir = XMVectorReciprocal(dir);
+		invDir = XMVectorMin(invDir, XMVectorReplicate(+FLT_MAX));
+		return XMVectorMax(invDir, XMVectorReplicate(-FLT_MAX));
+	}
+}
+
+Octree::Octree()
+	: mRoot(0)
+{
+#ifdef OCTREE_QUERY_STATS
+	mStats = 0;
+#endif
+}
+
+Octree::~Octree()
+{
+	delete mRoot;
+}
+
+void Octree::Build(const std::vector<XMFLOAT3>& vertices, const std::vector<unsigned>& indices)
+{
+	// Cache a copy of the vertices and indices.
+	mVertices = vertices;
+	mIndices  = indices;
+
+	// Build AABB to contain the scene mesh.
+	OctreeBox sceneBounds = BuildAABB();
+	
+	// Allocate the root node and set its AABB to contain the scene mesh.
+	delete mRoot;
+	mRoot = new OctreeNode();
+	mRoot->Bounds = sceneBounds;
+
+	// The root node contains every triangle.
+	std::vector<unsigned> triangles(mIndices.size() / 3);
+	for(unsigned i = 0; i < triangles.size(); ++i)
+		triangles[i] = i;
+
+	BuildOctree(mRoot, triangles, 0);
+}
+
+unsigned Octree::GetNodeCount()const
+{
+	unsigned nodeCount = 0;
+	size_t bytes = 0;
+	if( mRoot )
+		AccumulateMemoryUsage(mRoot, nodeCount, bytes);
+
+	return nodeCount;
+}
+
+size_t Octree::GetMemoryUsage()const
+{
+	unsigned nodeCount = 0;
+	size_t bytes = sizeof(Octree) + 
+		mVertices.capacity()*sizeof(XMFLOAT3) + 
+		mIndices.capacity()*sizeof(unsigned);
+
+	if( mRoot )
+		AccumulateMemoryUsage(mRoot, nodeCount, bytes);
+
+	return bytes;
+}
+
+#ifdef OCTREE_QUERY_STATS
+void Octree::SetQueryStats(OctreeQueryStats* stats)
+{
+	mStats = stats;
+}
+#endif
+
+void Octree::Pack(std::vector<OctreePackedNode>& nodes, std::vector<unsigned>& triangles)const
+{
+	nodes.clear();
+	triangles.clear();
+
+	if( mRoot == 0 )
+		return;
+
+	// Breadth first traversal; order[i] is the node stored at nodes[i].
+	std::vector<const OctreeNode*> order;
+	order.push_back(mRoot);
+
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		const OctreeNode* node = order[i];
+
+		OctreePackedNode packed;
+		packed.Center        = node->Bounds.Center;
+		packed.Extents       = node->Bounds.Extents;
+		packed.FirstChild    = 0;
+		packed.FirstTriangle = 0;
+		packed.TriangleCount = 0;
+
+		if( node->IsLeaf )
+		{
+			packed.FirstTriangle = (unsigned)triangles.size();
+			packed.TriangleCount = (unsigned)node->Triangles.size();
+			triangles.insert(triangles.end(), node->Triangles.begin(), node->Triangles.end());
+		}
+		else
+		{
+			packed.FirstChild = (unsigned)order.size();
+			for(int c = 0; c < 8; ++c)
+				order.push_back(node->Children[c]);
+		}
+
+		nodes.push_back(packed);
+	}
+}
+
+bool Octree::Unpack(const std::vector<XMFLOAT3>& vertices, const std::vector<unsigned>& indices,
+					const OctreePackedNode* nodes, unsigned nodeCount, const unsigned* triangles, unsigned triangleCount)
+{
+	delete mRoot;
+	mRoot = 0;
+	mVertices.clear();
+	mIndices.clear();
+
+	if( nodeCount == 0 )
+		return false;
+
+	mVertices = vertices;
+	mIndices  = indices;
+
+	bool valid = true;
+	mRoot = UnpackNode(0, nodes, nodeCount, triangles, triangleCount, valid);
+
+	if( !valid )
+	{
+		delete mRoot;
+		mRoot = 0;
+		mVertices.clear();
+		mIndices.clear();
+	}
+
+	return valid;
+}
+
+bool Octree::RayOctreeIntersect(FXMVECTOR rayPos, FXMVECTOR rayDir, float tMax)const
+{
+	if( mRoot == 0 )
+		return false;
+
+	Ray ray;
+	ray.Pos    = rayPos;
+	ray.Dir    = rayDir;
+	ray.InvDir = ReciprocalDir(rayDir);
+
+	float tEnter;
+	if( !IntersectRayBox(ray, mRoot->Bounds, tMax, tEnter) )
+		return false;
+
+	return RayOctreeIntersect(mRoot, ray, tMax);
+}
+
+bool Octree::RayOctreeClosestHit(FXMVECTOR rayPos, FXMVECTOR rayDir, OctreeHit& hit, float tMax)const
+{
+	hit.T = tMax;
+	hit.TriangleId = unsigned(-1);
+	hit.U = 0.0f;
+	hit.V = 0.0f;
+
+	if( mRoot == 0 )
+		return false;
+
+	Ray ray;
+	ray.Pos    = rayPos;
+	ray.Dir    = rayDir;
+	ray.InvDir = ReciprocalDir(rayDir);
+
+	float tEnter;
+	if( !IntersectRayBox(ray, mRoot->Bounds, tMax, tEnter) )
+		return false;
+
+	RayOctreeClosestHit(mRoot, ray, hit);
+
+	return hit.TriangleId != unsigned(-1);
+}
+
+unsigned Octree::RayOctreeClosestHits(const XMFLOAT3* rayPos, const XMFLOAT3* rayDir, 
+									  const float* tMax, unsigned count, OctreeHit* hits)const
+{
+	std::vector<Ray> rays(count);
+	std::vector<unsigned> active;
+	active.reserve(count);
+
+	for(unsigned i = 0; i < count; ++i)
+	{
+		hits[i].T = tMax[i];
+		hits[i].TriangleId = unsigned(-1);
+		hits[i].U = 0.0f;
+		hits[i].V = 0.0f;
+
+		if( mRoot == 0 )
+			continue;
+
+		rays[i].Pos    = XMLoadFloat3(&rayPos[i]);
+		rays[i].Dir    = XMLoadFloat3(&rayDir[i]);
+		rays[i].InvDir = ReciprocalDir(rays[i].Dir);
+
+		float tEnter;
+		if( IntersectRayBox(rays[i], mRoot->Bounds, tMax[i], tEnter) )
+			active.push_back(i);
+	}
+
+	if( !active.empty() )
+	{
+		// One list of surviving rays per tree level, reused across siblings.
+		std::deque<std::vector<unsigned> > childActive;
+		RayOctreeClosestHits(mRoot, &rays[0], &active[0], (unsigned)active.size(), 0, childActive, hits);
+	}
+
+	unsigned numHits = 0;
+	for(unsigned i = 0; i < count; ++i)
+	{
+		if( hits[i].TriangleId != unsigned(-1) )
+			++numHits;
+	}
+
+	return numHits;
+}
+
+bool Octree::GetBounds(OctreeBox& box)const
+{
+	if( mRoot == 0 )
+		return false;
+
+	box = mRoot->Bounds;
+	return true;
+}
+
+void Octree::GetTriangle(unsigned triangleId, XMFLOAT3& v0, XMFLOAT3& v1, XMFLOAT3& v2)const
+{
+	v0 = mVertices[mIndices[triangleId*3+0]];
+	v1 = mVertices[mIndices[triangleId*3+1]];
+	v2 = mVertices[mIndices[triangleId*3+2]];
+}
+
+bool Octree::FrustumOctreeIntersect(const XMVECTOR planes[6])const
+{
+	if( mRoot == 0 )
+		return false;
+
+	return FrustumOctreeIntersect(mRoot, planes);
+}
+
+void Octree::FrustumOctreeQuery(const XMVECTOR planes[6], std::vector<unsigned>& triangles)const
+{
+	if( mRoot == 0 )
+		return;
+
+	size_t first = triangles.size();
+	FrustumOctreeQuery(mRoot, planes, triangles);
+
+	// A triangle that straddles several leaves is stored in each of them.
+	std::sort(triangles.begin() + first, triangles.end());
+	triangles.erase(std::unique(triangles.begin() + first, triangles.end()), triangles.end());
+}
+
+int Octree::IntersectBoxPlanes(const OctreeBox& box, const XMVECTOR planes[6])
+{
+	// Set w of the center to one so we can dot4 with a plane.
+	XMVECTOR C = XMVectorSetW(XMLoadFloat3(&box.Center), 1.0f);
+	XMVECTOR E = XMLoadFloat3(&box.Extents);
+
+	bool allInside = true;
+	for(int i = 0; i < 6; ++i)
+	{
+		// Signed distance of the center, and half the length of the box projected 
+		// onto the plane normal.
+		float dist   = XMVectorGetX(XMVector4Dot(C, planes[i]));
+		float radius = XMVectorGetX(XMVector3Dot(E, XMVectorAbs(planes[i])));
+
+		if( dist > radius )
+			return 0;
+
+		if( dist >= -radius )
+			allInside = false;
+	}
+
+	return allInside ? 2 : 1;
+}
+
+OctreeBox Octree::BuildAABB()
+{
+	XMVECTOR vmin = XMVectorReplicate(+FLT_MAX);
+	XMVECTOR vmax = XMVectorReplicate(-FLT_MAX);
+	for(size_t i = 0; i < mVertices.size(); ++i)
+	{
+		XMVECTOR P = XMLoadFloat3(&mVertices[i]);
+
+		vmin = XMVectorMin(vmin, P);
+		vmax = XMVectorMax(vmax, P);
+	}
+
+	OctreeBox bounds;
+	XMVECTOR C = 0.5f*(vmin + vmax);
+	XMVECTOR E = 0.5f*(vmax - vmin); 
+
+	XMStoreFloat3(&bounds.Center, C); 
+	XMStoreFloat3(&bounds.Extents, E); 
+
+	return bounds;
+}
+
+void Octree::BuildOctree(OctreeNode* parent, const std::vector<unsigned>& triangles, unsigned depth)
+{
+	size_t triCount = triangles.size();
+
+	if(triCount < 60 || depth >= MaxDepth) 
+	{
+		parent->IsLeaf = true;
+		parent->Triangles = triangles;
+	}
+	else
+	{
+		parent->IsLeaf = false;
+
+		OctreeBox subbox[8];
+		parent->Subdivide(subbox);
+
+		for(int i = 0; i < 8; ++i)
+		{
+			// Allocate a new subnode.
+			parent->Children[i] = new OctreeNode();
+			parent->Children[i]->Bounds = subbox[i];
+
+			// Find triangles that intersect this node's bounding box.
+			std::vector<unsigned> intersectedTriangles;
+			for(size_t j = 0; j < triCount; ++j)
+			{
+				unsigned tri = triangles[j];
+
+				unsigned i0 = mIndices[tri*3+0];
+				unsigned i1 = mIndices[tri*3+1];
+				unsigned i2 = mIndices[tri*3+2];
+
+				XMVECTOR v0 = XMLoadFloat3(&mVertices[i0]);
+				XMVECTOR v1 = XMLoadFloat3(&mVertices[i1]);
+				XMVECTOR v2 = XMLoadFloat3(&mVertices[i2]);
+
+				if(IntersectTriangleBox(v0, v1, v2, subbox[i]))
+				{
+					intersectedTriangles.push_back(tri);
+				}
+			}
+
+			// Recurse.
+			BuildOctree(parent->Children[i], intersectedTriangles, depth+1);
+		}
+	}
+}
+
+void Octree::AccumulateMemoryUsage(const OctreeNode* node, unsigned& nodeCount, size_t& bytes)const
+{
+	nodeCount++;
+	bytes += sizeof(OctreeNode) + node->Triangles.capacity()*sizeof(unsigned);
+
+	if( !node->IsLeaf )
+	{
+		for(int i = 0; i < 8; ++i)
+			AccumulateMemoryUsage(node->Children[i], nodeCount, bytes);
+	}
+}
+
+OctreeNode* Octree::UnpackNode(unsigned index, const OctreePackedNode* nodes, unsigned nodeCount, 
+							   const unsigned* triangles, unsigned triangleCount, bool& valid)
+{
+	const OctreePackedNode& packed = nodes[index];
+
+	OctreeNode* node = new OctreeNode();
+	node->Bounds.Center  = packed.Center;
+	node->Bounds.Extents = packed.Extents;
+
+	if( packed.FirstChild == 0 )
+	{
+		node->IsLeaf = true;
+
+		if( packed.FirstTriangle > triangleCount || packed.TriangleCount > triangleCount - packed.FirstTriangle )
+		{
+			valid = false;
+			return node;
+		}
+
+		unsigned triCount = (unsigned)(mIndices.size() / 3);
+		node->Triangles.assign(triangles + packed.FirstTriangle, triangles + packed.FirstTriangle + packed.TriangleCount);
+		for(size_t i = 0; i < node->Triangles.size(); ++i)
+		{
+			if( node->Triangles[i] >= triCount )
+			{
+				valid = false;
+				return node;
+			}
+		}
+	}
+	else
+	{
+		node->IsLeaf = false;
+
+		// Children always come after their parent in breadth first order; checking
+		// that also guarantees the recursion terminates on a corrupt file.
+		if( nodeCount < 8 || packed.FirstChild <= index || packed.FirstChild > nodeCount - 8 )
+		{
+			valid = false;
+			return node;
+		}
+
+		for(unsigned c = 0; c < 8 && valid; ++c)
+			node->Children[c] = UnpackNode(packed.FirstChild + c, nodes, nodeCount, triangles, triangleCount, valid);
+	}
+
+	return node;
+}
+
+bool Octree::RayOctreeIntersect(const OctreeNode* parent, const Ray& ray, float tMax)const
+{
+#ifdef OCTREE_QUERY_STATS
+	if( mStats )
+		mStats->NodesVisited++;
+#endif
+
+	// Recurs until we find a leaf node (all the triangles are in the leaves).
+	if( !parent->IsLeaf )
+	{
+		// Visit the children the ray passes through nearest first, so that hits
+		// close to the ray origin are found before we descend into far subtrees.
+		unsigned order[8];
+		float tEnter[8];
+		unsigned count = SortChildrenFrontToBack(parent, ray, tMax, order, tEnter);
+
+		for(unsigned i = 0; i < count; ++i)
+		{
+			// If we hit a triangle down this branch, we can bail out that we hit a triangle.
+			if( RayOctreeIntersect(parent->Children[order[i]], ray, tMax) )
+				return true;
+		}
+
+		// If we get here. then we did not hit any triangles.
+		return false;
+	}
+	else
+	{
+		for(size_t i = 0; i < parent->Triangles.size(); ++i)
+		{
+			unsigned tri = parent->Triangles[i];
+
+#ifdef OCTREE_QUERY_STATS
+			if( mStats )
+				mStats->TrianglesTested++;
+#endif
+
+			XMVECTOR v0 = XMLoadFloat3(&mVertices[mIndices[tri*3+0]]);
+			XMVECTOR v1 = XMLoadFloat3(&mVertices[mIndices[tri*3+1]]);
+			XMVECTOR v2 = XMLoadFloat3(&mVertices[mIndices[tri*3+2]]);
+
+			float t, u, v;
+			if( IntersectRayTriangle(ray, v0, v1, v2, t, u, v) && t <= tMax )
+				return true;
+		}
+
+		return false;
+	}
+}
+
+void Octree::RayOctreeClosestHit(const OctreeNode* parent, const Ray& ray, OctreeHit& hit)const
+{
+#ifdef OCTREE_QUERY_STATS
+	if( mStats )
+		mStats->NodesVisited++;
+#endif
+
+	if( !parent->IsLeaf )
+	{
+		unsigned order[8];
+		float tEnter[8];
+		unsigned count = SortChildrenFrontToBack(parent, ray, hit.T, order, tEnter);
+
+		for(unsigned i = 0; i < count; ++i)
+		{
+			// Children are sorted by entry distance, so once a child starts beyond the 
+			// nearest hit found so far, none of the remaining children can contain a 
+			// nearer hit.
+			if( tEnter[i] > hit.T )
+				break;
+
+			RayOctreeClosestHit(parent->Children[order[i]], ray, hit);
+		}
+	}
+	else
+	{
+		for(size_t i = 0; i < parent->Triangles.size(); ++i)
+		{
+			unsigned tri = parent->Triangles[i];
+
+#ifdef OCTREE_QUERY_STATS
+			if( mStats )
+				mStats->TrianglesTested++;
+#endif
+
+			XMVECTOR v0 = XMLoadFloat3(&mVertices[mIndices[tri*3+0]]);
+			XMVECTOR v1 = XMLoadFloat3(&mVertices[mIndices[tri*3+1]]);
+			XMVECTOR v2 = XMLoadFloat3(&mVertices[mIndices[tri*3+2]]);
+
+			float t, u, v;
+			if( IntersectRayTriangle(ray, v0, v1, v2, t, u, v) && t <= hit.T )
+			{
+				// This is the new nearest hit.
+				hit.T = t;
+				hit.TriangleId = tri;
+				hit.U = u;
+				hit.V = v;
+			}
+		}
+	}
+}
+
+bool Octree::FrustumOctreeIntersect(const OctreeNode* parent, const XMVECTOR planes[6])const
+{
+#ifdef OCTREE_QUERY_STATS
+	if( mStats )
+		mStats->NodesVisited++;
+#endif
+
+	int result = IntersectBoxPlanes(parent->Bounds, planes);
+
+	if( result == 0 )
+		return false;
+
+	// Every triangle stored in a leaf overlaps the leaf's box, so a nonempty leaf
+	// inside the volume must be touched.
+	if( result == 2 && parent->IsLeaf && !parent->Triangles.empty() )
+		return true;
+
+	if( !parent->IsLeaf )
+	{
+		for(int i = 0; i < 8; ++i)
+		{
+			if( FrustumOctreeIntersect(parent->Children[i], planes) )
+				return true;
+		}
+
+		return false;
+	}
+	else
+	{
+		for(size_t i = 0; i < parent->Triangles.size(); ++i)
+		{
+			if( IntersectTriangleVolume(parent->Triangles[i], planes) != 0 )
+				return true;
+		}
+
+		return false;
+	}
+}
+
+void Octree::FrustumOctreeQuery(const OctreeNode* parent, const XMVECTOR planes[6], std::vector<unsigned>& triangles)const
+{
+#ifdef OCTREE_QUERY_STATS
+	if( mStats )
+		mStats->NodesVisited++;
+#endif
+
+	int result = IntersectBoxPlanes(parent->Bounds, planes);
+
+	if( result == 0 )
+		return;
+
+	// Everything below this node is inside the volume.
+	if( result == 2 )
+	{
+		AppendAllTriangles(parent, triangles);
+		return;
+	}
+
+	if( !parent->IsLeaf )
+	{
+		for(int i = 0; i < 8; ++i)
+			FrustumOctreeQuery(parent->Children[i], planes, triangles);
+	}
+	else
+	{
+		for(size_t i = 0; i < parent->Triangles.size(); ++i)
+		{
+			unsigned tri = parent->Triangles[i];
+			if( IntersectTriangleVolume(tri, planes) != 0 )
+				triangles.push_back(tri);
+		}
+	}
+}
+
+void Octree::AppendAllTriangles(const OctreeNode* parent, std::vector<unsigned>& triangles)const
+{
+	if( !parent->IsLeaf )
+	{
+		for(int i = 0; i < 8; ++i)
+			AppendAllTriangles(parent->Children[i], triangles);
+	}
+	else
+	{
+		triangles.insert(triangles.end(), parent->Triangles.begin(), parent->Triangles.end());
+	}
+}
+
+int Octree::IntersectTriangleVolume(unsigned tri, const XMVECTOR planes[6])const
+{
+#ifdef OCTREE_QUERY_STATS
+	if( mStats )
+		mStats->TrianglesTested++;
+#endif
+
+	// Set w of the points to one so we can dot4 with a plane.
+	XMVECTOR v[3];
+	for(int k = 0; k < 3; ++k)
+		v[k] = XMVectorSetW(XMLoadFloat3(&mVertices[mIndices[tri*3+k]]), 1.0f);
+
+	// Outside if all three vertices are in front of one plane; inside if all of
+	// them are behind every plane.  Otherwise the triangle may intersect.
+	bool allInside = true;
+	for(int i = 0; i < 6; ++i)
+	{
+		float d0 = XMVectorGetX(XMVector4Dot(v[0], planes[i]));
+		float d1 = XMVectorGetX(XMVector4Dot(v[1], planes[i]));
+		float d2 = XMVectorGetX(XMVector4Dot(v[2], planes[i]));
+
+		if( std::min(d0, std::min(d1, d2)) > 0.0f )
+			return 0;
+
+		if( std::max(d0, std::max(d1, d2)) >= 0.0f )
+			allInside = false;
+	}
+
+	return allInside ? 2 : 1;
+}
+
+void Octree::RayOctreeClosestHits(const OctreeNode* parent, const Ray* rays, const unsigned* active, unsigned activeCount,
+								   unsigned depth, std::deque<std::vector<unsigned> >& childActive, OctreeHit* hits)const
+{
+#ifdef OCTREE_QUERY_STATS
+	if( mStats )
+		mStats->NodesVisited++;
+#endif
+
+	if( !parent->IsLeaf )
+	{
+		// Visit the children front to back along the first ray.  For a coherent
+		// batch that order suits every ray, so near hits found first cull the
+		// far children for most of the batch.
+		const Ray& lead = rays[active[0]];
+
+		unsigned order[8];
+		float key[8];
+		for(unsigned i = 0; i < 8; ++i)
+		{
+			XMVECTOR C = XMLoadFloat3(&parent->Children[i]->Bounds.Center);
+			float d = XMVectorGetX(XMVector3Dot(C - lead.Pos, lead.Dir));
+
+			unsigned j = i;
+			for(; j > 0 && key[j-1] > d; --j)
+			{
+				key[j]   = key[j-1];
+				order[j] = order[j-1];
+			}
+
+			key[j]   = d;
+			order[j] = i;
+		}
+
+		// A deque never moves its elements when it grows, so this list stays put
+		// while deeper levels add theirs.  The recursion only touches the lists 
+		// of deeper levels.
+		if( childActive.size() <= depth )
+			childActive.resize(depth+1);
+
+		std::vector<unsigned>& childRays = childActive[depth];
+
+		for(unsigned i = 0; i < 8; ++i)
+		{
+			const OctreeNode* child = parent->Children[order[i]];
+
+			// Keep the rays that enter the child before their nearest hit so far.  
+			// The list is rebuilt for each child since earlier siblings may have 
+			// shortened some rays.
+			childRays.clear();
+			for(unsigned k = 0; k < activeCount; ++k)
+			{
+				unsigned r = active[k];
+
+				float tEnter;
+				if( IntersectRayBox(rays[r], child->Bounds, hits[r].T, tEnter) )
+					childRays.push_back(r);
+			}
+
+			if( !childRays.empty() )
+				RayOctreeClosestHits(child, rays, &childRays[0], (unsigned)childRays.size(), depth+1, childActive, hits);
+		}
+	}
+	else
+	{
+		for(size_t i = 0; i < parent->Triangles.size(); ++i)
+		{
+			unsigned tri = parent->Triangles[i];
+
+			XMVECTOR v0 = XMLoadFloat3(&mVertices[mIndices[tri*3+0]]);
+			XMVECTOR v1 = XMLoadFloat3(&mVertices[mIndices[tri*3+1]]);
+			XMVECTOR v2 = XMLoadFloat3(&mVertices[mIndices[tri*3+2]]);
+
+			for(unsigned k = 0; k < activeCount; ++k)
+			{
+				unsigned r = active[k];
+
+#ifdef OCTREE_QUERY_STATS
+				if( mStats )
+					mStats->TrianglesTested++;
+#endif
+
+				float t, u, v;
+				if( IntersectRayTriangle(rays[r], v0, v1, v2, t, u, v) && t <= hits[r].T )
+				{
+					hits[r].T = t;
+					hits[r].TriangleId = tri;
+					hits[r].U = u;
+					hits[r].V = v;
+				}
+			}
+		}
+	}
+}
+
+unsigned Octree::SortChildrenFrontToBack(const OctreeNode* parent, const Ray& ray, float tMax, 
+										 unsigned order[8], float tEnter[8])const
+{
+	// Insertion sort the children the ray hits by the distance at which the ray
+	// enters them.  There are at most eight, so this is cheap.
+	unsigned count = 0;
+	for(unsigned i = 0; i < 8; ++i)
+	{
+		float t;
+		if( !IntersectRayBox(ray, parent->Children[i]->Bounds, tMax, t) )
+			continue;
+
+		unsigned j = count++;
+		for(; j > 0 && tEnter[j-1] > t; --j)
+		{
+			tEnter[j] = tEnter[j-1];
+			order[j]  = order[j-1];
+		}
+
+		tEnter[j] = t;
+		order[j]  = i;
+	}
+
+	return count;
+}
+
+bool Octree::IntersectRayBox(const Ray& ray, const OctreeBox& box, float tMax, float& tEnter)
+{
+	// Slabs method using the precomputed reciprocal ray direction.  We clip the
+	// ray to [0, tMax] so boxes behind the origin or beyond tMax are rejected.
+	XMVECTOR C = XMLoadFloat3(&box.Center);
+	XMVECTOR E = XMLoadFloat3(&box.Extents);
+
+	XMVECTOR tSlab0 = (C - E - ray.Pos)*ray.InvDir;
+	XMVECTOR tSlab1 = (C + E - ray.Pos)*ray.InvDir;
+
+	XMVECTOR tNear = XMVectorMin(tSlab0, tSlab1);
+	XMVECTOR tFar  = XMVectorMax(tSlab0, tSlab1);
+
+	float t0 = std::max(0.0f, std::max(XMVectorGetX(tNear), 
+		std::max(XMVectorGetY(tNear), XMVectorGetZ(tNear))));
+	float t1 = std::min(tMax, std::min(XMVectorGetX(tFar), 
+		std::min(XMVectorGetY(tFar), XMVectorGetZ(tFar))));
+
+	tEnter = t0;
+	return t0 <= t1;
+}
+
+bool Octree::IntersectRayTriangle(const Ray& ray, FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, 
+								  float& t, float& u, float& v)
+{
+	// Moller-Trumbore; unlike a plain ray/triangle test this also returns the
+	// barycentric coordinates and does not require a unit length direction.
+	XMVECTOR e1 = v1 - v0;
+	XMVECTOR e2 = v2 - v0;
+
+	XMVECTOR p = XMVector3Cross(ray.Dir, e2);
+	float det = XMVectorGetX(XMVector3Dot(e1, p));
+
+	// Parallel ray.
+	if( fabsf(det) < 1e-20f )
+		return false;
+
+	float invDet = 1.0f / det;
+
+	XMVECTOR s = ray.Pos - v0;
+	u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+	if( u < 0.0f || u > 1.0f )
+		return false;
+
+	XMVECTOR q = XMVector3Cross(s, e1);
+	v = XMVectorGetX(XMVector3Dot(ray.Dir, q)) * invDet;
+	if( v < 0.0f || u + v > 1.0f )
+		return false;
+
+	t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+
+	return t >= 0.0f;
+}
+
+bool Octree::IntersectTriangleBox(FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, const OctreeBox& box)
+{
+	// Separating axis test: the triangle and the box are disjoint if and only if
+	// their projections are disjoint on one of the three box axes, the triangle
+	// normal, or the nine cross products of a box axis with a triangle edge.
+	// Touching counts as intersecting, so a triangle on a shared face of two
+	// children goes into both.  The box is padded slightly so that rounding
+	// never drops a triangle lying exactly on a face (e.g., a flat floor on a
+	// split plane).
+	XMVECTOR C = XMLoadFloat3(&box.Center);
+	float pad  = 1e-4f*std::max(box.Extents.x, std::max(box.Extents.y, box.Extents.z));
+	XMVECTOR E = XMLoadFloat3(&box.Extents) + XMVectorReplicate(pad);
+
+	// Work relative to the box center.
+	XMVECTOR p[3] = { v0 - C, v1 - C, v2 - C };
+
+	XMVECTOR edges[3] = { p[1] - p[0], p[2] - p[1], p[0] - p[2] };
+
+	XMVECTOR axes[13];
+	axes[0] = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+	axes[1] = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	axes[2] = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	axes[3] = XMVector3Cross(edges[0], edges[1]);
+	for(int i = 0; i < 3; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+			axes[4 + 3*i + j] = XMVector3Cross(axes[i], edges[j]);
+	}
+
+	for(int i = 0; i < 13; ++i)
+	{
+		// A degenerate axis (parallel edges) gives r = 0 and projections of 0,
+		// so it never separates.
+		float d0 = XMVectorGetX(XMVector3Dot(p[0], axes[i]));
+		float d1 = XMVectorGetX(XMVector3Dot(p[1], axes[i]));
+		float d2 = XMVectorGetX(XMVector3Dot(p[2], axes[i]));
+
+		// Projection radius of the box onto the axis.
+		float r = XMVectorGetX(XMVector3Dot(E, XMVectorAbs(axes[i])));
+
+		if( std::min(d0, std::min(d1, d2)) > r || std::max(d0, std::max(d1, d2)) < -r )
+			return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,282 @@
+//***************************************************************************************
+// Octree.h by Frank Luna (C) 2011 All Rights Reserved.
+//   
+// Simple octree for doing ray/triangle and volume/triangle intersection queries.
+// Shared by the picking and ambient occlusion demos and the octree benchmark.
+//
+// Only depends on DirectXMath and the standard library so it can be used by 
+// headless tools.  Define OCTREE_QUERY_STATS to compile in the traversal 
+// counters (see SetQueryStats); without it the queries carry no profiling code.
+//***************************************************************************************
+
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <DirectXMath.h>
+#include <cfloat>
+#include <deque>
+#include <vector>
+
+struct OctreeNode;
+
+///<summary>
+/// Axis-aligned box stored as a center and half extents.
+///</summary>
+struct OctreeBox
+{
+	DirectX::XMFLOAT3 Center;
+	DirectX::XMFLOAT3 Extents;
+};
+
+///<summary>
+/// Result of a closest-hit query.  The hit point is rayPos + T*rayDir, and
+/// (U, V) are the barycentric coordinates of the hit point with respect to the
+/// triangle vertices v1 and v2, so that P = (1-U-V)*v0 + U*v1 + V*v2.
+///</summary>
+struct OctreeHit
+{
+	float T;
+	unsigned TriangleId;
+	float U;
+	float V;
+};
+
+///<summary>
+/// Traversal counters accumulated by queries while attached with 
+/// Octree::SetQueryStats.  Used for profiling; not thread safe.
+///</summary>
+struct OctreeQueryStats
+{
+	unsigned long long NodesVisited;
+	unsigned long long TrianglesTested;
+};
+
+///<summary>
+/// Flattened octree node used to save a built tree (e.g., to a cache file).  The
+/// nodes are stored breadth first, so the eight children of a node are stored
+/// consecutively starting at FirstChild.
+///</summary>
+struct OctreePackedNode
+{
+	DirectX::XMFLOAT3 Center;
+	DirectX::XMFLOAT3 Extents;
+
+	// Index of the first of the eight children, or 0 for a leaf (the root is
+	// node 0, so it can never be a child).
+	unsigned FirstChild;
+
+	// Range of the leaf's triangle ids in the packed triangle list.
+	unsigned FirstTriangle;
+	unsigned TriangleCount;
+};
+
+class Octree
+{
+public:
+	Octree();
+	~Octree();
+
+	void Build(const std::vector<DirectX::XMFLOAT3>& vertices, const std::vector<unsigned>& indices);
+
+	// Number of nodes and approximate heap memory used by the tree, including the
+	// cached vertex and index copies.
+	unsigned GetNodeCount()const;
+	size_t GetMemoryUsage()const;
+
+#ifdef OCTREE_QUERY_STATS
+	// Queries add to stats while it is attached; pass null to detach.
+	void SetQueryStats(OctreeQueryStats* stats);
+#endif
+
+	// Flattens the built tree.
+	void Pack(std::vector<OctreePackedNode>& nodes, std::vector<unsigned>& triangles)const;
+
+	// Rebuilds the tree from packed data instead of calling Build.  The vertices and 
+	// indices must be the ones the packed tree was built from.  Returns false if the
+	// packed data is inconsistent, in which case the octree is left empty.
+	bool Unpack(const std::vector<DirectX::XMFLOAT3>& vertices, const std::vector<unsigned>& indices,
+		const OctreePackedNode* nodes, unsigned nodeCount, const unsigned* triangles, unsigned triangleCount);
+
+	// Any-hit query: returns true if the ray hits a triangle with 0 <= t <= tMax.
+	// The ray direction does not need to be unit length; t is measured in units of 
+	// the rayDir length.
+	bool RayOctreeIntersect(DirectX::FXMVECTOR rayPos, DirectX::FXMVECTOR rayDir, float tMax = FLT_MAX)const;
+
+	// Closest-hit query: returns true and fills out hit with the nearest triangle 
+	// the ray hits with 0 <= t <= tMax.
+	bool RayOctreeClosestHit(DirectX::FXMVECTOR rayPos, DirectX::FXMVECTOR rayDir, OctreeHit& hit, float tMax = FLT_MAX)const;
+
+	// Closest-hit query for count rays at once.  The tree is walked once for the 
+	// whole batch instead of once per ray: each node is visited with the rays that
+	// reach it, and each leaf triangle is loaded once and tested against all of
+	// them.  hits[i] is filled as RayOctreeClosestHit would fill it for ray i and
+	// tMax[i].  Returns the number of rays that hit.
+	unsigned RayOctreeClosestHits(const DirectX::XMFLOAT3* rayPos, const DirectX::XMFLOAT3* rayDir, 
+		const float* tMax, unsigned count, OctreeHit* hits)const;
+
+	// Bounds of the whole tree; returns false if the tree is empty.
+	bool GetBounds(OctreeBox& box)const;
+
+	void GetTriangle(unsigned triangleId, DirectX::XMFLOAT3& v0, DirectX::XMFLOAT3& v1, DirectX::XMFLOAT3& v2)const;
+
+	// Volume queries against the convex volume bounded by six planes, given in the
+	// form returned by XNA::ComputePlanesFromFrustum: (n, d) with unit n, and a
+	// point p is inside a plane if dot(n, p) + d <= 0.  Nodes entirely inside the
+	// volume are accepted without testing their triangles.
+	//
+	// FrustumOctreeIntersect returns true if any triangle touches the volume, and
+	// FrustumOctreeQuery appends the ids of every such triangle, each id once.  Like
+	// the plane tests they use, both are conservative near the volume's edges.
+	bool FrustumOctreeIntersect(const DirectX::XMVECTOR planes[6])const;
+	void FrustumOctreeQuery(const DirectX::XMVECTOR planes[6], std::vector<unsigned>& triangles)const;
+
+	// 0 if the box is outside one of the planes, 2 if it is inside all of them,
+	// and 1 if it may intersect the volume.
+	static int IntersectBoxPlanes(const OctreeBox& box, const DirectX::XMVECTOR planes[6]);
+
+private:
+	// Per-query ray data precomputed once and shared by every node visit.
+	struct Ray
+	{
+		DirectX::XMVECTOR Pos;
+		DirectX::XMVECTOR Dir;
+
+		// 1/Dir, clamped to +-FLT_MAX so it is finite.
+		DirectX::XMVECTOR InvDir;
+	};
+
+	OctreeBox BuildAABB();
+	void BuildOctree(OctreeNode* parent, const std::vector<unsigned>& triangles, unsigned depth);
+	void AccumulateMemoryUsage(const OctreeNode* node, unsigned& nodeCount, size_t& bytes)const;
+	OctreeNode* UnpackNode(unsigned index, const OctreePackedNode* nodes, unsigned nodeCount, 
+		const unsigned* triangles, unsigned triangleCount, bool& valid);
+
+	bool RayOctreeIntersect(const OctreeNode* parent, const Ray& ray, float tMax)const;
+	void RayOctreeClosestHit(const OctreeNode* parent, const Ray& ray, OctreeHit& hit)const;
+	void RayOctreeClosestHits(const OctreeNode* parent, const Ray* rays, const unsigned* active, unsigned activeCount,
+		unsigned depth, std::deque<std::vector<unsigned> >& childActive, OctreeHit* hits)const;
+
+	bool FrustumOctreeIntersect(const OctreeNode* parent, const DirectX::XMVECTOR planes[6])const;
+	void FrustumOctreeQuery(const OctreeNode* parent, const DirectX::XMVECTOR planes[6], std::vector<unsigned>& triangles)const;
+	void AppendAllTriangles(const OctreeNode* parent, std::vector<unsigned>& triangles)const;
+	int IntersectTriangleVolume(unsigned tri, const DirectX::XMVECTOR planes[6])const;
+
+	unsigned SortChildrenFrontToBack(const OctreeNode* parent, const Ray& ray, float tMax, 
+		unsigned order[8], float tEnter[8])const;
+
+	static bool IntersectRayBox(const Ray& ray, const OctreeBox& box, float tMax, float& tEnter);
+	static bool IntersectRayTriangle(const Ray& ray, DirectX::FXMVECTOR v0, DirectX::FXMVECTOR v1, DirectX::FXMVECTOR v2, 
+		float& t, float& u, float& v);
+	static bool IntersectTriangleBox(DirectX::FXMVECTOR v0, DirectX::FXMVECTOR v1, DirectX::FXMVECTOR v2, 
+		const OctreeBox& box);
+
+private:
+	// Stop subdividing at this depth even if a node still holds many triangles.
+	// Without a limit, many triangles meeting at one point (e.g., a dense fan) 
+	// would be subdivided forever.
+	static const unsigned MaxDepth = 10;
+
+	OctreeNode* mRoot;
+ 
+	std::vector<DirectX::XMFLOAT3> mVertices;
+	std::vector<unsigned> mIndices;
+
+#ifdef OCTREE_QUERY_STATS
+	OctreeQueryStats* mStats;
+#endif
+};
+
+struct OctreeNode
+{
+	#pragma region Properties
+	OctreeBox Bounds;
+
+	// This will be empty except for leaf nodes.  Stores triangle ids; triangle k
+	// has vertex indices mIndices[3*k+0], mIndices[3*k+1], mIndices[3*k+2].
+	std::vector<unsigned> Triangles;
+
+	OctreeNode* Children[8];
+
+	bool IsLeaf;
+	#pragma endregion
+
+	OctreeNode()
+	{
+		for(int i = 0; i < 8; ++i)
+			Children[i] = 0;
+
+		Bounds.Center  = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		Bounds.Extents = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		IsLeaf = false;
+	}
+
+	~OctreeNode()
+	{
+		for(int i = 0; i < 8; ++i)
+			delete Children[i];
+	}
+
+	///<summary>
+	/// Subdivides the bounding box of this node into eight subboxes (vMin[i], vMax[i]) for i = 0:7.
+	///</summary>
+	void Subdivide(OctreeBox box[8])
+	{
+		DirectX::XMFLOAT3 halfExtent(
+			0.5f*Bounds.Extents.x,
+			0.5f*Bounds.Extents.y,
+			0.5f*Bounds.Extents.z);
+
+		// "Top" four quadrants.
+		box[0].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x + halfExtent.x,
+			Bounds.Center.y + halfExtent.y,
+			Bounds.Center.z + halfExtent.z);
+		box[0].Extents = halfExtent;
+
+		box[1].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x - halfExtent.x,
+			Bounds.Center.y + halfExtent.y,
+			Bounds.Center.z + halfExtent.z);
+		box[1].Extents = halfExtent;
+
+		box[2].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x - halfExtent.x,
+			Bounds.Center.y + halfExtent.y,
+			Bounds.Center.z - halfExtent.z);
+		box[2].Extents = halfExtent;
+
+		box[3].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x + halfExtent.x,
+			Bounds.Center.y + halfExtent.y,
+			Bounds.Center.z - halfExtent.z);
+		box[3].Extents = halfExtent;
+
+		// "Bottom" four quadrants.
+		box[4].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x + halfExtent.x,
+			Bounds.Center.y - halfExtent.y,
+			Bounds.Center.z + halfExtent.z);
+		box[4].Extents = halfExtent;
+
+		box[5].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x - halfExtent.x,
+			Bounds.Center.y - halfExtent.y,
+			Bounds.Center.z + halfExtent.z);
+		box[5].Extents = halfExtent;
+
+		box[6].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x - halfExtent.x,
+			Bounds.Center.y - halfExtent.y,
+			Bounds.Center.z - halfExtent.z);
+		box[6].Extents = halfExtent;
+
+		box[7].Center  = DirectX::XMFLOAT3(
+			Bounds.Center.x + halfExtent.x,
+			Bounds.Center.y - halfExtent.y,
+			Bounds.Center.z - halfExtent.z);
+		box[7].Extents = halfExtent;
+	}
+};
+
+#endif // OCTREE_H
\ No newline at end of file
@@ -0,0 +1,170 @@
+//***************************************************************************************
+// ParallelFor.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "ParallelFor.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// One call to ParallelFor::Run.  Lives on the stack of the calling thread.
+	struct Batch
+	{
+		const std::function<void(size_t, size_t)>* Body;
+		size_t Count;
+		size_t GrainSize;
+		size_t NumChunks;
+		std::atomic<size_t> NextChunk;
+
+		// Number of workers currently executing this batch; guarded by the pool mutex.
+		unsigned Busy;
+	};
+
+	class WorkerPool
+	{
+	public:
+		WorkerPool() : mBatch(0), mGeneration(0), mQuit(false)
+		{
+			unsigned n = std::thread::hardware_concurrency();
+			for(unsigned i = 1; i < n; ++i)
+				mThreads.push_back(std::thread(&WorkerPool::WorkerMain, this));
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mQuit = true;
+			}
+			mWakeCV.notify_all();
+
+			for(size_t i = 0; i < mThreads.size(); ++i)
+				mThreads[i].join();
+		}
+
+		unsigned ThreadCount()const
+		{
+			return (unsigned)mThreads.size() + 1;
+		}
+
+		void Run(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+		{
+			if(count == 0)
+				return;
+
+			if(grainSize == 0)
+				grainSize = 1;
+
+			size_t numChunks = (count + grainSize - 1) / grainSize;
+
+			// Run serially if there is nothing to share, or if another batch is in
+			// flight (e.g., a nested call from inside a body).
+			std::unique_lock<std::mutex> runLock(mRunMutex, std::try_to_lock);
+			if(numChunks == 1 || mThreads.empty() || !runLock.owns_lock())
+			{
+				body(0, count);
+				return;
+			}
+
+			Batch batch;
+			batch.Body      = &body;
+			batch.Count     = count;
+			batch.GrainSize = grainSize;
+			batch.NumChunks = numChunks;
+			batch.NextChunk = 0;
+			batch.Busy      = 0;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mBatch = &batch;
+				++mGeneration;
+			}
+			mWakeCV.notify_all();
+
+			Execute(batch);
+
+			// Every chunk has been claimed; stop new workers from joining and wait
+			// for the ones still running to finish theirs.
+			std::unique_lock<std::mutex> lock(mMutex);
+			mBatch = 0;
+			mDoneCV.wait(lock, [&batch]{ return batch.Busy == 0; });
+		}
+
+	private:
+		static void Execute(Batch& batch)
+		{
+			for(;;)
+			{
+				size_t chunk = batch.NextChunk++;
+				if(chunk >= batch.NumChunks)
+					break;
+
+				size_t begin = chunk*batch.GrainSize;
+				size_t end   = begin + batch.GrainSize;
+				if(end > batch.Count)
+					end = batch.Count;
+
+				(*batch.Body)(begin, end);
+			}
+		}
+
+		void WorkerMain()
+		{
+			unsigned seenGeneration = 0;
+			for(;;)
+			{
+				Batch* batch = 0;
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+					mWakeCV.wait(lock, [&]{ return mQuit || (mBatch != 0 && mGeneration != seenGeneration); });
+					if(mQuit)
+						return;
+
+					seenGeneration = mGeneration;
+					batch = mBatch;
+					++batch->Busy;
+				}
+
+				Execute(*batch);
+
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					if(--batch->Busy == 0)
+						mDoneCV.notify_all();
+				}
+			}
+		}
+
+	private:
+		std::vector<std::thread> mThreads;
+
+		std::mutex mRunMutex;
+		std::mutex mMutex;
+		std::condition_variable mWakeCV;
+		std::condition_variable mDoneCV;
+
+		Batch* mBatch;
+		unsigned mGeneration;
+		bool mQuit;
+	};
+
+	WorkerPool& GetPool()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+}
+
+void ParallelFor::Run(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+	GetPool().Run(count, grainSize, body);
+}
+
+unsigned ParallelFor::ThreadCount()
+{
+	return GetPool().ThreadCount();
+}
@@ -0,0 +1,31 @@
+//***************************************************************************************
+// ParallelFor.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Splits a loop over [0, count) into chunks and runs them on a pool of worker
+// threads.  The pool is created on first use and lives for the rest of the program.
+// Only depends on the C++ standard library so it can be used by headless tools.
+//***************************************************************************************
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <cstddef>
+#include <functional>
+
+class ParallelFor
+{
+public:
+	// Calls body(begin, end) for consecutive ranges covering [0, count), each range
+	// holding at most grainSize elements.  The calling thread helps with the work
+	// and Run does not return until every range has been processed.
+	//
+	// The ranges may run in any order and on any thread, so body must only write
+	// to data owned by its range.  Calls made while another Run is in progress
+	// (including from inside body) execute serially on the calling thread.
+	static void Run(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+	// Number of threads that execute work, including the calling thread.
+	static unsigned ThreadCount();
+};
+
+#endif // PARALLELFOR_H